@@ -0,0 +1,137 @@
+
+#include "DataGenerator.h"
+#include <stdexcept>
+
+// Days from 1970-01-01 to 2014-01-01, the first generated date
+static const long kFirstDay = 16071;
+
+// Rows written at once by write()
+static const size_t kWriteBufferSize = 1024 * 1024;
+
+DataGenerator::Options::Options() :
+  rowCount(1000000),
+  duplicateRate(0.1),
+  stbCount(100000),
+  titleCount(5000),
+  providerCount(50),
+  dayCount(365),
+  seed(1)
+{
+}
+
+DataGenerator::DataGenerator(const Options& options) :
+  mOptions(options),
+  mRow(0),
+  mNewKeyCount(0)
+{
+  if (mOptions.stbCount == 0 || mOptions.titleCount == 0 ||
+    mOptions.providerCount == 0 || mOptions.dayCount == 0)
+  {
+    throw std::runtime_error("Every field needs at least one distinct value");
+  }
+  if (mOptions.duplicateRate < 0.0 || mOptions.duplicateRate >= 1.0)
+  {
+    throw std::runtime_error("The duplicate rate has to be at least 0, and less than 1");
+  }
+}
+
+const char* DataGenerator::GetHeader()
+{
+  return "STB|TITLE|PROVIDER|DATE|REV|VIEW_TIME";
+}
+
+uint64_t DataGenerator::random(uint64_t number, uint64_t stream) const
+{
+  // splitmix64, its output doesn't depend on the standard library
+  uint64_t z = mOptions.seed * 0x9E3779B97F4A7C15ULL + number * 0xBF58476D1CE4E5B9ULL +
+    stream * 0x94D049BB133111EBULL;
+  z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+  z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+  return z ^ (z >> 31);
+}
+
+std::string DataGenerator::FormatDay(size_t day)
+{
+  // Civil date of a day count, valid for any day after 1970
+  long z = kFirstDay + (long)day + 719468;
+  long era = z / 146097;
+  long dayOfEra = z - era * 146097;
+  long yearOfEra = (dayOfEra - dayOfEra / 1460 + dayOfEra / 36524 - dayOfEra / 146096) / 365;
+  long dayOfYear = dayOfEra - (365 * yearOfEra + yearOfEra / 4 - yearOfEra / 100);
+  long shiftedMonth = (5 * dayOfYear + 2) / 153;
+  long dayOfMonth = dayOfYear - (153 * shiftedMonth + 2) / 5 + 1;
+  long month = shiftedMonth < 10 ? shiftedMonth + 3 : shiftedMonth - 9;
+  long year = yearOfEra + era * 400 + (month <= 2 ? 1 : 0);
+
+  char date[16];
+  sprintf(date, "%04d-%02d-%02d", (int)(year % 10000), (int)month, (int)dayOfMonth);
+  return date;
+}
+
+bool DataGenerator::next(std::string* outLine)
+{
+  if (mRow == mOptions.rowCount)
+  {
+    return false;
+  }
+
+  uint64_t row = mRow++;
+
+  // Keys are numbered in the order they are first drawn, a duplicate
+  // picks any of those before it
+  double draw = (double)(random(row, 0) >> 11) / 9007199254740992.0;
+  uint64_t key;
+  if (mNewKeyCount > 0 && draw < mOptions.duplicateRate)
+  {
+    key = random(row, 1) % mNewKeyCount;
+  }
+  else
+  {
+    key = mNewKeyCount++;
+  }
+
+  unsigned stb = (unsigned)(random(key, 2) % mOptions.stbCount);
+  unsigned title = (unsigned)(random(key, 3) % mOptions.titleCount);
+  unsigned provider = (unsigned)(random(title, 4) % mOptions.providerCount);
+  std::string date = FormatDay((size_t)(random(key, 5) % mOptions.dayCount));
+
+  // A price of 1.00 to 9.99, and 5 minutes to 3 hours of viewing
+  unsigned cents = (unsigned)(100 + random(row, 6) % 900);
+  unsigned minutes = (unsigned)(5 + random(row, 7) % 176);
+
+  char line[256];
+  sprintf(line, "stb%u|title %u|prov%u|%s|%u.%02u|%u:%02u", stb, title, provider,
+    date.c_str(), cents / 100, cents % 100, minutes / 60, minutes % 60);
+  outLine->assign(line);
+
+  return true;
+}
+
+bool DataGenerator::write(FILE* output)
+{
+  std::string buffer(GetHeader());
+  buffer += '\n';
+
+  for (std::string line; next(&line);)
+  {
+    buffer += line;
+    buffer += '\n';
+
+    if (buffer.size() >= kWriteBufferSize)
+    {
+      if (fwrite(buffer.data(), 1, buffer.size(), output) != buffer.size())
+      {
+        return false;
+      }
+      buffer.clear();
+    }
+  }
+
+  return fwrite(buffer.data(), 1, buffer.size(), output) == buffer.size() &&
+    fflush(output) == 0;
+}
+
+size_t DataGenerator::getNewKeyCount() const
+{
+  return mNewKeyCount;
+}
@@ -0,0 +1,67 @@
+
+#ifndef __DATA_GENERATOR_H__
+#define __DATA_GENERATOR_H__
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string>
+
+/**
+  Generates bar delimited rows shaped like examples/Example1.txt, for the
+  fields of examples/Scheme.json: STB|TITLE|PROVIDER|DATE|REV|VIEW_TIME.
+  The same options always generate the same rows, on any platform.
+
+  Some rows repeat the key (STB, TITLE and DATE) of an earlier row, which
+  an import replaces.  The other rows draw a new key, which may still
+  repeat an earlier one by chance if the key space is small.  A title is
+  always distributed by the same provider.
+*/
+class DataGenerator
+{
+public:
+  struct Options
+  {
+    Options();
+
+    size_t rowCount;
+    /** Fraction of the rows that repeat the key of an earlier row */
+    double duplicateRate;
+    /** Distinct values of STB, TITLE, PROVIDER and DATE */
+    size_t stbCount;
+    size_t titleCount;
+    size_t providerCount;
+    /** Dates are consecutive days from 2014-01-01 */
+    size_t dayCount;
+    uint64_t seed;
+  };
+
+  explicit DataGenerator(const Options& options);
+
+  /** The first line of the file, naming the fields */
+  static const char* GetHeader();
+
+  /**
+    Write the next row into line, without a newline.  Returns false once
+    all the rows have been generated.
+  */
+  bool next(std::string* outLine);
+
+  /** Write the header and all the remaining rows, returns false on error */
+  bool write(FILE* output);
+
+  /** Keys drawn so far that don't repeat an earlier row on purpose */
+  size_t getNewKeyCount() const;
+
+  /** A date of the generated rows, day 0 is 2014-01-01, as YYYY-MM-DD */
+  static std::string FormatDay(size_t day);
+
+private:
+  /** A well mixed 64 bit hash of the seed, a number and a stream */
+  uint64_t random(uint64_t number, uint64_t stream) const;
+
+  Options mOptions;
+  size_t mRow;
+  size_t mNewKeyCount;
+};
+
+#endif
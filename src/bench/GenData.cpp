@@ -0,0 +1,83 @@
+
+/** Generates bar delimited input for import, shaped like examples/Example1.txt
+    and matching examples/Scheme.json.  The same options always generate the
+    same rows.
+
+    gendata -n 1000000 --duplicates 0.1 -o rows.txt
+*/
+
+#include <iostream>
+#include <string>
+#include <stdio.h>
+#include <tclap/CmdLine.h>
+#include "DataGenerator.h"
+
+int main(int argc, char** argv)
+{
+  try
+  {
+    DataGenerator::Options defaults;
+
+    TCLAP::CmdLine cmd("Synthetic data generator", ' ');
+    TCLAP::ValueArg<unsigned int> rowsArg("n", "rows", "Number of rows to generate", false, (unsigned int)defaults.rowCount, "Row count");
+    TCLAP::ValueArg<double> duplicatesArg("", "duplicates", "Fraction of the rows that repeat the key (STB, TITLE and DATE) of an earlier row, from 0 up to 1", false, defaults.duplicateRate, "Rate");
+    TCLAP::ValueArg<unsigned int> stbsArg("", "stbs", "Number of distinct set top boxes", false, (unsigned int)defaults.stbCount, "Count");
+    TCLAP::ValueArg<unsigned int> titlesArg("", "titles", "Number of distinct titles", false, (unsigned int)defaults.titleCount, "Count");
+    TCLAP::ValueArg<unsigned int> providersArg("", "providers", "Number of distinct providers, each title has one", false, (unsigned int)defaults.providerCount, "Count");
+    TCLAP::ValueArg<unsigned int> daysArg("", "days", "Number of distinct dates, consecutive days from 2014-01-01", false, (unsigned int)defaults.dayCount, "Count");
+    TCLAP::ValueArg<unsigned int> seedArg("", "seed", "Another seed generates other rows", false, (unsigned int)defaults.seed, "Seed");
+    TCLAP::ValueArg<std::string> outputArg("o", "output", "File to write, if omitted, rows are written to stdout", false, "", "Output file");
+    cmd.add(rowsArg);
+    cmd.add(duplicatesArg);
+    cmd.add(stbsArg);
+    cmd.add(titlesArg);
+    cmd.add(providersArg);
+    cmd.add(daysArg);
+    cmd.add(seedArg);
+    cmd.add(outputArg);
+    cmd.parse(argc, argv);
+
+    DataGenerator::Options options;
+    options.rowCount = rowsArg.getValue();
+    options.duplicateRate = duplicatesArg.getValue();
+    options.stbCount = stbsArg.getValue();
+    options.titleCount = titlesArg.getValue();
+    options.providerCount = providersArg.getValue();
+    options.dayCount = daysArg.getValue();
+    options.seed = seedArg.getValue();
+
+    DataGenerator generator(options);
+
+    FILE* output = stdout;
+    if (outputArg.isSet())
+    {
+      output = fopen(outputArg.getValue().c_str(), "wb");
+      if (output == NULL)
+      {
+        throw std::runtime_error("Unable to write \"" + outputArg.getValue() + "\"");
+      }
+    }
+
+    bool isWritten = generator.write(output);
+    if (output != stdout && fclose(output) != 0)
+    {
+      isWritten = false;
+    }
+    if (!isWritten)
+    {
+      throw std::runtime_error("Unable to write the rows");
+    }
+  }
+  catch (TCLAP::ArgException &e)
+  {
+    std::cerr << "error: " << e.error() << " for arg " << e.argId() << std::endl;
+    return 1;
+  }
+  catch (std::exception& ex)
+  {
+    std::cerr << "error: " << ex.what() << std::endl;
+    return 1;
+  }
+
+  return 0;
+}
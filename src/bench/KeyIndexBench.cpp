@@ -0,0 +1,164 @@
+
+/** Measures how put() into the concurrent key index scales from 1 to 32
+    threads, and checks every thread count collapses the rows to the same
+    winners as a single thread does.
+
+    keyindexbench [rows] [distinct keys]
+*/
+
+#include <iostream>
+#include <vector>
+#include <thread>
+#include <chrono>
+#include <stdio.h>
+#include <stdlib.h>
+#include <datastore/ConcurrentKeyIndex.h>
+#include <datastore/Database.h>
+#include <datastore/JsonStorage.h>
+
+/**
+  The key fields of examples/Scheme.json
+*/
+static const char* kScheme =
+  "["
+  "  {\"name\": \"STB\", \"type\": \"text\", \"size\": 64, \"key\": true},"
+  "  {\"name\": \"TITLE\", \"type\": \"text\", \"size\": 64, \"key\": true},"
+  "  {\"name\": \"DATE\", \"type\": \"date\", \"key\": true}"
+  "]";
+
+/**
+  Rows whose keys repeat every keyCount rows
+*/
+void generateRows(DataStore::Database& database, size_t rowCount, size_t keyCount,
+  DataStore::IRowConstList* outRows)
+{
+  DataStore::IFieldDescriptorConstListConstPtrH fields =
+    database.getScheme()->getFieldDescriptors();
+
+  outRows->reserve(rowCount);
+
+  char text[64];
+  for (size_t i = 0; i < rowCount; ++i)
+  {
+    size_t key = i % keyCount;
+
+    DataStore::IRowPtrH row = database.createRow();
+    sprintf(text, "stb%u", (unsigned)(key / 1000));
+    row->setValue(*(*fields)[0], (*fields)[0]->fromString(text));
+    sprintf(text, "title number %u", (unsigned)(key % 1000 / 28));
+    row->setValue(*(*fields)[1], (*fields)[1]->fromString(text));
+    sprintf(text, "2014-04-%02u", (unsigned)(key % 28 + 1));
+    row->setValue(*(*fields)[2], (*fields)[2]->fromString(text));
+
+    outRows->push_back(row);
+  }
+}
+
+/**
+  Put rows with threadCount threads, each taking a contiguous slice as
+  Database::insertBatch does, and return the seconds taken
+*/
+double putRows(const DataStore::IRowConstList& rows, size_t threadCount,
+  DataStore::ConcurrentKeyIndex* index)
+{
+  std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+  std::vector<std::thread> threads;
+  for (size_t thread = 0; thread < threadCount; ++thread)
+  {
+    size_t first = rows.size() * thread / threadCount;
+    size_t last = rows.size() * (thread + 1) / threadCount;
+
+    threads.push_back(std::thread([&rows, index, first, last]()
+    {
+      for (size_t i = first; i < last; ++i)
+      {
+        index->put(rows[i], index->hash(*rows[i]), i);
+      }
+    }));
+  }
+  for (size_t thread = 0; thread < threadCount; ++thread)
+  {
+    threads[thread].join();
+  }
+
+  std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+  return elapsed.count();
+}
+
+bool sameEntries(const DataStore::ConcurrentKeyIndex::EntryList& left,
+  const DataStore::ConcurrentKeyIndex::EntryList& right)
+{
+  if (left.size() != right.size())
+  {
+    return false;
+  }
+
+  for (size_t i = 0; i < left.size(); ++i)
+  {
+    if (left[i].row != right[i].row || left[i].firstSequence != right[i].firstSequence ||
+      left[i].lastSequence != right[i].lastSequence || left[i].occurrences != right[i].occurrences)
+    {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+int main(int argc, char** argv)
+{
+  size_t rowCount = argc > 1 ? (size_t)atol(argv[1]) : 1000000;
+  size_t keyCount = argc > 2 ? (size_t)atol(argv[2]) : rowCount / 4;
+  if (rowCount < 1 || keyCount < 1)
+  {
+    std::cerr << "error: The row and key counts have to be positive" << std::endl;
+    return 1;
+  }
+
+  try
+  {
+    DataStore::Database database(DataStore::ISchemeConstPtrH(new DataStore::SchemeJson(kScheme)));
+
+    DataStore::IRowConstList rows;
+    generateRows(database, rowCount, keyCount, &rows);
+
+    DataStore::IFieldDescriptorConstList keyFields(*database.getScheme()->getFieldDescriptors());
+
+    std::cout << "Rows: " << rowCount << ", distinct keys: " << std::min(rowCount, keyCount)
+      << ", hardware threads: " << std::thread::hardware_concurrency() << std::endl;
+
+    DataStore::ConcurrentKeyIndex::EntryList expected;
+    double singleSeconds = 0.0;
+
+    for (size_t threadCount = 1; threadCount <= 32; threadCount *= 2)
+    {
+      DataStore::ConcurrentKeyIndex index(keyFields);
+      double seconds = putRows(rows, threadCount, &index);
+
+      DataStore::ConcurrentKeyIndex::EntryList entries;
+      index.getEntries(&entries);
+
+      if (threadCount == 1)
+      {
+        expected.swap(entries);
+        singleSeconds = seconds;
+      }
+      else if (!sameEntries(expected, entries))
+      {
+        std::cerr << "error: " << threadCount << " threads disagree with 1 thread" << std::endl;
+        return 1;
+      }
+
+      std::cout << threadCount << " threads: " << (rowCount / seconds / 1000000.0)
+        << " M rows/s, speedup " << (singleSeconds / seconds) << "x" << std::endl;
+    }
+  }
+  catch (std::exception& ex)
+  {
+    std::cerr << "error: " << ex.what() << std::endl;
+    return 1;
+  }
+
+  return 0;
+}
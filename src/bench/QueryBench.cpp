@@ -0,0 +1,500 @@
+
+/** Times the steps of a report over generated rows, at each of a number of
+    sizes: generating the input, importing it, writing a snapshot, loading
+    the snapshot, filters, an ordered query, group by and writing a result.
+    Import and the snapshot are run with the import tool, the rest in this
+    process.  Results go out as JSON, one entry per size and step:
+
+    @verbatim
+    {"rows": 1000000, "benchmark": "filter_title", "seconds": 0.012,
+     "first_seconds": 0.031, "rows_per_second": 8.3e+07, "result_rows": 201}
+    @endverbatim
+
+    seconds is the median of the repetitions, first_seconds the first one
+    (e.g. before the pages of the snapshot were read).
+
+    querybench --rows 1000000,10000000 --import bin/import/import
+      --scheme examples/Scheme.json -o bench.json
+*/
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <sstream>
+#include <algorithm>
+#include <chrono>
+#include <thread>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <tclap/CmdLine.h>
+#include <rapidjson/prettywriter.h>
+#include <rapidjson/stringbuffer.h>
+#include <datastore/Database.h>
+#include <datastore/SnapshotStorage.h>
+#include <query/ResultWriter.h>
+#include "DataGenerator.h"
+
+#ifdef _WIN32
+static const char* kNullDevice = "NUL";
+#else
+static const char* kNullDevice = "/dev/null";
+#endif
+
+typedef std::chrono::steady_clock Clock;
+
+/**
+  The timings of one step at one size
+*/
+struct BenchResult
+{
+  BenchResult() :
+    rows(0), seconds(0.0), firstSeconds(0.0), hasResultRows(false), resultRows(0)
+  {
+  }
+
+  size_t rows;
+  std::string name;
+  double seconds;
+  double firstSeconds;
+  /** Only queries have result rows */
+  bool hasResultRows;
+  size_t resultRows;
+};
+
+typedef std::vector<BenchResult> BenchResultList;
+
+/**
+  Run step repeatCount times, step returns the rows it produced
+*/
+template <typename Step>
+BenchResult measure(const char* name, size_t rows, size_t repeatCount, Step step)
+{
+  BenchResult result;
+  result.rows = rows;
+  result.name = name;
+
+  std::vector<double> seconds;
+  for (size_t run = 0; run < repeatCount; ++run)
+  {
+    Clock::time_point start = Clock::now();
+    result.resultRows = step();
+    std::chrono::duration<double> elapsed = Clock::now() - start;
+    seconds.push_back(elapsed.count());
+  }
+
+  result.firstSeconds = seconds[0];
+  std::sort(seconds.begin(), seconds.end());
+  result.seconds = seconds[seconds.size() / 2];
+
+  std::cerr << rows << " rows, " << name << ": " << result.seconds << " s" << std::endl;
+  return result;
+}
+
+/**
+  Run a command, throw if it fails
+*/
+void runTool(const std::string& command)
+{
+  std::string quiet = command + " > " + kNullDevice;
+  if (system(quiet.c_str()) != 0)
+  {
+    throw std::runtime_error("Failed: " + command);
+  }
+}
+
+std::string quote(const std::string& path)
+{
+  return "\"" + path + "\"";
+}
+
+/**
+  Comma separated row counts
+*/
+std::vector<size_t> parseSizes(const std::string& expression)
+{
+  std::vector<size_t> sizes;
+
+  std::istringstream tokenStream(expression);
+  for (std::string size; std::getline(tokenStream, size, ',');)
+  {
+    size_t rows = (size_t)strtoull(size.c_str(), NULL, 10);
+    if (rows == 0)
+    {
+      throw std::runtime_error("Invalid row count \"" + size + "\"");
+    }
+    sizes.push_back(rows);
+  }
+
+  return sizes;
+}
+
+DataStore::IFieldDescriptorConstPtrH findField(const DataStore::Database& database,
+  const char* name)
+{
+  DataStore::IFieldDescriptorConstListConstPtrH fields =
+    database.getScheme()->getFieldDescriptors();
+
+  for (DataStore::IFieldDescriptorConstList::const_iterator field = fields->cbegin();
+    field != fields->cend(); ++field)
+  {
+    if (strcmp((*field)->getName(), name) == 0)
+    {
+      return *field;
+    }
+  }
+
+  throw std::runtime_error(std::string("The scheme has no field ") + name);
+}
+
+DataStore::IFieldDescriptorConstListPtrH fieldList(const DataStore::Database& database,
+  const char* first, const char* second = NULL, const char* third = NULL)
+{
+  DataStore::IFieldDescriptorConstListPtrH fields(new DataStore::IFieldDescriptorConstList());
+
+  const char* names[] = { first, second, third };
+  for (size_t name = 0; name < 3 && names[name] != NULL; ++name)
+  {
+    fields->push_back(findField(database, names[name]));
+  }
+
+  return fields;
+}
+
+/**
+  The rows from dayCount days, starting with the first generated one
+*/
+DataStore::Predicate firstDays(const DataStore::Database& database, size_t dayCount)
+{
+  DataStore::IFieldDescriptorConstPtrH date = findField(database, "DATE");
+
+  return DataStore::Predicate(DataStore::IQualifierPtrH(new DataStore::Logic::Range(date,
+    date->fromString(DataGenerator::FormatDay(0).c_str()),
+    date->fromString(DataGenerator::FormatDay(dayCount - 1).c_str()))));
+}
+
+/**
+  Read every row of cursor, returns how many there were
+*/
+size_t drain(DataStore::IQueryCursor* cursor)
+{
+  size_t rows = 0;
+  while (cursor->next() != NULL)
+  {
+    ++rows;
+  }
+
+  return rows;
+}
+
+/**
+  Time every step at rowCount rows
+*/
+void runSize(size_t rowCount, const DataGenerator::Options& generatorOptions,
+  const std::string& importTool, const std::string& schemeFilename,
+  const std::string& workDir, size_t repeatCount, bool keepsFiles,
+  BenchResultList* outResults)
+{
+  std::ostringstream prefix;
+  prefix << workDir << "/bench-" << rowCount;
+  std::string inputFilename = prefix.str() + ".txt";
+  std::string databaseFilename = prefix.str() + ".json";
+  std::string snapshotFilename = prefix.str() + ".snap";
+
+  DataGenerator::Options options(generatorOptions);
+  options.rowCount = rowCount;
+
+  outResults->push_back(measure("generate", rowCount, 1, [&]()
+  {
+    FILE* input = fopen(inputFilename.c_str(), "wb");
+    if (input == NULL)
+    {
+      throw std::runtime_error("Unable to write \"" + inputFilename + "\"");
+    }
+
+    DataGenerator generator(options);
+    bool isWritten = generator.write(input);
+    if (fclose(input) != 0 || !isWritten)
+    {
+      throw std::runtime_error("Unable to write \"" + inputFilename + "\"");
+    }
+
+    return rowCount;
+  }));
+
+  //
+  // A bulk import sorts by key out of memory, so it scales to any size
+  //
+
+  remove(databaseFilename.c_str());
+  runTool(quote(importTool) + " -c " + quote(schemeFilename) + " -d " + quote(databaseFilename));
+
+  std::ostringstream threads;
+  threads << std::max(1u, std::thread::hardware_concurrency());
+
+  outResults->push_back(measure("import", rowCount, 1, [&]()
+  {
+    runTool(quote(importTool) + " -d " + quote(databaseFilename) + " -i " +
+      quote(inputFilename) + " -b -t " + threads.str());
+    return rowCount;
+  }));
+
+  outResults->push_back(measure("snapshot", rowCount, 1, [&]()
+  {
+    runTool(quote(importTool) + " -d " + quote(databaseFilename) + " --snapshot " +
+      quote(snapshotFilename));
+    return rowCount;
+  }));
+
+  {
+    //
+    // Queries run on the snapshot, as query does
+    //
+
+    DataStore::DatabasePtrH database;
+    outResults->push_back(measure("load", rowCount, repeatCount, [&]()
+    {
+      database = DataStore::DatabasePtrH(new DataStore::Database(
+        DataStore::DataStorageSnapshot::Open(snapshotFilename.c_str())));
+      return rowCount;
+    }));
+
+    DataStore::IFieldDescriptorConstPtrH title = findField(*database, "TITLE");
+    DataStore::IFieldDescriptorConstPtrH rev = findField(*database, "REV");
+    DataStore::IFieldDescriptorConstListPtrH selectStb = fieldList(*database, "STB");
+
+    // One title, a week and the cheapest 6% of the rows
+    DataStore::Predicate oneTitle(DataStore::IQualifierPtrH(
+      new DataStore::Logic::Exact(title, title->fromString("title 1"))));
+    DataStore::Predicate oneWeek = firstDays(*database, std::min(options.dayCount, (size_t)7));
+    DataStore::Predicate cheap(DataStore::IQualifierPtrH(
+      new DataStore::Logic::Range(rev, NULL, rev->fromString("1.50"))));
+
+    BenchResultList queries;
+    queries.push_back(measure("filter_title", rowCount, repeatCount, [&]()
+    {
+      return drain(database->openCursor(selectStb, &oneTitle).get());
+    }));
+    queries.push_back(measure("filter_date_range", rowCount, repeatCount, [&]()
+    {
+      return drain(database->openCursor(selectStb, &oneWeek).get());
+    }));
+    queries.push_back(measure("filter_rev_range", rowCount, repeatCount, [&]()
+    {
+      return drain(database->openCursor(selectStb, &cheap).get());
+    }));
+
+    // A month, by price
+    DataStore::Predicate oneMonth = firstDays(*database, std::min(options.dayCount, (size_t)30));
+    DataStore::IFieldDescriptorConstListPtrH monthFields = fieldList(*database, "TITLE", "REV", "DATE");
+    DataStore::IFieldDescriptorConstListPtrH byPrice = fieldList(*database, "REV", "TITLE");
+    queries.push_back(measure("order_by", rowCount, repeatCount, [&]()
+    {
+      return drain(database->openCursor(monthFields, &oneMonth, byPrice).get());
+    }));
+
+    // The first run also sums the rows of the snapshot
+    queries.push_back(measure("group_by", rowCount, repeatCount, [&]()
+    {
+      return drain(database->openAggregateCursor(title).get());
+    }));
+
+    queries.push_back(measure("output", rowCount, repeatCount, [&]()
+    {
+      FILE* output = fopen(kNullDevice, "wb");
+      if (output == NULL)
+      {
+        throw std::runtime_error("Unable to open the null device");
+      }
+
+      DataStore::IQueryCursorPtrH cursor = database->openCursor();
+      DataStore::IFieldDescriptorConstListConstPtrH fields = cursor->getFieldDescriptors();
+
+      size_t rows = 0;
+      {
+        ResultWriter writer(output);
+        for (const DataStore::IRow* row = cursor->next(); row != NULL; row = cursor->next())
+        {
+          writer.writeRow(*row, *fields);
+          ++rows;
+        }
+        writer.flush();
+      }
+
+      fclose(output);
+      return rows;
+    }));
+
+    for (BenchResultList::iterator query = queries.begin(); query != queries.end(); ++query)
+    {
+      query->hasResultRows = true;
+      outResults->push_back(*query);
+    }
+  }
+
+  if (!keepsFiles)
+  {
+    remove(inputFilename.c_str());
+    remove(databaseFilename.c_str());
+    remove(snapshotFilename.c_str());
+  }
+}
+
+void writeString(rapidjson::PrettyWriter<rapidjson::StringBuffer>& writer, const std::string& text)
+{
+  writer.String(text.c_str(), (rapidjson::SizeType)text.size());
+}
+
+/**
+  The results, and what they were measured with
+*/
+std::string formatResults(const BenchResultList& results,
+  const DataGenerator::Options& options, size_t repeatCount)
+{
+  rapidjson::StringBuffer buffer;
+  rapidjson::PrettyWriter<rapidjson::StringBuffer> writer(buffer);
+
+  writer.StartObject();
+
+  writeString(writer, "generator");
+  writer.StartObject();
+  writeString(writer, "duplicate_rate");
+  writer.Double(options.duplicateRate);
+  writeString(writer, "stbs");
+  writer.Uint64(options.stbCount);
+  writeString(writer, "titles");
+  writer.Uint64(options.titleCount);
+  writeString(writer, "providers");
+  writer.Uint64(options.providerCount);
+  writeString(writer, "days");
+  writer.Uint64(options.dayCount);
+  writeString(writer, "seed");
+  writer.Uint64(options.seed);
+  writer.EndObject();
+
+  writeString(writer, "hardware_threads");
+  writer.Uint(std::thread::hardware_concurrency());
+  writeString(writer, "repeat");
+  writer.Uint64(repeatCount);
+
+  writeString(writer, "results");
+  writer.StartArray();
+  for (BenchResultList::const_iterator result = results.cbegin();
+    result != results.cend(); ++result)
+  {
+    writer.StartObject();
+    writeString(writer, "rows");
+    writer.Uint64(result->rows);
+    writeString(writer, "benchmark");
+    writeString(writer, result->name);
+    writeString(writer, "seconds");
+    writer.Double(result->seconds);
+    writeString(writer, "first_seconds");
+    writer.Double(result->firstSeconds);
+    writeString(writer, "rows_per_second");
+    writer.Double(result->seconds > 0.0 ? result->rows / result->seconds : 0.0);
+    if (result->hasResultRows)
+    {
+      writeString(writer, "result_rows");
+      writer.Uint64(result->resultRows);
+    }
+    writer.EndObject();
+  }
+  writer.EndArray();
+
+  writer.EndObject();
+
+  return std::string(buffer.GetString()) + "\n";
+}
+
+int main(int argc, char** argv)
+{
+  try
+  {
+    DataGenerator::Options defaults;
+
+    TCLAP::CmdLine cmd("Benchmarks of import, load, filter, order by, group by and output", ' ');
+    TCLAP::ValueArg<std::string> rowsArg("", "rows", "Comma separated row counts to run at, e.g. 1000000,10000000,100000000", false, "1000000", "Row counts");
+    TCLAP::ValueArg<std::string> importArg("", "import", "The import tool", false, "import", "Path");
+    TCLAP::ValueArg<std::string> schemeArg("", "scheme", "The scheme to import with, examples/Scheme.json", false, "Scheme.json", "JSON scheme file");
+    TCLAP::ValueArg<std::string> workDirArg("", "work-dir", "Directory for the generated input, database and snapshot", false, ".", "Directory");
+    TCLAP::ValueArg<std::string> outputArg("o", "output", "File to write the JSON results to, if omitted, they are written to stdout", false, "", "Output file");
+    TCLAP::ValueArg<unsigned int> repeatArg("", "repeat", "Times each query is run, its median time is reported", false, 3, "Count");
+    TCLAP::SwitchArg keepArg("", "keep", "Keep the generated input, database and snapshot", false);
+    TCLAP::ValueArg<double> duplicatesArg("", "duplicates", "Fraction of the rows that repeat the key of an earlier row", false, defaults.duplicateRate, "Rate");
+    TCLAP::ValueArg<unsigned int> stbsArg("", "stbs", "Number of distinct set top boxes", false, (unsigned int)defaults.stbCount, "Count");
+    TCLAP::ValueArg<unsigned int> titlesArg("", "titles", "Number of distinct titles", false, (unsigned int)defaults.titleCount, "Count");
+    TCLAP::ValueArg<unsigned int> providersArg("", "providers", "Number of distinct providers", false, (unsigned int)defaults.providerCount, "Count");
+    TCLAP::ValueArg<unsigned int> daysArg("", "days", "Number of distinct dates", false, (unsigned int)defaults.dayCount, "Count");
+    TCLAP::ValueArg<unsigned int> seedArg("", "seed", "Seed of the generated rows", false, (unsigned int)defaults.seed, "Seed");
+    cmd.add(rowsArg);
+    cmd.add(importArg);
+    cmd.add(schemeArg);
+    cmd.add(workDirArg);
+    cmd.add(outputArg);
+    cmd.add(repeatArg);
+    cmd.add(keepArg);
+    cmd.add(duplicatesArg);
+    cmd.add(stbsArg);
+    cmd.add(titlesArg);
+    cmd.add(providersArg);
+    cmd.add(daysArg);
+    cmd.add(seedArg);
+    cmd.parse(argc, argv);
+
+    DataGenerator::Options options;
+    options.duplicateRate = duplicatesArg.getValue();
+    options.stbCount = stbsArg.getValue();
+    options.titleCount = titlesArg.getValue();
+    options.providerCount = providersArg.getValue();
+    options.dayCount = daysArg.getValue();
+    options.seed = seedArg.getValue();
+
+    // Fail on bad options before any step runs
+    DataGenerator check(options);
+
+    size_t repeatCount = std::max(1u, repeatArg.getValue());
+    std::vector<size_t> sizes = parseSizes(rowsArg.getValue());
+
+    BenchResultList results;
+    for (std::vector<size_t>::const_iterator rows = sizes.cbegin(); rows != sizes.cend(); ++rows)
+    {
+      runSize(*rows, options, importArg.getValue(), schemeArg.getValue(),
+        workDirArg.getValue(), repeatCount, keepArg.getValue(), &results);
+    }
+
+    std::string json = formatResults(results, options, repeatCount);
+
+    FILE* output = stdout;
+    if (outputArg.isSet())
+    {
+      output = fopen(outputArg.getValue().c_str(), "w");
+      if (output == NULL)
+      {
+        throw std::runtime_error("Unable to write \"" + outputArg.getValue() + "\"");
+      }
+    }
+
+    bool isWritten = fputs(json.c_str(), output) >= 0;
+    if (output != stdout && fclose(output) != 0)
+    {
+      isWritten = false;
+    }
+    if (!isWritten)
+    {
+      throw std::runtime_error("Unable to write the results");
+    }
+  }
+  catch (TCLAP::ArgException &e)
+  {
+    std::cerr << "error: " << e.error() << " for arg " << e.argId() << std::endl;
+    return 1;
+  }
+  catch (std::exception& ex)
+  {
+    std::cerr << "error: " << ex.what() << std::endl;
+    return 1;
+  }
+
+  return 0;
+}
@@ -0,0 +1,219 @@
+/** Measures how fast import input can be split into lines and fields:
+    std::getline with a string stream (the original importer), a byte at
+    a time scan, and the tokenizer with the SIMD scan picked for this CPU.
+
+    scanbench [input file] [repetitions]
+*/
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <import/CharScan.h>
+#include <import/Tokenizer.h>
+
+static const char kFieldDelimiter = '|';
+
+struct Counts
+{
+  Counts() : lines(0), fields(0) {}
+
+  bool operator==(const Counts& other) const
+  {
+    return lines == other.lines && fields == other.fields;
+  }
+
+  size_t lines;
+  size_t fields;
+};
+
+/**
+  Rows shaped like examples/Example1.txt
+*/
+std::string generateInput(size_t rows)
+{
+  std::string input("STB|TITLE|PROVIDER|DATE|REV|VIEW_TIME\n");
+
+  char line[128];
+  for (size_t i = 0; i < rows; ++i)
+  {
+    sprintf(line, "stb%u|title number %u|provider %u|2014-%02u-%02u|%u.%02u|%u:%02u\n",
+      (unsigned)(i % 10007), (unsigned)(i % 3001), (unsigned)(i % 17),
+      (unsigned)(i % 12 + 1), (unsigned)(i % 28 + 1), (unsigned)(i % 10),
+      (unsigned)(i % 100), (unsigned)(i % 5), (unsigned)(i % 60));
+    input += line;
+  }
+
+  return input;
+}
+
+Counts scanGetline(const std::string& input)
+{
+  Counts counts;
+
+  std::istringstream stream(input);
+  for (std::string row; std::getline(stream, row);)
+  {
+    ++counts.lines;
+
+    std::istringstream tokenStream(row);
+    for (std::string field; std::getline(tokenStream, field, kFieldDelimiter);)
+    {
+      ++counts.fields;
+    }
+  }
+
+  return counts;
+}
+
+Counts scanScalar(std::vector<char>& block)
+{
+  Counts counts;
+
+  const char* position = &block[0];
+  const char* end = position + block.size();
+
+  const char* line = position;
+
+  while (position != end)
+  {
+    const char* found = FindFirstOfScalar(position, end, kFieldDelimiter, '\n');
+    if (found == end)
+    {
+      break;
+    }
+
+    // An empty line has no fields
+    if (*found == '\n')
+    {
+      if (found != line)
+      {
+        ++counts.fields;
+      }
+
+      ++counts.lines;
+      line = found + 1;
+    }
+    else
+    {
+      ++counts.fields;
+    }
+
+    position = found + 1;
+  }
+
+  return counts;
+}
+
+Counts scanTokenizer(std::vector<char>& block)
+{
+  Counts counts;
+
+  Tokenizer tokenizer(kFieldDelimiter);
+  tokenizer.reset(&block[0], &block[0] + block.size());
+
+  FieldList fields;
+  while (tokenizer.nextLine(&fields))
+  {
+    ++counts.lines;
+    counts.fields += fields.size();
+  }
+
+  return counts;
+}
+
+template <typename Scan>
+double measure(const char* name, const std::string& input, int repetitions, 
+  Scan scan, Counts* outCounts)
+{
+  std::vector<char> block;
+  double seconds = 0.0;
+
+  for (int i = 0; i < repetitions; ++i)
+  {
+    // The tokenizer writes into the block, so start each pass from a copy
+    block.assign(input.begin(), input.end());
+
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    *outCounts = scan(input, block);
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+    seconds += elapsed.count();
+  }
+
+  double megabytes = (double)input.size() * repetitions / (1024.0 * 1024.0);
+  std::cout << name << ": " << (megabytes / seconds) << " MB/s" << std::endl;
+
+  return seconds;
+}
+
+int main(int argc, char** argv)
+{
+  std::string input;
+
+  if (argc > 1)
+  {
+    std::ifstream file(argv[1], std::ios::in | std::ios::binary);
+    if (!file.is_open())
+    {
+      std::cerr << "error: Unable to open input file \"" << argv[1] << "\"" << std::endl;
+      return 1;
+    }
+
+    std::stringstream contents;
+    contents << file.rdbuf();
+    input = contents.str();
+  }
+  else
+  {
+    input = generateInput(1000000);
+  }
+
+  if (input.empty() || input[input.size() - 1] != '\n')
+  {
+    input += '\n';
+  }
+
+  int repetitions = argc > 2 ? atoi(argv[2]) : 5;
+  if (repetitions < 1)
+  {
+    repetitions = 1;
+  }
+
+  std::cout << "Input: " << input.size() << " bytes, " << repetitions 
+    << " repetitions, scan method " << GetCharScanMethod() << std::endl;
+
+  Counts getlineCounts;
+  Counts scalarCounts;
+  Counts tokenizerCounts;
+
+  double getlineSeconds = measure("std::getline", input, repetitions,
+    [](const std::string& text, std::vector<char>&) { return scanGetline(text); },
+    &getlineCounts);
+
+  measure("scalar", input, repetitions,
+    [](const std::string&, std::vector<char>& block) { return scanScalar(block); },
+    &scalarCounts);
+
+  double tokenizerSeconds = measure("tokenizer", input, repetitions,
+    [](const std::string&, std::vector<char>& block) { return scanTokenizer(block); },
+    &tokenizerCounts);
+
+  std::cout << "Speedup over std::getline: " << (getlineSeconds / tokenizerSeconds) 
+    << "x" << std::endl;
+
+  // std::getline drops a trailing empty field, so only lines are compared 
+  // with it
+  if (getlineCounts.lines != tokenizerCounts.lines || !(scalarCounts == tokenizerCounts))
+  {
+    std::cerr << "error: scans disagree on the number of lines or fields" << std::endl;
+    return 1;
+  }
+
+  return 0;
+}
@@ -0,0 +1,86 @@
+
+#include <datastore/Aggregate.h>
+
+using namespace DataStore;
+
+Aggregate::Aggregate(IFieldDescriptorConstPtrH groupField, IFieldDescriptorConstPtrH sumField) :
+  mGroupField(groupField),
+  mSumField(sumField)
+{
+}
+
+IFieldDescriptorConstPtrH Aggregate::getGroupField() const
+{
+  return mGroupField;
+}
+
+IFieldDescriptorConstPtrH Aggregate::getSumField() const
+{
+  return mSumField;
+}
+
+double Aggregate::sumOf(const IRow& row) const
+{
+  ValueConstPtrH value = row.getValue(*mSumField);
+  float f = 0.0f;
+  if (value && value->getValue().convertTo(&f))
+  {
+    return f;
+  }
+
+  return 0.0;
+}
+
+void Aggregate::add(const IRow& row)
+{
+  ValueConstPtrH group = row.getValue(*mGroupField);
+  if (!group)
+  {
+    return;
+  }
+
+  Totals& totals = mGroups.modify(group);
+  ++totals.rowCount;
+  totals.sum += sumOf(row);
+}
+
+void Aggregate::remove(const IRow& row)
+{
+  ValueConstPtrH group = row.getValue(*mGroupField);
+  if (!group)
+  {
+    return;
+  }
+
+  const Totals* found = mGroups.find(group);
+  if (!found)
+  {
+    return;
+  }
+
+  // Dropping the group rather than keeping a zero count also drops the
+  // rounding error its sum has picked up
+  if (found->rowCount == 1)
+  {
+    mGroups.erase(group);
+  }
+  else
+  {
+    Totals& totals = mGroups.modify(group);
+    --totals.rowCount;
+    totals.sum -= sumOf(row);
+  }
+}
+
+void Aggregate::getGroups(AggregateGroupList* outGroups) const
+{
+  outGroups->clear();
+  outGroups->reserve(mGroups.size());
+
+  mGroups.visit(NULL, [&](const ValueConstPtrH& value, const Totals& group) -> bool
+  {
+    AggregateGroup totals = { value, group.rowCount, group.sum };
+    outGroups->push_back(totals);
+    return true;
+  });
+}
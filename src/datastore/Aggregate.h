@@ -0,0 +1,80 @@
+
+#ifndef __AGGREGATE_H__
+#define __AGGREGATE_H__
+
+#include <datastore/FieldDescriptor.h>
+#include <datastore/Row.h>
+#include <datastore/PointerType.h>
+#include <datastore/Versioned.h>
+#include <vector>
+
+namespace DataStore
+{
+  /**
+    The totals of the rows holding one value of the group field
+  */
+  struct AggregateGroup
+  {
+    ValueConstPtrH value;
+    size_t rowCount;
+    double sum;
+  };
+
+  typedef std::vector<AggregateGroup> AggregateGroupList;
+
+  /**
+    The sum of a float field for each value of a group field, e.g. the
+    revenue of each title.  Kept up to date as rows are added and removed,
+    so it is answered without reading the rows.  Declared in the scheme
+    by the summed field's "aggregateBy".  A copy shares the groups with
+    the original until either changes them.
+  */
+  class Aggregate
+  {
+  public:
+    Aggregate(IFieldDescriptorConstPtrH groupField, IFieldDescriptorConstPtrH sumField);
+
+    IFieldDescriptorConstPtrH getGroupField() const;
+    IFieldDescriptorConstPtrH getSumField() const;
+
+    /** Count row in its group, rows without a group value are left out */
+    void add(const IRow& row);
+
+    /** Take row out of its group, which goes once it has no rows left */
+    void remove(const IRow& row);
+
+    /** The groups, in ascending order of their values */
+    void getGroups(AggregateGroupList* outGroups) const;
+
+  private:
+    struct ValueLess
+    {
+      bool operator() (const ValueConstPtrH& left, const ValueConstPtrH& right) const
+      {
+        return *left < *right;
+      }
+    };
+
+    struct Totals
+    {
+      Totals() : rowCount(0), sum(0.0) {}
+
+      size_t rowCount;
+      double sum;
+    };
+
+    typedef VersionedMap<ValueConstPtrH, Totals, ValueLess> TotalsByValue;
+
+    /** The value of the summed field, 0 if the row has none */
+    double sumOf(const IRow& row) const;
+
+    IFieldDescriptorConstPtrH mGroupField;
+    IFieldDescriptorConstPtrH mSumField;
+    TotalsByValue mGroups;
+  };
+
+  typedef PointerType<Aggregate>::Shared AggregatePtrH;
+  typedef std::vector<AggregatePtrH> AggregateList;
+}
+
+#endif
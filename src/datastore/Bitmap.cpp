@@ -0,0 +1,410 @@
+
+#include <datastore/Bitmap.h>
+#include <algorithm>
+#include <iterator>
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+using namespace DataStore;
+
+namespace
+{
+  inline size_t PopCount(uint64_t word)
+  {
+#ifdef _MSC_VER
+    return __popcnt((uint32_t)word) + __popcnt((uint32_t)(word >> 32));
+#else
+    return (size_t)__builtin_popcountll(word);
+#endif
+  }
+
+  /** Index of the lowest set bit, word must not be zero */
+  inline unsigned LowestBit(uint64_t word)
+  {
+#ifdef _MSC_VER
+    unsigned long idx;
+    if (_BitScanForward(&idx, (uint32_t)word))
+      return idx;
+    _BitScanForward(&idx, (uint32_t)(word >> 32));
+    return idx + 32;
+#else
+    return (unsigned)__builtin_ctzll(word);
+#endif
+  }
+}
+
+/////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////
+
+Bitmap::Container::Container() :
+  mCardinality(0)
+{
+}
+
+bool Bitmap::Container::add(uint16_t value)
+{
+  if (isBitset())
+  {
+    uint64_t& word = mBits[value >> 6];
+    uint64_t bit = (uint64_t)1 << (value & 63);
+    if (word & bit)
+      return false;
+
+    word |= bit;
+    ++mCardinality;
+    return true;
+  }
+
+  std::vector<uint16_t>::iterator pos = 
+    std::lower_bound(mArray.begin(), mArray.end(), value);
+  if (pos != mArray.end() && *pos == value)
+    return false;
+
+  mArray.insert(pos, value);
+  ++mCardinality;
+
+  if (mCardinality > kMaxArraySize)
+    toBitset();
+
+  return true;
+}
+
+bool Bitmap::Container::remove(uint16_t value)
+{
+  if (isBitset())
+  {
+    uint64_t& word = mBits[value >> 6];
+    uint64_t bit = (uint64_t)1 << (value & 63);
+    if (!(word & bit))
+      return false;
+
+    word &= ~bit;
+    --mCardinality;
+
+    if (mCardinality <= kMaxArraySize)
+      toArray();
+
+    return true;
+  }
+
+  std::vector<uint16_t>::iterator pos = 
+    std::lower_bound(mArray.begin(), mArray.end(), value);
+  if (pos == mArray.end() || *pos != value)
+    return false;
+
+  mArray.erase(pos);
+  --mCardinality;
+  return true;
+}
+
+bool Bitmap::Container::contains(uint16_t value) const
+{
+  if (isBitset())
+    return (mBits[value >> 6] & ((uint64_t)1 << (value & 63))) != 0;
+  else
+    return std::binary_search(mArray.begin(), mArray.end(), value);
+}
+
+void Bitmap::Container::intersect(const Container& other)
+{
+  if (isBitset() && other.isBitset())
+  {
+    mCardinality = 0;
+    for (size_t w = 0; w < kBitsetWords; ++w)
+    {
+      mBits[w] &= other.mBits[w];
+      mCardinality += PopCount(mBits[w]);
+    }
+
+    if (mCardinality <= kMaxArraySize)
+      toArray();
+  }
+  else if (isBitset())
+  {
+    // Result can be no larger than the other array
+    std::vector<uint16_t> result;
+    result.reserve(other.mArray.size());
+    for (std::vector<uint16_t>::const_iterator value = other.mArray.begin();
+      value != other.mArray.end(); ++value)
+    {
+      if (contains(*value))
+        result.push_back(*value);
+    }
+
+    mBits.clear();
+    mArray.swap(result);
+    mCardinality = mArray.size();
+  }
+  else
+  {
+    std::vector<uint16_t>::iterator out = mArray.begin();
+    for (std::vector<uint16_t>::const_iterator value = mArray.begin();
+      value != mArray.end(); ++value)
+    {
+      if (other.contains(*value))
+        *out++ = *value;
+    }
+
+    mArray.erase(out, mArray.end());
+    mCardinality = mArray.size();
+  }
+}
+
+void Bitmap::Container::merge(const Container& other)
+{
+  if (!isBitset() && !other.isBitset() && 
+    mCardinality + other.mCardinality <= kMaxArraySize)
+  {
+    std::vector<uint16_t> result;
+    result.reserve(mArray.size() + other.mArray.size());
+    std::set_union(mArray.begin(), mArray.end(), 
+      other.mArray.begin(), other.mArray.end(), std::back_inserter(result));
+
+    mArray.swap(result);
+    mCardinality = mArray.size();
+    return;
+  }
+
+  if (!isBitset())
+    toBitset();
+
+  if (other.isBitset())
+  {
+    mCardinality = 0;
+    for (size_t w = 0; w < kBitsetWords; ++w)
+    {
+      mBits[w] |= other.mBits[w];
+      mCardinality += PopCount(mBits[w]);
+    }
+  }
+  else
+  {
+    for (std::vector<uint16_t>::const_iterator value = other.mArray.begin();
+      value != other.mArray.end(); ++value)
+    {
+      add(*value);
+    }
+  }
+
+  if (mCardinality <= kMaxArraySize)
+    toArray();
+}
+
+bool Bitmap::Container::next(uint32_t from, uint16_t* outValue) const
+{
+  if (from > 0xFFFF)
+    return false;
+
+  if (isBitset())
+  {
+    size_t w = from >> 6;
+    uint64_t word = mBits[w] & (~(uint64_t)0 << (from & 63));
+
+    while (word == 0)
+    {
+      if (++w == kBitsetWords)
+        return false;
+      word = mBits[w];
+    }
+
+    *outValue = (uint16_t)((w << 6) + LowestBit(word));
+    return true;
+  }
+
+  std::vector<uint16_t>::const_iterator pos =
+    std::lower_bound(mArray.begin(), mArray.end(), (uint16_t)from);
+  if (pos == mArray.end())
+    return false;
+
+  *outValue = *pos;
+  return true;
+}
+
+void Bitmap::Container::toBitset()
+{
+  mBits.assign(kBitsetWords, 0);
+  for (std::vector<uint16_t>::const_iterator value = mArray.begin();
+    value != mArray.end(); ++value)
+  {
+    mBits[*value >> 6] |= (uint64_t)1 << (*value & 63);
+  }
+
+  std::vector<uint16_t>().swap(mArray);
+}
+
+void Bitmap::Container::toArray()
+{
+  std::vector<uint16_t> result;
+  result.reserve(mCardinality);
+
+  for (size_t w = 0; w < kBitsetWords; ++w)
+  {
+    for (uint64_t word = mBits[w]; word != 0; word &= word - 1)
+    {
+      result.push_back((uint16_t)((w << 6) + LowestBit(word)));
+    }
+  }
+
+  std::vector<uint64_t>().swap(mBits);
+  mArray.swap(result);
+}
+
+/////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////
+
+void Bitmap::const_iterator::seek()
+{
+  while (mChunk < mBitmap->mChunks.size())
+  {
+    uint16_t low;
+    if (mBitmap->mChunks[mChunk].container.next(mLow, &low))
+    {
+      mLow = low;
+      return;
+    }
+
+    ++mChunk;
+    mLow = 0;
+  }
+
+  mLow = 0;
+}
+
+/////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////
+
+namespace
+{
+  struct ChunkKeyLess
+  {
+    template <class Chunk>
+    bool operator() (const Chunk& chunk, uint16_t key) const
+    {
+      return chunk.key < key;
+    }
+  };
+}
+
+Bitmap::ChunkList::iterator Bitmap::findChunk(uint16_t key)
+{
+  return std::lower_bound(mChunks.begin(), mChunks.end(), key, ChunkKeyLess());
+}
+
+Bitmap::ChunkList::const_iterator Bitmap::findChunk(uint16_t key) const
+{
+  return std::lower_bound(mChunks.begin(), mChunks.end(), key, ChunkKeyLess());
+}
+
+bool Bitmap::add(Element value)
+{
+  uint16_t key = (uint16_t)(value >> 16);
+
+  ChunkList::iterator chunk = findChunk(key);
+  if (chunk == mChunks.end() || chunk->key != key)
+  {
+    Chunk newChunk;
+    newChunk.key = key;
+    chunk = mChunks.insert(chunk, newChunk);
+  }
+
+  return chunk->container.add((uint16_t)value);
+}
+
+bool Bitmap::remove(Element value)
+{
+  uint16_t key = (uint16_t)(value >> 16);
+
+  ChunkList::iterator chunk = findChunk(key);
+  if (chunk == mChunks.end() || chunk->key != key)
+    return false;
+
+  bool removed = chunk->container.remove((uint16_t)value);
+  if (chunk->container.size() == 0)
+    mChunks.erase(chunk);
+
+  return removed;
+}
+
+bool Bitmap::contains(Element value) const
+{
+  uint16_t key = (uint16_t)(value >> 16);
+
+  ChunkList::const_iterator chunk = findChunk(key);
+  return chunk != mChunks.end() && chunk->key == key && 
+    chunk->container.contains((uint16_t)value);
+}
+
+size_t Bitmap::size() const
+{
+  size_t total = 0;
+  for (ChunkList::const_iterator chunk = mChunks.begin();
+    chunk != mChunks.end(); ++chunk)
+  {
+    total += chunk->container.size();
+  }
+  return total;
+}
+
+void Bitmap::intersect(const Bitmap& other)
+{
+  ChunkList result;
+  ChunkList::const_iterator theirs = other.mChunks.begin();
+
+  for (ChunkList::iterator ours = mChunks.begin(); ours != mChunks.end(); ++ours)
+  {
+    while (theirs != other.mChunks.end() && theirs->key < ours->key)
+      ++theirs;
+
+    if (theirs == other.mChunks.end())
+      break;
+
+    if (theirs->key == ours->key)
+    {
+      ours->container.intersect(theirs->container);
+      if (ours->container.size() > 0)
+        result.push_back(*ours);
+    }
+  }
+
+  mChunks.swap(result);
+}
+
+void Bitmap::merge(const Bitmap& other)
+{
+  // Chunks that all come after ours (e.g. merged in chunk order) are
+  // appended, without copying ours
+  if (!other.mChunks.empty() &&
+    (mChunks.empty() || mChunks.back().key < other.mChunks.front().key))
+  {
+    mChunks.insert(mChunks.end(), other.mChunks.cbegin(), other.mChunks.cend());
+    return;
+  }
+
+  ChunkList result;
+  result.reserve(mChunks.size() + other.mChunks.size());
+
+  ChunkList::const_iterator ours = mChunks.begin();
+  ChunkList::const_iterator theirs = other.mChunks.begin();
+
+  while (ours != mChunks.end() || theirs != other.mChunks.end())
+  {
+    if (theirs == other.mChunks.end() || 
+      (ours != mChunks.end() && ours->key < theirs->key))
+    {
+      result.push_back(*ours++);
+    }
+    else if (ours == mChunks.end() || theirs->key < ours->key)
+    {
+      result.push_back(*theirs++);
+    }
+    else
+    {
+      result.push_back(*ours++);
+      result.back().container.merge((theirs++)->container);
+    }
+  }
+
+  mChunks.swap(result);
+}
@@ -0,0 +1,158 @@
+
+#ifndef __BITMAP_H__
+#define __BITMAP_H__
+
+#include <datastore/PointerType.h>
+#include <inttypes.h>
+#include <vector>
+
+namespace DataStore
+{
+  /**
+    A compressed set of 32 bit integers (row identifiers), organized like a
+    Roaring bitmap: the value space is split into chunks of 2^16 keyed by 
+    the high 16 bits.  Each chunk is stored as a sorted array of the low 
+    16 bits while sparse, and as a 2^16 bit bitset once dense.  
+
+    Intersections and unions work chunk by chunk, so the cost is 
+    proportional to the number of set values, not the size of the table.
+  */
+  class Bitmap
+  {
+  public:
+    typedef uint32_t Element;
+
+  private:
+    class Container
+    {
+    public:
+      enum
+      {
+        kMaxArraySize = 4096,
+        kBitsetWords = (1 << 16) / 64
+      };
+
+      Container();
+
+      bool add(uint16_t value);
+      bool remove(uint16_t value);
+      bool contains(uint16_t value) const;
+      size_t size() const { return mCardinality; }
+
+      void intersect(const Container& other);
+      void merge(const Container& other);
+
+      /** Smallest value >= from, false if none.  from may be 2^16 */
+      bool next(uint32_t from, uint16_t* outValue) const;
+
+    private:
+      bool isBitset() const { return !mBits.empty(); }
+      void toBitset();
+      void toArray();
+
+      std::vector<uint16_t> mArray;
+      std::vector<uint64_t> mBits;
+      size_t mCardinality;
+    };
+
+    struct Chunk
+    {
+      uint16_t key;
+      Container container;
+    };
+
+    typedef std::vector<Chunk> ChunkList;
+
+  public:
+    /**
+      Visits the set values in ascending order
+    */
+    class const_iterator
+    {
+    public:
+      const_iterator() :
+        mBitmap(NULL), mChunk(0), mLow(0)
+      {
+      }
+
+      const_iterator(const Bitmap* bitmap, size_t chunk, uint32_t low) :
+        mBitmap(bitmap), mChunk(chunk), mLow(low)
+      {
+        seek();
+      }
+
+      // default dtor, copy-ctor okay
+
+      const_iterator& operator++()
+      {
+        ++mLow;
+        seek();
+        return *this;
+      }
+
+      Element operator*() const
+      {
+        return ((Element)mBitmap->mChunks[mChunk].key << 16) | mLow;
+      }
+
+      bool operator==(const const_iterator& other) const
+      {
+        return mBitmap == other.mBitmap && mChunk == other.mChunk && mLow == other.mLow;
+      }
+
+      bool operator!=(const const_iterator& other) const
+      {
+        return !(*this == other);
+      }
+
+    private:
+      void seek();
+
+      const Bitmap* mBitmap;
+      size_t mChunk;
+      uint32_t mLow;
+    };
+
+    Bitmap() {}
+
+    /** Returns true if value was not already present */
+    bool add(Element value);
+
+    /** Returns true if value was present */
+    bool remove(Element value);
+
+    bool contains(Element value) const;
+
+    /** Number of values in the set */
+    size_t size() const;
+    bool empty() const { return mChunks.empty(); }
+    void clear() { mChunks.clear(); }
+    void swap(Bitmap& other) { mChunks.swap(other.mChunks); }
+
+    /** Keep only the values that are also in other (AND) */
+    void intersect(const Bitmap& other);
+
+    /** Add all values of other (OR) */
+    void merge(const Bitmap& other);
+
+    const_iterator cbegin() const
+    {
+      return const_iterator(this, 0, 0);
+    }
+
+    const_iterator cend() const
+    {
+      return const_iterator(this, mChunks.size(), 0);
+    }
+
+  private:
+    ChunkList::iterator findChunk(uint16_t key);
+    ChunkList::const_iterator findChunk(uint16_t key) const;
+
+    ChunkList mChunks;
+  };
+
+  typedef PointerType<Bitmap>::Shared BitmapPtrH;
+}
+
+#endif
@@ -0,0 +1,377 @@
+
+#include <datastore/BufferPool.h>
+#include <algorithm>
+#include <stdexcept>
+#include <string.h>
+
+#ifndef _WIN32
+#include <errno.h>
+#include <unistd.h>
+#endif
+
+using namespace DataStore;
+
+/////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////
+
+PageHandle::PageHandle() :
+  mPool(NULL),
+  mFrame(0)
+{
+}
+
+PageHandle::~PageHandle()
+{
+  release();
+}
+
+void PageHandle::release()
+{
+  if (mPool != NULL)
+  {
+    mPool->unpin(mFrame);
+    mPool = NULL;
+  }
+}
+
+/////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////
+
+BufferPool::BufferPool(size_t memoryLimit) :
+  mHand(0),
+  mNextFileId(0),
+  mHitCount(0),
+  mMissCount(0),
+  mEvictionCount(0)
+{
+  // Frames are only allocated as they are first used
+  Frame unused = { 0, false, false, false, 0, std::vector<char>() };
+  mFrames.resize(std::max<size_t>(memoryLimit / kPageSize, kMinFrames), unused);
+}
+
+size_t BufferPool::getFrameCount() const
+{
+  return mFrames.size();
+}
+
+size_t BufferPool::getHitCount() const
+{
+  std::lock_guard<std::mutex> lock(mMutex);
+  return mHitCount;
+}
+
+size_t BufferPool::getMissCount() const
+{
+  std::lock_guard<std::mutex> lock(mMutex);
+  return mMissCount;
+}
+
+size_t BufferPool::getEvictionCount() const
+{
+  std::lock_guard<std::mutex> lock(mMutex);
+  return mEvictionCount;
+}
+
+uint32_t BufferPool::addFile()
+{
+  std::lock_guard<std::mutex> lock(mMutex);
+  return mNextFileId++;
+}
+
+void BufferPool::removeFile(uint32_t fileId)
+{
+  std::lock_guard<std::mutex> lock(mMutex);
+
+  for (size_t frame = 0; frame < mFrames.size(); ++frame)
+  {
+    if (mFrames[frame].isUsed && (uint32_t)(mFrames[frame].key >> 32) == fileId)
+    {
+      mFrameOfPage.erase(mFrames[frame].key);
+      mFrames[frame].isUsed = false;
+      mFrames[frame].isReferenced = false;
+    }
+  }
+}
+
+const char* BufferPool::pin(const PagedFile& file, uint32_t fileId, uint64_t page,
+  PageHandle* outHandle)
+{
+  outHandle->release();
+
+  if (page > 0xFFFFFFFFu)
+  {
+    throw std::runtime_error("File is too large for the buffer pool");
+  }
+  uint64_t key = ((uint64_t)fileId << 32) | page;
+
+  std::unique_lock<std::mutex> lock(mMutex);
+
+  size_t frame = 0;
+  for (;;)
+  {
+    std::unordered_map<uint64_t, size_t>::const_iterator cached = mFrameOfPage.find(key);
+    if (cached == mFrameOfPage.end())
+    {
+      break;
+    }
+
+    // Another thread is reading the page, and may fail to
+    frame = cached->second;
+    if (mFrames[frame].isLoading)
+    {
+      mLoaded.wait(lock);
+      continue;
+    }
+
+    Frame& pinned = mFrames[frame];
+    ++pinned.pinCount;
+    pinned.isReferenced = true;
+    ++mHitCount;
+
+    outHandle->mPool = this;
+    outHandle->mFrame = frame;
+    return &pinned.data[0];
+  }
+
+  frame = chooseVictim();
+
+  Frame& victim = mFrames[frame];
+  if (victim.isUsed)
+  {
+    mFrameOfPage.erase(victim.key);
+    ++mEvictionCount;
+  }
+
+  if (victim.data.empty())
+  {
+    victim.data.resize(kPageSize);
+  }
+
+  // Pinned while it is read, so it isn't chosen again meanwhile
+  victim.key = key;
+  victim.isUsed = true;
+  victim.isReferenced = true;
+  victim.isLoading = true;
+  victim.pinCount = 1;
+  mFrameOfPage[key] = frame;
+  ++mMissCount;
+
+  lock.unlock();
+  try
+  {
+    file.readPage(page, &victim.data[0]);
+  }
+  catch (...)
+  {
+    lock.lock();
+    mFrameOfPage.erase(key);
+    victim.isUsed = false;
+    victim.isReferenced = false;
+    victim.isLoading = false;
+    victim.pinCount = 0;
+    mLoaded.notify_all();
+    throw;
+  }
+  lock.lock();
+
+  victim.isLoading = false;
+  mLoaded.notify_all();
+
+  outHandle->mPool = this;
+  outHandle->mFrame = frame;
+  return &victim.data[0];
+}
+
+void BufferPool::unpin(size_t frame)
+{
+  std::lock_guard<std::mutex> lock(mMutex);
+  --mFrames[frame].pinCount;
+}
+
+size_t BufferPool::chooseVictim()
+{
+  // Two sweeps clear every reference bit, so an unpinned frame is found
+  // by then if there is one
+  for (size_t sweep = 0; sweep < 2 * mFrames.size(); ++sweep)
+  {
+    size_t frame = mHand;
+    mHand = (mHand + 1) % mFrames.size();
+
+    Frame& candidate = mFrames[frame];
+    if (!candidate.isUsed)
+    {
+      return frame;
+    }
+    if (candidate.pinCount > 0)
+    {
+      continue;
+    }
+    if (candidate.isReferenced)
+    {
+      candidate.isReferenced = false;
+      continue;
+    }
+    return frame;
+  }
+
+  throw std::runtime_error("All pages of the buffer pool are pinned");
+}
+
+/////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////
+
+PagedFile::PagedFile(const char* filename, BufferPoolPtrH pool) :
+  mFilename(filename),
+  mPool(pool),
+  mFileId(0),
+  mFile(NULL),
+  mSize(0)
+{
+  if (!mPool)
+  {
+    mMapped = MappedFilePtrH(new MappedFile(filename));
+    mSize = mMapped->getSize();
+    return;
+  }
+
+  mFile = fopen(filename, "rb");
+  if (!mFile)
+  {
+    std::string ex = "Unable to open file \"" + mFilename + "\"";
+    throw std::runtime_error(ex);
+  }
+
+#ifdef _WIN32
+  bool isSized = _fseeki64(mFile, 0, SEEK_END) == 0;
+  mSize = isSized ? (uint64_t)_ftelli64(mFile) : 0;
+#else
+  bool isSized = fseeko(mFile, 0, SEEK_END) == 0;
+  mSize = isSized ? (uint64_t)ftello(mFile) : 0;
+#endif
+  if (!isSized)
+  {
+    fclose(mFile);
+    std::string ex = "Unable to open file \"" + mFilename + "\"";
+    throw std::runtime_error(ex);
+  }
+
+  mFileId = mPool->addFile();
+}
+
+PagedFile::~PagedFile()
+{
+  if (mPool)
+  {
+    mPool->removeFile(mFileId);
+    fclose(mFile);
+  }
+}
+
+const char* PagedFile::getMappedData() const
+{
+  return mMapped ? mMapped->getData() : NULL;
+}
+
+void PagedFile::read(uint64_t offset, void* outData, size_t size) const
+{
+  if (mMapped)
+  {
+    memcpy(outData, mMapped->getData() + offset, size);
+    return;
+  }
+
+  char* data = (char*)outData;
+  PageHandle handle;
+  while (size > 0)
+  {
+    size_t pageOffset = (size_t)(offset % BufferPool::kPageSize);
+    size_t count = std::min<size_t>(size, BufferPool::kPageSize - pageOffset);
+
+    const char* page = mPool->pin(*this, mFileId, offset / BufferPool::kPageSize, &handle);
+    memcpy(data, page + pageOffset, count);
+
+    data += count;
+    offset += count;
+    size -= count;
+  }
+}
+
+std::string PagedFile::readText(uint64_t offset) const
+{
+  if (mMapped)
+  {
+    return std::string(mMapped->getData() + offset);
+  }
+
+  std::string text;
+  PageHandle handle;
+  while (offset < mSize)
+  {
+    size_t pageOffset = (size_t)(offset % BufferPool::kPageSize);
+    size_t count = (size_t)std::min<uint64_t>(BufferPool::kPageSize - pageOffset, mSize - offset);
+
+    const char* page = mPool->pin(*this, mFileId, offset / BufferPool::kPageSize, &handle);
+    const char* start = page + pageOffset;
+    const char* end = (const char*)memchr(start, '\0', count);
+    if (end != NULL)
+    {
+      text.append(start, end);
+      return text;
+    }
+
+    text.append(start, count);
+    offset += count;
+  }
+
+  std::string ex = "Unterminated text in file \"" + mFilename + "\"";
+  throw std::runtime_error(ex);
+}
+
+const char* PagedFile::pin(uint64_t offset, size_t size, PageHandle* outHandle) const
+{
+  if (mMapped)
+  {
+    return mMapped->getData() + offset;
+  }
+
+  size_t pageOffset = (size_t)(offset % BufferPool::kPageSize);
+  if (pageOffset + size > BufferPool::kPageSize)
+  {
+    throw std::runtime_error("Pinned bytes span pages of the buffer pool");
+  }
+
+  return mPool->pin(*this, mFileId, offset / BufferPool::kPageSize, outHandle) + pageOffset;
+}
+
+void PagedFile::readPage(uint64_t page, char* outData) const
+{
+  uint64_t offset = page * BufferPool::kPageSize;
+  size_t size = offset < mSize ?
+    (size_t)std::min<uint64_t>(BufferPool::kPageSize, mSize - offset) : 0;
+
+#ifdef _WIN32
+  // The file position is shared by the threads reading pages
+  std::lock_guard<std::mutex> lock(mReadMutex);
+  bool isRead = size > 0 && _fseeki64(mFile, (__int64)offset, SEEK_SET) == 0;
+  isRead = isRead && fread(outData, 1, size, mFile) == size;
+#else
+  // pread() leaves the file position alone, so reads don't wait for each other
+  bool isRead = size > 0;
+  for (size_t done = 0; isRead && done < size;)
+  {
+    ssize_t count = pread(fileno(mFile), outData + done, size - done, (off_t)(offset + done));
+    if (count < 0 && errno == EINTR)
+    {
+      continue;
+    }
+    isRead = count > 0;
+    done += isRead ? (size_t)count : 0;
+  }
+#endif
+
+  if (!isRead)
+  {
+    std::string ex = "Unable to read file \"" + mFilename + "\"";
+    throw std::runtime_error(ex);
+  }
+}
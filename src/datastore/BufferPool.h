@@ -0,0 +1,169 @@
+
+#ifndef __BUFFER_POOL_H__
+#define __BUFFER_POOL_H__
+
+#include <datastore/MappedFile.h>
+#include <datastore/PointerType.h>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <stdint.h>
+#include <stdio.h>
+
+namespace DataStore
+{
+  class BufferPool;
+  typedef PointerType<BufferPool>::Shared BufferPoolPtrH;
+
+  class PagedFile;
+  typedef PointerType<PagedFile>::Shared PagedFilePtrH;
+
+  /**
+    A pinned page.  The page stays in memory, at the same address, until
+    the handle is released or destroyed.
+  */
+  class PageHandle
+  {
+  public:
+    PageHandle();
+    ~PageHandle();
+
+    /** Unpin the page, if any */
+    void release();
+
+  private:
+    friend class BufferPool;
+
+    PageHandle(const PageHandle&);
+    PageHandle& operator=(const PageHandle&);
+
+    BufferPool* mPool;
+    size_t mFrame;
+  };
+
+  /**
+    Caches fixed size pages of files in a bounded number of frames, so the
+    memory used to read storage doesn't grow with its size.  Once all
+    frames hold pages, a page is evicted with the CLOCK policy: the hand
+    sweeps the frames, skipping pinned pages and giving pages that were
+    used since it last passed them another round.  A pool whose frames
+    are all pinned throws rather than growing.
+
+    Pools can be shared by several files and threads.  A missing page is
+    read without holding the pool's lock, so cached pages are pinned while
+    it is read.  Threads that pin the same page meanwhile wait for it.
+  */
+  class BufferPool
+  {
+  public:
+    enum { kPageSize = 4096 };
+
+    /** Fewest frames, enough for the pages a few readers pin at once */
+    enum { kMinFrames = 16 };
+
+    /** Frames for memoryLimit bytes of pages, at least kMinFrames */
+    BufferPool(size_t memoryLimit);
+
+    size_t getFrameCount() const;
+
+    /** Pins of pages that were cached, and that had to be read */
+    size_t getHitCount() const;
+    size_t getMissCount() const;
+    size_t getEvictionCount() const;
+
+  private:
+    friend class PagedFile;
+    friend class PageHandle;
+
+    BufferPool(const BufferPool&);
+    BufferPool& operator=(const BufferPool&);
+
+    struct Frame
+    {
+      uint64_t key;
+      bool isUsed;
+      bool isReferenced;
+      bool isLoading;
+      size_t pinCount;
+      std::vector<char> data;
+    };
+
+    /** A number for a new file, to tell its pages apart */
+    uint32_t addFile();
+
+    /** Forget the pages of a closed file, none may be pinned */
+    void removeFile(uint32_t fileId);
+
+    /** Pin page of file, reading it into a frame if it isn't cached */
+    const char* pin(const PagedFile& file, uint32_t fileId, uint64_t page,
+      PageHandle* outHandle);
+
+    void unpin(size_t frame);
+
+    /** The frame to read a page into, evicting its page.  mMutex is held. */
+    size_t chooseVictim();
+
+    mutable std::mutex mMutex;
+    std::condition_variable mLoaded;
+    std::vector<Frame> mFrames;
+    std::unordered_map<uint64_t, size_t> mFrameOfPage;
+    size_t mHand;
+    uint32_t mNextFileId;
+
+    size_t mHitCount;
+    size_t mMissCount;
+    size_t mEvictionCount;
+  };
+
+  /**
+    A read-only file that is read a page at a time through a BufferPool.
+    Without a pool the whole file is mapped into memory instead (see
+    MappedFile), and the OS decides which of its pages stay in memory.
+  */
+  class PagedFile
+  {
+  public:
+    /** Throws if the file can't be opened */
+    PagedFile(const char* filename, BufferPoolPtrH pool);
+    ~PagedFile();
+
+    uint64_t getSize() const { return mSize; }
+
+    /** The whole file, if it's mapped rather than read through a pool */
+    const char* getMappedData() const;
+
+    /** Copy size bytes at offset, which the caller checked are in the file */
+    void read(uint64_t offset, void* outData, size_t size) const;
+
+    /** The nul terminated text at offset, whose nul is in the file */
+    std::string readText(uint64_t offset) const;
+
+    /**
+      Pin size bytes at offset, which must lie within one page of the pool,
+      and return their address.  They stay valid until outHandle is
+      released.
+    */
+    const char* pin(uint64_t offset, size_t size, PageHandle* outHandle) const;
+
+  private:
+    friend class BufferPool;
+
+    PagedFile(const PagedFile&);
+    PagedFile& operator=(const PagedFile&);
+
+    /** Read page from disk, called by several threads at once */
+    void readPage(uint64_t page, char* outData) const;
+
+    std::string mFilename;
+    BufferPoolPtrH mPool;
+    uint32_t mFileId;
+    FILE* mFile;
+    mutable std::mutex mReadMutex;  // Where reads share the file position
+    MappedFilePtrH mMapped;
+    uint64_t mSize;
+  };
+}
+
+#endif
@@ -0,0 +1,117 @@
+
+#include <datastore/ConcurrentKeyIndex.h>
+#include <algorithm>
+
+using namespace DataStore;
+
+namespace DataStore
+{
+  static bool IsFirstBefore(const ConcurrentKeyIndex::Entry& left,
+    const ConcurrentKeyIndex::Entry& right)
+  {
+    return left.firstSequence < right.firstSequence;
+  }
+}
+
+/////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////
+
+ConcurrentKeyIndex::ConcurrentKeyIndex(const IFieldDescriptorConstList& keyFields,
+  size_t stripeCount) :
+  mKeys(keyFields)
+{
+  mStripes.resize(stripeCount > 0 ? stripeCount : 1);
+  for (size_t stripe = 0; stripe < mStripes.size(); ++stripe)
+  {
+    mStripes[stripe] = StripePtr(new Stripe());
+  }
+}
+
+size_t ConcurrentKeyIndex::hash(const IRow& row) const
+{
+  return mKeys.hash(row);
+}
+
+ConcurrentKeyIndex::Stripe& ConcurrentKeyIndex::stripeOf(size_t hash) const
+{
+  // The low bits pick the bucket within the stripe
+  return *mStripes[(hash >> 7) % mStripes.size()];
+}
+
+bool ConcurrentKeyIndex::put(IRowConstPtrH row, size_t hash, uint64_t sequence)
+{
+  Stripe& stripe = stripeOf(hash);
+  std::lock_guard<std::mutex> lock(stripe.mutex);
+
+  typedef std::unordered_multimap<size_t, size_t>::const_iterator Candidate;
+  std::pair<Candidate, Candidate> candidates = stripe.entriesByHash.equal_range(hash);
+
+  for (Candidate candidate = candidates.first; candidate != candidates.second; ++candidate)
+  {
+    Entry& entry = stripe.entries[candidate->second];
+    if (!mKeys.equal(*entry.row, *row))
+    {
+      continue;
+    }
+
+    if (sequence > entry.lastSequence)
+    {
+      entry.row = row;
+      entry.lastSequence = sequence;
+    }
+    entry.firstSequence = std::min(entry.firstSequence, sequence);
+    ++entry.occurrences;
+    return false;
+  }
+
+  Entry entry = { hash, row, sequence, sequence, 1 };
+  stripe.entriesByHash.insert(std::make_pair(hash, stripe.entries.size()));
+  stripe.entries.push_back(entry);
+  return true;
+}
+
+IRowConstPtrH ConcurrentKeyIndex::find(const IRow& row, size_t hash) const
+{
+  Stripe& stripe = stripeOf(hash);
+  std::lock_guard<std::mutex> lock(stripe.mutex);
+
+  typedef std::unordered_multimap<size_t, size_t>::const_iterator Candidate;
+  std::pair<Candidate, Candidate> candidates = stripe.entriesByHash.equal_range(hash);
+
+  for (Candidate candidate = candidates.first; candidate != candidates.second; ++candidate)
+  {
+    const Entry& entry = stripe.entries[candidate->second];
+    if (mKeys.equal(*entry.row, row))
+    {
+      return entry.row;
+    }
+  }
+
+  return IRowConstPtrH();
+}
+
+size_t ConcurrentKeyIndex::size() const
+{
+  size_t count = 0;
+  for (size_t stripe = 0; stripe < mStripes.size(); ++stripe)
+  {
+    std::lock_guard<std::mutex> lock(mStripes[stripe]->mutex);
+    count += mStripes[stripe]->entries.size();
+  }
+
+  return count;
+}
+
+void ConcurrentKeyIndex::getEntries(EntryList* outEntries) const
+{
+  outEntries->clear();
+  outEntries->reserve(size());
+
+  for (size_t stripe = 0; stripe < mStripes.size(); ++stripe)
+  {
+    const EntryList& entries = mStripes[stripe]->entries;
+    outEntries->insert(outEntries->end(), entries.cbegin(), entries.cend());
+  }
+
+  std::sort(outEntries->begin(), outEntries->end(), IsFirstBefore);
+}
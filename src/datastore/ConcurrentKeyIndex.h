@@ -0,0 +1,92 @@
+
+#ifndef __CONCURRENT_KEY_INDEX_H__
+#define __CONCURRENT_KEY_INDEX_H__
+
+#include <datastore/FieldDescriptor.h>
+#include <datastore/Index.h>
+#include <datastore/Row.h>
+#include <datastore/PointerType.h>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+#include <stdint.h>
+
+namespace DataStore
+{
+  /**
+    A primary key index that many threads can put rows into at once, e.g.
+    to collapse the rows of a batch that share a key before they are
+    stored.  Keys are spread over stripes by their hash, and each stripe
+    has its own lock, so threads only contend when their keys land in the
+    same stripe.
+
+    Each row is put with a sequence number, its position in the input, and
+    the row with the highest sequence number of a key wins.  The outcome
+    doesn't depend on the order in which threads get to put their rows.
+  */
+  class ConcurrentKeyIndex
+  {
+  public:
+    enum { kDefaultStripeCount = 64 };
+
+    /** The winning row of a key */
+    struct Entry
+    {
+      size_t hash;
+      IRowConstPtrH row;
+      /** Sequence number of the key's first row, and of row */
+      uint64_t firstSequence;
+      uint64_t lastSequence;
+      /** Rows put with the key */
+      size_t occurrences;
+    };
+
+    typedef std::vector<Entry> EntryList;
+
+    ConcurrentKeyIndex(const IFieldDescriptorConstList& keyFields,
+      size_t stripeCount = kDefaultStripeCount);
+
+    /** Hash of row's key fields, the same as KeyIndex::hash() */
+    size_t hash(const IRow& row) const;
+
+    /**
+      Put row, whose key hashes to hash.  It replaces the row of its key if
+      sequence is higher.  Returns true if the key is new.  Safe to call
+      from several threads, with distinct sequence numbers.
+    */
+    bool put(IRowConstPtrH row, size_t hash, uint64_t sequence);
+
+    /** The winning row of the key of row, NULL if there is none */
+    IRowConstPtrH find(const IRow& row, size_t hash) const;
+
+    size_t size() const;
+
+    /**
+      Set outEntries to the entries in order of their first sequence
+      number.  Not safe while rows are put.
+    */
+    void getEntries(EntryList* outEntries) const;
+
+  private:
+    ConcurrentKeyIndex(const ConcurrentKeyIndex&);
+    ConcurrentKeyIndex& operator=(const ConcurrentKeyIndex&);
+
+    struct Stripe
+    {
+      mutable std::mutex mutex;
+      /** Entries by hash, a hash may be shared by several keys */
+      std::unordered_multimap<size_t, size_t> entriesByHash;
+      EntryList entries;
+    };
+
+    typedef std::unique_ptr<Stripe> StripePtr;
+
+    Stripe& stripeOf(size_t hash) const;
+
+    KeyIndex mKeys;
+    std::vector<StripePtr> mStripes;
+  };
+}
+
+#endif
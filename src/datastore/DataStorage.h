@@ -7,14 +7,59 @@
 namespace DataStore
 {
   class Database;
+  class Predicate;
   struct IRow;
 
+  /**
+    Receives rows, one at a time, as they are read from a storage
+  */
+  struct IRowSink
+  {
+    virtual void addRow(PointerType<IRow>::SharedConst row) = 0;
+  };
+
+  class ZoneMap;
+
+  /**
+    Rows that a storage can read in place, by position, rather than
+    loading them all into a database up front
+  */
+  struct IRowSource
+  {
+    virtual size_t getRowCount() const = 0;
+    virtual PointerType<IRow>::SharedConst getRow(size_t position) const = 0;
+
+    /** 
+      Fill outZones with the stored summaries of the rows.  Returns false
+      if the source has none that match ZoneMap's block size.
+    */
+    virtual bool getZones(ZoneMap* outZones) const = 0;
+
+    /**
+      Set outPosition to the position of the row with the same key fields
+      as key, or to getRowCount() if there is none.  Returns false if the
+      source can't look keys up, e.g. it has no stored key tree.
+    */
+    virtual bool findKey(const IRow& key, size_t* outPosition) const = 0;
+  };
+
+  typedef PointerType<IRowSource>::Shared IRowSourcePtrH;
+
   /**
   */
   struct IDataStorage
   {
     virtual ISchemeConstPtrH getScheme() = 0;
-    virtual void load(Database* database) = 0;
+
+    /**
+      Load the stored rows into database.  If fields is not NULL only their
+      values are needed, backends may leave the other fields without values.
+      If filter is not NULL only rows that match it are needed, backends
+      may skip the others (by block or by row) but don't have to, the 
+      filter is applied again when the database is queried.
+    */
+    virtual void load(Database* database, IFieldDescriptorConstListConstPtrH fields,
+      const Predicate* filter) = 0;
 
     virtual void beginPersist() = 0;
     virtual void persistRow(const IRow* row) = 0;
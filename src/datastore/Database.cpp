@@ -1,292 +1,1180 @@
 
 #include <datastore/Database.h>
+#include <datastore/Aggregate.h>
+#include <datastore/ConcurrentKeyIndex.h>
 #include <datastore/Logic.h>
+#include <datastore/Index.h>
+#include <datastore/RowIdentifier.h>
+#include <datastore/ZoneMap.h>
 #include <algorithm>
+#include <exception>
+#include <stdexcept>
+#include <string>
+#include <string.h>
+#include <stdio.h>
+#include <thread>
 
 using namespace DataStore;
 
 namespace DataStore
 {
   /**
-    Identifies a row within the in-memory database, It's really just
-    a size_t...
+    Bread-dead storage, stores entire database in memory using
+    vectors of rows.
   */
-  class RowIdentifier
+  class DatabaseInMemory : public IRowSelector,
+    public std::enable_shared_from_this<DatabaseInMemory>
   {
-    enum { kEmpty = -1 };
-    typedef size_t IdType;
+  protected:
+    typedef PointerType<DatabaseInMemory>::SharedConst DatabaseInMemoryConstPtrH;
+
   public:
+    /**
+      stl algorithm compatible comparison for sorting rows (by identifier) 
+      by a subset of fields in ascending order.  The order in which the 
+      fields appear in the descriptor list imply sorting priority.
+    */
+    struct IRowOrderByFieldsAscending
+    {
+      IRowOrderByFieldsAscending(const DatabaseInMemory& memory,
+        const IFieldDescriptorConstList& byFields) :
+        mMemory(memory),
+        mCompareField(byFields)
+      {
+      }
+
+      bool operator() (const RowIdentifier& leftId, const RowIdentifier& rightId)
+      {
+        const IRow& left = mMemory.rowAt(leftId, &mLeft);
+        const IRow& right = mMemory.rowAt(rightId, &mRight);
+
+        for (IFieldDescriptorConstList::const_iterator field = mCompareField.cbegin();
+          field != mCompareField.cend(); ++field)
+        {
+          const ValueConstPtrH leftValue = left.getValue(*field->get());
+          const ValueConstPtrH rightValue = right.getValue(*field->get());
+
+          // All previous fields are equal, and this one is less than the other
+          if (*leftValue < *rightValue)
+            return true;
+
+          // If not equal, don't continue looking at other fields
+          if (*leftValue != *rightValue)
+            return false;
+        }
+
+        return false;
+      }
+
+    private:
+      const DatabaseInMemory& mMemory;
+      const IFieldDescriptorConstList& mCompareField;
+      IRowConstPtrH mLeft;
+      IRowConstPtrH mRight;
+    };
+
+    /**
+      Produces the identifiers of the rows that match a predicate, one at
+      a time and in row order.  Rows come either from the index candidates,
+      or from a scan of the blocks that the zone maps don't rule out.
+    */
+    class Scan
+    {
+    public:
+      Scan(const DatabaseInMemory& memory, const Predicate& pred) :
+        mMemory(memory),
+        mPred(pred),
+        mZoneFilter(pred),
+        mBlock(0),
+        mRow(0),
+        mBlockEnd(0)
+      {
+        mStats.usedIndex = memory.lookupCandidates(mPred, &mCandidates);
+        mCandidate = mCandidates.cbegin();
+      }
+
+      /** Returns false once there are no more matches */
+      bool next(RowIdentifier* outId)
+      {
+        if (mStats.usedIndex)
+        {
+          for (; mCandidate != mCandidates.cend(); ++mCandidate)
+          {
+            ++mStats.rowsScanned;
+            if (mPred.matches(mMemory.rowAt(*mCandidate, &mRowHolder)))
+            {
+              *outId = RowIdentifier(*mCandidate);
+              ++mCandidate;
+              ++mStats.rowsMatched;
+              return true;
+            }
+          }
+
+          return false;
+        }
+
+        for (;;)
+        {
+          for (; mRow < mBlockEnd; ++mRow)
+          {
+            ++mStats.rowsScanned;
+            if (mPred.matches(mMemory.rowAt(mRow, &mRowHolder)))
+            {
+              *outId = RowIdentifier(mRow++);
+              ++mStats.rowsMatched;
+              return true;
+            }
+          }
+
+          if (!nextBlock())
+          {
+            return false;
+          }
+        }
+      }
+
+      const QueryStats& getStats() const
+      {
+        return mStats;
+      }
+
+    private:
+      Scan(const Scan&);
+      Scan& operator=(const Scan&);
+
+      /** Advance to the next block that may hold a match */
+      bool nextBlock()
+      {
+        const ZoneMap& zoneMap = mMemory.mZones;
+
+        for (; mBlock < zoneMap.getBlockCount(); ++mBlock)
+        {
+          if (!mZoneFilter.mayMatch(zoneMap.getZones(mBlock)))
+          {
+            ++mStats.blocksSkipped;
+            continue;
+          }
+
+          ++mStats.blocksScanned;
+          mRow = mBlock * ZoneMap::kRowsPerBlock;
+          mBlockEnd = std::min(mMemory.getRowCount(), mRow + ZoneMap::kRowsPerBlock);
+          ++mBlock;
+          return true;
+        }
+
+        return false;
+      }
+
+      const DatabaseInMemory& mMemory;
+      Predicate mPred;
+      ZoneFilter mZoneFilter;
+      QueryStats mStats;
+
+      Bitmap mCandidates;
+      Bitmap::const_iterator mCandidate;
+
+      size_t mBlock;
+      size_t mRow;
+      size_t mBlockEnd;
+      IRowConstPtrH mRowHolder;
+    };
+
+    /**
+      Streams the result of a query.  Unordered results are produced as the
+      scan finds them.  Ordered results need every match before the first
+      one can be returned, but only their identifiers are held on to.
+    */
+    class Cursor : public IQueryCursor
+    {
+    public:
+      Cursor(DatabaseInMemoryConstPtrH memory,
+        IFieldDescriptorConstListConstPtrH selectedFields,
+        const Predicate& filterConstraint,
+        IFieldDescriptorConstListConstPtrH orderBy) :
+        mMemory(memory),
+        mSelectedFields(selectedFields),
+        mOrderBy(orderBy),
+        mScan(*memory, filterConstraint),
+        mSorted(false),
+        mNextSorted(0)
+      {
+      }
+
+      IFieldDescriptorConstListConstPtrH getFieldDescriptors() const
+      {
+        return mSelectedFields;
+      }
+
+      const IRow* next()
+      {
+        RowIdentifier id;
+
+        if (!mOrderBy)
+        {
+          if (!mScan.next(&id))
+            return NULL;
+        }
+        else
+        {
+          if (!mSorted)
+          {
+            mMemory->collectOrdered(&mScan, *mOrderBy, &mSortedRows);
+            mSorted = true;
+          }
+
+          if (mNextSorted == mSortedRows.size())
+            return NULL;
+
+          id = mSortedRows[mNextSorted++];
+        }
+
+        return &mMemory->rowAt(id, &mCurrent);
+      }
+
+      const QueryStats& getStats() const
+      {
+        return mScan.getStats();
+      }
+
+    private:
+      DatabaseInMemoryConstPtrH mMemory;
+      IFieldDescriptorConstListConstPtrH mSelectedFields;
+      IFieldDescriptorConstListConstPtrH mOrderBy;
+      Scan mScan;
+
+      bool mSorted;
+      RowIdentifierList mSortedRows;
+      size_t mNextSorted;
+      IRowConstPtrH mCurrent;
+    };
+
+    /**
+      A thin container that stores the identifiers of a subset of rows 
+      from the database, and a reference to a subset of fields.  By the 
+      time a row subset makes it into a Result, it has already been ordered.
+    */
+    class Result : public IQueryResult
+    {
+    public:
+      Result(IFieldDescriptorConstListConstPtrH selectedFields,
+        DatabaseInMemoryConstPtrH memory,
+        RowIdentifierList& selectedRows) :
+        mSelectedFields(selectedFields),
+        mMemory(memory)
+      {
+        mSelectedRows.swap(selectedRows);
+      }
+
+      IFieldDescriptorConstListConstPtrH getFieldDescriptors() const
+      {
+        return mSelectedFields;
+      }
+
+      IRowConstPtrH operator[](size_t idx) const
+      {
+        return mMemory->getRow(mSelectedRows[idx]);
+      }
+
+      size_t size() const
+      {
+        return mSelectedRows.size();
+      }
+
+    private:
+      IFieldDescriptorConstListConstPtrH mSelectedFields;
+      DatabaseInMemoryConstPtrH mMemory;
+      RowIdentifierList mSelectedRows;
+    };
+
+    /**
+      Streams the groups of the aggregates by a field, a row per group in
+      ascending order of the group values.  The group field selects the
+      group's value, any other field its sum, which is a text column with
+      two decimals (like the prices it adds up) named e.g. "REV:sum".
+      The groups are copied when the cursor is opened, no rows are read.
+    */
+    class AggregateCursor : public IQueryCursor
+    {
+    public:
+      AggregateCursor(const DatabaseInMemory& memory,
+        IFieldDescriptorConstPtrH groupField,
+        const IFieldDescriptorConstList& select) :
+        mGroupField(groupField),
+        mRowFields(memory.mFields),
+        mSelectedFields(new IFieldDescriptorConstList()),
+        mNextGroup(0)
+      {
+        for (IFieldDescriptorConstList::const_iterator field = select.cbegin();
+          field != select.cend(); ++field)
+        {
+          if (**field == *groupField)
+          {
+            mSelectedFields->push_back(groupField);
+            continue;
+          }
+
+          AggregatePtrH aggregate = memory.findAggregate(*groupField, **field);
+          if (!aggregate)
+          {
+            std::string ex = "No sum of ";
+            ex += (*field)->getName();
+            ex += " by ";
+            ex += groupField->getName();
+            ex += " is declared in the scheme";
+            throw std::runtime_error(ex);
+          }
+
+          // Sums go after the fields of the scheme, rows are indexed by id
+          std::string name = (*field)->getName();
+          name += ":sum";
+          IFieldDescriptorConstPtrH sumField = FieldDescriptorFactory::Create(
+            (FieldId)mRowFields.size(), TypeInfo_String, name.c_str(), "", false, 0);
+          mRowFields.push_back(sumField);
+          mSelectedFields->push_back(sumField);
+
+          mSums.push_back(AggregateGroupList());
+          aggregate->getGroups(&mSums.back());
+        }
+
+        // Any aggregate by the field has every group, a row with a value
+        // of the group field counts in all of them
+        AggregatePtrH groups = memory.findAggregate(*groupField);
+        if (!groups)
+        {
+          std::string ex = "Nothing is aggregated by ";
+          ex += groupField->getName();
+          ex += " in the scheme";
+          throw std::runtime_error(ex);
+        }
+        groups->getGroups(&mGroups);
+        mStats.rowsMatched = mGroups.size();
+      }
+
+      IFieldDescriptorConstListConstPtrH getFieldDescriptors() const
+      {
+        return mSelectedFields;
+      }
+
+      const IRow* next()
+      {
+        if (mNextGroup == mGroups.size())
+        {
+          return NULL;
+        }
+
+        size_t group = mNextGroup++;
+        size_t firstSum = mRowFields.size() - mSums.size();
+
+        Row* row = new Row(mRowFields);
+        mCurrent = IRowConstPtrH(row);
+        row->setValue(*mGroupField, ValuePtrH(new Value(*mGroups[group].value)));
+
+        char sum[64];
+        for (size_t column = 0; column < mSums.size(); ++column)
+        {
+          sprintf(sum, "%.2f", mSums[column][group].sum);
+          const IFieldDescriptor& sumField = *mRowFields[firstSum + column];
+          row->setValue(sumField, sumField.fromString(sum));
+        }
+
+        return row;
+      }
+
+      const QueryStats& getStats() const
+      {
+        return mStats;
+      }
+
+    private:
+      IFieldDescriptorConstPtrH mGroupField;
+      /** The fields of the scheme, followed by the sums */
+      IFieldDescriptorConstList mRowFields;
+      IFieldDescriptorConstListPtrH mSelectedFields;
+
+      AggregateGroupList mGroups;
+      /** The groups of each sum, in the order of mGroups */
+      std::vector<AggregateGroupList> mSums;
+      size_t mNextGroup;
+
+      IRowConstPtrH mCurrent;
+      QueryStats mStats;
+    };
+
+    //////////////////////////////////////////////////////////////////
+    //////////////////////////////////////////////////////////////////
+    /** 
+      Only indexedFields are indexed, they must hold values.  So are the 
+      aggregates of the scheme kept, those over indexedFields, unless 
+      keepsAggregates is false.
+    */
+    DatabaseInMemory(const IFieldDescriptorConstList& fields,
+      const IFieldDescriptorConstList& keyFields,
+      const IFieldDescriptorConstList& indexedFields,
+      bool keepsAggregates = true) :
+      mFields(fields),
+      mKeyFields(keyFields),
+      mKeys(keyFields),
+      mIsSourceSummed(true),
+      mAggregatesMutex(new std::mutex()),
+      mZones(fields.size())
+    {
+      for (IFieldDescriptorConstList::const_iterator field = indexedFields.cbegin();
+        field != indexedFields.cend(); ++field)
+      {
+        IIndexPtrH index = IndexFactory::Create(*field);
+        if (index)
+        {
+          mIndexes.push_back(index);
+        }
+
+        const std::vector<std::string>& aggregateBy = (*field)->getAggregateBy();
+        for (std::vector<std::string>::const_iterator groupName = aggregateBy.cbegin();
+          groupName != aggregateBy.cend() && keepsAggregates; ++groupName)
+        {
+          IFieldDescriptorConstPtrH groupField = FindField(indexedFields, groupName->c_str());
+          if (groupField)
+          {
+            mAggregates.push_back(AggregatePtrH(new Aggregate(groupField, *field)));
+          }
+        }
+      }
+    }
 
-    inline static RowIdentifier Empty()
+    /**
+      A copy to write the next version of the database to.  Rows don't
+      change once stored, so both versions share them (and an attached
+      source).  So do they share the row list, indexes, aggregates and
+      zones, until the copy writes to them: only the nodes on the paths 
+      to the entries it writes are copied.
+    */
+    DatabaseInMemoryPtrH clone() const
     {
-      return RowIdentifier();
+      // A reader may be summing the attached rows meanwhile
+      std::lock_guard<std::mutex> lock(*mAggregatesMutex);
+
+      DatabaseInMemoryPtrH copy(new DatabaseInMemory(*this));
+      copy->mAggregatesMutex = PointerType<std::mutex>::Shared(new std::mutex());
+
+      copy->mIndexes.clear();
+      for (IIndexList::const_iterator index = mIndexes.cbegin();
+        index != mIndexes.cend(); ++index)
+      {
+        copy->mIndexes.push_back((*index)->clone());
+      }
+
+      copy->mAggregates.clear();
+      for (AggregateList::const_iterator aggregate = mAggregates.cbegin();
+        aggregate != mAggregates.cend(); ++aggregate)
+      {
+        copy->mAggregates.push_back(AggregatePtrH(new Aggregate(**aggregate)));
+      }
+
+      return copy;
     }
 
-    inline RowIdentifier() :
-      mId((IdType)kEmpty)
+    /**
+      Serve the rows of source in place.  Nothing is read from it up front
+      but its zones, the key and secondary indexes are built when the rows
+      are materialized, and the aggregates when they are first read.
+    */
+    void attach(IRowSourcePtrH source)
     {
+      if (!mRows.empty() || mSource)
+      {
+        throw std::runtime_error("Rows can only be attached to an empty database");
+      }
+
+      mSource = source;
+      mIsSourceSummed = mAggregates.empty();
+
+      if (!mSource->getZones(&mZones))
+      {
+        for (size_t id = 0; id < mSource->getRowCount(); ++id)
+        {
+          mZones.update(id, *mSource->getRow(id), mFields);
+        }
+      }
     }
 
-    inline RowIdentifier(const IdType& id) :
-      mId(id)
+    /** True while rows are still served in place by an attached source */
+    bool isAttached() const
     {
+      return (bool)mSource;
     }
 
-    inline RowIdentifier& operator++()
+    /**
+      Copy the rows of an attached source into the database, and index
+      them, ahead of modifying it
+    */
+    void materialize()
     {
-      ++mId;
-      return *this;
+      if (!mSource)
+      {
+        return;
+      }
+
+      size_t rowCount = mSource->getRowCount();
+
+      for (RowIdentifier id(0); id < rowCount; ++id)
+      {
+        IRowConstPtrH row = mSource->getRow(id);
+        mKeys.insert(mKeys.hash(*row), id);
+        indexRow(id, *row);
+        if (!mIsSourceSummed)
+        {
+          aggregateRow(*row);
+        }
+        mRows.push_back(row);
+      }
+
+      mSource.reset();
+      mIsSourceSummed = true;
     }
 
-    inline bool operator<(const IdType& id) const
+    size_t getRowCount() const
     {
-      return mId < id;
+      return mSource ? mSource->getRowCount() : mRows.size();
     }
 
-    inline bool empty() const
+    IRowConstPtrH getRow(const RowIdentifier& id) const
     {
-      return mId == (IdType)kEmpty;
+      return mSource ? mSource->getRow(id) : mRows[id];
     }
 
-    inline const IdType& getId() const
+    /** 
+      The row stored at id.  Rows that are read in place are only kept 
+      alive by holder, so the reference is valid until it is reused.
+    */
+    const IRow& rowAt(const RowIdentifier& id, IRowConstPtrH* holder) const
     {
-      return mId;
+      if (mSource)
+      {
+        *holder = mSource->getRow(id);
+        return **holder;
+      }
+
+      return *mRows[id];
     }
 
-    inline operator IdType() const
+    /** Hash of row's key fields, as used by lookupKey() and insert() */
+    size_t hashKey(const IRow& row) const
     {
-      return mId;
+      return mKeys.hash(row);
     }
 
-  private:
-    IdType mId;
-  };
+    bool equalKeys(const IRow& left, const IRow& right) const
+    {
+      return mKeys.equal(left, right);
+    }
 
-  /**
-    Bread-dead storage, stores entire database in memory using
-    vectors of rows.
-  */
-  class DatabaseInMemory
-  {
-  protected:
-    typedef std::vector<IRowConstPtrH> IRowConstList;
-    typedef PointerType<IRowConstList>::Shared IRowConstListPtrH;
-    typedef PointerType<IRowConstList>::SharedConst IRowConstListConstPtrH;
+    /** The row holding the same key as row, Empty if there is none */
+    RowIdentifier lookupKey(const IRow& row, size_t keyHash) const
+    {
+      return mKeys.find(row, keyHash, mRows);
+    }
 
-  public:
-    /**
-      stl algorithm compatible comparison for sorting a row by a subset of fields
-      in ascending order.  The order in which the fields appear in the descriptor
-      list imply sorting priority.
+    bool replace(const RowIdentifier& id, IRowConstPtrH row)
+    {
+      if (id < mRows.size())
+      {
+        unindexRow(id, *mRows[id]);
+        unaggregateRow(*mRows[id]);
+        mRows.modify(id) = row;
+        indexRow(id, *row);
+        aggregateRow(*row);
+        mZones.update(id, *row, mFields);
+        return true;
+      }
+      else
+      {
+        return false;
+      }
+    }
+
+    bool insert(IRowConstPtrH row, size_t keyHash)
+    {
+      RowIdentifier id(mRows.size());
+      mKeys.insert(keyHash, id);
+      indexRow(id, *row);
+      aggregateRow(*row);
+      mZones.update(id, *row, mFields);
+      mRows.push_back(row);
+      return true;
+    }
+
+    /** 
+      Add row without a key, for databases that are never modified after
+      they have been loaded
     */
-    struct IRowOrderByFieldsAscending
+    void append(IRowConstPtrH row)
     {
-      IRowOrderByFieldsAscending(const IFieldDescriptorConstList& byFields) :
-        mCompareField(byFields)
+      RowIdentifier id(mRows.size());
+      indexRow(id, *row);
+      aggregateRow(*row);
+      mZones.update(id, *row, mFields);
+      mRows.push_back(row);
+    }
+
+    bool select(const IFieldDescriptor& field, const ValueRange& range,
+      Bitmap* outRows) const
+    {
+      for (IIndexList::const_iterator index = mIndexes.cbegin();
+        index != mIndexes.cend(); ++index)
       {
+        if (*(*index)->getField() == field && (*index)->lookup(range, outRows))
+        {
+          return true;
+        }
       }
 
-      // going through the shared pointer here will make this slower
-      bool operator() (const IRowConstPtrH& left, const IRowConstPtrH& right)
+      return false;
+    }
+
+    void persist(IDataStorage* storage)
+    {
+      IRowConstPtrH holder;
+      for (size_t id = 0; id < getRowCount(); ++id)
       {
-        for (IFieldDescriptorConstList::const_iterator field = mCompareField.cbegin();
-          field != mCompareField.cend(); ++field)
+        storage->persistRow(&rowAt(id, &holder));
+      }
+    }
+
+    IQueryCursorPtrH openCursor(
+      IFieldDescriptorConstListConstPtrH selectFields,
+      const Predicate* filterConstraint,
+      IFieldDescriptorConstListConstPtrH orderBy) const
+    {
+      return IQueryCursorPtrH(new Cursor(shared_from_this(),
+        selectFields, *filterConstraint, orderBy));
+    }
+
+    IQueryCursorPtrH openAggregateCursor(IFieldDescriptorConstPtrH groupField,
+      IFieldDescriptorConstListConstPtrH select) const
+    {
+      sumSourceRows();
+
+      if (select)
+      {
+        return IQueryCursorPtrH(new AggregateCursor(*this, groupField, *select));
+      }
+
+      // The group, and every sum by it
+      IFieldDescriptorConstList allSums(1, groupField);
+      for (AggregateList::const_iterator aggregate = mAggregates.cbegin();
+        aggregate != mAggregates.cend(); ++aggregate)
+      {
+        if (*(*aggregate)->getGroupField() == *groupField)
         {
-          const ValueConstPtrH leftValue = left->getValue(*field->get());
-          const ValueConstPtrH rightValue = right->getValue(*field->get());
+          allSums.push_back((*aggregate)->getSumField());
+        }
+      }
 
-          // All previous fields are equal, and this one is less than the other
-          if (*leftValue < *rightValue)
-            return true;
+      return IQueryCursorPtrH(new AggregateCursor(*this, groupField, allSums));
+    }
 
-          // If not equal, don't continue looking at other fields
-          if (*leftValue != *rightValue)
-            return false;
+    IQueryResultConstPtrH query(
+      IFieldDescriptorConstListConstPtrH selectFields,
+      const Predicate* filterConstraint,
+      IFieldDescriptorConstListConstPtrH orderBy,
+      QueryStats* pStats) const
+    {
+      Scan scan(*this, *filterConstraint);
+      RowIdentifierList selectedRows;
+
+      if (orderBy)
+      {
+        collectOrdered(&scan, *orderBy, &selectedRows);
+      }
+      else
+      {
+        for (RowIdentifier id; scan.next(&id);)
+        {
+          selectedRows.push_back(id);
         }
+      }
+
+      if (pStats != NULL)
+      {
+        *pStats = scan.getStats();
+      }
+
+      return IQueryResultConstPtrH(
+        new Result(selectFields, shared_from_this(), selectedRows));
+    }
+
+    void queryBatch(const BatchQueryList& queries, IQueryResultConstList* outResults,
+      QueryStatsList* outStats) const
+    {
+      std::vector<RowIdentifierList> selectedRows(queries.size());
+      QueryStatsList stats(queries.size());
+      IRowConstPtrH rowHolder;
 
+      // Filters the indexes answer test their candidates alone
+      std::vector<size_t> scanning;
+      std::vector<ZoneFilter> zoneFilters;
+      for (size_t query = 0; query < queries.size(); ++query)
+      {
+        const Predicate& filter = queries[query].filter;
+
+        Bitmap candidates;
+        stats[query].usedIndex = lookupCandidates(filter, &candidates);
+        if (!stats[query].usedIndex)
+        {
+          scanning.push_back(query);
+          zoneFilters.push_back(ZoneFilter(filter));
+          continue;
+        }
+
+        for (Bitmap::const_iterator candidate = candidates.cbegin();
+          candidate != candidates.cend(); ++candidate)
+        {
+          ++stats[query].rowsScanned;
+          if (filter.matches(rowAt(*candidate, &rowHolder)))
+          {
+            selectedRows[query].push_back(RowIdentifier(*candidate));
+          }
+        }
+      }
+
+      // The rest share a scan of the blocks that any of them may match
+      std::vector<size_t> matching;
+      for (size_t block = 0; block < mZones.getBlockCount() && !scanning.empty(); ++block)
+      {
+        matching.clear();
+        for (size_t filter = 0; filter < scanning.size(); ++filter)
+        {
+          QueryStats& queryStats = stats[scanning[filter]];
+          if (zoneFilters[filter].mayMatch(mZones.getZones(block)))
+          {
+            ++queryStats.blocksScanned;
+            matching.push_back(scanning[filter]);
+          }
+          else
+          {
+            ++queryStats.blocksSkipped;
+          }
+        }
+
+        size_t blockEnd = std::min(getRowCount(), (block + 1) * ZoneMap::kRowsPerBlock);
+        for (size_t id = block * ZoneMap::kRowsPerBlock; id < blockEnd && !matching.empty(); ++id)
+        {
+          const IRow& row = rowAt(id, &rowHolder);
+          for (std::vector<size_t>::const_iterator query = matching.cbegin();
+            query != matching.cend(); ++query)
+          {
+            ++stats[*query].rowsScanned;
+            if (queries[*query].filter.matches(row))
+            {
+              selectedRows[*query].push_back(RowIdentifier(id));
+            }
+          }
+        }
+      }
+
+      outResults->clear();
+      for (size_t query = 0; query < queries.size(); ++query)
+      {
+        if (queries[query].orderBy)
+        {
+          std::sort(selectedRows[query].begin(), selectedRows[query].end(),
+            IRowOrderByFieldsAscending(*this, *queries[query].orderBy));
+        }
+
+        stats[query].rowsMatched = selectedRows[query].size();
+        outResults->push_back(IQueryResultConstPtrH(new Result(queries[query].select,
+          shared_from_this(), selectedRows[query])));
+      }
+
+      if (outStats != NULL)
+      {
+        outStats->swap(stats);
+      }
+    }
+
+  private:
+    /** Drain scan, and sort the matches */
+    void collectOrdered(Scan* scan, const IFieldDescriptorConstList& orderBy,
+      RowIdentifierList* outRows) const
+    {
+      for (RowIdentifier id; scan->next(&id);)
+      {
+        outRows->push_back(id);
+      }
+
+      std::sort(outRows->begin(),
+        outRows->end(),
+        IRowOrderByFieldsAscending(*this, orderBy));
+    }
+
+    /**
+      Use the indexes to narrow down the rows that could match pred, 
+      AND/OR'ing the per-index row bitmaps as dictated by the predicate.
+      Returns false if pred can not be answered from the indexes, in 
+      which case a full scan is required.
+    */
+    bool lookupCandidates(const Predicate& pred, Bitmap* outCandidates) const
+    {
+      // Rows served in place aren't indexed until they are materialized,
+      // but the source may find a key
+      if (mSource)
+      {
+        return lookupSourceKey(pred, outCandidates);
+      }
+
+      if (mIndexes.empty())
+      {
         return false;
       }
 
-    private:
-      const IFieldDescriptorConstList& mCompareField;
-    };
+      return pred.select(*this, outCandidates);
+    }
 
     /**
-      A bit of an assumption here is that the IFieldDescriptor id can be
-      used as an index into a vector of values (i.e. the id monotonically
-      increases from zero for each field in the scheme).  There should 
-      reall be some kind of contract between a scheme and database with 
-      which to establish this.
+      A predicate that pins every key field to a single value matches the
+      row of that key at most, which the source looks up.  Returns false
+      if pred doesn't, or the source can't look keys up.
     */
-    class Row : public IRow
+    bool lookupSourceKey(const Predicate& pred, Bitmap* outCandidates) const
     {
-    public:
-      Row(const IFieldDescriptorConstList& fields)
+      if (mKeyFields.empty())
+      {
+        return false;
+      }
+
+      Row key(mFields);
+      for (IFieldDescriptorConstList::const_iterator field = mKeyFields.cbegin();
+        field != mKeyFields.cend(); ++field)
+      {
+        ValueRange range;
+        if (!pred.getRange(**field, &range) || !range.isExact())
+        {
+          return false;
+        }
+        key.setValue(**field, ValuePtrH(new Value(*range.getLow())));
+      }
+
+      size_t position = 0;
+      if (!mSource->findKey(key, &position))
       {
-        // Reserve space for a complete row.
-        mRow.resize(fields.size());
+        return false;
       }
 
-      ValueConstPtrH getValue(const IFieldDescriptor& field) const
+      outCandidates->clear();
+      if (position < mSource->getRowCount())
       {
-        if ((size_t)field.getId() < mRow.size())
-          return mRow[field.getId()];
-        else
-          return NULL;
+        outCandidates->add((Bitmap::Element)position);
       }
+      return true;
+    }
 
-      bool setValue(const IFieldDescriptor& field, 
-        ValuePtrH value)
+    void indexRow(const RowIdentifier& id, const IRow& row)
+    {
+      for (IIndexList::const_iterator index = mIndexes.cbegin();
+        index != mIndexes.cend(); ++index)
       {
-        if ((size_t)field.getId() < mRow.size())
+        ValueConstPtrH value = row.getValue(*(*index)->getField());
+        if (value)
         {
-          mRow[field.getId()] = value;
-          return true;
+          (*index)->insert(value, id);
         }
-        else
+      }
+    }
+
+    void unindexRow(const RowIdentifier& id, const IRow& row)
+    {
+      for (IIndexList::const_iterator index = mIndexes.cbegin();
+        index != mIndexes.cend(); ++index)
+      {
+        ValueConstPtrH value = row.getValue(*(*index)->getField());
+        if (value)
         {
-          return false;
+          (*index)->remove(value, id);
         }
       }
+    }
 
-    private:
-      std::vector<ValuePtrH> mRow;
-    };
+    void aggregateRow(const IRow& row)
+    {
+      for (AggregateList::const_iterator aggregate = mAggregates.cbegin();
+        aggregate != mAggregates.cend(); ++aggregate)
+      {
+        (*aggregate)->add(row);
+      }
+    }
 
     /**
-      A thin container that stores a reference to a subset of rows from
-      the database, and a reference to a subset of fields.  By the time
-      a row subset makes it into a Result, it has already been ordered.
+      Add the rows served in place to the aggregates, unless they were
+      already.  Readers of the version share the work, the first one does it.
     */
-    class Result : public IQueryResult
+    void sumSourceRows() const
     {
-    public:
-      Result(IFieldDescriptorConstListConstPtrH selectedFields,
-        IRowConstListConstPtrH selectedRows) :
-        mSelectedFields(selectedFields),
-        mSelectedRows(selectedRows)
+      std::lock_guard<std::mutex> lock(*mAggregatesMutex);
+      if (mIsSourceSummed)
       {
+        return;
       }
 
-      IFieldDescriptorConstListConstPtrH getFieldDescriptors() const
+      IRowConstPtrH rowHolder;
+      for (size_t id = 0; id < getRowCount(); ++id)
       {
-        return mSelectedFields;
+        const IRow& row = rowAt(id, &rowHolder);
+        for (AggregateList::const_iterator aggregate = mAggregates.cbegin();
+          aggregate != mAggregates.cend(); ++aggregate)
+        {
+          (*aggregate)->add(row);
+        }
       }
 
-      IRowConstPtrH operator[](size_t idx) const
+      mIsSourceSummed = true;
+    }
+
+    void unaggregateRow(const IRow& row)
+    {
+      for (AggregateList::const_iterator aggregate = mAggregates.cbegin();
+        aggregate != mAggregates.cend(); ++aggregate)
       {
-        return (*mSelectedRows)[idx];
+        (*aggregate)->remove(row);
       }
+    }
 
-      size_t size() const
+    /** 
+      The aggregate of sumField by groupField, or any aggregate by 
+      groupField if sumField is NULL.  NULL if there is none.
+    */
+    AggregatePtrH findAggregate(const IFieldDescriptor& groupField,
+      const IFieldDescriptor* sumField = NULL) const
+    {
+      for (AggregateList::const_iterator aggregate = mAggregates.cbegin();
+        aggregate != mAggregates.cend(); ++aggregate)
       {
-        return mSelectedRows->size();
+        if (*(*aggregate)->getGroupField() == groupField &&
+          (sumField == NULL || *(*aggregate)->getSumField() == *sumField))
+        {
+          return *aggregate;
+        }
       }
 
-    private:
-      IFieldDescriptorConstListConstPtrH mSelectedFields;
-      IRowConstListConstPtrH mSelectedRows;
-    };
+      return AggregatePtrH();
+    }
 
-    //////////////////////////////////////////////////////////////////
-    //////////////////////////////////////////////////////////////////
-    DatabaseInMemory()
+    AggregatePtrH findAggregate(const IFieldDescriptor& groupField,
+      const IFieldDescriptor& sumField) const
     {
+      return findAggregate(groupField, &sumField);
     }
 
-    RowIdentifier lookupRow(const Predicate& pred) const
+    static IFieldDescriptorConstPtrH FindField(const IFieldDescriptorConstList& fields,
+      const char* name)
     {
-      for (RowIdentifier id(0); id < mRows.size(); ++id)
+      for (IFieldDescriptorConstList::const_iterator field = fields.cbegin();
+        field != fields.cend(); ++field)
       {
-        if (pred.matches(*mRows[id]))
+        if (strcmp((*field)->getName(), name) == 0)
         {
-          return RowIdentifier(id);
+          return *field;
         }
       }
 
-      return RowIdentifier::Empty();
+      return IFieldDescriptorConstPtrH();
     }
 
-    bool replace(const RowIdentifier& id, IRowConstPtrH row)
+    IFieldDescriptorConstList mFields;
+    IFieldDescriptorConstList mKeyFields;
+    RowVector mRows;
+    IRowSourcePtrH mSource;
+    KeyIndex mKeys;
+    IIndexList mIndexes;
+    AggregateList mAggregates;
+    /** False until the rows of mSource are in the aggregates */
+    mutable bool mIsSourceSummed;
+    /** Guards the aggregates while mIsSourceSummed is false */
+    PointerType<std::mutex>::Shared mAggregatesMutex;
+    ZoneMap mZones;
+  };
+}
+
+/////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////
+
+namespace DataStore
+{
+  /** Fewest rows of a batch worth handing to another thread */
+  static const size_t kMinRowsPerThread = 16384;
+
+  /**
+    Call work(first, last) for threadCount slices of [0, count), on as many
+    threads.  The first exception thrown by work is rethrown here, once 
+    every slice is done.
+  */
+  template <typename Work>
+  static void RunInParallel(size_t threadCount, size_t count, Work work)
+  {
+    if (threadCount <= 1)
     {
-      if (id < mRows.size())
-      {
-        mRows[id] = row;
-        return true;
-      }
-      else
+      work(0, count);
+      return;
+    }
+
+    std::vector<std::exception_ptr> failures(threadCount);
+    std::vector<std::thread> threads;
+    threads.reserve(threadCount);
+
+    for (size_t thread = 0; thread < threadCount; ++thread)
+    {
+      threads.push_back(std::thread([&, thread]()
       {
-        return false;
-      }
+        try
+        {
+          work(count * thread / threadCount, count * (thread + 1) / threadCount);
+        }
+        catch (...)
+        {
+          failures[thread] = std::current_exception();
+        }
+      }));
     }
 
-    bool insert(IRowConstPtrH row)
+    for (size_t thread = 0; thread < threadCount; ++thread)
     {
-      mRows.push_back(row);
-      return true;
+      threads[thread].join();
     }
 
-    void persist(IDataStorage* storage)
+    for (size_t thread = 0; thread < threadCount; ++thread)
     {
-      for (std::vector<IRowConstPtrH>::const_iterator row = mRows.cbegin();
-        row != mRows.cend(); ++row)
+      if (failures[thread])
       {
-        storage->persistRow(row->get());
+        std::rethrow_exception(failures[thread]);
       }
     }
+  }
+}
 
-    IQueryResultConstPtrH query(
-      IFieldDescriptorConstListConstPtrH selectFields,
-      const Predicate* filterConstraint,
-      IFieldDescriptorConstListConstPtrH orderBy)
+/////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////
+
+namespace DataStore
+{
+  /**
+    The scope of a call that modifies a database.  The outermost write of
+    a thread picks the version to write to, and the writes it calls share
+    it: a copy of the published version, or a replacement (see 
+    Database::reload).  The outermost write publishes the version once 
+    committed, one that wasn't committed is discarded.
+  */
+  class DatabaseWrite
+  {
+  public:
+    DatabaseWrite(Database* database, 
+      DatabaseInMemoryPtrH replacement = DatabaseInMemoryPtrH()) :
+      mDatabase(database),
+      mLock(database->mWriterMutex),
+      mIsCommitted(false)
     {
-      IRowConstListPtrH selectedRows(new IRowConstList());
+      if (mDatabase->mWriteDepth++ > 0)
+      {
+        return;
+      }
 
-      for (std::vector<IRowConstPtrH>::const_iterator row = mRows.cbegin();
-        row != mRows.cend(); ++row)
+      if (replacement)
       {
-        if (filterConstraint->matches(*(row->get())))
-        {
-          selectedRows->push_back(*row);
-        }
+        mDatabase->mWriting = replacement;
+        return;
       }
 
-      if (orderBy)
+      // Only writers replace mMemory, so it can be copied without holding
+      // up the readers
+      try
+      {
+        mDatabase->mWriting = mDatabase->mMemory->clone();
+      }
+      catch (std::exception&)
       {
-        std::sort(selectedRows->begin(),
-          selectedRows->end(),
-          IRowOrderByFieldsAscending(*(orderBy.get())));
+        --mDatabase->mWriteDepth;
+        throw;
       }
+    }
 
-      return IQueryResultConstPtrH(
-        new Result(selectFields, selectedRows));
+    ~DatabaseWrite()
+    {
+      if (--mDatabase->mWriteDepth > 0)
+      {
+        return;
+      }
+
+      DatabaseInMemoryPtrH written;
+      written.swap(mDatabase->mWriting);
+
+      if (mIsCommitted)
+      {
+        std::lock_guard<std::mutex> lock(mDatabase->mVersionMutex);
+        mDatabase->mMemory.swap(written);
+        ++mDatabase->mGeneration;
+      }
+
+      // The version that was replaced (or the uncommitted copy) is freed 
+      // here, unless queries still read it
+    }
+
+    DatabaseInMemory& get()
+    {
+      return *mDatabase->mWriting;
+    }
+
+    void commit()
+    {
+      mIsCommitted = true;
     }
 
   private:
-    IRowConstList mRows;
+    DatabaseWrite(const DatabaseWrite&);
+    DatabaseWrite& operator=(const DatabaseWrite&);
+
+    Database* mDatabase;
+    std::lock_guard<std::recursive_mutex> mLock;
+    bool mIsCommitted;
   };
 }
 
 /////////////////////////////////////////////////////////////////////
 /////////////////////////////////////////////////////////////////////
 
-Database::Database(IDataStoragePtrH storage) :
-  mStorage(storage),
+Database::Database(IDataStoragePtrH storage,
+  IFieldDescriptorConstListConstPtrH loadFields,
+  const Predicate* loadFilter) :
   mScheme(storage->getScheme()),
-  mMemory(new DatabaseInMemory())
+  mStorage(storage),
+  mGeneration(0),
+  mWriteDepth(0),
+  mLoadedFields(loadFields),
+  mPartial(loadFields || loadFilter != NULL),
+  mIsFiltered(loadFilter != NULL)
 {
   mFields = mScheme->getFieldDescriptors();
   mKeyFields = mScheme->getKeyFieldDescriptors();
+  // Sums over the rows that passed a filter aren't the sums of the groups
+  mMemory = DatabaseInMemoryPtrH(new DatabaseInMemory(*mFields, *mKeyFields,
+    mLoadedFields ? *mLoadedFields : *mFields, !mIsFiltered));
 
-  storage->load(this);
+  if (loadFilter != NULL)
+  {
+    IFieldDescriptorConstList filterFields;
+    loadFilter->getFieldDescriptors(&filterFields);
+    throwUnlessLoaded(filterFields);
+  }
+
+  storage->load(this, mLoadedFields, loadFilter);
 }
 
 Database::Database(ISchemeConstPtrH scheme) :
   mScheme(scheme),
-  mMemory(new DatabaseInMemory())
+  mGeneration(0),
+  mWriteDepth(0),
+  mPartial(false),
+  mIsFiltered(false)
 {
   mFields = mScheme->getFieldDescriptors();
   mKeyFields = mScheme->getKeyFieldDescriptors();
+  mMemory = DatabaseInMemoryPtrH(new DatabaseInMemory(*mFields, *mKeyFields, *mFields));
 }
 
 Database::~Database()
@@ -301,18 +1189,84 @@ ISchemeConstPtrH Database::getScheme() const
 
 IRowPtrH Database::createRow() const
 {
-  IRowPtrH newRow(new DatabaseInMemory::Row(*(mFields.get())));
+  IRowPtrH newRow(new Row(*(mFields.get())));
   return newRow;
 }
 
+void Database::attach(IRowSourcePtrH source)
+{
+  DatabaseWrite write(this);
+  write.get().attach(source);
+  write.commit();
+}
+
 void Database::persist()
 {
-  if (mStorage)
+  // Writers don't replace the published version meanwhile
+  std::lock_guard<std::recursive_mutex> lock(mWriterMutex);
+  DatabaseInMemoryPtrH memory = mWriting ? mWriting : mMemory;
+
+  // Rows that are still served in place by the storage are unchanged,
+  // and rows that were only partially loaded mustn't overwrite them
+  if (mStorage && !memory->isAttached() && !mPartial)
   {
     mStorage->beginPersist();
-    mMemory->persist(mStorage.get());
+    memory->persist(mStorage.get());
     mStorage->endPersist();
+
+    std::lock_guard<std::mutex> versionLock(mVersionMutex);
+    ++mGeneration;
+  }
+}
+
+void Database::reload(IDataStoragePtrH storage)
+{
+  // Another reload may replace mStorage meanwhile
+  std::lock_guard<std::recursive_mutex> lock(mWriterMutex);
+
+  if (!mStorage || mPartial)
+  {
+    throw std::runtime_error("Only a database that was loaded in full can be reloaded");
+  }
+
+  if (storage)
+  {
+    // Rows refer to fields by their position
+    IFieldDescriptorConstListConstPtrH fields = storage->getScheme()->getFieldDescriptors();
+    bool isSameScheme = fields->size() == mFields->size();
+    for (size_t field = 0; field < fields->size() && isSameScheme; ++field)
+    {
+      isSameScheme = 
+        strcmp((*fields)[field]->getName(), (*mFields)[field]->getName()) == 0 &&
+        (*fields)[field]->getType() == (*mFields)[field]->getType();
+    }
+
+    if (!isSameScheme)
+    {
+      throw std::runtime_error("The reloaded storage has a different scheme");
+    }
   }
+
+  DatabaseWrite write(this, DatabaseInMemoryPtrH(
+    new DatabaseInMemory(*mFields, *mKeyFields, *mFields)));
+
+  IDataStoragePtrH loaded = storage ? storage : mStorage;
+  loaded->load(this, NULL, NULL);
+  mStorage = loaded;
+
+  write.commit();
+}
+
+uint64_t Database::getGeneration() const
+{
+  std::lock_guard<std::mutex> lock(mVersionMutex);
+  return mGeneration;
+}
+
+DatabaseInMemoryPtrH Database::pinVersion() const
+{
+  std::lock_guard<std::mutex> lock(mVersionMutex);
+  return mMemory;
 }
 
 bool Database::insert(IRowConstPtrH row, InsertionResult* pResult)
@@ -320,34 +1274,33 @@ bool Database::insert(IRowConstPtrH row, InsertionResult* pResult)
   InsertionResult result = eInsertionResult_Unknown;
   bool status = false;
 
-  //
-  // Create constraint that will match iff all key fields are exact
-  //
-
-  Logic::And* andTogether = new Logic::And();
-  for (IFieldDescriptorConstList::const_iterator keyField = mKeyFields->cbegin();
-    keyField != mKeyFields->cend(); ++keyField)
+  if (mPartial)
   {
-    IFieldDescriptorConstPtrH field = *keyField;
-
-    IQualifierPtrH exactKeyValue(new Logic::Exact(field, row->getValue(*field)));
-    andTogether->with(exactKeyValue);
+    if (pResult != NULL)
+    {
+      *pResult = result;
+    }
+    return false;
   }
 
-  IQualifierPtrH exactKeys(andTogether);
-  Predicate matchExactKeys(exactKeys);
+  DatabaseWrite write(this);
+  DatabaseInMemory& memory = write.get();
+  memory.materialize();
+
+  size_t keyHash = memory.hashKey(*row);
 
-  RowIdentifier found = mMemory->lookupRow(matchExactKeys);
+  RowIdentifier found = memory.lookupKey(*row, keyHash);
   if (found.empty())
   {
     result = eInsertionResult_Inserted;
-    status = mMemory->insert(row);
+    status = memory.insert(row, keyHash);
   }
   else
   {
     result = eInsertionResult_Replaced;
-    status = mMemory->replace(found, row);
+    status = memory.replace(found, row);
   }
+  write.commit();
 
   if (pResult != NULL)
   {
@@ -356,7 +1309,162 @@ bool Database::insert(IRowConstPtrH row, InsertionResult* pResult)
   return status;
 }
 
+bool Database::insertBatch(const IRowConstList& rows, 
+  size_t* pInserted, size_t* pReplaced)
+{
+  //
+  // Collapse rows sharing a key, the last one wins.  Distinct keys keep
+  // the position of their first row, so rows are stored in the same 
+  // order as inserting them one at a time would.  Large batches are 
+  // collapsed, and probed, by several threads.
+  //
+
+  if (mPartial)
+  {
+    return false;
+  }
+
+  DatabaseWrite write(this);
+  DatabaseInMemory& memory = write.get();
+  memory.materialize();
+
+  size_t threadCount = std::min<size_t>(
+    std::max<size_t>(std::thread::hardware_concurrency(), 1),
+    std::max<size_t>(rows.size() / kMinRowsPerThread, 1));
+
+  ConcurrentKeyIndex distinctRows(*mKeyFields);
+  RunInParallel(threadCount, rows.size(), [&](size_t first, size_t last)
+  {
+    for (size_t i = first; i < last; ++i)
+    {
+      distinctRows.put(rows[i], distinctRows.hash(*rows[i]), i);
+    }
+  });
+
+  ConcurrentKeyIndex::EntryList distinctKeys;
+  distinctRows.getEntries(&distinctKeys);
+
+  //
+  // Probe the primary index once per distinct key
+  //
+
+  std::vector<RowIdentifier> found(distinctKeys.size());
+  RunInParallel(threadCount, distinctKeys.size(), [&](size_t first, size_t last)
+  {
+    for (size_t key = first; key < last; ++key)
+    {
+      found[key] = memory.lookupKey(*distinctKeys[key].row, distinctKeys[key].hash);
+    }
+  });
+
+  size_t inserted = 0;
+  size_t replaced = 0;
+  bool status = true;
+
+  for (size_t key = 0; key < distinctKeys.size(); ++key)
+  {
+    const ConcurrentKeyIndex::Entry& entry = distinctKeys[key];
+
+    if (found[key].empty())
+    {
+      status = memory.insert(entry.row, entry.hash) && status;
+      ++inserted;
+      replaced += entry.occurrences - 1;
+    }
+    else
+    {
+      status = memory.replace(found[key], entry.row) && status;
+      replaced += entry.occurrences;
+    }
+  }
+  write.commit();
+
+  if (pInserted != NULL)
+  {
+    *pInserted = inserted;
+  }
+  if (pReplaced != NULL)
+  {
+    *pReplaced = replaced;
+  }
+  return status;
+}
+
+bool Database::loadBatch(const IRowConstList& rows)
+{
+  if (!mPartial)
+  {
+    return insertBatch(rows);
+  }
+
+  DatabaseWrite write(this);
+  for (IRowConstList::const_iterator row = rows.cbegin(); row != rows.cend(); ++row)
+  {
+    write.get().append(*row);
+  }
+  write.commit();
+
+  return true;
+}
+
+void Database::throwUnlessLoaded(const IFieldDescriptorConstList& fields) const
+{
+  if (!mLoadedFields)
+  {
+    return;
+  }
+
+  for (IFieldDescriptorConstList::const_iterator field = fields.cbegin();
+    field != fields.cend(); ++field)
+  {
+    bool loaded = false;
+    for (IFieldDescriptorConstList::const_iterator loadedField = mLoadedFields->cbegin();
+      loadedField != mLoadedFields->cend() && !loaded; ++loadedField)
+    {
+      loaded = **loadedField == **field;
+    }
+
+    if (!loaded)
+    {
+      std::string ex = "Field \"";
+      ex += (*field)->getName();
+      ex += "\" was not loaded";
+      throw std::runtime_error(ex);
+    }
+  }
+}
+
 IQueryResultConstPtrH Database::query(
+  IFieldDescriptorConstListConstPtrH selectFields,
+  const Predicate* filterConstraint,
+  IFieldDescriptorConstListConstPtrH orderBy,
+  QueryStats* pStats)
+{
+  IFieldDescriptorConstListConstPtrH select = selectFields;
+  if (!select || select->empty())
+  {
+    select = mScheme->getFieldDescriptors();
+  }
+
+  const Predicate* filter = &Predicate::AlwaysTrue();
+  if (filterConstraint != NULL)
+  {
+    filter = filterConstraint;
+  }
+
+  IFieldDescriptorConstList filterFields;
+  filter->getFieldDescriptors(&filterFields);
+  throwUnlessLoaded(*select);
+  throwUnlessLoaded(filterFields);
+  if (orderBy)
+  {
+    throwUnlessLoaded(*orderBy);
+  }
+
+  return pinVersion()->query(select, filter, orderBy, pStats);
+}
+
+IQueryCursorPtrH Database::openCursor(
   IFieldDescriptorConstListConstPtrH selectFields,
   const Predicate* filterConstraint,
   IFieldDescriptorConstListConstPtrH orderBy)
@@ -373,5 +1481,57 @@ IQueryResultConstPtrH Database::query(
     filter = filterConstraint;
   }
 
-  return mMemory->query(select, filter, orderBy);
+  IFieldDescriptorConstList filterFields;
+  filter->getFieldDescriptors(&filterFields);
+  throwUnlessLoaded(*select);
+  throwUnlessLoaded(filterFields);
+  if (orderBy)
+  {
+    throwUnlessLoaded(*orderBy);
+  }
+
+  return pinVersion()->openCursor(select, filter, orderBy);
+}
+
+void Database::queryBatch(const BatchQueryList& queries, IQueryResultConstList* outResults,
+  QueryStatsList* outStats)
+{
+  BatchQueryList checked(queries);
+  for (BatchQueryList::iterator query = checked.begin(); query != checked.end(); ++query)
+  {
+    if (!query->select || query->select->empty())
+    {
+      query->select = mScheme->getFieldDescriptors();
+    }
+
+    IFieldDescriptorConstList filterFields;
+    query->filter.getFieldDescriptors(&filterFields);
+    throwUnlessLoaded(*query->select);
+    throwUnlessLoaded(filterFields);
+    if (query->orderBy)
+    {
+      throwUnlessLoaded(*query->orderBy);
+    }
+  }
+
+  pinVersion()->queryBatch(checked, outResults, outStats);
+}
+
+IQueryCursorPtrH Database::openAggregateCursor(
+  IFieldDescriptorConstPtrH groupField,
+  IFieldDescriptorConstListConstPtrH select)
+{
+  if (mIsFiltered)
+  {
+    throw std::runtime_error("Aggregates are not kept for a database that was loaded with a filter");
+  }
+
+  IFieldDescriptorConstList used(1, groupField);
+  if (select)
+  {
+    used.insert(used.end(), select->cbegin(), select->cend());
+  }
+  throwUnlessLoaded(used);
+
+  return pinVersion()->openAggregateCursor(groupField, select);
 }
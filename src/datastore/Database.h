@@ -6,6 +6,8 @@
 #include <datastore/DataStorage.h>
 #include <datastore/Row.h>
 #include <datastore/Logic.h>
+#include <mutex>
+#include <stdint.h>
 
 namespace DataStore
 {
@@ -87,8 +89,86 @@ namespace DataStore
   typedef PointerType<IQueryResult>::Shared IQueryResultPtrH;
   typedef PointerType<IQueryResult>::SharedConst IQueryResultConstPtrH;
 
+  struct QueryStats;
+
+  /**
+    Streams the rows selected by a query one at a time, without 
+    materializing the whole result.
+  */
+  struct IQueryCursor
+  {
+    /** Returns fields that selected within result */
+    virtual IFieldDescriptorConstListConstPtrH getFieldDescriptors() const = 0;
+
+    /** 
+      Returns the next row, or NULL once all rows have been returned.  The
+      row remains valid until the next call.  Rows come from the version 
+      of the database the cursor was opened on, later changes don't show.
+    */
+    virtual const IRow* next() = 0;
+
+    /** Execution counters so far, complete once next() returns NULL */
+    virtual const QueryStats& getStats() const = 0;
+  };
+
+  typedef PointerType<IQueryCursor>::Shared IQueryCursorPtrH;
+
+  /**
+    Counters describing how a query was executed
+  */
+  struct QueryStats
+  {
+    QueryStats() :
+      rowsScanned(0), rowsMatched(0), blocksScanned(0), blocksSkipped(0),
+      usedIndex(false)
+    {
+    }
+
+    /** Rows that were tested against the filter */
+    size_t rowsScanned;
+    /** Rows that passed the filter */
+    size_t rowsMatched;
+    /** Blocks of rows that were scanned */
+    size_t blocksScanned;
+    /** Blocks of rows skipped because their zone maps ruled out a match */
+    size_t blocksSkipped;
+    /** True if the candidate rows came from the indexes, not a full scan */
+    bool usedIndex;
+  };
+
+  typedef std::vector<QueryStats> QueryStatsList;
+
+  /**
+    One query of a batch, see Database::queryBatch()
+  */
+  struct BatchQuery
+  {
+    BatchQuery() :
+      filter(Predicate::AlwaysTrue())
+    {
+    }
+
+    /** NULL selects all fields */
+    IFieldDescriptorConstListConstPtrH select;
+    Predicate filter;
+    /** NULL leaves the order undefined */
+    IFieldDescriptorConstListConstPtrH orderBy;
+  };
+
+  typedef std::vector<BatchQuery> BatchQueryList;
+  typedef std::vector<IQueryResultConstPtrH> IQueryResultConstList;
+
   /**
     A database that can hold a single table.
+
+    Queries read an immutable version of the rows, which they hold on to
+    until they are done, so they can run while another thread modifies the
+    database, without waiting for it.  Writers take turns, and each call 
+    that modifies the database works on a copy of the current version, 
+    which it publishes when it returns.  A copy shares the rows, indexes
+    and aggregates of the version it was made from, and copies only the
+    parts it writes to, so a write costs about the same however large the
+    table.  A version is freed once the last query reading it is done.
   */
   class Database
   {
@@ -104,9 +184,15 @@ namespace DataStore
     } InsertionResult;
 
     /**
-      Creates a database with a storage-back
+      Creates a database with a storage-back.  If loadFields is specified,
+      only those fields are loaded, and it must include the fields of 
+      loadFilter.  If loadFilter is specified, rows that don't match it 
+      may not be loaded.  Either way the database can only be queried on 
+      the loaded fields and rows, and can't be modified or persisted.
     */
-    Database(IDataStoragePtrH storage);
+    Database(IDataStoragePtrH storage, 
+      IFieldDescriptorConstListConstPtrH loadFields = NULL,
+      const Predicate* loadFilter = NULL);
 
     /** Create an in-memory only database 
     */
@@ -120,20 +206,86 @@ namespace DataStore
     IRowPtrH createRow() const;
 
     /** 
-      Insert row into database.  A duplicate row will be replaced
+      Insert row into database.  A duplicate row will be replaced.  Fails 
+      if only some of the fields were loaded.
     */
     bool insert(IRowConstPtrH row, InsertionResult* pResult = NULL);
 
+    /**
+      Insert rows into database, in order.  Rows sharing a key with an 
+      earlier row (in rows, or already stored) replace it, so the last one
+      wins.  The counts are the same as inserting the rows one at a time,
+      but each distinct key is looked up only once.
+    */
+    bool insertBatch(const IRowConstList& rows, 
+      size_t* pInserted = NULL, size_t* pReplaced = NULL);
+
+    /**
+      Add rows read by the storage, while the database is loaded.  Rows 
+      that were loaded with only some of their fields may be missing their 
+      keys, they are added as they are (stored rows are unique already).
+      So are the rows of a filtered load.
+    */
+    bool loadBatch(const IRowConstList& rows);
+
     /**
      If select is not specified (NULL), all fields are selected.
+     Throws if any of the fields were not loaded.
      If filterConstraint is not specified (NULL), all rows are selected.
      if orderBy is not specified (NULL), the order is undefined.
+     If pStats is specified, it receives execution counters.
     */
     IQueryResultConstPtrH query(
+      IFieldDescriptorConstListConstPtrH select = NULL,
+      const Predicate* filterConstraint = NULL,
+      IFieldDescriptorConstListConstPtrH orderBy = NULL,
+      QueryStats* pStats = NULL);
+
+    /**
+     Same as query(), but the rows are produced as they are read.  Unordered
+     queries use constant memory.
+    */
+    IQueryCursorPtrH openCursor(
       IFieldDescriptorConstListConstPtrH select = NULL,
       const Predicate* filterConstraint = NULL,
       IFieldDescriptorConstListConstPtrH orderBy = NULL);
 
+    /**
+      Run several queries over the same version of the database, as if by
+      query(), in a single pass over the rows.  Filters that the indexes
+      answer read their candidates on their own, the rest share the scan:
+      each block is read once for the filters its zone maps don't rule
+      out, and each of its rows is tested against all of them.  Receives 
+      a result per query, in order, and if outStats is specified their 
+      execution counters.  Throws if any of the fields were not loaded.
+    */
+    void queryBatch(const BatchQueryList& queries, IQueryResultConstList* outResults,
+      QueryStatsList* outStats = NULL);
+
+    /**
+      Read the aggregates by groupField that the scheme declares: a row per
+      value of groupField, in ascending order.  Aggregates aren't stored,
+      so the rows a storage serves in place are summed by the first call,
+      or when they are copied in by the first modification.  After that,
+      no rows are read.
+      In select, groupField selects the value and any other field its sum,
+      as a text column named e.g. "REV:sum".  If select is not specified
+      (NULL), the value and every sum by groupField are selected.  Throws
+      if an aggregate isn't declared, or if any of the fields were not 
+      loaded, or if the rows were loaded with a filter.
+    */
+    IQueryCursorPtrH openAggregateCursor(
+      IFieldDescriptorConstPtrH groupField,
+      IFieldDescriptorConstListConstPtrH select = NULL);
+
+    /**
+      Serve the rows of source in place, rather than inserting them.  Used
+      by storages that can read rows where they are stored.  The rows are 
+      copied into the database the first time it is modified, until then
+      persist() has nothing to write.
+    */
+    void attach(IRowSourcePtrH source);
+
     /**
     */
     ISchemeConstPtrH getScheme() const;
@@ -143,12 +295,54 @@ namespace DataStore
     */
     void persist();
 
+    /**
+      Load the rows of storage, the database's own by default, and publish
+      them as a new version.  Queries read the previous version meanwhile.
+      Another process may have imported into the storage since it was 
+      opened, so it can be replaced by one opened again, whose scheme must
+      be the same.  Throws if only some of the fields or rows were loaded,
+      the database is left as it was if loading fails.
+    */
+    void reload(IDataStoragePtrH storage = IDataStoragePtrH());
+
+    /**
+      Counts the versions published, and the times the database was 
+      persisted.  A result computed while it was still the same can be 
+      reused for the same query, e.g. by a cache of results.
+    */
+    uint64_t getGeneration() const;
+
   private:
+    friend class DatabaseWrite;
+
+    /** The published version, that queries read from now on */
+    DatabaseInMemoryPtrH pinVersion() const;
+
     ISchemeConstPtrH mScheme;
     IDataStoragePtrH mStorage;
+
+    /** The published version, guarded by mVersionMutex */
     DatabaseInMemoryPtrH mMemory;
+    mutable std::mutex mVersionMutex;
+    /** Guarded by mVersionMutex */
+    uint64_t mGeneration;
+
+    /** Writers take turns, a write may call others (e.g. a load) */
+    std::recursive_mutex mWriterMutex;
+    /** The version being written, while writes are in progress */
+    DatabaseInMemoryPtrH mWriting;
+    size_t mWriteDepth;
+
+    /** Throw if a field was not loaded, and so can't be queried */
+    void throwUnlessLoaded(const IFieldDescriptorConstList& fields) const;
+
     IFieldDescriptorConstListConstPtrH mFields;
     IFieldDescriptorConstListConstPtrH mKeyFields;
+    IFieldDescriptorConstListConstPtrH mLoadedFields;
+    /** True if only some fields or rows were loaded */
+    bool mPartial;
+    /** True if only some rows were loaded */
+    bool mIsFiltered;
   };
 
   typedef PointerType<Database>::Shared DatabasePtrH;
@@ -52,16 +52,25 @@ ValuePtrH FloatFieldDescriptor::fromString(const char* str) const
 }
 
 IFieldDescriptorPtrH FieldDescriptorFactory::Create(FieldId id, TypeInfo type,
-  const char* name, const char* description, bool isKey, size_t size)
+  const char* name, const char* description, bool isKey, size_t size,
+  IndexType index, PartitionType partition, 
+  const std::vector<std::string>& aggregateBy)
 {
+  FieldDescriptorBase* field = NULL;
+
   if (type == TypeInfo_String)
-    return IFieldDescriptorPtrH(new TextFieldDescriptor(id, name, description, isKey, size));
+    field = new TextFieldDescriptor(id, name, description, isKey, size);
   else if (type == TypeInfo_Date)
-    return IFieldDescriptorPtrH(new DateFieldDescriptor(id, name, description, isKey));
+    field = new DateFieldDescriptor(id, name, description, isKey);
   else if (type == TypeInfo_Time)
-    return IFieldDescriptorPtrH(new TimeFieldDescriptor(id, name, description, isKey));
+    field = new TimeFieldDescriptor(id, name, description, isKey);
   else if (type == TypeInfo_Float)
-    return IFieldDescriptorPtrH(new FloatFieldDescriptor(id, name, description, isKey, size));
+    field = new FloatFieldDescriptor(id, name, description, isKey, size);
   else
     return NULL;
+
+  field->setIndexType(index);
+  field->setPartitionType(partition);
+  field->setAggregateBy(aggregateBy);
+  return IFieldDescriptorPtrH(field);
 }
\ No newline at end of file
@@ -12,6 +12,28 @@ namespace DataStore
 {
   typedef int FieldId;
 
+  /**
+    Kind of secondary index that a database maintains for a field.
+  */
+  typedef enum
+  {
+    eIndexType_None,
+    eIndexType_Hash,    // equality lookups
+    eIndexType_Ordered, // equality and range lookups
+    eIndexType_Bitmap   // a row bitmap per distinct value, for low-cardinality fields
+  } IndexType;
+
+  /**
+    How a storage that supports it splits rows into partitions, by the 
+    value of a date field.
+  */
+  typedef enum
+  {
+    ePartitionType_None,
+    ePartitionType_Day,  // a partition per day
+    ePartitionType_Month // a partition per month
+  } PartitionType;
+
   /**
     Provides information about a field, and a method
     for translating a string into a new instance of
@@ -25,6 +47,14 @@ namespace DataStore
     virtual size_t getSize() const = 0;
     virtual FieldId getId() const = 0;
     virtual bool isKey() const = 0;
+    virtual IndexType getIndexType() const = 0;
+    virtual PartitionType getPartitionType() const = 0;
+
+    /** 
+      Names of the fields that a database keeps the sum of this field by,
+      for each of their values (see Database::openAggregateCursor)
+    */
+    virtual const std::vector<std::string>& getAggregateBy() const = 0;
 
     virtual bool operator==(const IFieldDescriptor& other) const = 0;
 
@@ -59,7 +89,10 @@ namespace DataStore
   {
   public:
     static IFieldDescriptorPtrH Create(FieldId id, TypeInfo type,
-    const char* name, const char* description, bool isKey, size_t size);
+    const char* name, const char* description, bool isKey, size_t size,
+    IndexType index = eIndexType_None, 
+    PartitionType partition = ePartitionType_None,
+    const std::vector<std::string>& aggregateBy = std::vector<std::string>());
 
   private:
     FieldDescriptorFactory();
@@ -101,6 +134,36 @@ namespace DataStore
       return mId;
     }
 
+    virtual IndexType getIndexType() const
+    {
+      return mIndexType;
+    }
+
+    void setIndexType(IndexType index)
+    {
+      mIndexType = index;
+    }
+
+    virtual PartitionType getPartitionType() const
+    {
+      return mPartitionType;
+    }
+
+    void setPartitionType(PartitionType partition)
+    {
+      mPartitionType = partition;
+    }
+
+    virtual const std::vector<std::string>& getAggregateBy() const
+    {
+      return mAggregateBy;
+    }
+
+    void setAggregateBy(const std::vector<std::string>& aggregateBy)
+    {
+      mAggregateBy = aggregateBy;
+    }
+
     virtual bool operator==(const IFieldDescriptor& other) const
     {
       return mId == other.getId();
@@ -110,7 +173,8 @@ namespace DataStore
     FieldDescriptorBase(FieldId id, TypeInfo type, const char* name,
       const char* description, bool isKey, size_t size = 0) :
         mId(id), mType(type), mName(name), mDescrition(description),
-        mIsKey(isKey), mSize(size)
+        mIsKey(isKey), mSize(size), mIndexType(eIndexType_None),
+        mPartitionType(ePartitionType_None)
     {
     }
   
@@ -121,6 +185,9 @@ namespace DataStore
     size_t mSize;
     FieldId mId;
     bool mIsKey;
+    IndexType mIndexType;
+    PartitionType mPartitionType;
+    std::vector<std::string> mAggregateBy;
   };
 
   /**
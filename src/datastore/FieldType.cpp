@@ -1,5 +1,6 @@
 
 #include <datastore/FieldType.h>
+#include <algorithm>
 #include <string.h>
 #include <time.h>
 
@@ -32,6 +33,13 @@ bool Date::fromString(const char* str)
 }
 
 mStd::mString Date::toString() const
+{
+  char v[11 + 1];
+  format(v, sizeof(v));
+  return mStd::mString(v);
+}
+
+size_t Date::format(char* buffer, size_t size) const
 {
   struct tm timeDetails = { 0 };
 
@@ -41,18 +49,18 @@ mStd::mString Date::toString() const
   localtime_r(&mDate, &timeDetails);
 #endif
 
-  char v[11 + 1];
-
+  int written =
 #ifdef _MSC_VER
   sprintf_s(
 #else
   snprintf(
 #endif
-    v, sizeof(v), "%04d-%02d-%02d",
+    buffer, size, "%04d-%02d-%02d",
     timeDetails.tm_year + 1900,
     timeDetails.tm_mon + 1,
     timeDetails.tm_mday);
-  return mStd::mString(v);
+
+  return written < 0 ? 0 : std::min((size_t)written, size - 1);
 }
 
 /////////////////////////////////////////////////////////////////////
@@ -79,14 +87,22 @@ bool Time::fromString(const char* str)
 mStd::mString Time::toString() const
 {
   char v[11 + 1];
+  format(v, sizeof(v));
+  return mStd::mString(v);
+}
+
+size_t Time::format(char* buffer, size_t size) const
+{
+  int written =
 #ifdef _MSC_VER
   sprintf_s(
 #else
   snprintf(
 #endif
-    v, sizeof(v), "%02d:%04d",
+    buffer, size, "%02d:%04d",
     (mTime >> 12), (mTime & 0xFFF));
-  return mStd::mString(v);
+
+  return written < 0 ? 0 : std::min((size_t)written, size - 1);
 }
 
 /////////////////////////////////////////////////////////////////////
@@ -38,6 +38,12 @@ namespace DataStore
     bool fromString(const char* str);
     mStd::mString toString() const;
 
+    /** 
+      Format as YYYY-MM-DD into buffer without allocating.  Returns the 
+      number of characters written, excluding the terminator.
+    */
+    size_t format(char* buffer, size_t size) const;
+
     bool operator==(const Date& other) const
     {
       return other.mDate == mDate;
@@ -55,6 +61,24 @@ namespace DataStore
       return mDate > other.mDate;
     }
 
+    size_t hash() const
+    {
+      return (size_t)mDate;
+    }
+
+    /** The raw encoding, for binary storage formats */
+    int64_t getEncoded() const
+    {
+      return (int64_t)mDate;
+    }
+
+    static Date FromEncoded(int64_t encoded)
+    {
+      Date date;
+      date.mDate = (time_t)encoded;
+      return date;
+    }
+
   private:
     // Could use smaller type
     time_t mDate;
@@ -74,6 +98,12 @@ namespace DataStore
     bool fromString(const char* str);
     mStd::mString toString() const;
 
+    /** 
+      Format as HH:SSSS into buffer without allocating.  Returns the 
+      number of characters written, excluding the terminator.
+    */
+    size_t format(char* buffer, size_t size) const;
+
     bool operator==(const Time& other) const
     {
       return other.mTime == mTime;
@@ -91,6 +121,24 @@ namespace DataStore
       return mTime > other.mTime;
     }
 
+    size_t hash() const
+    {
+      return (size_t)mTime;
+    }
+
+    /** The raw encoding, for binary storage formats */
+    uint32_t getEncoded() const
+    {
+      return mTime;
+    }
+
+    static Time FromEncoded(uint32_t encoded)
+    {
+      Time time;
+      time.mTime = encoded;
+      return time;
+    }
+
   private:
     uint32_t mTime;
   };
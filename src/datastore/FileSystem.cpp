@@ -0,0 +1,95 @@
+
+#include <datastore/FileSystem.h>
+#include <stdexcept>
+#include <errno.h>
+#include <stdio.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#include <direct.h>
+#else
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <dirent.h>
+#endif
+
+using namespace DataStore;
+
+/////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////
+
+bool FileSystem::IsDirectory(const std::string& path)
+{
+#ifdef _WIN32
+  DWORD attributes = GetFileAttributesA(path.c_str());
+  return attributes != INVALID_FILE_ATTRIBUTES &&
+    (attributes & FILE_ATTRIBUTE_DIRECTORY) != 0;
+#else
+  struct stat status;
+  return stat(path.c_str(), &status) == 0 && S_ISDIR(status.st_mode);
+#endif
+}
+
+void FileSystem::MakeDirectory(const std::string& path)
+{
+#ifdef _WIN32
+  int result = _mkdir(path.c_str());
+#else
+  int result = mkdir(path.c_str(), 0777);
+#endif
+  if (result != 0 && !(errno == EEXIST && IsDirectory(path)))
+  {
+    std::string ex = "Unable to create database directory \"" + path + "\"";
+    throw std::runtime_error(ex);
+  }
+}
+
+void FileSystem::ListFiles(const std::string& path, std::vector<std::string>* outNames)
+{
+  std::string ex = "Unable to list database directory \"" + path + "\"";
+
+#ifdef _WIN32
+  WIN32_FIND_DATAA found;
+  HANDLE search = FindFirstFileA((path + "\\*").c_str(), &found);
+  if (search == INVALID_HANDLE_VALUE)
+  {
+    throw std::runtime_error(ex);
+  }
+
+  do
+  {
+    if ((found.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) == 0)
+    {
+      outNames->push_back(found.cFileName);
+    }
+  } while (FindNextFileA(search, &found));
+
+  FindClose(search);
+#else
+  DIR* directory = opendir(path.c_str());
+  if (!directory)
+  {
+    throw std::runtime_error(ex);
+  }
+
+  for (struct dirent* entry = readdir(directory); entry != NULL; entry = readdir(directory))
+  {
+    std::string name(entry->d_name);
+    if (name != "." && name != ".." && !IsDirectory(path + "/" + name))
+    {
+      outNames->push_back(name);
+    }
+  }
+
+  closedir(directory);
+#endif
+}
+
+bool FileSystem::ReplaceFile(const std::string& from, const std::string& to)
+{
+#ifdef _WIN32
+  return MoveFileExA(from.c_str(), to.c_str(), MOVEFILE_REPLACE_EXISTING) != 0;
+#else
+  return rename(from.c_str(), to.c_str()) == 0;
+#endif
+}
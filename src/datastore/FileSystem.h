@@ -0,0 +1,36 @@
+
+#ifndef __FILE_SYSTEM_H__
+#define __FILE_SYSTEM_H__
+
+#include <string>
+#include <vector>
+
+namespace DataStore
+{
+  /**
+    The file system operations needed by storages that keep a database in
+    a directory of files, on POSIX and Windows.
+  */
+  class FileSystem
+  {
+  public:
+    static bool IsDirectory(const std::string& path);
+
+    /** Create directory path, unless it already exists */
+    static void MakeDirectory(const std::string& path);
+
+    /** Names of the regular files in directory path */
+    static void ListFiles(const std::string& path, std::vector<std::string>* outNames);
+
+    /**
+      Rename from over to, replacing to if it exists.  Readers of to see
+      either the old or the new file, never a partial one.
+    */
+    static bool ReplaceFile(const std::string& from, const std::string& to);
+
+  private:
+    FileSystem();
+  };
+}
+
+#endif
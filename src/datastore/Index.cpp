@@ -0,0 +1,441 @@
+
+#include <datastore/Index.h>
+#include <algorithm>
+#include <utility>
+
+using namespace DataStore;
+
+namespace DataStore
+{
+  /**
+    Orders the entries of an index by value, and then by the number 
+    after it, a row or a chunk of rows
+  */
+  struct ValueEntryLess
+  {
+    bool operator() (const std::pair<ValueConstPtrH, size_t>& left,
+      const std::pair<ValueConstPtrH, size_t>& right) const
+    {
+      if (*left.first < *right.first)
+        return true;
+      if (*right.first < *left.first)
+        return false;
+
+      return left.second < right.second;
+    }
+  };
+
+  /** The value of the entries of an index that map nothing */
+  struct Unmapped
+  {
+  };
+
+  /**
+    Equality-only index, orders rows by the hash of their value
+  */
+  class HashIndex : public IIndex
+  {
+    /** The hash of a row's value, and the row */
+    typedef std::pair<size_t, size_t> Entry;
+    typedef VersionedMap<Entry, Unmapped> RowsByHash;
+
+  public:
+    HashIndex(IFieldDescriptorConstPtrH field) :
+      mField(field)
+    {
+    }
+
+    IFieldDescriptorConstPtrH getField() const
+    {
+      return mField;
+    }
+
+    void insert(ValueConstPtrH value, const RowIdentifier& id)
+    {
+      mRows.insert(Entry(value->hash(), id), Unmapped());
+    }
+
+    void remove(ValueConstPtrH value, const RowIdentifier& id)
+    {
+      mRows.erase(Entry(value->hash(), id));
+    }
+
+    bool lookup(const ValueRange& range, Bitmap* outRows) const
+    {
+      if (!range.isExact())
+      {
+        return false;
+      }
+
+      // Hash collisions are weeded out by the caller
+      Entry first(range.getLow()->hash(), 0);
+      mRows.visit(&first, [&](const Entry& entry, const Unmapped&) -> bool
+      {
+        if (entry.first != first.first)
+        {
+          return false;
+        }
+
+        outRows->add((Bitmap::Element)entry.second);
+        return true;
+      });
+
+      return true;
+    }
+
+    IIndexPtrH clone() const
+    {
+      return IIndexPtrH(new HashIndex(*this));
+    }
+
+  private:
+    IFieldDescriptorConstPtrH mField;
+    RowsByHash mRows;
+  };
+
+  /**
+    Sorted index, answers both exact and range lookups
+  */
+  class OrderedIndex : public IIndex
+  {
+    /** A row's value, and the row */
+    typedef std::pair<ValueConstPtrH, size_t> Entry;
+    typedef VersionedMap<Entry, Unmapped, ValueEntryLess> RowsByValue;
+
+  public:
+    OrderedIndex(IFieldDescriptorConstPtrH field) :
+      mField(field)
+    {
+    }
+
+    IFieldDescriptorConstPtrH getField() const
+    {
+      return mField;
+    }
+
+    void insert(ValueConstPtrH value, const RowIdentifier& id)
+    {
+      mRows.insert(Entry(value, id), Unmapped());
+    }
+
+    void remove(ValueConstPtrH value, const RowIdentifier& id)
+    {
+      mRows.erase(Entry(value, id));
+    }
+
+    bool lookup(const ValueRange& range, Bitmap* outRows) const
+    {
+      if (range.isEmpty())
+      {
+        return true;
+      }
+
+      Entry first(range.getLow(), 0);
+      mRows.visit(range.getLow() ? &first : NULL, [&](const Entry& entry, const Unmapped&) -> bool
+      {
+        if (range.getHigh() && *range.getHigh() < *entry.first)
+        {
+          return false;
+        }
+
+        outRows->add((Bitmap::Element)entry.second);
+        return true;
+      });
+
+      return true;
+    }
+
+    IIndexPtrH clone() const
+    {
+      return IIndexPtrH(new OrderedIndex(*this));
+    }
+
+  private:
+    IFieldDescriptorConstPtrH mField;
+    RowsByValue mRows;
+  };
+
+  /**
+    One bitmap of rows per distinct value.  Meant for low-cardinality
+    fields, where the bitmaps are dense and cheap to AND/OR together.
+    Each value's bitmap is kept in pieces of 2^kChunkBits rows, so that a
+    write to a copy of the index copies a single piece.
+  */
+  class BitmapIndex : public IIndex
+  {
+    enum { kChunkBits = 16 };
+
+    /** A value, and a chunk of the rows */
+    typedef std::pair<ValueConstPtrH, size_t> Entry;
+
+    /** The rows of an entry, and the stamp of the map that made them */
+    struct Rows
+    {
+      Rows() :
+        stamp(0)
+      {
+      }
+
+      uint64_t stamp;
+      BitmapPtrH bitmap;
+    };
+
+    typedef VersionedMap<Entry, Rows, ValueEntryLess> RowsByValue;
+
+  public:
+    BitmapIndex(IFieldDescriptorConstPtrH field) :
+      mField(field)
+    {
+    }
+
+    IFieldDescriptorConstPtrH getField() const
+    {
+      return mField;
+    }
+
+    void insert(ValueConstPtrH value, const RowIdentifier& id)
+    {
+      modifyRows(Entry(value, (size_t)id >> kChunkBits)).add((Bitmap::Element)id);
+    }
+
+    void remove(ValueConstPtrH value, const RowIdentifier& id)
+    {
+      Entry entry(value, (size_t)id >> kChunkBits);
+      if (mRows.find(entry))
+      {
+        Bitmap& rows = modifyRows(entry);
+        rows.remove((Bitmap::Element)id);
+        if (rows.empty())
+        {
+          mRows.erase(entry);
+        }
+      }
+    }
+
+    bool lookup(const ValueRange& range, Bitmap* outRows) const
+    {
+      if (range.isEmpty())
+      {
+        return true;
+      }
+
+      typedef std::pair<size_t, const Bitmap*> ChunkRows;
+      std::vector<ChunkRows> found;
+
+      Entry first(range.getLow(), 0);
+      mRows.visit(range.getLow() ? &first : NULL, [&](const Entry& entry, const Rows& rows) -> bool
+      {
+        if (range.getHigh() && *range.getHigh() < *entry.first)
+        {
+          return false;
+        }
+
+        found.push_back(ChunkRows(entry.second, rows.bitmap.get()));
+        return true;
+      });
+
+      // Merged a chunk at a time, each chunk is appended to the last
+      std::stable_sort(found.begin(), found.end(),
+        [](const ChunkRows& left, const ChunkRows& right) { return left.first < right.first; });
+
+      Bitmap rows;
+      for (std::vector<ChunkRows>::const_iterator chunk = found.cbegin(); chunk != found.cend();)
+      {
+        Bitmap chunkRows(*chunk->second);
+        size_t key = chunk->first;
+        for (++chunk; chunk != found.cend() && chunk->first == key; ++chunk)
+        {
+          chunkRows.merge(*chunk->second);
+        }
+
+        rows.merge(chunkRows);
+      }
+
+      outRows->merge(rows);
+      return true;
+    }
+
+    IIndexPtrH clone() const
+    {
+      return IIndexPtrH(new BitmapIndex(*this));
+    }
+
+  private:
+    /** The rows of entry to change, copied first unless this copy made them */
+    Bitmap& modifyRows(const Entry& entry)
+    {
+      Rows& rows = mRows.modify(entry);
+      if (rows.stamp != mRows.getStamp())
+      {
+        rows.bitmap = rows.bitmap ? BitmapPtrH(new Bitmap(*rows.bitmap)) : BitmapPtrH(new Bitmap());
+        rows.stamp = mRows.getStamp();
+      }
+
+      return *rows.bitmap;
+    }
+
+    IFieldDescriptorConstPtrH mField;
+    RowsByValue mRows;
+  };
+}
+
+/////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////
+
+IIndexPtrH IndexFactory::Create(IFieldDescriptorConstPtrH field)
+{
+  if (field->getIndexType() == eIndexType_Hash)
+    return IIndexPtrH(new HashIndex(field));
+  else if (field->getIndexType() == eIndexType_Ordered)
+    return IIndexPtrH(new OrderedIndex(field));
+  else if (field->getIndexType() == eIndexType_Bitmap)
+    return IIndexPtrH(new BitmapIndex(field));
+  else
+    return NULL;
+}
+
+/////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////
+
+KeyIndex::KeyIndex(const IFieldDescriptorConstList& keyFields) :
+  mKeyFields(keyFields),
+  mBits(0),
+  mCount(0)
+{
+}
+
+size_t KeyIndex::hash(const IRow& row) const
+{
+  size_t hash = 0;
+
+  for (IFieldDescriptorConstList::const_iterator field = mKeyFields.cbegin();
+    field != mKeyFields.cend(); ++field)
+  {
+    ValueConstPtrH value = row.getValue(**field);
+    size_t valueHash = value ? value->hash() : 0;
+
+    // boost::hash_combine
+    hash ^= valueHash + 0x9e3779b9 + (hash << 6) + (hash >> 2);
+  }
+
+  return hash;
+}
+
+bool KeyIndex::equal(const IRow& left, const IRow& right) const
+{
+  for (IFieldDescriptorConstList::const_iterator field = mKeyFields.cbegin();
+    field != mKeyFields.cend(); ++field)
+  {
+    ValueConstPtrH leftValue = left.getValue(**field);
+    ValueConstPtrH rightValue = right.getValue(**field);
+
+    if (!leftValue || !rightValue)
+    {
+      if (leftValue || rightValue)
+        return false;
+    }
+    else if (*leftValue != *rightValue)
+    {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+int KeyIndex::Compare(const IFieldDescriptorConstList& keyFields,
+  const IRow& left, const IRow& right)
+{
+  for (IFieldDescriptorConstList::const_iterator field = keyFields.cbegin();
+    field != keyFields.cend(); ++field)
+  {
+    ValueConstPtrH leftValue = left.getValue(**field);
+    ValueConstPtrH rightValue = right.getValue(**field);
+
+    if (!leftValue || !rightValue)
+    {
+      if (leftValue)
+        return 1;
+      if (rightValue)
+        return -1;
+    }
+    else if (*leftValue < *rightValue)
+    {
+      return -1;
+    }
+    else if (*leftValue != *rightValue)
+    {
+      return 1;
+    }
+  }
+
+  return 0;
+}
+
+RowIdentifier KeyIndex::find(const IRow& row, size_t hash,
+  const RowVector& rows) const
+{
+  if (mCount == 0)
+  {
+    return RowIdentifier::Empty();
+  }
+
+  size_t mask = mSlots.size() - 1;
+  for (size_t slot = homeOf(hash); !mSlots[slot].id.empty(); slot = (slot + 1) & mask)
+  {
+    const Slot& candidate = mSlots[slot];
+    if (candidate.hash == hash && equal(row, *rows[candidate.id]))
+    {
+      return candidate.id;
+    }
+  }
+
+  return RowIdentifier::Empty();
+}
+
+void KeyIndex::insert(size_t hash, const RowIdentifier& id)
+{
+  if ((mCount + 1) * 2 > mSlots.size())
+  {
+    SlotVector slots;
+    slots.swap(mSlots);
+    mBits = mBits > 0 ? mBits + 1 : 10;
+
+    for (size_t slot = 0; slot < ((size_t)1 << mBits); ++slot)
+    {
+      mSlots.push_back(Slot());
+    }
+
+    for (size_t slot = 0; slot < slots.size(); ++slot)
+    {
+      if (!slots[slot].id.empty())
+      {
+        place(slots[slot].hash, slots[slot].id);
+      }
+    }
+  }
+
+  place(hash, id);
+  ++mCount;
+}
+
+size_t KeyIndex::homeOf(size_t hash) const
+{
+  // Fibonacci hashing spreads hashes whose low bits are alike (e.g. of
+  // floats) over the table
+  return (size_t)(((uint64_t)hash * 0x9e3779b97f4a7c15ull) >> (64 - mBits));
+}
+
+void KeyIndex::place(size_t hash, const RowIdentifier& id)
+{
+  size_t mask = mSlots.size() - 1;
+  size_t slot = homeOf(hash);
+  while (!mSlots[slot].id.empty())
+  {
+    slot = (slot + 1) & mask;
+  }
+
+  Slot& free = mSlots.modify(slot);
+  free.hash = hash;
+  free.id = id;
+}
@@ -0,0 +1,119 @@
+
+#ifndef __INDEX_H__
+#define __INDEX_H__
+
+#include <datastore/FieldDescriptor.h>
+#include <datastore/RowIdentifier.h>
+#include <datastore/Logic.h>
+#include <datastore/Bitmap.h>
+#include <datastore/Row.h>
+#include <datastore/PointerType.h>
+#include <datastore/Versioned.h>
+
+namespace DataStore
+{
+  /**
+    A secondary index over the values of a single field.  Maps values to
+    the identifiers of the rows that hold them.
+  */
+  struct IIndex
+  {
+    virtual IFieldDescriptorConstPtrH getField() const = 0;
+
+    virtual void insert(ValueConstPtrH value, const RowIdentifier& id) = 0;
+    virtual void remove(ValueConstPtrH value, const RowIdentifier& id) = 0;
+
+    /**
+      Add the rows whose value may fall within range to outRows.  Returns 
+      false if the index is unable to answer for the range (e.g. a hash 
+      index asked for a non-exact range).  Results are candidates only, 
+      the caller is expected to re-check them.
+    */
+    virtual bool lookup(const ValueRange& range, Bitmap* outRows) const = 0;
+
+    /** 
+      A copy of the index, that is modified independently.  Both share
+      their entries until either modifies them.
+    */
+    virtual PointerType<IIndex>::Shared clone() const = 0;
+  };
+
+  typedef PointerType<IIndex>::Shared IIndexPtrH;
+  typedef std::vector<IIndexPtrH> IIndexList;
+
+  /** The rows of a database, by their identifiers */
+  typedef VersionedVector<IRowConstPtrH, 8> RowVector;
+
+  /**
+    The primary index, maps the composite key of each row to the row's 
+    identifier.  Keys are hashed by the key fields' values into an open
+    addressing table, and compared in full on a hash match.  The table is
+    a VersionedVector, so a copy of the index shares it, and an insert 
+    copies only the slots it writes.  It's rebuilt twice the size once 
+    half full.
+  */
+  class KeyIndex
+  {
+  public:
+    KeyIndex(const IFieldDescriptorConstList& keyFields);
+
+    /** Hash of row's key fields */
+    size_t hash(const IRow& row) const;
+
+    /** True if both rows hold the same key */
+    bool equal(const IRow& left, const IRow& right) const;
+
+    /** 
+      Order of two rows by their key fields, negative if left comes first.
+      Missing values come before any value.
+    */
+    static int Compare(const IFieldDescriptorConstList& keyFields,
+      const IRow& left, const IRow& right);
+
+    /** 
+      The row in rows holding the same key as row, whose key hashes to 
+      hash.  Empty if there is none.
+    */
+    RowIdentifier find(const IRow& row, size_t hash, 
+      const RowVector& rows) const;
+
+    void insert(size_t hash, const RowIdentifier& id);
+
+  private:
+    /** A slot of the table, free while id is empty */
+    struct Slot
+    {
+      size_t hash;
+      RowIdentifier id;
+    };
+
+    typedef VersionedVector<Slot, 8> SlotVector;
+
+    /** The slot at which looking for hash starts */
+    size_t homeOf(size_t hash) const;
+
+    /** Store id in the first free slot from the home of hash */
+    void place(size_t hash, const RowIdentifier& id);
+
+    IFieldDescriptorConstList mKeyFields;
+    SlotVector mSlots;
+    /** mSlots holds 2^mBits slots, none while mBits is 0 */
+    size_t mBits;
+    size_t mCount;
+  };
+
+  /**
+    Creates the type of index requested by a field's descriptor
+  */
+  class IndexFactory
+  {
+  public:
+    /** NULL if the field is not indexed */
+    static IIndexPtrH Create(IFieldDescriptorConstPtrH field);
+
+  private:
+    IndexFactory();
+  };
+}
+
+#endif
@@ -1,6 +1,7 @@
 
 #include <datastore/JsonStorage.h>
 #include <datastore/Database.h>
+#include <datastore/ZoneMap.h>
 #include <stdexcept>
 
 // Throw exceptions rather than assert on JSON parsing failures:
@@ -13,12 +14,19 @@ do {                                \
 #include <rapidjson/document.h>
 #include <rapidjson/filestream.h>
 #include <rapidjson/prettywriter.h>
+#include <rapidjson/stringbuffer.h>
+#include <rapidjson/writer.h>
+#include <algorithm>
 #include <fstream>
 #include <streambuf>
 #include <string>
+#include <memory>
 
 using namespace DataStore;
 
+// Rows read from the file are inserted this many at a time
+static const size_t kLoadBatchSize = 64 * 1024;
+
 /////////////////////////////////////////////////////////////////////
 /////////////////////////////////////////////////////////////////////
 
@@ -104,6 +112,10 @@ namespace DataStore
         // type
         // size
         // description
+        // key (optional)
+        // index (optional)
+        // partition (optional)
+        // aggregateBy (optional)
         //
 
         std::string name;
@@ -111,6 +123,9 @@ namespace DataStore
         TypeInfo type = DataStore::TypeInfo_Empty;
         bool isKey = false;
         size_t size = 0;
+        IndexType index = DataStore::eIndexType_None;
+        PartitionType partition = DataStore::ePartitionType_None;
+        std::vector<std::string> aggregateBy;
 
         for (rapidjson::Value::ConstMemberIterator member = field->MemberBegin();
           member != field->MemberEnd(); ++member)
@@ -137,6 +152,41 @@ namespace DataStore
           {
             isKey = member->value.GetBool();
           }
+          else if (memberName == "index")
+          {
+            if (!IndexFromString(member->value.GetString(), &index))
+            {
+              std::string ex("Invalid Scheme JSON: Unknown index type: ");
+              ex += member->value.GetString();
+              throw std::runtime_error(ex);
+            }
+          }
+          else if (memberName == "partition")
+          {
+            if (!PartitionFromString(member->value.GetString(), &partition))
+            {
+              std::string ex("Invalid Scheme JSON: Unknown partition type: ");
+              ex += member->value.GetString();
+              throw std::runtime_error(ex);
+            }
+          }
+          else if (memberName == "aggregateBy")
+          {
+            if (!member->value.IsArray())
+            {
+              throw std::runtime_error("Invalid Scheme JSON: 'aggregateBy' expects an array of field names");
+            }
+
+            for (rapidjson::Value::ConstValueIterator groupName = member->value.Begin();
+              groupName != member->value.End(); ++groupName)
+            {
+              if (!groupName->IsString())
+              {
+                throw std::runtime_error("Invalid Scheme JSON: 'aggregateBy' expects an array of field names");
+              }
+              aggregateBy.push_back(groupName->GetString());
+            }
+          }
           else
           {
             std::string ex("Invalid Scheme JSON: Unexpected member: ");
@@ -147,7 +197,7 @@ namespace DataStore
 
         IFieldDescriptorPtrH fieldDescriptor;
         fieldDescriptor = FieldDescriptorFactory::Create(fieldId, type, name.c_str(),
-          description.c_str(), isKey, size);
+          description.c_str(), isKey, size, index, partition, aggregateBy);
         if (!fieldDescriptor)
         {
           std::string ex("Internal error creating FieldDescriptor for ");
@@ -168,11 +218,18 @@ namespace DataStore
 
     template <class Allocator>
     void writeScheme(rapidjson::Value* root, Allocator& allocator) const
+    {
+      WriteScheme(*mFields, root, allocator);
+    }
+
+    template <class Allocator>
+    static void WriteScheme(const IFieldDescriptorConstList& fields,
+      rapidjson::Value* root, Allocator& allocator)
     {
       rapidjson::Value& fieldArray = root->SetArray();
 
-      for (IFieldDescriptorConstList::const_iterator field = mFields->begin();
-        field != mFields->end(); ++field)
+      for (IFieldDescriptorConstList::const_iterator field = fields.begin();
+        field != fields.end(); ++field)
       {
         // Wow...
 
@@ -181,12 +238,14 @@ namespace DataStore
         rapidjson::Value size;
         rapidjson::Value description;
         rapidjson::Value key;
+        rapidjson::Value index;
 
         name.SetString((*field)->getName());
         type.SetString(TypeToString((*field)->getType()));
         size.SetInt((*field)->getSize());
         description.SetString((*field)->getDescription());
         key.SetBool((*field)->isKey());
+        index.SetString(IndexToString((*field)->getIndexType()));
 
         rapidjson::Value newFieldObject(rapidjson::kObjectType);
         newFieldObject.AddMember("name", name, allocator);
@@ -194,6 +253,30 @@ namespace DataStore
         newFieldObject.AddMember("size", size, allocator);
         newFieldObject.AddMember("description", description, allocator);
         newFieldObject.AddMember("key", key, allocator);
+        newFieldObject.AddMember("index", index, allocator);
+
+        // Only written when set, so unpartitioned schemes are unchanged
+        if ((*field)->getPartitionType() != DataStore::ePartitionType_None)
+        {
+          rapidjson::Value partition;
+          partition.SetString(PartitionToString((*field)->getPartitionType()));
+          newFieldObject.AddMember("partition", partition, allocator);
+        }
+
+        // Likewise for aggregates
+        const std::vector<std::string>& aggregateBy = (*field)->getAggregateBy();
+        if (!aggregateBy.empty())
+        {
+          rapidjson::Value groupNames(rapidjson::kArrayType);
+          for (std::vector<std::string>::const_iterator groupName = aggregateBy.cbegin();
+            groupName != aggregateBy.cend(); ++groupName)
+          {
+            rapidjson::Value name;
+            name.SetString(groupName->c_str(), allocator);
+            groupNames.PushBack(name, allocator);
+          }
+          newFieldObject.AddMember("aggregateBy", groupNames, allocator);
+        }
 
         fieldArray.PushBack(newFieldObject, allocator);
       }
@@ -241,10 +324,69 @@ namespace DataStore
         return "null";
     }
 
+    /** Parse supported index types, false if unrecognized */
+    static bool IndexFromString(const char* index, IndexType* outIndex)
+    {
+      std::string indexName(index);
+      if (indexName == "none")
+        *outIndex = DataStore::eIndexType_None;
+      else if (indexName == "hash")
+        *outIndex = DataStore::eIndexType_Hash;
+      else if (indexName == "ordered")
+        *outIndex = DataStore::eIndexType_Ordered;
+      else if (indexName == "bitmap")
+        *outIndex = DataStore::eIndexType_Bitmap;
+      else
+        return false;
+
+      return true;
+    }
+
+    /** Return string representation of an IndexType */
+    static const char* IndexToString(IndexType index)
+    {
+      if (index == DataStore::eIndexType_Hash)
+        return "hash";
+      else if (index == DataStore::eIndexType_Ordered)
+        return "ordered";
+      else if (index == DataStore::eIndexType_Bitmap)
+        return "bitmap";
+      else
+        return "none";
+    }
+
+    /** Parse supported partition types, false if unrecognized */
+    static bool PartitionFromString(const char* partition, PartitionType* outPartition)
+    {
+      std::string partitionName(partition);
+      if (partitionName == "none")
+        *outPartition = DataStore::ePartitionType_None;
+      else if (partitionName == "day")
+        *outPartition = DataStore::ePartitionType_Day;
+      else if (partitionName == "month")
+        *outPartition = DataStore::ePartitionType_Month;
+      else
+        return false;
+
+      return true;
+    }
+
+    /** Return string representation of a PartitionType */
+    static const char* PartitionToString(PartitionType partition)
+    {
+      if (partition == DataStore::ePartitionType_Day)
+        return "day";
+      else if (partition == DataStore::ePartitionType_Month)
+        return "month";
+      else
+        return "none";
+    }
+
     /** Throw an exception if one of a few constrainst are not met */
     void throwOnInvalidConstraints() const
     {
       bool hasOneKey = false;
+      bool hasPartition = false;
 
       for (IFieldDescriptorConstList::const_iterator field = mFields->begin();
         field != mFields->end(); ++field)
@@ -263,6 +405,22 @@ namespace DataStore
         {
           hasOneKey = true;
         }
+        if ((*field)->getPartitionType() != DataStore::ePartitionType_None)
+        {
+          if ((*field)->getType() != DataStore::TypeInfo_Date)
+          {
+            std::string ex("Unmet Scheme Constraints: Only date fields can be partitioned, not ");
+            ex += (*field)->getName();
+            throw std::runtime_error(ex);
+          }
+          if (hasPartition)
+          {
+            throw std::runtime_error("Unmet Scheme Constraints: Only one field can be partitioned");
+          }
+          hasPartition = true;
+        }
+
+        throwOnInvalidAggregates(**field);
 
         // Field names should be unique too
       }
@@ -273,6 +431,42 @@ namespace DataStore
       }
     }
 
+    /** Only float fields can be summed, by other fields of the scheme */
+    void throwOnInvalidAggregates(const IFieldDescriptor& field) const
+    {
+      const std::vector<std::string>& aggregateBy = field.getAggregateBy();
+      if (aggregateBy.empty())
+      {
+        return;
+      }
+
+      if (field.getType() != DataStore::TypeInfo_Float)
+      {
+        std::string ex("Unmet Scheme Constraints: Only float fields can be aggregated, not ");
+        ex += field.getName();
+        throw std::runtime_error(ex);
+      }
+
+      for (std::vector<std::string>::const_iterator groupName = aggregateBy.cbegin();
+        groupName != aggregateBy.cend(); ++groupName)
+      {
+        bool isGroupField = false;
+        for (IFieldDescriptorConstList::const_iterator other = mFields->cbegin();
+          other != mFields->cend() && !isGroupField; ++other)
+        {
+          isGroupField = *groupName == (*other)->getName() && **other != field;
+        }
+
+        if (!isGroupField)
+        {
+          std::string ex("Unmet Scheme Constraints: ");
+          ex += field.getName();
+          ex += " is aggregated by \"" + *groupName + "\", which is not another field";
+          throw std::runtime_error(ex);
+        }
+      }
+    }
+
     IFieldDescriptorConstListPtrH mFields;
     IFieldDescriptorConstListPtrH mKeyFields;
   };
@@ -280,6 +474,44 @@ namespace DataStore
   /////////////////////////////////////////////////////////////////////
   /////////////////////////////////////////////////////////////////////
 
+  /**
+    Inserts the rows read from storage into a database, a batch at a time
+    so each key is looked up once per batch.
+  */
+  class BatchInserter : public IRowSink
+  {
+  public:
+    BatchInserter(Database* database) :
+      mDatabase(database)
+    {
+      mBatch.reserve(kLoadBatchSize);
+    }
+
+    void addRow(IRowConstPtrH row)
+    {
+      mBatch.push_back(row);
+
+      if (mBatch.size() == kLoadBatchSize)
+      {
+        flush();
+      }
+    }
+
+    void flush()
+    {
+      if (!mDatabase->loadBatch(mBatch))
+      {
+        throw std::runtime_error("Invalid Database JSON: corrupt row");
+      }
+
+      mBatch.clear();
+    }
+
+  private:
+    Database* mDatabase;
+    IRowConstList mBatch;
+  };
+
   /**
   */
   class DataStorageJsonImpl
@@ -288,7 +520,9 @@ namespace DataStore
     DataStorageJsonImpl(const char* dbFilename) :
       mDatabaseFilename(dbFilename),
       mDatabaseFileHandle(NULL),
-      mRowDataRoot(NULL)
+      mRowDataRoot(NULL),
+      mZoneDataRoot(NULL),
+      mPersistedRowCount(0)
     {
       // Load existing
       open(eExisting);
@@ -300,7 +534,9 @@ namespace DataStore
       mScheme(scheme),
       mDatabaseFilename(newDbFilename),
       mDatabaseFileHandle(NULL),
-      mRowDataRoot(NULL)
+      mRowDataRoot(NULL),
+      mZoneDataRoot(NULL),
+      mPersistedRowCount(0)
     {
       // This will be a new db
     }
@@ -319,44 +555,53 @@ namespace DataStore
 
     /**
     */
-    void load(Database* database)
+    void load(Database* database, IFieldDescriptorConstListConstPtrH fields,
+      const Predicate* filter)
     {
-      loadRows(database);
+      BatchInserter inserter(database);
+      loadRows(&inserter, fields, filter);
+      inserter.flush();
     }
 
     /**
+      Rows are written to the file as they are persisted, rather than 
+      collected into a document first, so persisting doesn't hold a second
+      copy of the database in memory.
     */
     void beginPersist()
     {
-      mRowDataRoot = NULL;
+      open(eOverwrite);
+
+      mFileStream = FileStreamPtr(new rapidjson::FileStream(mDatabaseFileHandle));
+      mWriter = WriterPtr(new Writer(*mFileStream));
 
-      rapidjson::Value& dbObject = mDatabase.SetObject();
+      mWriter->StartObject();
 
+      rapidjson::Document schemeDocument;
       rapidjson::Value schemeObject;
-      mScheme->getImpl()->writeScheme(&schemeObject, mDatabase.GetAllocator());
-      dbObject.AddMember("scheme", schemeObject, mDatabase.GetAllocator());
+      mScheme->getImpl()->writeScheme(&schemeObject, schemeDocument.GetAllocator());
+      mWriter->String("scheme");
+      schemeObject.Accept(*mWriter);
+
+      mWriter->String("rows");
+      mWriter->StartArray();
 
-      rapidjson::Value rowsObject(rapidjson::kArrayType);
-      dbObject.AddMember("rows", rowsObject, mDatabase.GetAllocator());
-      
-      mRowDataRoot = &dbObject["rows"];
+      mPersistedZones = ZoneMapPtrH(new ZoneMap(mScheme->getFieldDescriptors()->size()));
+      mPersistedRowCount = 0;
     }
 
     /**
     */
     void persistRow(const IRow* row)
     {
-      if (mRowDataRoot != NULL)
+      if (mWriter)
       {
-        rapidjson::Document::AllocatorType& allocator = mDatabase.GetAllocator();
-
-        rapidjson::Value jsonRow(rapidjson::kArrayType);
+        mWriter->StartArray();
 
         IFieldDescriptorConstListConstPtrH fields = mScheme->getFieldDescriptors();
         for (IFieldDescriptorConstList::const_iterator field = fields->cbegin();
           field != fields->cend(); ++field)
         {
-          rapidjson::Value jsonValue;
           mStd::mString strValue;
 
           ValueConstPtrH rowValue = row->getValue(*(field->get()));
@@ -368,18 +613,17 @@ namespace DataStore
 
           if (!strValue.empty())
           {
-            jsonValue.SetString(strValue.c_str(), allocator);
+            mWriter->String(strValue.c_str());
           }
           else
           {
-            jsonValue.SetString("");
+            mWriter->String("");
           }
-
-
-          jsonRow.PushBack(jsonValue,allocator);
         }
 
-        mRowDataRoot->PushBack(jsonRow, allocator);
+        mWriter->EndArray();
+
+        mPersistedZones->update(mPersistedRowCount++, *row, *fields);
       }
     }
 
@@ -390,15 +634,77 @@ namespace DataStore
       // This is a little silly.. You wouldn't want to overwrite
       // the entire datastore each time in a real-life scenario
 
-      open(eOverwrite);
+      if (mWriter)
+      {
+        mWriter->EndArray();
 
-      rapidjson::FileStream dbFile(mDatabaseFileHandle);
-      rapidjson::PrettyWriter<rapidjson::FileStream> writer(dbFile);
-      mDatabase.Accept(writer);
+        rapidjson::Document zonesDocument;
+        rapidjson::Value zonesObject;
+        writeZones(&zonesObject, zonesDocument.GetAllocator());
+        mWriter->String("zones");
+        zonesObject.Accept(*mWriter);
+
+        mWriter->EndObject();
+
+        mWriter.reset();
+        mFileStream.reset();
+        fflush(mDatabaseFileHandle);
+      }
+    }
+
+    /**
+      Pass the stored rows to sink, without a database
+    */
+    void scanRows(IRowSink* sink)
+    {
+      loadRows(sink, NULL, NULL);
     }
 
   private:
 
+    /**
+      Per-block min/max summaries of the persisted rows, written alongside
+      them so that readers can tell which blocks of "rows" are worth
+      reading.  One entry per ZoneMap::kRowsPerBlock rows, each holding
+      a [min, max] pair per field (null if the block has no values).
+    */
+    template <class Allocator>
+    void writeZones(rapidjson::Value* root, Allocator& allocator) const
+    {
+      rapidjson::Value& blockArray = root->SetArray();
+
+      for (size_t block = 0; block < mPersistedZones->getBlockCount(); ++block)
+      {
+        const ZoneList& zones = mPersistedZones->getZones(block);
+        rapidjson::Value zoneArray(rapidjson::kArrayType);
+
+        for (ZoneList::const_iterator zone = zones.begin(); zone != zones.end(); ++zone)
+        {
+          rapidjson::Value minMax;
+          if (zone->min)
+          {
+            mStd::mString minValue;
+            mStd::mString maxValue;
+            zone->min->getValue().convertTo(&minValue);
+            zone->max->getValue().convertTo(&maxValue);
+
+            rapidjson::Value jsonMin;
+            rapidjson::Value jsonMax;
+            jsonMin.SetString(minValue.c_str(), allocator);
+            jsonMax.SetString(maxValue.c_str(), allocator);
+
+            minMax.SetArray();
+            minMax.PushBack(jsonMin, allocator);
+            minMax.PushBack(jsonMax, allocator);
+          }
+
+          zoneArray.PushBack(minMax, allocator);
+        }
+
+        blockArray.PushBack(zoneArray, allocator);
+      }
+    }
+
     bool isOpen() const
     {
       return mDatabaseFileHandle != NULL;
@@ -482,6 +788,11 @@ namespace DataStore
             mRowDataRoot = &dbMember->value;
             foundRows = true;
           }
+          else if (strcmp(dbMember->name.GetString(), "zones") == 0)
+          {
+            // Optional, read when rows are filtered as they are loaded
+            mZoneDataRoot = &dbMember->value;
+          }
         }
 
         if (!foundScheme)
@@ -496,8 +807,72 @@ namespace DataStore
     }
 
     /**
+      Read the stored zones, one ZoneList per block of rows.  Returns false
+      if there are none, or they don't cover the rows, in which case they 
+      can't be used.
     */
-    void loadRows(Database* database)
+    bool readZones(std::vector<ZoneList>* outBlocks) const
+    {
+      if (mZoneDataRoot == NULL || !mZoneDataRoot->IsArray() ||
+        mRowDataRoot == NULL || !mRowDataRoot->IsArray())
+      {
+        return false;
+      }
+
+      size_t rowCount = mRowDataRoot->Size();
+      size_t blockCount = (rowCount + ZoneMap::kRowsPerBlock - 1) / ZoneMap::kRowsPerBlock;
+      if (mZoneDataRoot->Size() != blockCount)
+      {
+        return false;
+      }
+
+      IFieldDescriptorConstListConstPtrH fieldDescriptors = mScheme->getFieldDescriptors();
+
+      for (rapidjson::Value::ConstValueIterator block = mZoneDataRoot->Begin();
+        block != mZoneDataRoot->End(); ++block)
+      {
+        if (!block->IsArray() || block->Size() != fieldDescriptors->size())
+        {
+          return false;
+        }
+
+        ZoneList zones(fieldDescriptors->size());
+
+        for (rapidjson::SizeType fieldIdx = 0; fieldIdx < block->Size(); ++fieldIdx)
+        {
+          const rapidjson::Value& minMax = (*block)[fieldIdx];
+          if (minMax.IsNull())
+          {
+            continue;
+          }
+
+          if (!minMax.IsArray() || minMax.Size() != 2 ||
+            !minMax[0u].IsString() || !minMax[1u].IsString())
+          {
+            return false;
+          }
+
+          IFieldDescriptorConstPtrH field = (*fieldDescriptors)[fieldIdx];
+          zones[fieldIdx].min = field->fromString(minMax[0u].GetString());
+          zones[fieldIdx].max = field->fromString(minMax[1u].GetString());
+          if (!zones[fieldIdx].min || !zones[fieldIdx].max)
+          {
+            return false;
+          }
+        }
+
+        outBlocks->push_back(zones);
+      }
+
+      return true;
+    }
+
+    /**
+      Only the values of fields are converted, all of them if it's NULL.
+      Only rows that match filter are passed to sink, if it's not NULL.
+    */
+    void loadRows(IRowSink* sink, IFieldDescriptorConstListConstPtrH fields,
+      const Predicate* filter)
     {
       // Scheme must have already been parsed by this point
       mDebugAssert(mScheme);
@@ -515,13 +890,40 @@ namespace DataStore
           throw std::runtime_error(ex);
         }
 
+        //
+        // Skip the blocks of rows whose zones rule out a match
+        //
+
+        std::vector<ZoneList> blocks;
+        std::unique_ptr<ZoneFilter> zoneFilter;
+        if (filter != NULL)
+        {
+          zoneFilter.reset(new ZoneFilter(*filter));
+          if (zoneFilter->empty() || !readZones(&blocks))
+          {
+            blocks.clear();
+          }
+        }
+
         //
         // Rows layed out as an array of arrays, with the fields sorted
         // in order according to the scheme.
         //
-        for (rapidjson::Value::ConstValueIterator row = mRowDataRoot->Begin();
+
+        rapidjson::Value::ConstValueIterator rowsBegin = mRowDataRoot->Begin();
+        for (rapidjson::Value::ConstValueIterator row = rowsBegin;
           row != mRowDataRoot->End(); ++row)
         {
+          size_t rowIdx = row - rowsBegin;
+          if (!blocks.empty() && rowIdx % ZoneMap::kRowsPerBlock == 0 &&
+            !zoneFilter->mayMatch(blocks[rowIdx / ZoneMap::kRowsPerBlock]))
+          {
+            size_t blockRows = std::min((size_t)ZoneMap::kRowsPerBlock,
+              (size_t)(mRowDataRoot->End() - row));
+            row += blockRows - 1;
+            continue;
+          }
+
           if (!row->IsArray())
           {
             std::string ex = "Invalid Database JSON: expected array, found ";
@@ -529,22 +931,36 @@ namespace DataStore
             throw std::runtime_error(ex);
           }
 
-          IRowPtrH newRow = database->createRow();
+          IRowPtrH newRow(new Row(*fieldDescriptors));
 
-          size_t fieldIdx = 0;
-          for (rapidjson::Value::ConstValueIterator jsonValue = row->Begin();
-            jsonValue != row->End(); ++jsonValue, ++fieldIdx)
+          if (!fields)
           {
-            IFieldDescriptorConstPtrH field = (*fieldDescriptors)[fieldIdx];
-            ValuePtrH value = field->fromString(jsonValue->GetString());
-            newRow->setValue(*(field.get()), value);
+            size_t fieldIdx = 0;
+            for (rapidjson::Value::ConstValueIterator jsonValue = row->Begin();
+              jsonValue != row->End(); ++jsonValue, ++fieldIdx)
+            {
+              IFieldDescriptorConstPtrH field = (*fieldDescriptors)[fieldIdx];
+              ValuePtrH value = field->fromString(jsonValue->GetString());
+              newRow->setValue(*(field.get()), value);
+            }
+          }
+          else
+          {
+            for (IFieldDescriptorConstList::const_iterator field = fields->cbegin();
+              field != fields->cend(); ++field)
+            {
+              rapidjson::SizeType fieldIdx = (rapidjson::SizeType)(*field)->getId();
+              if (fieldIdx < row->Size())
+              {
+                ValuePtrH value = (*field)->fromString((*row)[fieldIdx].GetString());
+                newRow->setValue(**field, value);
+              }
+            }
           }
 
-          // Gets the job done, but could be more efficient
-          // this does an implicit search.
-          if (!database->insert(newRow))
+          if (filter == NULL || filter->matches(*newRow))
           {
-            throw std::runtime_error("Invalid Database JSON: corrupt row");
+            sink->addRow(newRow);
           }
         }
       }
@@ -555,7 +971,18 @@ namespace DataStore
     FILE* mDatabaseFileHandle;
 
     rapidjson::Value* mRowDataRoot;
+    rapidjson::Value* mZoneDataRoot;
     SchemeJsonConstPtrH mScheme;
+
+    typedef rapidjson::PrettyWriter<rapidjson::FileStream> Writer;
+    typedef std::unique_ptr<rapidjson::FileStream> FileStreamPtr;
+    typedef std::unique_ptr<Writer> WriterPtr;
+
+    FileStreamPtr mFileStream;
+    WriterPtr mWriter;
+
+    ZoneMapPtrH mPersistedZones;
+    size_t mPersistedRowCount;
   };
 }
 
@@ -577,6 +1004,54 @@ SchemeJson::SchemeJson()
 {
 }
 
+SchemeJsonPtrH SchemeJson::Load(const char* schemeFilename)
+{
+  FILE* schemeFile = fopen(schemeFilename, "r");
+  if (!schemeFile)
+  {
+    std::string ex = "Unable to open scheme file \"";
+    ex += schemeFilename;
+    ex += "\"";
+    throw std::runtime_error(ex);
+  }
+
+  SchemeJsonPtrH scheme;
+  try
+  {
+    scheme = SchemeJsonPtrH(new SchemeJson(schemeFile));
+  }
+  catch (...)
+  {
+    fclose(schemeFile);
+    throw;
+  }
+
+  fclose(schemeFile);
+  return scheme;
+}
+
+void SchemeJson::Save(const IScheme& scheme, const char* schemeFilename)
+{
+  std::string ex = "Unable to write scheme file \"";
+  ex += schemeFilename;
+  ex += "\"";
+
+  FILE* schemeFile = fopen(schemeFilename, "w");
+  if (!schemeFile)
+  {
+    throw std::runtime_error(ex);
+  }
+
+  std::string json = ToJson(scheme);
+  bool isWritten = fwrite(json.c_str(), 1, json.size(), schemeFile) == json.size();
+  isWritten = fclose(schemeFile) == 0 && isWritten;
+
+  if (!isWritten)
+  {
+    throw std::runtime_error(ex);
+  }
+}
+
 bool SchemeJson::allFieldsPresent(const std::vector<std::string>& headerFieldNames) const
 {
   IFieldDescriptorConstListConstPtrH fields = getFieldDescriptors();
@@ -625,6 +1100,20 @@ SchemeJsonImpl* SchemeJson::getImpl() const
   return mImpl.get();
 }
 
+std::string SchemeJson::ToJson(const IScheme& scheme)
+{
+  rapidjson::Document schemeDocument;
+  rapidjson::Value schemeObject;
+  SchemeJsonImpl::WriteScheme(*scheme.getFieldDescriptors(), &schemeObject,
+    schemeDocument.GetAllocator());
+
+  rapidjson::StringBuffer schemeText;
+  rapidjson::Writer<rapidjson::StringBuffer> writer(schemeText);
+  schemeObject.Accept(writer);
+
+  return schemeText.GetString();
+}
+
 /////////////////////////////////////////////////////////////////////
 /////////////////////////////////////////////////////////////////////
 
@@ -635,6 +1124,11 @@ DatabasePtrH DataStorageJson::Load(const char* dbFilename)
   return db;
 }
 
+DataStorageJsonPtrH DataStorageJson::Open(const char* dbFilename)
+{
+  return DataStorageJsonPtrH(new DataStorageJson(dbFilename));
+}
+
 DatabasePtrH DataStorageJson::Create(SchemeJsonConstPtrH scheme, const char* newDbFilename)
 {
   IDataStoragePtrH newStoragePtrH(new DataStorageJson(scheme, newDbFilename));
@@ -645,16 +1139,7 @@ DatabasePtrH DataStorageJson::Create(SchemeJsonConstPtrH scheme, const char* new
 
 DatabasePtrH DataStorageJson::Create(const char* schemeFilename, const char* newDbFilename)
 {
-  FILE* schemeFile = fopen(schemeFilename, "r");
-  if (!schemeFile)
-  {
-    std::string ex = "Unable to open scheme file \"";
-    ex += schemeFilename;
-    ex += +"\"";
-    throw std::runtime_error(ex);
-  }
-
-  SchemeJsonPtrH scheme(new SchemeJson(schemeFile));
+  SchemeJsonPtrH scheme = SchemeJson::Load(schemeFilename);
   IDataStoragePtrH newStoragePtrH(new DataStorageJson(scheme, newDbFilename));
   DatabasePtrH newDb(new Database(newStoragePtrH));
 
@@ -676,9 +1161,15 @@ ISchemeConstPtrH DataStorageJson::getScheme()
   return mImpl->getScheme();
 }
 
-void DataStorageJson::load(Database* database)
+void DataStorageJson::load(Database* database, IFieldDescriptorConstListConstPtrH fields,
+  const Predicate* filter)
+{
+  mImpl->load(database, fields, filter);
+}
+
+void DataStorageJson::scanRows(IRowSink* sink)
 {
-  mImpl->load(database);
+  mImpl->scanRows(sink);
 }
 
 void DataStorageJson::beginPersist()
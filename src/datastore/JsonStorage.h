@@ -6,6 +6,7 @@
 #include <datastore/DataStorage.h>
 #include <datastore/Database.h>
 #include <Resource/mString.h>
+#include <string>
 
 namespace DataStore
 {
@@ -16,8 +17,19 @@ namespace DataStore
   class SchemeJsonImpl;
   typedef PointerType<SchemeJsonImpl>::Shared SchemeJsonImplPtrH;
 
+  class SchemeJson;
+  typedef PointerType<SchemeJson>::Shared SchemeJsonPtrH;
+  typedef PointerType<SchemeJson>::SharedConst SchemeJsonConstPtrH;
+
   /**
-  IScheme implementation, reads from a JSON scheme encoding:
+  IScheme implementation, reads from a JSON scheme encoding.  The optional 
+  "index" member declares a secondary index on a field, one of "hash" 
+  (equality lookups), "ordered" (equality and range lookups) or "bitmap"
+  (a compressed row bitmap per distinct value, for low-cardinality fields
+  that are AND/OR'ed together in filters).  Indexes are rebuilt in memory 
+  when a database is loaded.  The optional "partition" member, "day" or
+  "month", may be set on one date field to store the database partitioned
+  by that field (see DataStoragePartitioned).
 
   Example:
   @vertabim
@@ -33,17 +45,20 @@ namespace DataStore
       "name": "TITLE",
       "type": "text",
       "size": 64,
+      "index": "hash",
       "description": "The title of the media asset"
     },
     {
       "name": "PROVIDER",
       "type": "text",
       "size": 64,
+      "index": "bitmap",
       "description": "The distributor of the media asset"
     },
     {
       "name": "DATE",
       "type": "date",
+      "index": "ordered",
       "description": "The local date on which the content was leased by through the STB"
     },
     {
@@ -76,6 +91,15 @@ namespace DataStore
     IFieldDescriptorConstListConstPtrH getFieldDescriptors() const;
     IFieldDescriptorConstListConstPtrH getKeyFieldDescriptors() const;
 
+    /** Encode the fields of any scheme as JSON scheme text */
+    static std::string ToJson(const IScheme& scheme);
+
+    /** Read a JSON scheme file */
+    static SchemeJsonPtrH Load(const char* schemeFilename);
+
+    /** Write the fields of any scheme to a JSON scheme file */
+    static void Save(const IScheme& scheme, const char* schemeFilename);
+
     /** @hidden - internal use only */
     SchemeJsonImpl* getImpl() const;
 
@@ -83,9 +107,6 @@ namespace DataStore
     SchemeJsonImplPtrH mImpl;
   };
 
-  typedef PointerType<SchemeJson>::Shared SchemeJsonPtrH;
-  typedef PointerType<SchemeJson>::SharedConst SchemeJsonConstPtrH;
-
   /**
     @hidden
     Hide json encoding/deconding details from client
@@ -93,6 +114,9 @@ namespace DataStore
   class DataStorageJsonImpl;
   typedef PointerType<DataStorageJsonImpl>::Shared DataStorageJsonImplPtrH;
   
+  class DataStorageJson;
+  typedef PointerType<DataStorageJson>::Shared DataStorageJsonPtrH;
+
   /**
   An IDataStorage implementation that stores a scheme and value-row information
   in a json encoded file.  It is expected that all rows will be loaded into
@@ -105,6 +129,11 @@ namespace DataStore
     "rows": [
       [value1, value2, value3, ...],
       ...
+    ],
+    "zones": [
+      // per block of rows, a [min, max] (or null) per field
+      [[min1, max1], [min2, max2], null, ...],
+      ...
     ]
   }
   @endverbatim
@@ -113,12 +142,27 @@ namespace DataStore
   {
   public:
     static DatabasePtrH Load(const char* existingDbFilename);
+
+    /** 
+      Open an existing datastorage without loading it into a database, to 
+      read its rows with scanRows() or rewrite them with the persist calls
+    */
+    static DataStorageJsonPtrH Open(const char* existingDbFilename);
+
     static DatabasePtrH Create(const char* schemeFilename, const char* newDbFilename);
     static DatabasePtrH Create(SchemeJsonConstPtrH scheme, const char* newDbFilename);
 
     ISchemeConstPtrH getScheme();
 
-    void load(Database* database);
+    /** 
+      Blocks of rows are skipped using the stored zones, and rows that 
+      don't match filter are dropped as they are read
+    */
+    void load(Database* database, IFieldDescriptorConstListConstPtrH fields,
+      const Predicate* filter);
+
+    /** Pass every stored row to sink, in stored order */
+    void scanRows(IRowSink* sink);
 
     void beginPersist();
     void persistRow(const IRow* row);
@@ -0,0 +1,312 @@
+
+#include <datastore/KeyTree.h>
+#include <datastore/FieldType.h>
+#include <algorithm>
+#include <stdexcept>
+#include <string.h>
+
+using namespace DataStore;
+
+// Level and entry count, followed by the entry offsets
+static const size_t kPageHeaderSize = 2 * sizeof(uint16_t);
+
+/////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////
+
+namespace DataStore
+{
+  template <typename T>
+  static void AppendBigEndian(std::string* bytes, T value)
+  {
+    for (size_t shift = sizeof(T) * 8; shift > 0; shift -= 8)
+    {
+      bytes->push_back((char)(uint8_t)(value >> (shift - 8)));
+    }
+  }
+
+  template <typename T>
+  static T Read(const char* data)
+  {
+    T value;
+    memcpy(&value, data, sizeof(value));
+    return value;
+  }
+
+  template <typename T>
+  static void Write(char* data, T value)
+  {
+    memcpy(data, &value, sizeof(value));
+  }
+
+  /** Bytes an entry takes on a page of level, its offset included */
+  static size_t EntrySize(const KeyTree::Entry& entry, uint16_t level)
+  {
+    return 2 * sizeof(uint16_t) + entry.first.size() +
+      (level == 0 ? sizeof(uint64_t) : sizeof(uint32_t));
+  }
+
+  /**
+    Append the pages of one level of the tree, filling each page with
+    entries in order.  outParents receives the first key and page of each
+    page, which are the entries of the level above.
+  */
+  static void WriteLevel(const KeyTree::EntryList& entries, uint16_t level,
+    std::vector<char>* pages, KeyTree::EntryList* outParents)
+  {
+    size_t first = 0;
+    while (first < entries.size())
+    {
+      size_t used = kPageHeaderSize;
+      size_t last = first;
+      while (last < entries.size() && used + EntrySize(entries[last], level) <= KeyTree::kPageSize)
+      {
+        used += EntrySize(entries[last], level);
+        ++last;
+      }
+
+      size_t page = pages->size() / KeyTree::kPageSize;
+      pages->resize(pages->size() + KeyTree::kPageSize, 0);
+      char* data = &(*pages)[page * KeyTree::kPageSize];
+
+      uint16_t count = (uint16_t)(last - first);
+      Write<uint16_t>(data, level);
+      Write<uint16_t>(data + sizeof(uint16_t), count);
+
+      size_t offset = kPageHeaderSize + count * sizeof(uint16_t);
+      for (size_t entry = first; entry < last; ++entry)
+      {
+        const std::string& key = entries[entry].first;
+
+        Write<uint16_t>(data + kPageHeaderSize + (entry - first) * sizeof(uint16_t), (uint16_t)offset);
+        Write<uint16_t>(data + offset, (uint16_t)key.size());
+        offset += sizeof(uint16_t);
+        memcpy(data + offset, key.data(), key.size());
+        offset += key.size();
+
+        if (level == 0)
+        {
+          Write<uint64_t>(data + offset, entries[entry].second);
+          offset += sizeof(uint64_t);
+        }
+        else
+        {
+          Write<uint32_t>(data + offset, (uint32_t)entries[entry].second);
+          offset += sizeof(uint32_t);
+        }
+      }
+
+      outParents->push_back(KeyTree::Entry(entries[first].first, page));
+      first = last;
+    }
+  }
+
+  static void ThrowInvalid()
+  {
+    throw std::runtime_error("Invalid key tree");
+  }
+}
+
+/////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////
+
+std::string KeyTree::EncodeKey(const IFieldDescriptorConstList& keyFields,
+  const IRow& row)
+{
+  std::string key;
+
+  for (IFieldDescriptorConstList::const_iterator field = keyFields.cbegin();
+    field != keyFields.cend(); ++field)
+  {
+    ValueConstPtrH value = row.getValue(**field);
+    if (!value)
+    {
+      key.push_back(0);
+      continue;
+    }
+    key.push_back(1);
+
+    TypeInfo type = (*field)->getType();
+    if (type == DataStore::TypeInfo_String)
+    {
+      mStd::mString text;
+      value->getValue().convertTo(&text);
+      key.append(text.c_str());
+      key.push_back(0);
+    }
+    else if (type == DataStore::TypeInfo_Date)
+    {
+      Date date;
+      value->getValue().convertTo(&date);
+      // Flip the sign so negative dates order first
+      AppendBigEndian(&key, (uint64_t)date.getEncoded() ^ 0x8000000000000000ULL);
+    }
+    else if (type == DataStore::TypeInfo_Time)
+    {
+      Time time;
+      value->getValue().convertTo(&time);
+      AppendBigEndian(&key, time.getEncoded());
+    }
+    else
+    {
+      float number = 0.0f;
+      value->getValue().convertTo(&number);
+      if (number == 0.0f)
+      {
+        // -0 and 0 are the same key
+        number = 0.0f;
+      }
+
+      // Negative floats order backwards, and before positive ones
+      uint32_t bits = Read<uint32_t>((const char*)&number);
+      bits = (bits & 0x80000000u) ? ~bits : (bits | 0x80000000u);
+      AppendBigEndian(&key, bits);
+    }
+  }
+
+  return key;
+}
+
+bool KeyTree::Build(EntryList* entries, std::vector<char>* outPages)
+{
+  outPages->clear();
+
+  if (entries->empty())
+  {
+    return false;
+  }
+
+  for (EntryList::const_iterator entry = entries->cbegin(); entry != entries->cend(); ++entry)
+  {
+    if (entry->first.size() > kMaxKeySize)
+    {
+      return false;
+    }
+  }
+
+  std::sort(entries->begin(), entries->end());
+
+  // Each level indexes the first keys of the pages below it, up to a
+  // level that fits a single page, the root
+  uint16_t level = 0;
+  EntryList parents;
+  WriteLevel(*entries, level, outPages, &parents);
+
+  while (parents.size() > 1)
+  {
+    EntryList children;
+    children.swap(parents);
+    WriteLevel(children, ++level, outPages, &parents);
+  }
+
+  return true;
+}
+
+KeyTree::KeyTree(const char* pages, uint64_t size) :
+  mPages(pages),
+  mOffset(0),
+  mPageCount(size / kPageSize)
+{
+  if (size == 0 || size % kPageSize != 0)
+  {
+    ThrowInvalid();
+  }
+}
+
+KeyTree::KeyTree(PagedFilePtrH file, uint64_t offset, uint64_t size) :
+  mPages(NULL),
+  mFile(file),
+  mOffset(offset),
+  mPageCount(size / kPageSize)
+{
+  if (size == 0 || size % kPageSize != 0 || offset % kPageSize != 0)
+  {
+    ThrowInvalid();
+  }
+}
+
+const char* KeyTree::getPage(uint64_t page, PageHandle* outHandle) const
+{
+  if (mFile)
+  {
+    return mFile->pin(mOffset + page * kPageSize, kPageSize, outHandle);
+  }
+
+  return mPages + page * kPageSize;
+}
+
+bool KeyTree::find(const std::string& key, uint64_t* outPosition) const
+{
+  uint64_t page = mPageCount - 1;
+  PageHandle handle;
+
+  for (;;)
+  {
+    const char* data = getPage(page, &handle);
+    uint16_t level = Read<uint16_t>(data);
+    uint16_t count = Read<uint16_t>(data + sizeof(uint16_t));
+    size_t payloadSize = level == 0 ? sizeof(uint64_t) : sizeof(uint32_t);
+
+    if (kPageHeaderSize + count * sizeof(uint16_t) > kPageSize)
+    {
+      ThrowInvalid();
+    }
+
+    // The last entry whose key is no greater than key
+    const char* found = NULL;
+    size_t foundSize = 0;
+    size_t low = 0;
+    size_t high = count;
+    while (low < high)
+    {
+      size_t middle = (low + high) / 2;
+
+      size_t offset = Read<uint16_t>(data + kPageHeaderSize + middle * sizeof(uint16_t));
+      if (offset + sizeof(uint16_t) > kPageSize)
+      {
+        ThrowInvalid();
+      }
+      size_t entrySize = Read<uint16_t>(data + offset);
+      if (offset + sizeof(uint16_t) + entrySize + payloadSize > kPageSize)
+      {
+        ThrowInvalid();
+      }
+
+      const char* entry = data + offset + sizeof(uint16_t);
+      int order = memcmp(entry, key.data(), std::min(entrySize, key.size()));
+      if (order < 0 || (order == 0 && entrySize <= key.size()))
+      {
+        found = entry;
+        foundSize = entrySize;
+        low = middle + 1;
+      }
+      else
+      {
+        high = middle;
+      }
+    }
+
+    if (found == NULL)
+    {
+      return false;
+    }
+
+    if (level == 0)
+    {
+      if (foundSize != key.size() || memcmp(found, key.data(), foundSize) != 0)
+      {
+        return false;
+      }
+
+      *outPosition = Read<uint64_t>(found + foundSize);
+      return true;
+    }
+
+    // Children are written before their parents, which also rules out cycles
+    uint64_t child = Read<uint32_t>(found + foundSize);
+    if (child >= page)
+    {
+      ThrowInvalid();
+    }
+    page = child;
+  }
+}
@@ -0,0 +1,87 @@
+
+#ifndef __KEY_TREE_H__
+#define __KEY_TREE_H__
+
+#include <datastore/FieldDescriptor.h>
+#include <datastore/Row.h>
+#include <datastore/BufferPool.h>
+#include <datastore/PointerType.h>
+#include <string>
+#include <utility>
+#include <vector>
+#include <stdint.h>
+
+namespace DataStore
+{
+  /**
+    A B+tree from the composite key of each row to its position, built
+    once for rows that don't change (e.g. those of a snapshot) and read in
+    place from its pages.  A lookup reads one page per level of the tree,
+    so only a few pages of a mapped file are touched to find a row.
+
+    Keys are compared byte by byte as encoded by EncodeKey(), under which
+    rows with equal keys have equal encoded keys.
+
+    @verbatim
+    page:   kPageSize bytes, the root is the last page
+              uint16 level, 0 for leaves
+              uint16 entry count
+              uint16 offset of each entry within the page, in key order
+    entry:  uint16 key size, key bytes, then
+              leaf:      64 bit row position
+              interior:  32 bit child page, whose first key is the key
+    @endverbatim
+  */
+  class KeyTree
+  {
+  public:
+    enum { kPageSize = 4096 };
+
+    /** Keys above this size aren't stored, see Build() */
+    enum { kMaxKeySize = 1024 };
+
+    typedef std::pair<std::string, uint64_t> Entry;
+    typedef std::vector<Entry> EntryList;
+
+    /**
+      The key of row, its key fields in order.  A field is encoded as a
+      byte that is 0 if row has no value for it, followed by the value:
+      text with a terminating nul, and dates, times and floats as big
+      endian integers.
+    */
+    static std::string EncodeKey(const IFieldDescriptorConstList& keyFields,
+      const IRow& row);
+
+    /**
+      Set outPages to the tree of entries (key, row position), which are
+      sorted.  Returns false, leaving outPages empty, if there are no
+      entries or a key is larger than kMaxKeySize.
+    */
+    static bool Build(EntryList* entries, std::vector<char>* outPages);
+
+    /** The tree in pages, which must outlive it */
+    KeyTree(const char* pages, uint64_t size);
+
+    /** The tree in size bytes of file at offset, which is page aligned */
+    KeyTree(PagedFilePtrH file, uint64_t offset, uint64_t size);
+
+    /**
+      Set outPosition to the row position stored for key, false if there
+      is none.  Throws if the pages are corrupt.
+    */
+    bool find(const std::string& key, uint64_t* outPosition) const;
+
+  private:
+    /** The address of page, pinned by outHandle if it's read from mFile */
+    const char* getPage(uint64_t page, PageHandle* outHandle) const;
+
+    const char* mPages;
+    PagedFilePtrH mFile;
+    uint64_t mOffset;
+    uint64_t mPageCount;
+  };
+
+  typedef PointerType<KeyTree>::Shared KeyTreePtrH;
+}
+
+#endif
@@ -1,8 +1,148 @@
 
 #include <datastore/Logic.h>
+#include <datastore/FieldType.h>
+#include <algorithm>
+#include <stdio.h>
 
 using namespace DataStore;
 
+namespace DataStore
+{
+  /** 
+    Append value of field in quotes, or * if there is none.  Floats keep 
+    every digit, so no two values read the same.
+  */
+  static void DescribeValue(const IFieldDescriptor& field, const ValueConstPtrH& value,
+    std::string* outText)
+  {
+    if (!value)
+    {
+      outText->push_back('*');
+      return;
+    }
+
+    const mStd::Variant& v = value->getValue();
+    std::string text;
+    char buffer[64];
+    Date date;
+    Time time;
+    float f = 0.0f;
+
+    if (field.getType() == TypeInfo_Date && v.convertTo(&date))
+    {
+      text.assign(buffer, date.format(buffer, sizeof(buffer)));
+    }
+    else if (field.getType() == TypeInfo_Time && v.convertTo(&time))
+    {
+      text.assign(buffer, time.format(buffer, sizeof(buffer)));
+    }
+    else if (field.getType() == TypeInfo_Float && v.convertTo(&f))
+    {
+      sprintf(buffer, "%.9g", f);
+      text = buffer;
+    }
+    else
+    {
+      mStd::mString str;
+      v.convertTo(&str);
+      text = str.c_str();
+    }
+
+    outText->push_back('"');
+    for (std::string::const_iterator c = text.cbegin(); c != text.cend(); ++c)
+    {
+      if (*c == '"' || *c == '\\')
+      {
+        outText->push_back('\\');
+      }
+      outText->push_back(*c);
+    }
+    outText->push_back('"');
+  }
+
+  /** Append the distinct terms of qualifiers in sorted order, joined by op */
+  static void DescribeJoined(const IQualifierList& qualifiers, const char* op,
+    std::string* outText)
+  {
+    std::vector<std::string> terms;
+    for (IQualifierList::const_iterator qual = qualifiers.cbegin();
+      qual != qualifiers.cend(); ++qual)
+    {
+      std::string term;
+      (*qual)->describe(&term);
+      terms.push_back(term);
+    }
+
+    std::sort(terms.begin(), terms.end());
+    terms.erase(std::unique(terms.begin(), terms.end()), terms.end());
+
+    if (terms.size() == 1)
+    {
+      *outText += terms[0];
+      return;
+    }
+
+    outText->push_back('(');
+    for (std::vector<std::string>::const_iterator term = terms.cbegin();
+      term != terms.cend(); ++term)
+    {
+      if (term != terms.cbegin())
+      {
+        *outText += op;
+      }
+      *outText += *term;
+    }
+    outText->push_back(')');
+  }
+}
+
+/////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////
+
+bool ValueRange::isExact() const
+{
+  return mLow && mHigh && *mLow == *mHigh;
+}
+
+bool ValueRange::isEmpty() const
+{
+  return mLow && mHigh && *mHigh < *mLow;
+}
+
+bool ValueRange::contains(const Value& value) const
+{
+  if (mLow && value < *mLow)
+    return false;
+  if (mHigh && *mHigh < value)
+    return false;
+  return true;
+}
+
+bool ValueRange::overlaps(const Value& low, const Value& high) const
+{
+  if (mLow && high < *mLow)
+    return false;
+  if (mHigh && *mHigh < low)
+    return false;
+  return true;
+}
+
+void ValueRange::intersect(const ValueRange& other)
+{
+  if (other.mLow && (!mLow || *mLow < *other.mLow))
+    mLow = other.mLow;
+  if (other.mHigh && (!mHigh || *other.mHigh < *mHigh))
+    mHigh = other.mHigh;
+}
+
+void ValueRange::merge(const ValueRange& other)
+{
+  if (!other.mLow || (mLow && *other.mLow < *mLow))
+    mLow = other.mLow;
+  if (!other.mHigh || (mHigh && *mHigh < *other.mHigh))
+    mHigh = other.mHigh;
+}
+
 /////////////////////////////////////////////////////////////////////
 /////////////////////////////////////////////////////////////////////
 
@@ -19,6 +159,34 @@ bool Predicate::matches(const IRow& row) const
     return true;
 }
 
+void Predicate::getFieldDescriptors(IFieldDescriptorConstList* outFieldDescriptors) const
+{
+  if (mRoot)
+    mRoot->getFieldDescriptors(outFieldDescriptors);
+}
+
+bool Predicate::getRange(const IFieldDescriptor& field, ValueRange* outRange) const
+{
+  if (mRoot)
+    return mRoot->getRange(field, outRange);
+  else
+    return false;
+}
+
+bool Predicate::select(const IRowSelector& selector, Bitmap* outRows) const
+{
+  if (mRoot)
+    return mRoot->select(selector, outRows);
+  else
+    return false;
+}
+
+void Predicate::describe(std::string* outText) const
+{
+  if (mRoot)
+    mRoot->describe(outText);
+}
+
 const Predicate& Predicate::AlwaysTrue()
 {
   static Predicate always(NULL);
@@ -54,6 +222,134 @@ void Logic::And::getFieldDescriptors(IFieldDescriptorConstList* outFieldDescript
   }
 }
 
+bool Logic::And::getRange(const IFieldDescriptor& field, ValueRange* outRange) const
+{
+  bool constrained = false;
+
+  // Every sub-qualifier must hold, so each one can only narrow the range
+  for (IQualifierList::const_iterator qual = mQualifiers.cbegin();
+    qual != mQualifiers.cend(); ++qual)
+  {
+    if ((*qual)->getRange(field, outRange))
+      constrained = true;
+  }
+
+  return constrained;
+}
+
+bool Logic::And::select(const IRowSelector& selector, Bitmap* outRows) const
+{
+  bool selected = false;
+
+  // Qualifiers that can't be answered from an index are left to matches()
+  for (IQualifierList::const_iterator qual = mQualifiers.cbegin();
+    qual != mQualifiers.cend(); ++qual)
+  {
+    Bitmap rows;
+    if ((*qual)->select(selector, &rows))
+    {
+      if (selected)
+      {
+        outRows->intersect(rows);
+      }
+      else
+      {
+        outRows->swap(rows);
+        selected = true;
+      }
+
+      if (outRows->empty())
+        break;
+    }
+  }
+
+  return selected;
+}
+
+void Logic::And::describe(std::string* outText) const
+{
+  DescribeJoined(mQualifiers, " AND ", outText);
+}
+
+/////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////
+
+void Logic::Or::with(IQualifierPtrH qualifier)
+{
+  mQualifiers.push_back(qualifier);
+}
+
+bool Logic::Or::matches(const IRow& row) const
+{
+  for (IQualifierList::const_iterator qual = mQualifiers.cbegin();
+    qual != mQualifiers.cend(); ++qual)
+  {
+    if ((*qual)->matches(row))
+      return true;
+  }
+
+  return false;
+}
+
+void Logic::Or::getFieldDescriptors(IFieldDescriptorConstList* outFieldDescriptors) const
+{
+  for (IQualifierList::const_iterator qual = mQualifiers.cbegin();
+    qual != mQualifiers.cend(); ++qual)
+  {
+    (*qual)->getFieldDescriptors(outFieldDescriptors);
+  }
+}
+
+bool Logic::Or::getRange(const IFieldDescriptor& field, ValueRange* outRange) const
+{
+  if (mQualifiers.empty())
+    return false;
+
+  // Only bounded if every alternative bounds the field
+  ValueRange any;
+  for (IQualifierList::const_iterator qual = mQualifiers.cbegin();
+    qual != mQualifiers.cend(); ++qual)
+  {
+    ValueRange alternative;
+    if (!(*qual)->getRange(field, &alternative))
+      return false;
+
+    if (qual == mQualifiers.cbegin())
+      any = alternative;
+    else
+      any.merge(alternative);
+  }
+
+  outRange->intersect(any);
+  return true;
+}
+
+bool Logic::Or::select(const IRowSelector& selector, Bitmap* outRows) const
+{
+  if (mQualifiers.empty())
+    return false;
+
+  // Every alternative must be answerable, or any row could match
+  Bitmap anyRows;
+  for (IQualifierList::const_iterator qual = mQualifiers.cbegin();
+    qual != mQualifiers.cend(); ++qual)
+  {
+    Bitmap rows;
+    if (!(*qual)->select(selector, &rows))
+      return false;
+
+    anyRows.merge(rows);
+  }
+
+  outRows->swap(anyRows);
+  return true;
+}
+
+void Logic::Or::describe(std::string* outText) const
+{
+  DescribeJoined(mQualifiers, " OR ", outText);
+}
+
 /////////////////////////////////////////////////////////////////////
 /////////////////////////////////////////////////////////////////////
 
@@ -73,4 +369,70 @@ bool Logic::Exact::matches(const IRow& row) const
 void Logic::Exact::getFieldDescriptors(IFieldDescriptorConstList* outFieldDescriptors) const
 {
   outFieldDescriptors->push_back(mExpectedField);
-}
\ No newline at end of file
+}
+
+bool Logic::Exact::getRange(const IFieldDescriptor& field, ValueRange* outRange) const
+{
+  if (field != *mExpectedField)
+    return false;
+
+  outRange->intersect(ValueRange::Exactly(mExpectedValue));
+  return true;
+}
+
+bool Logic::Exact::select(const IRowSelector& selector, Bitmap* outRows) const
+{
+  return selector.select(*mExpectedField, ValueRange::Exactly(mExpectedValue), outRows);
+}
+
+void Logic::Exact::describe(std::string* outText) const
+{
+  *outText += mExpectedField->getName();
+  *outText += "=";
+  DescribeValue(*mExpectedField, mExpectedValue, outText);
+}
+
+/////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////
+
+bool Logic::Range::matches(const IRow& row) const
+{
+  ValueConstPtrH value = row.getValue(*mField);
+  if (value)
+  {
+    return mRange.contains(*value);
+  }
+  else
+  {
+    return false;
+  }
+}
+
+void Logic::Range::getFieldDescriptors(IFieldDescriptorConstList* outFieldDescriptors) const
+{
+  outFieldDescriptors->push_back(mField);
+}
+
+bool Logic::Range::getRange(const IFieldDescriptor& field, ValueRange* outRange) const
+{
+  if (field != *mField)
+    return false;
+
+  outRange->intersect(mRange);
+  return true;
+}
+
+bool Logic::Range::select(const IRowSelector& selector, Bitmap* outRows) const
+{
+  return selector.select(*mField, mRange, outRows);
+}
+
+void Logic::Range::describe(std::string* outText) const
+{
+  *outText += mField->getName();
+  *outText += " in [";
+  DescribeValue(*mField, mRange.getLow(), outText);
+  *outText += ",";
+  DescribeValue(*mField, mRange.getHigh(), outText);
+  *outText += "]";
+}
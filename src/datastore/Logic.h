@@ -3,11 +3,70 @@
 #define __LOGIC_H__
 
 #include <datastore/Row.h>
+#include <datastore/Bitmap.h>
 #include <datastore/PointerType.h>
+#include <string>
 #include <vector>
 
 namespace DataStore
 {
+  /**
+    An inclusive range of values [low, high].  A NULL bound is unbounded
+    on that side, so a default constructed range contains every value.
+  */
+  class ValueRange
+  {
+  public:
+    ValueRange() {}
+    ValueRange(ValueConstPtrH low, ValueConstPtrH high) :
+      mLow(low), mHigh(high)
+    {
+    }
+
+    static ValueRange Exactly(ValueConstPtrH value)
+    {
+      return ValueRange(value, value);
+    }
+
+    const ValueConstPtrH& getLow() const { return mLow; }
+    const ValueConstPtrH& getHigh() const { return mHigh; }
+
+    /** True if the range holds a single value */
+    bool isExact() const;
+
+    /** True if no value can fall within the range */
+    bool isEmpty() const;
+
+    bool contains(const Value& value) const;
+
+    /** True if any value in [low, high] could also be within this range */
+    bool overlaps(const Value& low, const Value& high) const;
+
+    /** Narrow this range to the values that are also in other */
+    void intersect(const ValueRange& other);
+
+    /** Widen this range to cover other as well */
+    void merge(const ValueRange& other);
+
+  private:
+    ValueConstPtrH mLow;
+    ValueConstPtrH mHigh;
+  };
+
+  /**
+    Answers for the rows whose field value falls within a range using 
+    indexes only, without touching the rows themselves.
+  */
+  struct IRowSelector
+  {
+    /**
+      Set outRows to (a superset of) the rows whose field value is within 
+      range.  Returns false if there is no index that can answer.
+    */
+    virtual bool select(const IFieldDescriptor& field, const ValueRange& range,
+      Bitmap* outRows) const = 0;
+  };
+
   /**
    A logical qualifier, used to constrain portions of a query
   */
@@ -15,6 +74,28 @@ namespace DataStore
   {
     virtual bool matches(const IRow& row) const = 0;
     virtual void getFieldDescriptors(IFieldDescriptorConstList* outFieldDescriptors) const = 0;
+
+    /** 
+      Narrow outRange to the values of field that a matching row can hold. 
+      Returns false (and leaves outRange alone) if this qualifier places no 
+      bound on field.
+    */
+    virtual bool getRange(const IFieldDescriptor& field, ValueRange* outRange) const = 0;
+
+    /**
+      Set outRows to a superset of the rows that match, computed from the 
+      indexes available to selector.  Returns false if the rows can not
+      be narrowed down this way.  The result still has to be checked 
+      with matches().
+    */
+    virtual bool select(const IRowSelector& selector, Bitmap* outRows) const = 0;
+
+    /**
+      Append the canonical text of the qualifier to outText.  Qualifiers
+      that match the same rows for the same reason, e.g. the terms of an 
+      And given in another order, read the same, and different ones don't.
+    */
+    virtual void describe(std::string* outText) const = 0;
   };
 
   typedef PointerType<IQualifier>::Shared IQualifierPtrH;
@@ -39,6 +120,29 @@ namespace DataStore
       void with(IQualifierPtrH qualifier);
       bool matches(const IRow& row) const;
       void getFieldDescriptors(IFieldDescriptorConstList* outFieldDescriptors) const;
+      bool getRange(const IFieldDescriptor& field, ValueRange* outRange) const;
+      bool select(const IRowSelector& selector, Bitmap* outRows) const;
+      void describe(std::string* outText) const;
+
+    private:
+      IQualifierList mQualifiers;
+    };
+
+    /**
+    */
+    class Or : public IQualifier
+    {
+    public:
+      Or()
+      {
+      }
+
+      void with(IQualifierPtrH qualifier);
+      bool matches(const IRow& row) const;
+      void getFieldDescriptors(IFieldDescriptorConstList* outFieldDescriptors) const;
+      bool getRange(const IFieldDescriptor& field, ValueRange* outRange) const;
+      bool select(const IRowSelector& selector, Bitmap* outRows) const;
+      void describe(std::string* outText) const;
 
     private:
       IQualifierList mQualifiers;
@@ -56,11 +160,36 @@ namespace DataStore
 
       bool matches(const IRow& row) const;
       void getFieldDescriptors(IFieldDescriptorConstList* outFieldDescriptors) const;
+      bool getRange(const IFieldDescriptor& field, ValueRange* outRange) const;
+      bool select(const IRowSelector& selector, Bitmap* outRows) const;
+      void describe(std::string* outText) const;
 
     private:
       IFieldDescriptorConstPtrH mExpectedField;
       ValueConstPtrH mExpectedValue;
     };
+
+    /**
+      Matches values within an inclusive range, either bound may be NULL
+    */
+    class Range : public IQualifier
+    {
+    public:
+      Range(IFieldDescriptorConstPtrH field, ValueConstPtrH low, ValueConstPtrH high) :
+        mField(field), mRange(low, high)
+      {
+      }
+
+      bool matches(const IRow& row) const;
+      void getFieldDescriptors(IFieldDescriptorConstList* outFieldDescriptors) const;
+      bool getRange(const IFieldDescriptor& field, ValueRange* outRange) const;
+      bool select(const IRowSelector& selector, Bitmap* outRows) const;
+      void describe(std::string* outText) const;
+
+    private:
+      IFieldDescriptorConstPtrH mField;
+      ValueRange mRange;
+    };
   }
 
   /**
@@ -82,6 +211,19 @@ namespace DataStore
     /* default dtor okay */
    
     virtual bool matches(const IRow& row) const;
+
+    /** Fields that the expression refers to, may contain duplicates */
+    void getFieldDescriptors(IFieldDescriptorConstList* outFieldDescriptors) const;
+
+    /** @see IQualifier::getRange */
+    bool getRange(const IFieldDescriptor& field, ValueRange* outRange) const;
+
+    /** @see IQualifier::select */
+    bool select(const IRowSelector& selector, Bitmap* outRows) const;
+
+    /** @see IQualifier::describe, empty for a predicate that matches all */
+    void describe(std::string* outText) const;
+
   private:
     IQualifierPtrH mRoot;
   };
@@ -0,0 +1,871 @@
+
+#include <datastore/LsmStorage.h>
+#include <datastore/SnapshotStorage.h>
+#include <datastore/JsonStorage.h>
+#include <datastore/FileSystem.h>
+#include <datastore/Index.h>
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+#include <queue>
+#include <set>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+#include <stdio.h>
+
+using namespace DataStore;
+
+static const char* kSchemeFilename = "scheme.json";
+static const char* kManifestFilename = "manifest";
+
+// Rows held by the memtable before it's flushed, unless set otherwise
+static const size_t kDefaultMemtableLimit = 1000000;
+
+// The newest runs are merged while an older run holds no more than this
+// many times their rows
+static const size_t kRunSizeRatio = 2;
+
+// The merged position of a row that a newer run replaced
+static const size_t kHiddenRow = (size_t)-1;
+
+/////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////
+
+namespace DataStore
+{
+  /** Orders rows by key, rows of the same key are equivalent */
+  class RowKeyLess
+  {
+  public:
+    RowKeyLess(IFieldDescriptorConstListConstPtrH keyFields) :
+      mKeyFields(keyFields)
+    {
+    }
+
+    bool operator()(const IRowConstPtrH& left, const IRowConstPtrH& right) const
+    {
+      return KeyIndex::Compare(*mKeyFields, *left, *right) < 0;
+    }
+
+  private:
+    IFieldDescriptorConstListConstPtrH mKeyFields;
+  };
+
+  typedef std::set<IRowConstPtrH, RowKeyLess> SortedRows;
+
+  /** Add row to rows, true if it replaced the row with the same key */
+  static bool Replace(SortedRows* rows, IRowConstPtrH row)
+  {
+    std::pair<SortedRows::iterator, bool> inserted = rows->insert(row);
+    if (!inserted.second)
+    {
+      rows->insert(rows->erase(inserted.first), row);
+    }
+    return !inserted.second;
+  }
+
+  /////////////////////////////////////////////////////////////////////
+
+  /**
+    Merges runs sorted by key into a single sequence sorted by key.  Where
+    runs hold the same key only the row of the newest (last) run is kept.
+  */
+  class RunMerger
+  {
+  public:
+    RunMerger(IFieldDescriptorConstListConstPtrH keyFields,
+      const std::vector<IRowSourcePtrH>& runs) :
+      mRuns(runs),
+      mKeyFields(keyFields),
+      mHeads(HeadAfter(keyFields))
+    {
+      for (size_t run = 0; run < mRuns.size(); ++run)
+      {
+        advance(run, 0);
+      }
+    }
+
+    /** The next row, and where it's held, false once all are merged */
+    bool next(size_t* outRun, size_t* outPosition, IRowConstPtrH* outRow)
+    {
+      if (mHeads.empty())
+      {
+        return false;
+      }
+
+      Head head = mHeads.top();
+      mHeads.pop();
+      advance(head.run, head.position + 1);
+
+      // Older rows of the same key are hidden
+      while (!mHeads.empty() &&
+        KeyIndex::Compare(*mKeyFields, *mHeads.top().row, *head.row) == 0)
+      {
+        Head hidden = mHeads.top();
+        mHeads.pop();
+        advance(hidden.run, hidden.position + 1);
+      }
+
+      *outRun = head.run;
+      *outPosition = head.position;
+      *outRow = head.row;
+      return true;
+    }
+
+  private:
+    struct Head
+    {
+      size_t run;
+      size_t position;
+      IRowConstPtrH row;
+    };
+
+    /** Heap order, the smallest key first, and the newest run first within a key */
+    class HeadAfter
+    {
+    public:
+      HeadAfter(IFieldDescriptorConstListConstPtrH keyFields) :
+        mKeyFields(keyFields)
+      {
+      }
+
+      bool operator()(const Head& left, const Head& right) const
+      {
+        int order = KeyIndex::Compare(*mKeyFields, *left.row, *right.row);
+        if (order != 0)
+          return order > 0;
+        return left.run < right.run;
+      }
+
+    private:
+      IFieldDescriptorConstListConstPtrH mKeyFields;
+    };
+
+    void advance(size_t run, size_t position)
+    {
+      if (position < mRuns[run]->getRowCount())
+      {
+        Head head = { run, position, mRuns[run]->getRow(position) };
+        mHeads.push(head);
+      }
+    }
+
+    std::vector<IRowSourcePtrH> mRuns;
+    IFieldDescriptorConstListConstPtrH mKeyFields;
+    std::priority_queue<Head, std::vector<Head>, HeadAfter> mHeads;
+  };
+
+  /////////////////////////////////////////////////////////////////////
+
+  /**
+    The rows of several runs in merged order, read in place from the runs.
+    There are no stored zones for the merged order, keys are looked up in
+    the runs' key trees, newest first.
+  */
+  class MergedRows : public IRowSource
+  {
+  public:
+    MergedRows(IFieldDescriptorConstListConstPtrH keyFields,
+      const std::vector<IRowSourcePtrH>& runs) :
+      mRuns(runs),
+      mPositions(runs.size())
+    {
+      for (size_t run = 0; run < mRuns.size(); ++run)
+      {
+        mPositions[run].assign(mRuns[run]->getRowCount(), kHiddenRow);
+      }
+
+      RunMerger merger(keyFields, runs);
+
+      RowLocation location;
+      IRowConstPtrH row;
+      while (merger.next(&location.run, &location.position, &row))
+      {
+        mPositions[location.run][location.position] = mLocations.size();
+        mLocations.push_back(location);
+      }
+    }
+
+    size_t getRowCount() const
+    {
+      return mLocations.size();
+    }
+
+    IRowConstPtrH getRow(size_t position) const
+    {
+      const RowLocation& location = mLocations[position];
+      return mRuns[location.run]->getRow(location.position);
+    }
+
+    bool getZones(ZoneMap* /*outZones*/) const
+    {
+      return false;
+    }
+
+    /** The newest run holding key has the row that wasn't hidden */
+    bool findKey(const IRow& key, size_t* outPosition) const
+    {
+      for (size_t run = mRuns.size(); run-- > 0;)
+      {
+        size_t position = 0;
+        if (!mRuns[run]->findKey(key, &position))
+        {
+          return false;
+        }
+        if (position < mPositions[run].size())
+        {
+          *outPosition = mPositions[run][position];
+          return true;
+        }
+      }
+
+      *outPosition = mLocations.size();
+      return true;
+    }
+
+  private:
+    struct RowLocation
+    {
+      size_t run;
+      size_t position;
+    };
+
+    std::vector<IRowSourcePtrH> mRuns;
+    std::vector<RowLocation> mLocations;
+
+    /** Per run, the merged position of each row, or kHiddenRow */
+    std::vector<std::vector<size_t> > mPositions;
+  };
+
+  /////////////////////////////////////////////////////////////////////
+
+  struct LsmRun
+  {
+    std::string filename;
+    size_t rowCount;
+  };
+
+  typedef std::vector<LsmRun> LsmRunList;
+
+  class DataStorageLsmImpl
+  {
+  public:
+    DataStorageLsmImpl(const char* existingDbDirectory, BufferPoolPtrH pool) :
+      mScheme(SchemeJson::Load((std::string(existingDbDirectory) + "/" + kSchemeFilename).c_str())),
+      mKeyFields(mScheme->getKeyFieldDescriptors()),
+      mDirectory(existingDbDirectory),
+      mPool(pool),
+      mNextRun(1),
+      mMemtable(RowKeyLess(mKeyFields)),
+      mMemtableLimit(kDefaultMemtableLimit),
+      mPersisted(RowKeyLess(mKeyFields)),
+      mCompacting(false),
+      mCompactionCount(0)
+    {
+      readManifest();
+    }
+
+    DataStorageLsmImpl(ISchemeConstPtrH scheme, const char* newDbDirectory) :
+      mScheme(scheme),
+      mKeyFields(mScheme->getKeyFieldDescriptors()),
+      mDirectory(newDbDirectory),
+      mNextRun(1),
+      mMemtable(RowKeyLess(mKeyFields)),
+      mMemtableLimit(kDefaultMemtableLimit),
+      mPersisted(RowKeyLess(mKeyFields)),
+      mCompacting(false),
+      mCompactionCount(0)
+    {
+      FileSystem::MakeDirectory(mDirectory);
+      SchemeJson::Save(*mScheme, getPath(kSchemeFilename).c_str());
+
+      std::lock_guard<std::mutex> lock(mMutex);
+      writeManifest();
+    }
+
+    ~DataStorageLsmImpl()
+    {
+      if (mCompaction.joinable())
+      {
+        mCompaction.join();
+      }
+    }
+
+    ISchemeConstPtrH getScheme() const
+    {
+      return mScheme;
+    }
+
+    void load(Database* database)
+    {
+      std::vector<IRowSourcePtrH> runs = openRuns(getRuns());
+
+      // A single run is already in key order, and has stored zones
+      if (runs.size() == 1)
+      {
+        database->attach(runs.front());
+      }
+      else if (runs.size() > 1)
+      {
+        database->attach(IRowSourcePtrH(new MergedRows(mKeyFields, runs)));
+      }
+    }
+
+    void beginPersist()
+    {
+      waitForCompaction();
+      mPersisted.clear();
+    }
+
+    /** Rows aren't persisted in key order, and may not outlive the call */
+    void persistRow(const IRow* row)
+    {
+      IFieldDescriptorConstListConstPtrH fields = mScheme->getFieldDescriptors();
+
+      IRowPtrH copy(new Row(*fields));
+      for (IFieldDescriptorConstList::const_iterator field = fields->cbegin();
+        field != fields->cend(); ++field)
+      {
+        ValueConstPtrH value = row->getValue(**field);
+        if (value)
+        {
+          copy->setValue(**field, ValuePtrH(new Value(*value)));
+        }
+      }
+
+      Replace(&mPersisted, copy);
+    }
+
+    void endPersist()
+    {
+      LsmRunList replaced = getRuns();
+      LsmRunList runs;
+      if (!mPersisted.empty())
+      {
+        runs.push_back(writeRun(mPersisted.cbegin(), mPersisted.cend()));
+      }
+      mPersisted.clear();
+
+      replaceRuns(replaced, runs);
+    }
+
+    bool put(IRowConstPtrH row)
+    {
+      bool isReplaced = Replace(&mMemtable, row) || isInRuns(*row);
+
+      if (mMemtable.size() >= mMemtableLimit)
+      {
+        flush();
+      }
+
+      return isReplaced;
+    }
+
+    void flush()
+    {
+      if (mMemtable.empty())
+      {
+        return;
+      }
+
+      LsmRun run = writeRun(mMemtable.cbegin(), mMemtable.cend());
+      mMemtable.clear();
+
+      {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mRuns.push_back(run);
+        writeManifest();
+      }
+
+      startCompaction();
+    }
+
+    void waitForCompaction()
+    {
+      joinCompaction();
+
+      LsmRunList runs;
+      while (chooseCompaction(&runs))
+      {
+        compactRuns(runs);
+      }
+    }
+
+    void compact()
+    {
+      joinCompaction();
+
+      LsmRunList runs = getRuns();
+      if (runs.size() > 1)
+      {
+        compactRuns(runs);
+      }
+    }
+
+    void setMemtableLimit(size_t rows)
+    {
+      mMemtableLimit = rows > 0 ? rows : 1;
+    }
+
+    size_t getRunCount() const
+    {
+      std::lock_guard<std::mutex> lock(mMutex);
+      return mRuns.size();
+    }
+
+    size_t getCompactionCount() const
+    {
+      return mCompactionCount;
+    }
+
+  private:
+    std::string getPath(const std::string& name) const
+    {
+      return mDirectory + "/" + name;
+    }
+
+    LsmRunList getRuns() const
+    {
+      std::lock_guard<std::mutex> lock(mMutex);
+      return mRuns;
+    }
+
+    /**
+      True if a run holds the key of row, each run reads a few pages of its
+      key tree.  Runs without a key tree can't tell, and count as not
+      holding it.
+    */
+    bool isInRuns(const IRow& row)
+    {
+      std::vector<IRowSourcePtrH> runs = getLookupRuns();
+      for (size_t run = runs.size(); run-- > 0;)
+      {
+        size_t position = 0;
+        if (runs[run]->findKey(row, &position) && position < runs[run]->getRowCount())
+        {
+          return true;
+        }
+      }
+
+      return false;
+    }
+
+    /**
+      The runs, kept open between lookups.  Runs are opened with mMutex
+      held so a compaction can't remove their files first.
+    */
+    std::vector<IRowSourcePtrH> getLookupRuns()
+    {
+      std::lock_guard<std::mutex> lock(mMutex);
+
+      bool isCurrent = mLookupRunNames.size() == mRuns.size();
+      for (size_t run = 0; isCurrent && run < mRuns.size(); ++run)
+      {
+        isCurrent = mLookupRunNames[run] == mRuns[run].filename;
+      }
+
+      if (!isCurrent)
+      {
+        std::vector<std::string> names;
+        std::vector<IRowSourcePtrH> runs;
+        for (LsmRunList::const_iterator run = mRuns.cbegin(); run != mRuns.cend(); ++run)
+        {
+          std::vector<std::string>::const_iterator opened =
+            std::find(mLookupRunNames.cbegin(), mLookupRunNames.cend(), run->filename);
+          if (opened != mLookupRunNames.cend())
+          {
+            runs.push_back(mLookupRuns[opened - mLookupRunNames.cbegin()]);
+          }
+          else
+          {
+            runs.push_back(openRuns(LsmRunList(1, *run)).front());
+          }
+          names.push_back(run->filename);
+        }
+
+        mLookupRunNames.swap(names);
+        mLookupRuns.swap(runs);
+      }
+
+      return mLookupRuns;
+    }
+
+    std::vector<IRowSourcePtrH> openRuns(const LsmRunList& runs) const
+    {
+      std::vector<IRowSourcePtrH> sources;
+      for (LsmRunList::const_iterator run = runs.cbegin(); run != runs.cend(); ++run)
+      {
+        std::string filename = getPath(run->filename);
+        sources.push_back(DataStorageSnapshot::Open(filename.c_str(), mPool)->getRows());
+      }
+      return sources;
+    }
+
+    /** Write rows, in key order, as a new run */
+    template <typename RowIterator>
+    LsmRun writeRun(RowIterator begin, RowIterator end)
+    {
+      LsmRun run = { nextRunFilename(), 0 };
+
+      std::string filename = getPath(run.filename);
+      DataStorageSnapshotPtrH snapshot = DataStorageSnapshot::Create(mScheme, filename.c_str());
+
+      snapshot->beginPersist();
+      for (RowIterator row = begin; row != end; ++row)
+      {
+        snapshot->persistRow(row->get());
+        ++run.rowCount;
+      }
+      snapshot->endPersist();
+
+      return run;
+    }
+
+    std::string nextRunFilename()
+    {
+      std::lock_guard<std::mutex> lock(mMutex);
+
+      char filename[32];
+      sprintf(filename, "run-%06u.snap", mNextRun++);
+      return filename;
+    }
+
+    /**
+      Choose the newest runs that add up to at least half of the run
+      before them, false if there are fewer than two
+    */
+    bool chooseCompaction(LsmRunList* outRuns) const
+    {
+      LsmRunList runs = getRuns();
+      if (runs.size() < 2)
+      {
+        return false;
+      }
+
+      size_t first = runs.size() - 1;
+      size_t rowCount = runs[first].rowCount;
+      while (first > 0 && runs[first - 1].rowCount <= rowCount * kRunSizeRatio)
+      {
+        --first;
+        rowCount += runs[first].rowCount;
+      }
+
+      if (first == runs.size() - 1)
+      {
+        return false;
+      }
+
+      outRuns->assign(runs.begin() + first, runs.end());
+      return true;
+    }
+
+    void startCompaction()
+    {
+      if (mCompacting)
+      {
+        return;
+      }
+      joinCompaction();
+
+      LsmRunList runs;
+      if (chooseCompaction(&runs))
+      {
+        mCompacting = true;
+        mCompaction = std::thread(&DataStorageLsmImpl::compactInBackground, this, runs);
+      }
+    }
+
+    void compactInBackground(LsmRunList runs)
+    {
+      try
+      {
+        compactRuns(runs);
+      }
+      catch (std::exception& ex)
+      {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mCompactionError = ex.what();
+      }
+
+      mCompacting = false;
+    }
+
+    /** Wait for the background compaction, rethrowing its error */
+    void joinCompaction()
+    {
+      if (mCompaction.joinable())
+      {
+        mCompaction.join();
+      }
+
+      std::lock_guard<std::mutex> lock(mMutex);
+      if (!mCompactionError.empty())
+      {
+        std::string ex = "Unable to compact runs: " + mCompactionError;
+        mCompactionError.clear();
+        throw std::runtime_error(ex);
+      }
+    }
+
+    /** Merge consecutive runs into one, which takes their place */
+    void compactRuns(const LsmRunList& runs)
+    {
+      std::vector<IRowSourcePtrH> sources = openRuns(runs);
+      RunMerger merger(mKeyFields, sources);
+
+      LsmRun merged = { nextRunFilename(), 0 };
+      std::string filename = getPath(merged.filename);
+      DataStorageSnapshotPtrH snapshot = DataStorageSnapshot::Create(mScheme, filename.c_str());
+
+      size_t run = 0;
+      size_t position = 0;
+      IRowConstPtrH row;
+
+      snapshot->beginPersist();
+      while (merger.next(&run, &position, &row))
+      {
+        snapshot->persistRow(row.get());
+        ++merged.rowCount;
+      }
+      snapshot->endPersist();
+
+      replaceRuns(runs, LsmRunList(1, merged));
+      ++mCompactionCount;
+    }
+
+    /**
+      Put runs in place of replaced, which are consecutive (runs are only
+      added after them while they're compacted), and remove their files
+    */
+    void replaceRuns(const LsmRunList& replaced, const LsmRunList& runs)
+    {
+      {
+        std::lock_guard<std::mutex> lock(mMutex);
+
+        LsmRunList::iterator first = mRuns.begin();
+        if (!replaced.empty())
+        {
+          while (first != mRuns.end() && first->filename != replaced.front().filename)
+          {
+            ++first;
+          }
+          if ((size_t)(mRuns.end() - first) < replaced.size())
+          {
+            throw std::runtime_error("Replaced runs are missing from the manifest");
+          }
+        }
+
+        first = mRuns.erase(first, first + replaced.size());
+        mRuns.insert(first, runs.begin(), runs.end());
+        writeManifest();
+      }
+
+      for (LsmRunList::const_iterator run = replaced.cbegin(); run != replaced.cend(); ++run)
+      {
+        remove(getPath(run->filename).c_str());
+      }
+    }
+
+    void readManifest()
+    {
+      std::string manifestFilename = getPath(kManifestFilename);
+      FILE* manifest = fopen(manifestFilename.c_str(), "r");
+      if (!manifest)
+      {
+        std::string ex = "Unable to open manifest \"" + manifestFilename + "\"";
+        throw std::runtime_error(ex);
+      }
+
+      char filename[256];
+      unsigned long long rowCount = 0;
+      while (fscanf(manifest, "%255s %llu", filename, &rowCount) == 2)
+      {
+        LsmRun run = { filename, (size_t)rowCount };
+        mRuns.push_back(run);
+
+        unsigned int number = 0;
+        if (sscanf(filename, "run-%u.snap", &number) == 1 && number >= mNextRun)
+        {
+          mNextRun = number + 1;
+        }
+      }
+
+      bool isComplete = feof(manifest) != 0;
+      fclose(manifest);
+
+      if (!isComplete)
+      {
+        std::string ex = "Invalid manifest \"" + manifestFilename + "\"";
+        throw std::runtime_error(ex);
+      }
+    }
+
+    /** Written alongside and renamed over, with mMutex held */
+    void writeManifest() const
+    {
+      std::string manifestFilename = getPath(kManifestFilename);
+      std::string temporaryFilename = manifestFilename + ".tmp";
+
+      FILE* manifest = fopen(temporaryFilename.c_str(), "w");
+      if (!manifest)
+      {
+        std::string ex = "Unable to write manifest \"" + manifestFilename + "\"";
+        throw std::runtime_error(ex);
+      }
+
+      for (LsmRunList::const_iterator run = mRuns.cbegin(); run != mRuns.cend(); ++run)
+      {
+        fprintf(manifest, "%s %llu\n", run->filename.c_str(), (unsigned long long)run->rowCount);
+      }
+
+      bool isWritten = fflush(manifest) == 0;
+      fclose(manifest);
+
+      if (!isWritten || !FileSystem::ReplaceFile(temporaryFilename, manifestFilename))
+      {
+        remove(temporaryFilename.c_str());
+        std::string ex = "Unable to write manifest \"" + manifestFilename + "\"";
+        throw std::runtime_error(ex);
+      }
+    }
+
+    ISchemeConstPtrH mScheme;
+    IFieldDescriptorConstListConstPtrH mKeyFields;
+    std::string mDirectory;
+    BufferPoolPtrH mPool;
+
+    /** Guards the runs, the manifest, and the compaction error */
+    mutable std::mutex mMutex;
+    LsmRunList mRuns;
+    unsigned int mNextRun;
+
+    SortedRows mMemtable;
+    size_t mMemtableLimit;
+
+    /** The runs opened for key lookups, by filename, guarded by mMutex */
+    std::vector<std::string> mLookupRunNames;
+    std::vector<IRowSourcePtrH> mLookupRuns;
+
+    SortedRows mPersisted;
+
+    std::thread mCompaction;
+    std::atomic<bool> mCompacting;
+    std::atomic<size_t> mCompactionCount;
+    std::string mCompactionError;
+  };
+}
+
+/////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////
+
+DatabasePtrH DataStorageLsm::Load(const char* existingDbDirectory, BufferPoolPtrH pool)
+{
+  IDataStoragePtrH existingStoragePtrH(new DataStorageLsm(existingDbDirectory, pool));
+  DatabasePtrH db(new Database(existingStoragePtrH));
+  return db;
+}
+
+DataStorageLsmPtrH DataStorageLsm::Open(const char* existingDbDirectory, BufferPoolPtrH pool)
+{
+  return DataStorageLsmPtrH(new DataStorageLsm(existingDbDirectory, pool));
+}
+
+DataStorageLsmPtrH DataStorageLsm::Create(ISchemeConstPtrH scheme, const char* newDbDirectory)
+{
+  return DataStorageLsmPtrH(new DataStorageLsm(scheme, newDbDirectory));
+}
+
+bool DataStorageLsm::IsLsm(const char* path)
+{
+  if (!FileSystem::IsDirectory(path))
+  {
+    return false;
+  }
+
+  std::string manifestFilename = std::string(path) + "/" + kManifestFilename;
+  FILE* manifest = fopen(manifestFilename.c_str(), "r");
+  if (!manifest)
+  {
+    return false;
+  }
+
+  fclose(manifest);
+  return true;
+}
+
+DataStorageLsm::DataStorageLsm(const char* existingDbDirectory, BufferPoolPtrH pool) :
+  mImpl(new DataStorageLsmImpl(existingDbDirectory, pool))
+{
+}
+
+DataStorageLsm::DataStorageLsm(ISchemeConstPtrH scheme, const char* newDbDirectory) :
+  mImpl(new DataStorageLsmImpl(scheme, newDbDirectory))
+{
+}
+
+DataStorageLsm::~DataStorageLsm()
+{
+}
+
+ISchemeConstPtrH DataStorageLsm::getScheme()
+{
+  return mImpl->getScheme();
+}
+
+void DataStorageLsm::load(Database* database, IFieldDescriptorConstListConstPtrH /*fields*/,
+  const Predicate* /*filter*/)
+{
+  mImpl->load(database);
+}
+
+void DataStorageLsm::beginPersist()
+{
+  mImpl->beginPersist();
+}
+
+void DataStorageLsm::persistRow(const IRow* row)
+{
+  mImpl->persistRow(row);
+}
+
+void DataStorageLsm::endPersist()
+{
+  mImpl->endPersist();
+}
+
+bool DataStorageLsm::put(IRowConstPtrH row)
+{
+  return mImpl->put(row);
+}
+
+void DataStorageLsm::flush()
+{
+  mImpl->flush();
+}
+
+void DataStorageLsm::waitForCompaction()
+{
+  mImpl->waitForCompaction();
+}
+
+void DataStorageLsm::compact()
+{
+  mImpl->compact();
+}
+
+void DataStorageLsm::setMemtableLimit(size_t rows)
+{
+  mImpl->setMemtableLimit(rows);
+}
+
+size_t DataStorageLsm::getRunCount() const
+{
+  return mImpl->getRunCount();
+}
+
+size_t DataStorageLsm::getCompactionCount() const
+{
+  return mImpl->getCompactionCount();
+}
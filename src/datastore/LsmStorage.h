@@ -0,0 +1,123 @@
+
+#ifndef __LSM_STORAGE_H__
+#define __LSM_STORAGE_H__
+
+#include <datastore/Scheme.h>
+#include <datastore/DataStorage.h>
+#include <datastore/Database.h>
+#include <datastore/BufferPool.h>
+
+namespace DataStore
+{
+  /**
+    @hidden
+    Hide the runs and their compaction from client code
+  */
+  class DataStorageLsmImpl;
+  typedef PointerType<DataStorageLsmImpl>::Shared DataStorageLsmImplPtrH;
+
+  class DataStorageLsm;
+  typedef PointerType<DataStorageLsm>::Shared DataStorageLsmPtrH;
+
+  /**
+  An IDataStorage implementation laid out as a log-structured merge tree,
+  for many small imports that overwrite each other's keys.  Rows are put
+  into an in-memory table sorted by key, which is written as an immutable
+  run (a snapshot sorted by key, see DataStorageSnapshot) when it fills up
+  or is flushed, so an import only writes the rows it imports.
+
+  Runs are merged in the background once the newer ones add up to the
+  size of an older one, so there are only a logarithmic number of them.
+  Where runs hold the same key, the row of the newest run wins, both when
+  runs are compacted and when they are merged to load a database.
+
+  @verbatim
+  scheme.json       JSON scheme (see SchemeJson)
+  manifest          the runs, oldest first, a "<file> <row count>" line each
+  run-000001.snap   a run, rows sorted by key
+  @endverbatim
+  */
+  class DataStorageLsm : public IDataStorage
+  {
+  public:
+    /**
+      Load the merged runs of an existing database directory.  Runs are
+      read through pool if one is given (see DataStorageSnapshot::Load).
+    */
+    static DatabasePtrH Load(const char* existingDbDirectory,
+      BufferPoolPtrH pool = BufferPoolPtrH());
+
+    /**
+      Open an existing database directory, without loading any rows.  Runs
+      that are looked up or compacted are read through pool if one is given.
+    */
+    static DataStorageLsmPtrH Open(const char* existingDbDirectory,
+      BufferPoolPtrH pool = BufferPoolPtrH());
+
+    /** A new database without runs in directory, which is created if needed */
+    static DataStorageLsmPtrH Create(ISchemeConstPtrH scheme, const char* newDbDirectory);
+
+    /** True if path is an LSM database directory */
+    static bool IsLsm(const char* path);
+
+    /**
+      Waits for a background compaction.  Rows that were put but not
+      flushed are discarded.
+    */
+    ~DataStorageLsm();
+
+    ISchemeConstPtrH getScheme();
+
+    /**
+      Attach the runs, merged by key.  A newer row of a key that doesn't
+      match filter still hides an older one that does, so runs are merged
+      whole.
+    */
+    void load(Database* database, IFieldDescriptorConstListConstPtrH fields,
+      const Predicate* filter);
+
+    /** The persisted rows replace all runs, as a single run */
+    void beginPersist();
+    void persistRow(const IRow* row);
+    void endPersist();
+
+    /**
+      Add row to the memtable, replacing any row with the same key.  The
+      memtable is flushed once it holds the memtable limit.  Returns true
+      if a row with the key was put before, as found in the memtable or
+      in the key trees of the runs.
+    */
+    bool put(IRowConstPtrH row);
+
+    /**
+      Write the memtable as a new run, and start compacting in the
+      background if the newest runs should be merged
+    */
+    void flush();
+
+    /**
+      Wait for the background compaction, and any compaction that it left
+      due.  Throws if a compaction failed.
+    */
+    void waitForCompaction();
+
+    /** Merge all runs into one */
+    void compact();
+
+    /** Rows held by the memtable before it's flushed */
+    void setMemtableLimit(size_t rows);
+
+    size_t getRunCount() const;
+
+    /** Number of compactions finished since opening */
+    size_t getCompactionCount() const;
+
+  private:
+    DataStorageLsm(const char* existingDbDirectory, BufferPoolPtrH pool);
+    DataStorageLsm(ISchemeConstPtrH scheme, const char* newDbDirectory);
+
+    DataStorageLsmImplPtrH mImpl;
+  };
+}
+
+#endif
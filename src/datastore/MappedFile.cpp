@@ -0,0 +1,100 @@
+
+#include <datastore/MappedFile.h>
+#include <stdexcept>
+#include <string>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+using namespace DataStore;
+
+/////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////
+
+MappedFile::MappedFile(const char* filename) :
+  mData(NULL),
+  mSize(0)
+{
+  std::string ex = "Unable to map file \"";
+  ex += filename;
+  ex += "\"";
+
+#ifdef _WIN32
+  HANDLE file = CreateFileA(filename, GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_DELETE,
+    NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+  if (file == INVALID_HANDLE_VALUE)
+  {
+    throw std::runtime_error(ex);
+  }
+
+  LARGE_INTEGER size;
+  if (!GetFileSizeEx(file, &size))
+  {
+    CloseHandle(file);
+    throw std::runtime_error(ex);
+  }
+  mSize = (size_t)size.QuadPart;
+
+  // Empty files can't be mapped, leave them without data
+  if (mSize > 0)
+  {
+    HANDLE mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+    if (mapping != NULL)
+    {
+      mData = (const char*)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+      CloseHandle(mapping);
+    }
+  }
+
+  CloseHandle(file);
+#else
+  int file = open(filename, O_RDONLY);
+  if (file < 0)
+  {
+    throw std::runtime_error(ex);
+  }
+
+  struct stat status;
+  if (fstat(file, &status) != 0)
+  {
+    close(file);
+    throw std::runtime_error(ex);
+  }
+  mSize = (size_t)status.st_size;
+
+  // Empty files can't be mapped, leave them without data
+  if (mSize > 0)
+  {
+    void* data = mmap(NULL, mSize, PROT_READ, MAP_SHARED, file, 0);
+    if (data != MAP_FAILED)
+    {
+      mData = (const char*)data;
+    }
+  }
+
+  close(file);
+#endif
+
+  if (mSize > 0 && mData == NULL)
+  {
+    throw std::runtime_error(ex);
+  }
+}
+
+MappedFile::~MappedFile()
+{
+  if (mData != NULL)
+  {
+#ifdef _WIN32
+    UnmapViewOfFile(mData);
+#else
+    munmap((void*)mData, mSize);
+#endif
+  }
+}
@@ -0,0 +1,35 @@
+
+#ifndef __MAPPED_FILE_H__
+#define __MAPPED_FILE_H__
+
+#include <datastore/PointerType.h>
+#include <stddef.h>
+
+namespace DataStore
+{
+  /**
+    A read-only view of a whole file, mapped into memory.  Mapping is
+    constant time, pages are read from disk as they are first touched.
+  */
+  class MappedFile
+  {
+  public:
+    /** Throws if the file can't be opened or mapped */
+    MappedFile(const char* filename);
+    ~MappedFile();
+
+    const char* getData() const { return mData; }
+    size_t getSize() const { return mSize; }
+
+  private:
+    MappedFile(const MappedFile&);
+    MappedFile& operator=(const MappedFile&);
+
+    const char* mData;
+    size_t mSize;
+  };
+
+  typedef PointerType<MappedFile>::Shared MappedFilePtrH;
+}
+
+#endif
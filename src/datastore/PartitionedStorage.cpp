@@ -0,0 +1,630 @@
+
+#include <datastore/PartitionedStorage.h>
+#include <datastore/SnapshotStorage.h>
+#include <datastore/FileSystem.h>
+#include <datastore/JsonStorage.h>
+#include <datastore/Logic.h>
+#include <datastore/ZoneMap.h>
+#include <algorithm>
+#include <map>
+#include <set>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include <stdio.h>
+#include <string.h>
+
+using namespace DataStore;
+
+static const char* kSchemeFilename = "scheme.json";
+static const char* kPartitionExtension = ".snap";
+static const char* kUndatedPartition = "undated";
+
+/////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////
+
+namespace DataStore
+{
+  /**
+    The rows of several sources, one after the other.  Zones are merged
+    into ZoneMap blocks of the concatenated rows, a block that straddles
+    two sources covers the zones of both.
+  */
+  class PartitionRows : public IRowSource
+  {
+  public:
+    PartitionRows(size_t fieldCount) :
+      mFieldCount(fieldCount),
+      mRowCount(0)
+    {
+    }
+
+    void append(IRowSourcePtrH source)
+    {
+      mSources.push_back(source);
+      mStarts.push_back(mRowCount);
+      mRowCount += source->getRowCount();
+    }
+
+    size_t getRowCount() const
+    {
+      return mRowCount;
+    }
+
+    IRowConstPtrH getRow(size_t position) const
+    {
+      // The last source starting at or before position
+      size_t source = std::upper_bound(mStarts.begin(), mStarts.end(), position) -
+        mStarts.begin() - 1;
+      return mSources[source]->getRow(position - mStarts[source]);
+    }
+
+    bool getZones(ZoneMap* outZones) const
+    {
+      const size_t blockSize = ZoneMap::kRowsPerBlock;
+      std::vector<ZoneList> blocks((mRowCount + blockSize - 1) / blockSize,
+        ZoneList(mFieldCount));
+
+      for (size_t source = 0; source < mSources.size(); ++source)
+      {
+        ZoneMap sourceZones(mFieldCount);
+        if (!mSources[source]->getZones(&sourceZones))
+        {
+          return false;
+        }
+
+        size_t sourceRows = mSources[source]->getRowCount();
+        for (size_t sourceBlock = 0; sourceBlock < sourceZones.getBlockCount(); ++sourceBlock)
+        {
+          size_t first = sourceBlock * blockSize;
+          if (first >= sourceRows)
+          {
+            break;
+          }
+          size_t last = std::min(first + blockSize, sourceRows) - 1;
+
+          const ZoneList& zones = sourceZones.getZones(sourceBlock);
+          for (size_t block = (mStarts[source] + first) / blockSize;
+            block <= (mStarts[source] + last) / blockSize; ++block)
+          {
+            for (size_t field = 0; field < mFieldCount && field < zones.size(); ++field)
+            {
+              if (zones[field].min)
+              {
+                blocks[block][field].update(zones[field].min);
+                blocks[block][field].update(zones[field].max);
+              }
+            }
+          }
+        }
+      }
+
+      for (size_t block = 0; block < blocks.size(); ++block)
+      {
+        outZones->setZones(block, blocks[block]);
+      }
+      return true;
+    }
+
+    /** Keys are unique across partitions, so the first source holding key has its row */
+    bool findKey(const IRow& key, size_t* outPosition) const
+    {
+      for (size_t source = 0; source < mSources.size(); ++source)
+      {
+        size_t position = 0;
+        if (!mSources[source]->findKey(key, &position))
+        {
+          return false;
+        }
+        if (position < mSources[source]->getRowCount())
+        {
+          *outPosition = mStarts[source] + position;
+          return true;
+        }
+      }
+
+      *outPosition = mRowCount;
+      return true;
+    }
+
+  private:
+    size_t mFieldCount;
+    size_t mRowCount;
+    std::vector<IRowSourcePtrH> mSources;
+    std::vector<size_t> mStarts;
+  };
+
+  typedef PointerType<PartitionRows>::Shared PartitionRowsPtrH;
+
+  /////////////////////////////////////////////////////////////////////
+
+  class DataStoragePartitionedImpl
+  {
+  public:
+    DataStoragePartitionedImpl(const char* existingDbDirectory, BufferPoolPtrH pool) :
+      mDirectory(existingDbDirectory),
+      mPool(pool)
+    {
+      mScheme = SchemeJson::Load(getPath(kSchemeFilename).c_str());
+
+      findPartitionField();
+      findPartitions();
+    }
+
+    DataStoragePartitionedImpl(ISchemeConstPtrH scheme, const char* newDbDirectory) :
+      mScheme(scheme),
+      mDirectory(newDbDirectory)
+    {
+      findPartitionField();
+      FileSystem::MakeDirectory(mDirectory);
+    }
+
+    ISchemeConstPtrH getScheme() const
+    {
+      return mScheme;
+    }
+
+    void load(Database* database, const Predicate* filter)
+    {
+      PartitionRowsPtrH rows(new PartitionRows(mScheme->getFieldDescriptors()->size()));
+
+      for (std::set<std::string>::const_iterator partition = mPartitions.cbegin();
+        partition != mPartitions.cend(); ++partition)
+      {
+        if (mayMatch(*partition, filter))
+        {
+          std::string filename = getPartitionPath(*partition);
+          DataStorageSnapshotPtrH snapshot = DataStorageSnapshot::Open(filename.c_str(), mPool);
+          rows->append(snapshot->getRows());
+        }
+      }
+
+      // A database with nothing attached is persisted, e.g. a new one
+      if (rows->getRowCount() > 0)
+      {
+        database->attach(rows);
+      }
+    }
+
+    void beginPersist()
+    {
+      mPersisted.clear();
+    }
+
+    void persistRow(const IRow* row)
+    {
+      std::string partition = partitionOf(*row);
+
+      std::map<std::string, DataStorageSnapshotPtrH>::iterator persisted =
+        mPersisted.find(partition);
+      if (persisted == mPersisted.end())
+      {
+        std::string filename = getPartitionPath(partition);
+        DataStorageSnapshotPtrH snapshot = DataStorageSnapshot::Create(mScheme, filename.c_str());
+        snapshot->beginPersist();
+        persisted = mPersisted.insert(std::make_pair(partition, snapshot)).first;
+      }
+
+      persisted->second->persistRow(row);
+    }
+
+    void endPersist()
+    {
+      SchemeJson::Save(*mScheme, getPath(kSchemeFilename).c_str());
+
+      std::set<std::string> written;
+      for (std::map<std::string, DataStorageSnapshotPtrH>::iterator persisted = mPersisted.begin();
+        persisted != mPersisted.end(); ++persisted)
+      {
+        persisted->second->endPersist();
+        written.insert(persisted->first);
+      }
+      mPersisted.clear();
+
+      // Rows only move out of a partition if their date is replaced
+      findPartitions();
+      for (std::set<std::string>::const_iterator partition = mPartitions.cbegin();
+        partition != mPartitions.cend(); ++partition)
+      {
+        if (written.find(*partition) == written.end())
+        {
+          remove(getPartitionPath(*partition).c_str());
+        }
+      }
+      mPartitions = written;
+    }
+
+    void put(IRowConstPtrH row)
+    {
+      mPending.push_back(row);
+    }
+
+    void flush(size_t* pInserted, size_t* pReplaced)
+    {
+      IRowConstList pending;
+      pending.swap(mPending);
+
+      size_t inserted = 0;
+      size_t replaced = 0;
+
+      if (!pending.empty() && !isKeyPartitioned())
+      {
+        // A replaced row may move to another partition, so they are all
+        // loaded, and all persisted as the database is released
+        DatabasePtrH database = DataStoragePartitioned::Load(mDirectory.c_str(), mPool);
+        if (!database->insertBatch(pending, &inserted, &replaced))
+        {
+          throw std::runtime_error("Unable to insert rows into partitions");
+        }
+        database.reset();
+
+        findPartitions();
+      }
+      else if (!pending.empty())
+      {
+        // A key can only be stored in the partition of its date, and rows
+        // keep their order within it
+        std::map<std::string, IRowConstList> partitions;
+        for (IRowConstList::const_iterator row = pending.cbegin(); row != pending.cend(); ++row)
+        {
+          partitions[partitionOf(**row)].push_back(*row);
+        }
+
+        for (std::map<std::string, IRowConstList>::const_iterator partition = partitions.cbegin();
+          partition != partitions.cend(); ++partition)
+        {
+          size_t partitionInserted = 0;
+          size_t partitionReplaced = 0;
+          writePartition(partition->first, partition->second,
+            &partitionInserted, &partitionReplaced);
+
+          inserted += partitionInserted;
+          replaced += partitionReplaced;
+        }
+      }
+
+      if (pInserted != NULL)
+      {
+        *pInserted = inserted;
+      }
+      if (pReplaced != NULL)
+      {
+        *pReplaced = replaced;
+      }
+    }
+
+    size_t dropBefore(const Date& date)
+    {
+      size_t dropped = 0;
+      std::set<std::string> kept;
+
+      for (std::set<std::string>::const_iterator partition = mPartitions.cbegin();
+        partition != mPartitions.cend(); ++partition)
+      {
+        ValueConstPtrH first;
+        ValueConstPtrH last;
+        Date lastDate;
+        if (getBounds(*partition, &first, &last) &&
+          last->getValue().convertTo(&lastDate) && lastDate < date)
+        {
+          if (remove(getPartitionPath(*partition).c_str()) != 0)
+          {
+            std::string ex = "Unable to remove partition \"" + getPartitionPath(*partition) + "\"";
+            throw std::runtime_error(ex);
+          }
+          ++dropped;
+        }
+        else
+        {
+          kept.insert(*partition);
+        }
+      }
+
+      mPartitions = kept;
+      return dropped;
+    }
+
+    size_t getPartitionCount() const
+    {
+      return mPartitions.size();
+    }
+
+  private:
+    std::string getPath(const std::string& name) const
+    {
+      return mDirectory + "/" + name;
+    }
+
+    std::string getPartitionPath(const std::string& partition) const
+    {
+      return getPath(partition + kPartitionExtension);
+    }
+
+    void findPartitionField()
+    {
+      IFieldDescriptorConstListConstPtrH fields = mScheme->getFieldDescriptors();
+      for (IFieldDescriptorConstList::const_iterator field = fields->cbegin();
+        field != fields->cend(); ++field)
+      {
+        if ((*field)->getPartitionType() != ePartitionType_None)
+        {
+          mPartitionField = *field;
+          return;
+        }
+      }
+
+      throw std::runtime_error("Unable to partition a scheme without a partitioned field");
+    }
+
+    /** Partitions are named by their files, e.g. 2014-04.snap */
+    void findPartitions()
+    {
+      std::vector<std::string> names;
+      FileSystem::ListFiles(mDirectory, &names);
+
+      const size_t extensionLength = strlen(kPartitionExtension);
+
+      mPartitions.clear();
+      for (std::vector<std::string>::const_iterator name = names.cbegin();
+        name != names.cend(); ++name)
+      {
+        if (name->size() > extensionLength &&
+          name->compare(name->size() - extensionLength, extensionLength, kPartitionExtension) == 0)
+        {
+          mPartitions.insert(name->substr(0, name->size() - extensionLength));
+        }
+      }
+    }
+
+    /** True if the partitioned field is part of the key */
+    bool isKeyPartitioned() const
+    {
+      IFieldDescriptorConstListConstPtrH keyFields = mScheme->getKeyFieldDescriptors();
+      return std::find(keyFields->cbegin(), keyFields->cend(), mPartitionField) !=
+        keyFields->cend();
+    }
+
+    /**
+      Insert rows into the stored rows of partition, or into a new one, and
+      rewrite its snapshot
+    */
+    void writePartition(const std::string& partition, const IRowConstList& rows,
+      size_t* outInserted, size_t* outReplaced)
+    {
+      std::string filename = getPartitionPath(partition);
+
+      // Not persisted by itself, only the snapshot below is written
+      Database database(mScheme);
+      if (mPartitions.find(partition) != mPartitions.end())
+      {
+        DataStorageSnapshotPtrH stored = DataStorageSnapshot::Open(filename.c_str(), mPool);
+        database.attach(stored->getRows());
+      }
+
+      if (!database.insertBatch(rows, outInserted, outReplaced))
+      {
+        throw std::runtime_error("Unable to insert rows into partition "" + partition + """);
+      }
+
+      DataStorageSnapshotPtrH snapshot = DataStorageSnapshot::Create(mScheme, filename.c_str());
+      snapshot->beginPersist();
+      IQueryCursorPtrH cursor = database.openCursor();
+      for (const IRow* row = cursor->next(); row != NULL; row = cursor->next())
+      {
+        snapshot->persistRow(row);
+      }
+      snapshot->endPersist();
+
+      mPartitions.insert(partition);
+    }
+
+    std::string partitionOf(const IRow& row) const
+    {
+      ValueConstPtrH value = row.getValue(*mPartitionField);
+      Date date;
+      if (!value || !value->getValue().convertTo(&date))
+      {
+        return kUndatedPartition;
+      }
+
+      char formatted[32];
+      date.format(formatted, sizeof(formatted));
+      if (mPartitionField->getPartitionType() == ePartitionType_Month)
+      {
+        // YYYY-MM
+        formatted[7] = 0;
+      }
+      return formatted;
+    }
+
+    /** The first and last date of a partition, false if it has none */
+    bool getBounds(const std::string& partition, ValueConstPtrH* outFirst,
+      ValueConstPtrH* outLast) const
+    {
+      int year = 0;
+      int month = 0;
+      int day = 0;
+      char bound[32];
+
+      if (sscanf(partition.c_str(), "%d-%d-%d", &year, &month, &day) == 3)
+      {
+        sprintf(bound, "%04d-%02d-%02d", year, month, day);
+        *outFirst = mPartitionField->fromString(bound);
+        *outLast = *outFirst;
+      }
+      else if (sscanf(partition.c_str(), "%d-%d", &year, &month) == 2)
+      {
+        static const int kDaysInMonth[] = { 31, 28, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31 };
+        if (month < 1 || month > 12)
+        {
+          return false;
+        }
+
+        bool isLeapYear = (year % 4 == 0 && year % 100 != 0) || year % 400 == 0;
+        int lastDay = kDaysInMonth[month - 1] + (month == 2 && isLeapYear ? 1 : 0);
+
+        sprintf(bound, "%04d-%02d-01", year, month);
+        *outFirst = mPartitionField->fromString(bound);
+        sprintf(bound, "%04d-%02d-%02d", year, month, lastDay);
+        *outLast = mPartitionField->fromString(bound);
+      }
+      else
+      {
+        return false;
+      }
+
+      return *outFirst && *outLast;
+    }
+
+    /** False if no row in partition can match filter */
+    bool mayMatch(const std::string& partition, const Predicate* filter) const
+    {
+      ValueRange range;
+      if (!filter || !filter->getRange(*mPartitionField, &range))
+      {
+        return true;
+      }
+
+      // A bounded field must have a value to match
+      if (range.isEmpty() || partition == kUndatedPartition)
+      {
+        return false;
+      }
+
+      ValueConstPtrH first;
+      ValueConstPtrH last;
+      if (!getBounds(partition, &first, &last))
+      {
+        return true;
+      }
+
+      return range.overlaps(*first, *last);
+    }
+
+    ISchemeConstPtrH mScheme;
+    std::string mDirectory;
+    BufferPoolPtrH mPool;
+    IFieldDescriptorConstPtrH mPartitionField;
+
+    /** Stored partitions, in date order */
+    std::set<std::string> mPartitions;
+
+    std::map<std::string, DataStorageSnapshotPtrH> mPersisted;
+
+    /** Rows put, but not yet flushed */
+    IRowConstList mPending;
+  };
+}
+
+/////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////
+
+DatabasePtrH DataStoragePartitioned::Load(const char* existingDbDirectory, BufferPoolPtrH pool)
+{
+  IDataStoragePtrH existingStoragePtrH(new DataStoragePartitioned(existingDbDirectory, pool));
+  DatabasePtrH db(new Database(existingStoragePtrH));
+  return db;
+}
+
+DataStoragePartitionedPtrH DataStoragePartitioned::Open(const char* existingDbDirectory,
+  BufferPoolPtrH pool)
+{
+  return DataStoragePartitionedPtrH(new DataStoragePartitioned(existingDbDirectory, pool));
+}
+
+DatabasePtrH DataStoragePartitioned::Create(ISchemeConstPtrH scheme, const char* newDbDirectory)
+{
+  IDataStoragePtrH newStoragePtrH(new DataStoragePartitioned(scheme, newDbDirectory));
+  DatabasePtrH newDb(new Database(newStoragePtrH));
+  return newDb;
+}
+
+bool DataStoragePartitioned::IsPartitioned(const char* path)
+{
+  if (!FileSystem::IsDirectory(path))
+  {
+    return false;
+  }
+
+  // Other storages keep their scheme in a directory too
+  std::string schemeFilename = std::string(path) + "/" + kSchemeFilename;
+  try
+  {
+    return IsPartitioned(*SchemeJson::Load(schemeFilename.c_str()));
+  }
+  catch (std::exception&)
+  {
+    return false;
+  }
+}
+
+bool DataStoragePartitioned::IsPartitioned(const IScheme& scheme)
+{
+  IFieldDescriptorConstListConstPtrH fields = scheme.getFieldDescriptors();
+  for (IFieldDescriptorConstList::const_iterator field = fields->cbegin();
+    field != fields->cend(); ++field)
+  {
+    if ((*field)->getPartitionType() != ePartitionType_None)
+    {
+      return true;
+    }
+  }
+  return false;
+}
+
+DataStoragePartitioned::DataStoragePartitioned(const char* existingDbDirectory,
+  BufferPoolPtrH pool) :
+  mImpl(new DataStoragePartitionedImpl(existingDbDirectory, pool))
+{
+}
+
+DataStoragePartitioned::DataStoragePartitioned(ISchemeConstPtrH scheme, const char* newDbDirectory) :
+  mImpl(new DataStoragePartitionedImpl(scheme, newDbDirectory))
+{
+}
+
+ISchemeConstPtrH DataStoragePartitioned::getScheme()
+{
+  return mImpl->getScheme();
+}
+
+void DataStoragePartitioned::load(Database* database, IFieldDescriptorConstListConstPtrH /*fields*/,
+  const Predicate* filter)
+{
+  mImpl->load(database, filter);
+}
+
+void DataStoragePartitioned::beginPersist()
+{
+  mImpl->beginPersist();
+}
+
+void DataStoragePartitioned::persistRow(const IRow* row)
+{
+  mImpl->persistRow(row);
+}
+
+void DataStoragePartitioned::endPersist()
+{
+  mImpl->endPersist();
+}
+
+void DataStoragePartitioned::put(IRowConstPtrH row)
+{
+  mImpl->put(row);
+}
+
+void DataStoragePartitioned::flush(size_t* pInserted, size_t* pReplaced)
+{
+  mImpl->flush(pInserted, pReplaced);
+}
+
+size_t DataStoragePartitioned::dropBefore(const Date& date)
+{
+  return mImpl->dropBefore(date);
+}
+
+size_t DataStoragePartitioned::getPartitionCount() const
+{
+  return mImpl->getPartitionCount();
+}
@@ -0,0 +1,117 @@
+
+#ifndef __PARTITIONED_STORAGE_H__
+#define __PARTITIONED_STORAGE_H__
+
+#include <datastore/Scheme.h>
+#include <datastore/DataStorage.h>
+#include <datastore/Database.h>
+#include <datastore/BufferPool.h>
+#include <datastore/FieldType.h>
+
+namespace DataStore
+{
+  /**
+    @hidden
+    Hide the directory layout from client code
+  */
+  class DataStoragePartitionedImpl;
+  typedef PointerType<DataStoragePartitionedImpl>::Shared DataStoragePartitionedImplPtrH;
+
+  class DataStoragePartitioned;
+  typedef PointerType<DataStoragePartitioned>::Shared DataStoragePartitionedPtrH;
+
+  /**
+  An IDataStorage implementation that splits rows by the value of the
+  scheme's partitioned date field (see SchemeJson), into a segment per day
+  or per month.  A database is a directory holding the scheme and a
+  snapshot (see DataStorageSnapshot) per partition, so partitions are
+  mapped and read in place like snapshots are.
+
+  Partitions that a load filter rules out by its range on the partitioned
+  field are never opened, and partitions that have expired are dropped by
+  removing their files, without reading or rewriting any rows.  Rows that
+  are put and flushed only rewrite the partitions they fall in.
+
+  @verbatim
+  scheme.json       JSON scheme (see SchemeJson)
+  2014-04.snap      rows dated in April 2014 (or 2014-04-01.snap per day)
+  undated.snap      rows without a value for the partitioned field
+  @endverbatim
+  */
+  class DataStoragePartitioned : public IDataStorage
+  {
+  public:
+    /**
+      Load the partitions of an existing database directory, read through
+      pool if one is given (see DataStorageSnapshot::Load)
+    */
+    static DatabasePtrH Load(const char* existingDbDirectory,
+      BufferPoolPtrH pool = BufferPoolPtrH());
+
+    /** Open an existing database directory, without loading any rows */
+    static DataStoragePartitionedPtrH Open(const char* existingDbDirectory,
+      BufferPoolPtrH pool = BufferPoolPtrH());
+
+    /**
+      A new, empty database in directory, which is created if needed.
+      scheme must have a partitioned field.
+    */
+    static DatabasePtrH Create(ISchemeConstPtrH scheme, const char* newDbDirectory);
+
+    /** True if path is a partitioned database directory */
+    static bool IsPartitioned(const char* path);
+
+    /** True if scheme has a partitioned field, so can be stored partitioned */
+    static bool IsPartitioned(const IScheme& scheme);
+
+    ISchemeConstPtrH getScheme();
+
+    /**
+      Attach the rows of every partition that filter may match, in
+      partition order.  Rows are read in place, so fields aren't needed.
+    */
+    void load(Database* database, IFieldDescriptorConstListConstPtrH fields,
+      const Predicate* filter);
+
+    void beginPersist();
+    void persistRow(const IRow* row);
+
+    /**
+      Write a snapshot per partition that has rows, and remove the
+      partitions that no longer do.
+    */
+    void endPersist();
+
+    /**
+      Queue row for the partition its date falls in.  Nothing is read or
+      written until flush().
+    */
+    void put(IRowConstPtrH row);
+
+    /**
+      Insert the queued rows, replacing stored rows with the same key, as
+      Database::insertBatch does.  Only the partitions that receive rows
+      are loaded and rewritten, the others are left in place.  If the
+      partitioned field isn't part of the key, a replaced row may move to
+      another partition, so all of them are loaded and rewritten.
+    */
+    void flush(size_t* pInserted = NULL, size_t* pReplaced = NULL);
+
+    /**
+      Remove the partitions that only hold dates before date, returns the
+      number of partitions removed.  Undated rows are kept.
+    */
+    size_t dropBefore(const Date& date);
+
+    /** Number of partitions stored */
+    size_t getPartitionCount() const;
+
+  private:
+    DataStoragePartitioned(const char* existingDbDirectory, BufferPoolPtrH pool);
+    DataStoragePartitioned(ISchemeConstPtrH scheme, const char* newDbDirectory);
+
+    DataStoragePartitionedImplPtrH mImpl;
+  };
+}
+
+#endif
@@ -5,6 +5,7 @@
 #include <datastore/FieldDescriptor.h>
 #include <datastore/Value.h>
 #include <datastore/PointerType.h>
+#include <vector>
 
 namespace DataStore
 {
@@ -19,6 +20,51 @@ namespace DataStore
 
   typedef PointerType<IRow>::Shared IRowPtrH;
   typedef PointerType<IRow>::SharedConst IRowConstPtrH;
+
+  /**
+    A bit of an assumption here is that the IFieldDescriptor id can be
+    used as an index into a vector of values (i.e. the id monotonically
+    increases from zero for each field in the scheme).  There should 
+    reall be some kind of contract between a scheme and database with 
+    which to establish this.
+  */
+  class Row : public IRow
+  {
+  public:
+    Row(const IFieldDescriptorConstList& fields)
+    {
+      // Reserve space for a complete row.
+      mRow.resize(fields.size());
+    }
+
+    ValueConstPtrH getValue(const IFieldDescriptor& field) const
+    {
+      if ((size_t)field.getId() < mRow.size())
+        return mRow[field.getId()];
+      else
+        return NULL;
+    }
+
+    bool setValue(const IFieldDescriptor& field, 
+      ValuePtrH value)
+    {
+      if ((size_t)field.getId() < mRow.size())
+      {
+        mRow[field.getId()] = value;
+        return true;
+      }
+      else
+      {
+        return false;
+      }
+    }
+
+  private:
+    std::vector<ValuePtrH> mRow;
+  };
+
+  typedef std::vector<IRowPtrH> IRowList;
+  typedef std::vector<IRowConstPtrH> IRowConstList;
 }
 
 #endif
@@ -0,0 +1,68 @@
+
+#ifndef __ROW_IDENTIFIER_H__
+#define __ROW_IDENTIFIER_H__
+
+#include <stddef.h>
+#include <vector>
+
+namespace DataStore
+{
+  /**
+    Identifies a row within the in-memory database, It's really just
+    a size_t...
+  */
+  class RowIdentifier
+  {
+    enum { kEmpty = -1 };
+    typedef size_t IdType;
+  public:
+
+    inline static RowIdentifier Empty()
+    {
+      return RowIdentifier();
+    }
+
+    inline RowIdentifier() :
+      mId((IdType)kEmpty)
+    {
+    }
+
+    inline RowIdentifier(const IdType& id) :
+      mId(id)
+    {
+    }
+
+    inline RowIdentifier& operator++()
+    {
+      ++mId;
+      return *this;
+    }
+
+    inline bool operator<(const IdType& id) const
+    {
+      return mId < id;
+    }
+
+    inline bool empty() const
+    {
+      return mId == (IdType)kEmpty;
+    }
+
+    inline const IdType& getId() const
+    {
+      return mId;
+    }
+
+    inline operator IdType() const
+    {
+      return mId;
+    }
+
+  private:
+    IdType mId;
+  };
+
+  typedef std::vector<RowIdentifier> RowIdentifierList;
+}
+
+#endif
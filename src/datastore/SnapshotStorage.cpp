@@ -0,0 +1,832 @@
+
+#include <datastore/SnapshotStorage.h>
+#include <datastore/JsonStorage.h>
+#include <datastore/BufferPool.h>
+#include <datastore/FileSystem.h>
+#include <datastore/ZoneMap.h>
+#include <datastore/KeyTree.h>
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include <stdio.h>
+#include <string.h>
+
+using namespace DataStore;
+
+static const char kSnapshotMagic[8] = { 'D', 'S', 'S', 'N', 'A', 'P', 0, 0 };
+static const uint32_t kSnapshotVersion = 2;
+
+// Version 1 files have no key tree, and a header without its section
+static const uint32_t kSnapshotVersionWithoutKeys = 1;
+
+// Sections start on a page of their own
+static const uint64_t kSectionAlignment = 4096;
+
+/////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////
+
+namespace DataStore
+{
+  //
+  // On-disk layout, see DataStorageSnapshot
+  //
+
+  struct SnapshotSection
+  {
+    uint64_t offset;
+    uint64_t size;
+  };
+
+  struct SnapshotColumn
+  {
+    SnapshotSection values;
+    SnapshotSection present;
+    SnapshotSection heap;
+  };
+
+  struct SnapshotHeader
+  {
+    char magic[8];
+    uint32_t version;
+    uint32_t fieldCount;
+    uint64_t rowCount;
+    uint64_t rowsPerBlock;
+    uint64_t blockCount;
+    SnapshotSection scheme;
+    SnapshotSection keyTree;
+  };
+
+  static uint64_t HeaderSizeOf(uint32_t version)
+  {
+    if (version == kSnapshotVersionWithoutKeys)
+      return sizeof(SnapshotHeader) - sizeof(SnapshotSection);
+    else
+      return sizeof(SnapshotHeader);
+  }
+
+  /** Bytes per entry in the values section of a column of type */
+  static size_t WidthOf(TypeInfo type)
+  {
+    if (type == DataStore::TypeInfo_String)
+      return sizeof(uint64_t);
+    else if (type == DataStore::TypeInfo_Date)
+      return sizeof(int64_t);
+    else if (type == DataStore::TypeInfo_Time)
+      return sizeof(uint32_t);
+    else
+      return sizeof(float);
+  }
+
+  static uint64_t AlignSection(uint64_t offset)
+  {
+    return (offset + kSectionAlignment - 1) / kSectionAlignment * kSectionAlignment;
+  }
+
+  /////////////////////////////////////////////////////////////////////
+  /////////////////////////////////////////////////////////////////////
+
+  /**
+    Collects the values of one column, as they will be laid out on disk
+  */
+  class SnapshotColumnBuilder
+  {
+  public:
+    SnapshotColumnBuilder(TypeInfo type) :
+      mType(type),
+      mCount(0)
+    {
+    }
+
+    /** Append the value of the next row, NULL if it has none */
+    void append(const Value* value)
+    {
+      if (mCount % 8 == 0)
+      {
+        mPresent.push_back(0);
+      }
+      if (value != NULL)
+      {
+        mPresent.back() |= (uint8_t)(1 << (mCount % 8));
+      }
+      ++mCount;
+
+      if (mType == DataStore::TypeInfo_String)
+      {
+        mStd::mString text;
+        if (value != NULL)
+        {
+          value->getValue().convertTo(&text);
+        }
+
+        appendValue((uint64_t)mHeap.size());
+        mHeap.insert(mHeap.end(), text.c_str(), text.c_str() + strlen(text.c_str()) + 1);
+      }
+      else if (mType == DataStore::TypeInfo_Date)
+      {
+        Date date;
+        if (value != NULL)
+        {
+          value->getValue().convertTo(&date);
+        }
+        appendValue(date.getEncoded());
+      }
+      else if (mType == DataStore::TypeInfo_Time)
+      {
+        Time time;
+        if (value != NULL)
+        {
+          value->getValue().convertTo(&time);
+        }
+        appendValue(time.getEncoded());
+      }
+      else
+      {
+        float number = 0.0f;
+        if (value != NULL)
+        {
+          value->getValue().convertTo(&number);
+        }
+        appendValue(number);
+      }
+    }
+
+    /** Assign the sections of the column, starting at offset */
+    uint64_t layout(uint64_t offset, SnapshotColumn* outColumn) const
+    {
+      offset = layoutSection(offset, mValues.size(), &outColumn->values);
+      offset = layoutSection(offset, mPresent.size(), &outColumn->present);
+      return layoutSection(offset, mHeap.size(), &outColumn->heap);
+    }
+
+    const std::vector<char>& getValues() const { return mValues; }
+    const std::vector<uint8_t>& getPresent() const { return mPresent; }
+    const std::vector<char>& getHeap() const { return mHeap; }
+
+  private:
+    /** Empty sections take no space, so they don't pad the file */
+    static uint64_t layoutSection(uint64_t offset, size_t size, SnapshotSection* outSection)
+    {
+      outSection->offset = size > 0 ? AlignSection(offset) : offset;
+      outSection->size = size;
+      return outSection->offset + outSection->size;
+    }
+
+    template <typename T>
+    void appendValue(T value)
+    {
+      const char* bytes = (const char*)&value;
+      mValues.insert(mValues.end(), bytes, bytes + sizeof(value));
+    }
+
+    TypeInfo mType;
+    size_t mCount;
+    std::vector<char> mValues;
+    std::vector<uint8_t> mPresent;
+    std::vector<char> mHeap;
+  };
+
+  typedef std::vector<SnapshotColumnBuilder> SnapshotColumnBuilderList;
+
+  /////////////////////////////////////////////////////////////////////
+  /////////////////////////////////////////////////////////////////////
+
+  /**
+    Writes sections to a file, padding up to their offsets
+  */
+  class SnapshotFileWriter
+  {
+  public:
+    SnapshotFileWriter(const std::string& filename) :
+      mFilename(filename),
+      mOffset(0)
+    {
+      mFile = fopen(filename.c_str(), "wb");
+      if (!mFile)
+      {
+        std::string ex = "Unable to open snapshot \"" + filename + "\"";
+        throw std::runtime_error(ex);
+      }
+    }
+
+    ~SnapshotFileWriter()
+    {
+      if (mFile)
+      {
+        fclose(mFile);
+      }
+    }
+
+    void write(uint64_t offset, const void* data, size_t size)
+    {
+      static const char kPadding[256] = { 0 };
+
+      while (mOffset < offset)
+      {
+        size_t padding = (size_t)std::min<uint64_t>(offset - mOffset, sizeof(kPadding));
+        put(kPadding, padding);
+      }
+
+      put(data, size);
+    }
+
+    void close()
+    {
+      int closed = fclose(mFile);
+      mFile = NULL;
+
+      if (closed != 0)
+      {
+        throwWriteError();
+      }
+    }
+
+  private:
+    void put(const void* data, size_t size)
+    {
+      if (size > 0 && fwrite(data, 1, size, mFile) != size)
+      {
+        throwWriteError();
+      }
+      mOffset += size;
+    }
+
+    void throwWriteError() const
+    {
+      std::string ex = "Unable to write snapshot \"" + mFilename + "\"";
+      throw std::runtime_error(ex);
+    }
+
+    std::string mFilename;
+    FILE* mFile;
+    uint64_t mOffset;
+  };
+
+  /////////////////////////////////////////////////////////////////////
+  /////////////////////////////////////////////////////////////////////
+
+  class SnapshotRows;
+  typedef PointerType<SnapshotRows>::SharedConst SnapshotRowsConstPtrH;
+
+  /**
+    A row of a mapped snapshot.  Values are decoded each time they are
+    read, and can't be changed.
+  */
+  class SnapshotRow : public IRow
+  {
+  public:
+    SnapshotRow(SnapshotRowsConstPtrH rows, size_t position) :
+      mRows(rows),
+      mPosition(position)
+    {
+    }
+
+    ValueConstPtrH getValue(const IFieldDescriptor& field) const;
+
+    bool setValue(const IFieldDescriptor& /*field*/, ValuePtrH /*value*/)
+    {
+      return false;
+    }
+
+  private:
+    SnapshotRowsConstPtrH mRows;
+    size_t mPosition;
+  };
+
+  /**
+    The rows of a mapped snapshot file
+  */
+  class SnapshotRows : public IRowSource,
+    public std::enable_shared_from_this<SnapshotRows>
+  {
+  public:
+    /**
+      Open filename, read through pool or mapped if pool is NULL, and check
+      that its sections lie within the file
+    */
+    SnapshotRows(const char* filename, BufferPoolPtrH pool) :
+      mFile(new PagedFile(filename, pool)),
+      mFilename(filename)
+    {
+      // The version comes first, the size of the header depends on it
+      memset(&mHeader, 0, sizeof(mHeader));
+      if (mFile->getSize() < HeaderSizeOf(kSnapshotVersionWithoutKeys))
+      {
+        throwInvalid("truncated header");
+      }
+
+      mFile->read(0, &mHeader, (size_t)HeaderSizeOf(kSnapshotVersionWithoutKeys));
+      if (memcmp(mHeader.magic, kSnapshotMagic, sizeof(kSnapshotMagic)) != 0)
+      {
+        throwInvalid("not a snapshot");
+      }
+      if (mHeader.version != kSnapshotVersion && mHeader.version != kSnapshotVersionWithoutKeys)
+      {
+        throwInvalid("unsupported version");
+      }
+
+      uint64_t headerSize = HeaderSizeOf(mHeader.version);
+      if (mFile->getSize() < headerSize)
+      {
+        throwInvalid("truncated header");
+      }
+      mFile->read(0, &mHeader, (size_t)headerSize);
+
+      uint64_t directorySize = (uint64_t)mHeader.fieldCount * 3 * sizeof(SnapshotColumn);
+      if (!contains(headerSize, directorySize) ||
+        !contains(mHeader.scheme.offset, mHeader.scheme.size))
+      {
+        throwInvalid("truncated directory");
+      }
+
+      mColumns.resize(mHeader.fieldCount * 3);
+      if (!mColumns.empty())
+      {
+        mFile->read(headerSize, &mColumns[0], mColumns.size() * sizeof(SnapshotColumn));
+      }
+
+      std::string schemeJson((size_t)mHeader.scheme.size, '\0');
+      if (!schemeJson.empty())
+      {
+        mFile->read(mHeader.scheme.offset, &schemeJson[0], schemeJson.size());
+      }
+      mScheme = SchemeJsonPtrH(new SchemeJson(schemeJson.c_str()));
+      mKeyFields = mScheme->getKeyFieldDescriptors();
+
+      IFieldDescriptorConstListConstPtrH fields = mScheme->getFieldDescriptors();
+      if (fields->size() != mHeader.fieldCount)
+      {
+        throwInvalid("scheme does not match columns");
+      }
+
+      for (IFieldDescriptorConstList::const_iterator field = fields->cbegin();
+        field != fields->cend(); ++field)
+      {
+        mTypes.push_back((*field)->getType());
+      }
+
+      // Scans visit only the stored blocks, so none may be missing
+      if (mHeader.rowsPerBlock == 0 ||
+        mHeader.blockCount != mHeader.rowCount / mHeader.rowsPerBlock +
+          (mHeader.rowCount % mHeader.rowsPerBlock != 0 ? 1 : 0))
+      {
+        throwInvalid("block count does not match rows");
+      }
+
+      for (size_t column = 0; column < mTypes.size() * 3; ++column)
+      {
+        checkColumn(column);
+      }
+
+      // Without keys that fit the tree there is none
+      if (mHeader.keyTree.size > 0)
+      {
+        if (!contains(mHeader.keyTree.offset, mHeader.keyTree.size))
+        {
+          throwInvalid("truncated key tree");
+        }
+        mKeyTree = KeyTreePtrH(new KeyTree(mFile, mHeader.keyTree.offset, mHeader.keyTree.size));
+      }
+    }
+
+    SchemeJsonConstPtrH getScheme() const
+    {
+      return mScheme;
+    }
+
+    size_t getRowCount() const
+    {
+      return (size_t)mHeader.rowCount;
+    }
+
+    IRowConstPtrH getRow(size_t position) const
+    {
+      return std::make_shared<SnapshotRow>(shared_from_this(), position);
+    }
+
+    bool getZones(ZoneMap* outZones) const
+    {
+      if (mHeader.rowsPerBlock != ZoneMap::kRowsPerBlock)
+      {
+        return false;
+      }
+
+      size_t fieldCount = mTypes.size();
+      for (size_t block = 0; block < mHeader.blockCount; ++block)
+      {
+        ZoneList zones(fieldCount);
+        for (size_t field = 0; field < fieldCount; ++field)
+        {
+          zones[field].min = getValue(fieldCount + field, block);
+          zones[field].max = getValue(fieldCount * 2 + field, block);
+        }
+
+        outZones->setZones(block, zones);
+      }
+
+      return true;
+    }
+
+    bool findKey(const IRow& key, size_t* outPosition) const
+    {
+      if (!mKeyTree)
+      {
+        // An empty snapshot holds no key, otherwise its keys weren't stored
+        *outPosition = 0;
+        return mHeader.rowCount == 0;
+      }
+
+      uint64_t position = 0;
+      if (!mKeyTree->find(KeyTree::EncodeKey(*mKeyFields, key), &position) ||
+        position >= mHeader.rowCount)
+      {
+        position = mHeader.rowCount;
+      }
+
+      *outPosition = (size_t)position;
+      return true;
+    }
+
+    /** Decode entry position of column, NULL if it has no value */
+    ValuePtrH getValue(size_t column, size_t position) const
+    {
+      const char* data = mFile->getMappedData();
+      const SnapshotColumn& sections = mColumns[column];
+
+      uint8_t present = 0;
+      mFile->read(sections.present.offset + position / 8, &present, sizeof(present));
+      if ((present & (1 << (position % 8))) == 0)
+      {
+        return NULL;
+      }
+
+      // Read the entry through the pool, unless the file is mapped
+      TypeInfo type = mTypes[column % mTypes.size()];
+      char value[sizeof(uint64_t)];
+      mFile->read(sections.values.offset + position * WidthOf(type), value, WidthOf(type));
+
+      if (type == DataStore::TypeInfo_String)
+      {
+        uint64_t offset = 0;
+        memcpy(&offset, value, sizeof(offset));
+        if (offset >= sections.heap.size)
+        {
+          throwInvalid("text offset out of range");
+        }
+
+        if (data != NULL)
+        {
+          mStd::mString text(data + sections.heap.offset + offset);
+          return ValuePtrH(new Value(text));
+        }
+
+        // mString doesn't copy, so the text has to outlive it
+        std::string stored = mFile->readText(sections.heap.offset + offset);
+        mStd::mString text(stored.c_str());
+        return ValuePtrH(new Value(text));
+      }
+      else if (type == DataStore::TypeInfo_Date)
+      {
+        int64_t encoded = 0;
+        memcpy(&encoded, value, sizeof(encoded));
+        Date date = Date::FromEncoded(encoded);
+        return ValuePtrH(new Value(date));
+      }
+      else if (type == DataStore::TypeInfo_Time)
+      {
+        uint32_t encoded = 0;
+        memcpy(&encoded, value, sizeof(encoded));
+        Time time = Time::FromEncoded(encoded);
+        return ValuePtrH(new Value(time));
+      }
+      else
+      {
+        float number = 0.0f;
+        memcpy(&number, value, sizeof(number));
+        return ValuePtrH(new Value(number));
+      }
+    }
+
+  private:
+    bool contains(uint64_t offset, uint64_t size) const
+    {
+      return offset <= mFile->getSize() && size <= mFile->getSize() - offset;
+    }
+
+    /** Throw unless the sections of column hold all of its entries */
+    void checkColumn(size_t column) const
+    {
+      const SnapshotColumn& sections = mColumns[column];
+      TypeInfo type = mTypes[column % mTypes.size()];
+      uint64_t count = column < mTypes.size() ? mHeader.rowCount : mHeader.blockCount;
+
+      if (sections.values.size != count * WidthOf(type) ||
+        sections.present.size != (count + 7) / 8 ||
+        !contains(sections.values.offset, sections.values.size) ||
+        !contains(sections.present.offset, sections.present.size) ||
+        !contains(sections.heap.offset, sections.heap.size))
+      {
+        throwInvalid("truncated column");
+      }
+
+      // Strings must not run off the end of the heap
+      char last = '\0';
+      if (sections.heap.size > 0)
+      {
+        mFile->read(sections.heap.offset + sections.heap.size - 1, &last, sizeof(last));
+      }
+      if (last != '\0')
+      {
+        throwInvalid("unterminated text");
+      }
+    }
+
+    void throwInvalid(const char* reason) const
+    {
+      std::string ex = "Invalid snapshot \"" + mFilename + "\": " + reason;
+      throw std::runtime_error(ex);
+    }
+
+    PagedFilePtrH mFile;
+    std::string mFilename;
+    SnapshotHeader mHeader;
+    std::vector<SnapshotColumn> mColumns;
+    SchemeJsonPtrH mScheme;
+    IFieldDescriptorConstListConstPtrH mKeyFields;
+    KeyTreePtrH mKeyTree;
+    std::vector<TypeInfo> mTypes;
+  };
+
+  typedef PointerType<SnapshotRows>::Shared SnapshotRowsPtrH;
+
+  ValueConstPtrH SnapshotRow::getValue(const IFieldDescriptor& field) const
+  {
+    return mRows->getValue(field.getId(), mPosition);
+  }
+
+  /////////////////////////////////////////////////////////////////////
+  /////////////////////////////////////////////////////////////////////
+
+  /**
+  */
+  class DataStorageSnapshotImpl
+  {
+  public:
+    DataStorageSnapshotImpl(const char* snapshotFilename, BufferPoolPtrH pool) :
+      mFilename(snapshotFilename),
+      mRows(new SnapshotRows(snapshotFilename, pool)),
+      mPersistedRowCount(0)
+    {
+      mScheme = mRows->getScheme();
+    }
+
+    DataStorageSnapshotImpl(ISchemeConstPtrH scheme, const char* newSnapshotFilename) :
+      mScheme(scheme),
+      mFilename(newSnapshotFilename),
+      mPersistedRowCount(0)
+    {
+      // This will be a new snapshot
+    }
+
+    ISchemeConstPtrH getScheme() const
+    {
+      return mScheme;
+    }
+
+    IRowSourcePtrH getRows() const
+    {
+      return mRows;
+    }
+
+    void load(Database* database)
+    {
+      if (mRows)
+      {
+        database->attach(mRows);
+      }
+    }
+
+    /**
+      Columns are collected in memory as rows are persisted, the file is
+      only written once their sizes are known.
+    */
+    void beginPersist()
+    {
+      IFieldDescriptorConstListConstPtrH fields = mScheme->getFieldDescriptors();
+
+      mPersistedColumns.clear();
+      for (IFieldDescriptorConstList::const_iterator field = fields->cbegin();
+        field != fields->cend(); ++field)
+      {
+        mPersistedColumns.push_back(SnapshotColumnBuilder((*field)->getType()));
+      }
+
+      mPersistedZones = ZoneMapPtrH(new ZoneMap(fields->size()));
+      mPersistedKeys.clear();
+      mPersistedRowCount = 0;
+    }
+
+    void persistRow(const IRow* row)
+    {
+      IFieldDescriptorConstListConstPtrH fields = mScheme->getFieldDescriptors();
+
+      for (IFieldDescriptorConstList::const_iterator field = fields->cbegin();
+        field != fields->cend(); ++field)
+      {
+        ValueConstPtrH value = row->getValue(**field);
+        mPersistedColumns[(*field)->getId()].append(value.get());
+      }
+
+      mPersistedKeys.push_back(KeyTree::Entry(
+        KeyTree::EncodeKey(*mScheme->getKeyFieldDescriptors(), *row), mPersistedRowCount));
+
+      mPersistedZones->update(mPersistedRowCount++, *row, *fields);
+    }
+
+    void endPersist()
+    {
+      IFieldDescriptorConstListConstPtrH fields = mScheme->getFieldDescriptors();
+      size_t fieldCount = fields->size();
+
+      // Zone min columns, then zone max columns, follow the field columns
+      SnapshotColumnBuilderList columns(mPersistedColumns);
+      for (size_t pass = 0; pass < 2; ++pass)
+      {
+        for (IFieldDescriptorConstList::const_iterator field = fields->cbegin();
+          field != fields->cend(); ++field)
+        {
+          SnapshotColumnBuilder zoneColumn((*field)->getType());
+          for (size_t block = 0; block < mPersistedZones->getBlockCount(); ++block)
+          {
+            const Zone& zone = mPersistedZones->getZones(block)[(*field)->getId()];
+            zoneColumn.append(pass == 0 ? zone.min.get() : zone.max.get());
+          }
+          columns.push_back(zoneColumn);
+        }
+      }
+
+      //
+      // Lay out the file, then write it front to back
+      //
+
+      std::string schemeJson = SchemeJson::ToJson(*mScheme);
+
+      std::vector<char> keyTree;
+      KeyTree::Build(&mPersistedKeys, &keyTree);
+      mPersistedKeys.clear();
+
+      SnapshotHeader header;
+      memset(&header, 0, sizeof(header));
+      memcpy(header.magic, kSnapshotMagic, sizeof(kSnapshotMagic));
+      header.version = kSnapshotVersion;
+      header.fieldCount = (uint32_t)fieldCount;
+      header.rowCount = mPersistedRowCount;
+      header.rowsPerBlock = ZoneMap::kRowsPerBlock;
+      header.blockCount = mPersistedZones->getBlockCount();
+      header.scheme.offset = sizeof(SnapshotHeader) + columns.size() * sizeof(SnapshotColumn);
+      header.scheme.size = schemeJson.size();
+
+      std::vector<SnapshotColumn> directory(columns.size());
+      uint64_t offset = header.scheme.offset + header.scheme.size;
+      for (size_t column = 0; column < columns.size(); ++column)
+      {
+        offset = columns[column].layout(offset, &directory[column]);
+      }
+
+      header.keyTree.offset = keyTree.empty() ? offset : AlignSection(offset);
+      header.keyTree.size = keyTree.size();
+
+      std::string temporaryFilename = mFilename + ".tmp";
+      {
+        SnapshotFileWriter file(temporaryFilename);
+        file.write(0, &header, sizeof(header));
+        file.write(sizeof(header), &directory[0], directory.size() * sizeof(SnapshotColumn));
+        file.write(header.scheme.offset, schemeJson.c_str(), schemeJson.size());
+
+        for (size_t column = 0; column < columns.size(); ++column)
+        {
+          const SnapshotColumnBuilder& builder = columns[column];
+          const SnapshotColumn& sections = directory[column];
+
+          if (!builder.getValues().empty())
+            file.write(sections.values.offset, &builder.getValues()[0], builder.getValues().size());
+          if (!builder.getPresent().empty())
+            file.write(sections.present.offset, &builder.getPresent()[0], builder.getPresent().size());
+          if (!builder.getHeap().empty())
+            file.write(sections.heap.offset, &builder.getHeap()[0], builder.getHeap().size());
+        }
+
+        if (!keyTree.empty())
+          file.write(header.keyTree.offset, &keyTree[0], keyTree.size());
+
+        file.close();
+      }
+
+      replaceFile(temporaryFilename);
+
+      mPersistedColumns.clear();
+      mPersistedZones.reset();
+    }
+
+  private:
+    /** Rename filename over the snapshot */
+    void replaceFile(const std::string& filename) const
+    {
+      if (!FileSystem::ReplaceFile(filename, mFilename))
+      {
+        remove(filename.c_str());
+        std::string ex = "Unable to replace snapshot \"" + mFilename + "\"";
+        throw std::runtime_error(ex);
+      }
+    }
+
+    ISchemeConstPtrH mScheme;
+    std::string mFilename;
+    SnapshotRowsPtrH mRows;
+
+    SnapshotColumnBuilderList mPersistedColumns;
+    ZoneMapPtrH mPersistedZones;
+    KeyTree::EntryList mPersistedKeys;
+    size_t mPersistedRowCount;
+  };
+}
+
+/////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////
+
+DatabasePtrH DataStorageSnapshot::Load(const char* snapshotFilename, BufferPoolPtrH pool)
+{
+  IDataStoragePtrH existingStoragePtrH(new DataStorageSnapshot(snapshotFilename, pool));
+  DatabasePtrH db(new Database(existingStoragePtrH));
+  return db;
+}
+
+DataStorageSnapshotPtrH DataStorageSnapshot::Open(const char* snapshotFilename,
+  BufferPoolPtrH pool)
+{
+  return DataStorageSnapshotPtrH(new DataStorageSnapshot(snapshotFilename, pool));
+}
+
+DataStorageSnapshotPtrH DataStorageSnapshot::Create(ISchemeConstPtrH scheme,
+  const char* newSnapshotFilename)
+{
+  return DataStorageSnapshotPtrH(new DataStorageSnapshot(scheme, newSnapshotFilename));
+}
+
+bool DataStorageSnapshot::IsSnapshot(const char* filename)
+{
+  FILE* file = fopen(filename, "rb");
+  if (!file)
+  {
+    return false;
+  }
+
+  char magic[sizeof(kSnapshotMagic)];
+  bool isSnapshot = fread(magic, 1, sizeof(magic), file) == sizeof(magic) &&
+    memcmp(magic, kSnapshotMagic, sizeof(magic)) == 0;
+
+  fclose(file);
+  return isSnapshot;
+}
+
+DataStorageSnapshot::DataStorageSnapshot(const char* existingSnapshotFilename,
+  BufferPoolPtrH pool) :
+  mImpl(new DataStorageSnapshotImpl(existingSnapshotFilename, pool))
+{
+}
+
+DataStorageSnapshot::DataStorageSnapshot(ISchemeConstPtrH scheme, const char* newSnapshotFilename) :
+  mImpl(new DataStorageSnapshotImpl(scheme, newSnapshotFilename))
+{
+}
+
+ISchemeConstPtrH DataStorageSnapshot::getScheme()
+{
+  return mImpl->getScheme();
+}
+
+void DataStorageSnapshot::load(Database* database, IFieldDescriptorConstListConstPtrH /*fields*/,
+  const Predicate* /*filter*/)
+{
+  mImpl->load(database);
+}
+
+IRowSourcePtrH DataStorageSnapshot::getRows() const
+{
+  return mImpl->getRows();
+}
+
+void DataStorageSnapshot::beginPersist()
+{
+  mImpl->beginPersist();
+}
+
+void DataStorageSnapshot::persistRow(const IRow* row)
+{
+  mImpl->persistRow(row);
+}
+
+void DataStorageSnapshot::endPersist()
+{
+  mImpl->endPersist();
+}
@@ -0,0 +1,108 @@
+
+#ifndef __SNAPSHOT_STORAGE_H__
+#define __SNAPSHOT_STORAGE_H__
+
+#include <datastore/Scheme.h>
+#include <datastore/DataStorage.h>
+#include <datastore/Database.h>
+#include <datastore/BufferPool.h>
+
+namespace DataStore
+{
+  /**
+    @hidden
+    Hide the file layout from client code
+  */
+  class DataStorageSnapshotImpl;
+  typedef PointerType<DataStorageSnapshotImpl>::Shared DataStorageSnapshotImplPtrH;
+
+  class DataStorageSnapshot;
+  typedef PointerType<DataStorageSnapshot>::Shared DataStorageSnapshotPtrH;
+
+  /**
+  An IDataStorage implementation whose file layout is the layout the rows
+  are read in, so nothing has to be parsed.  The file is mapped into memory
+  when it is loaded, and rows are served in place (see Database::attach),
+  so loading takes the same time regardless of size.  Each column starts on
+  its own page, and only the pages of the columns a query touches are read
+  from disk.  To bound the memory used for the pages, a snapshot can be
+  read through a BufferPool instead.
+
+  All integers are in the byte order of the machine that wrote the file.
+
+  @verbatim
+  header:     magic "DSSNAP", version, field count, row count,
+              zone block size and count, scheme section, key tree section
+  directory:  a column per field, then a zone min column and a zone max
+              column per field (one entry per block of rows)
+  scheme:     JSON scheme text (see SchemeJson)
+  columns:    per column, page aligned sections of
+                values:  fixed width array, one entry per row
+                         text:  64 bit offset into the heap
+                         date:  64 bit seconds since the epoch
+                         time:  32 bit encoded time
+                         float: 32 bit float
+                present: bitmap, one bit per row, clear if the row has no value
+                heap:    nul terminated strings, text columns only
+  key tree:   page aligned B+tree from each row's key to its position (see
+              KeyTree), empty if a key is too large
+  @endverbatim
+
+  Version 1 snapshots, which have no key tree and no key tree section in
+  their header, can still be read.
+  */
+  class DataStorageSnapshot : public IDataStorage
+  {
+  public:
+    /**
+      Map an existing snapshot into a new database, or read it through
+      pool if one is given
+    */
+    static DatabasePtrH Load(const char* existingSnapshotFilename,
+      BufferPoolPtrH pool = BufferPoolPtrH());
+
+    /** Open an existing snapshot, without loading it into a database */
+    static DataStorageSnapshotPtrH Open(const char* existingSnapshotFilename,
+      BufferPoolPtrH pool = BufferPoolPtrH());
+
+    /**
+      Storage for a new snapshot of rows with scheme.  The file is written
+      by the persist calls.
+    */
+    static DataStorageSnapshotPtrH Create(ISchemeConstPtrH scheme,
+      const char* newSnapshotFilename);
+
+    /** True if filename holds a snapshot, as opposed to e.g. JSON */
+    static bool IsSnapshot(const char* filename);
+
+    ISchemeConstPtrH getScheme();
+
+    /** 
+      Rows are read in place, so only the columns that are used are read.
+      The filter isn't needed, queries skip blocks with the stored zones
+      and find the row of a key with the key tree.
+    */
+    void load(Database* database, IFieldDescriptorConstListConstPtrH fields,
+      const Predicate* filter);
+
+    /** The rows of an existing snapshot, read in place.  NULL if new. */
+    IRowSourcePtrH getRows() const;
+
+    void beginPersist();
+    void persistRow(const IRow* row);
+
+    /**
+      Write the file.  It's written alongside and then renamed over the
+      existing snapshot, whose rows may still be mapped.
+    */
+    void endPersist();
+
+  private:
+    DataStorageSnapshot(const char* existingSnapshotFilename, BufferPoolPtrH pool);
+    DataStorageSnapshot(ISchemeConstPtrH scheme, const char* newSnapshotFilename);
+
+    DataStorageSnapshotImplPtrH mImpl;
+  };
+}
+
+#endif
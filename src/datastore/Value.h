@@ -3,10 +3,63 @@
 #define __VALUE_H__
 
 #include <Resource/Variant.h>
+#include <Resource/mString.h>
 #include <datastore/PointerType.h>
+#include <string.h>
 
 namespace DataStore
 {
+  //
+  // Hash functions for the types that can be held by a Value.  Types
+  // defined by the datastore (Date, Time) provide their own hash().
+  //
+
+  inline size_t HashOf(const char* str)
+  {
+    // FNV-1a
+    size_t hash = (size_t)2166136261U;
+    for (const unsigned char* c = (const unsigned char*)str; *c != 0; ++c)
+    {
+      hash = (hash ^ *c) * (size_t)16777619U;
+    }
+    return hash;
+  }
+
+  inline size_t HashOf(const mStd::mString& str)
+  {
+    return HashOf(str.c_str());
+  }
+
+  inline size_t HashOf(float f)
+  {
+    // +0.0 and -0.0 compare equal, make them hash equal too
+    if (f == 0.0f)
+      return 0;
+
+    size_t hash = 0;
+    memcpy(&hash, &f, sizeof(f) < sizeof(hash) ? sizeof(f) : sizeof(hash));
+    return hash;
+  }
+
+  inline size_t HashOf(const mStd::Variant& v)
+  {
+    // Slow path, only taken when the held type is not known up front
+    // (floats parsed by mStd::Variant)
+    float f = 0.0f;
+    if (v.convertTo(&f))
+      return HashOf(f);
+
+    mStd::mString str;
+    v.convertTo(&str);
+    return HashOf(str);
+  }
+
+  template <typename T>
+  inline size_t HashOf(const T& v)
+  {
+    return v.hash();
+  }
+
   /**
     The generic container that holds values within a database.  There is
     no real distinction between this object and an mStd::Variant.
@@ -15,13 +68,15 @@ namespace DataStore
   {
   public:
     Value(const mStd::Variant& v) :
-      mValue(v)
+      mValue(v),
+      mHash(HashOf(v))
     {
     }
 
     template<typename T>
     Value(T& v) :
-      mValue(v)
+      mValue(v),
+      mHash(HashOf(v))
     {
     }
 
@@ -30,6 +85,12 @@ namespace DataStore
       return mValue;
     }
 
+    /** Equal values have equal hashes */
+    size_t hash() const
+    {
+      return mHash;
+    }
+
     bool operator==(const Value& other) const
     {
       return mValue == other.mValue;
@@ -52,6 +113,7 @@ namespace DataStore
 
   private:
     mStd::Variant mValue;
+    size_t mHash;
   };
 
   typedef PointerType<Value>::Shared ValuePtrH;
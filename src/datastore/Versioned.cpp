@@ -0,0 +1,22 @@
+#include <datastore/Versioned.h>
+#include <atomic>
+
+using namespace DataStore;
+
+static std::atomic<uint64_t> gNextStamp(1);
+static std::atomic<uint64_t> gCopiedNodes(0);
+
+uint64_t Versioned::NewStamp()
+{
+  return gNextStamp++;
+}
+
+uint64_t Versioned::GetCopiedNodes()
+{
+  return gCopiedNodes;
+}
+
+void Versioned::CountCopiedNode()
+{
+  ++gCopiedNodes;
+}
@@ -0,0 +1,530 @@
+#ifndef __VERSIONED_H__
+#define __VERSIONED_H__
+
+#include <datastore/PointerType.h>
+#include <algorithm>
+#include <functional>
+#include <vector>
+#include <stddef.h>
+#include <stdint.h>
+
+namespace DataStore
+{
+  /**
+    Stamps of the copy-on-write containers below, which keep their
+    elements in trees of nodes that copies share.  Each node carries the
+    stamp of the container that made it, and only that container changes
+    it in place, any other copies it first.  Copying a container gives
+    both the copy and the original a new stamp, so neither changes a node
+    the other can see.
+
+    A version of a database is such a copy, its writer changes only the
+    nodes on the paths to the elements it writes.  The versions readers
+    hold are never changed, so they read without locks.  A container
+    mustn't be copied while another thread copies or changes it.
+  */
+  class Versioned
+  {
+  public:
+    /** A stamp that no container has had */
+    static uint64_t NewStamp();
+
+    /** Nodes copied so far by the writes of every container */
+    static uint64_t GetCopiedNodes();
+
+    /** Count a node copied by a write */
+    static void CountCopiedNode();
+
+  private:
+    Versioned();
+  };
+
+  /**
+    A vector that shares its elements with its copies until it changes
+    them.  Elements are kept in leaves of 2^kLeafBits, under branches of
+    2^kBranchBits, so that changing or appending an element copies at
+    most a leaf and the branches above it.
+  */
+  template <typename T, size_t kLeafBits = 6>
+  class VersionedVector
+  {
+    enum
+    {
+      kBranchBits = 6,
+      kLeafMask = (1 << kLeafBits) - 1,
+      kBranchMask = (1 << kBranchBits) - 1
+    };
+
+    struct Node
+    {
+      uint64_t stamp;
+      /** Elements of a leaf */
+      std::vector<T> values;
+      /** Nodes under a branch */
+      std::vector<typename PointerType<Node>::Shared> children;
+    };
+
+    typedef typename PointerType<Node>::Shared NodePtrH;
+
+  public:
+    VersionedVector() :
+      mSize(0),
+      mDepth(0),
+      mStamp(Versioned::NewStamp())
+    {
+    }
+
+    VersionedVector(const VersionedVector& other) :
+      mRoot(other.mRoot),
+      mSize(other.mSize),
+      mDepth(other.mDepth),
+      mStamp(Versioned::NewStamp())
+    {
+      other.mStamp = Versioned::NewStamp();
+    }
+
+    VersionedVector& operator=(const VersionedVector& other)
+    {
+      if (this != &other)
+      {
+        mRoot = other.mRoot;
+        mSize = other.mSize;
+        mDepth = other.mDepth;
+        mStamp = Versioned::NewStamp();
+        other.mStamp = Versioned::NewStamp();
+      }
+
+      return *this;
+    }
+
+    size_t size() const { return mSize; }
+    bool empty() const { return mSize == 0; }
+
+    const T& operator[](size_t index) const
+    {
+      const Node* node = mRoot.get();
+      for (size_t level = mDepth; level > 0; --level)
+      {
+        node = node->children[ChildOf(index, level)].get();
+      }
+
+      return node->values[index & kLeafMask];
+    }
+
+    /** The element at index to change, copying its leaf if it's shared */
+    T& modify(size_t index)
+    {
+      Node* node = own(&mRoot);
+      for (size_t level = mDepth; level > 0; --level)
+      {
+        node = own(&node->children[ChildOf(index, level)]);
+      }
+
+      return node->values[index & kLeafMask];
+    }
+
+    void push_back(const T& value)
+    {
+      if (!mRoot)
+      {
+        mRoot = newNode();
+      }
+      else if (mSize == Capacity(mDepth))
+      {
+        NodePtrH root = newNode();
+        root->children.push_back(mRoot);
+        mRoot = root;
+        ++mDepth;
+      }
+
+      Node* node = own(&mRoot);
+      for (size_t level = mDepth; level > 0; --level)
+      {
+        size_t child = ChildOf(mSize, level);
+        if (child == node->children.size())
+        {
+          node->children.push_back(newNode());
+        }
+        node = own(&node->children[child]);
+      }
+
+      node->values.push_back(value);
+      ++mSize;
+    }
+
+    void clear()
+    {
+      mRoot.reset();
+      mSize = 0;
+      mDepth = 0;
+    }
+
+    void swap(VersionedVector& other)
+    {
+      std::swap(mRoot, other.mRoot);
+      std::swap(mSize, other.mSize);
+      std::swap(mDepth, other.mDepth);
+      std::swap(mStamp, other.mStamp);
+    }
+
+  private:
+    /** Elements that fit under a root depth levels above the leaves */
+    static size_t Capacity(size_t depth)
+    {
+      return (size_t)1 << (kLeafBits + depth * kBranchBits);
+    }
+
+    /** The child of a branch level levels above the leaves, that holds index */
+    static size_t ChildOf(size_t index, size_t level)
+    {
+      return (index >> (kLeafBits + (level - 1) * kBranchBits)) & kBranchMask;
+    }
+
+    NodePtrH newNode() const
+    {
+      NodePtrH node(new Node());
+      node->stamp = mStamp;
+      return node;
+    }
+
+    /** *node, replaced by a copy first unless this container made it */
+    Node* own(NodePtrH* node) const
+    {
+      if ((*node)->stamp != mStamp)
+      {
+        *node = NodePtrH(new Node(**node));
+        (*node)->stamp = mStamp;
+        Versioned::CountCopiedNode();
+      }
+
+      return node->get();
+    }
+
+    NodePtrH mRoot;
+    size_t mSize;
+    /** Levels of branches above the leaves */
+    size_t mDepth;
+    mutable uint64_t mStamp;
+  };
+
+  /**
+    A sorted map that shares its entries with its copies until it changes
+    them.  A B+tree of nodes of up to kNodeSize entries, so that changing,
+    adding or erasing an entry copies at most a leaf and the branches
+    above it.  Full nodes are split, but nodes aren't merged as they
+    empty, a node is only dropped with its last entry.
+  */
+  template <typename Key, typename Mapped, typename Less = std::less<Key> >
+  class VersionedMap
+  {
+    enum { kNodeSize = 64 };
+
+    struct Node
+    {
+      uint64_t stamp;
+      bool isLeaf;
+      /**
+        Sorted keys of a leaf.  Those of a branch bound its children from
+        below, but the first, as keys smaller than any go to the first.
+      */
+      std::vector<Key> keys;
+      std::vector<Mapped> values;
+      std::vector<typename PointerType<Node>::Shared> children;
+    };
+
+    typedef typename PointerType<Node>::Shared NodePtrH;
+
+  public:
+    VersionedMap() :
+      mSize(0),
+      mStamp(Versioned::NewStamp())
+    {
+    }
+
+    VersionedMap(const VersionedMap& other) :
+      mRoot(other.mRoot),
+      mSize(other.mSize),
+      mStamp(Versioned::NewStamp())
+    {
+      other.mStamp = Versioned::NewStamp();
+    }
+
+    VersionedMap& operator=(const VersionedMap& other)
+    {
+      if (this != &other)
+      {
+        mRoot = other.mRoot;
+        mSize = other.mSize;
+        mStamp = Versioned::NewStamp();
+        other.mStamp = Versioned::NewStamp();
+      }
+
+      return *this;
+    }
+
+    size_t size() const { return mSize; }
+    bool empty() const { return mSize == 0; }
+
+    /**
+      The stamp of this copy of the map, for values that are shared in
+      turn (e.g. pointers) to tell whether they were made by it
+    */
+    uint64_t getStamp() const { return mStamp; }
+
+    /** The value of key, NULL if there is none */
+    const Mapped* find(const Key& key) const
+    {
+      const Node* node = mRoot.get();
+      if (!node)
+      {
+        return NULL;
+      }
+
+      while (!node->isLeaf)
+      {
+        node = node->children[childOf(*node, key)].get();
+      }
+
+      size_t entry = lowerBound(*node, key);
+      if (entry < node->keys.size() && !mLess(key, node->keys[entry]))
+      {
+        return &node->values[entry];
+      }
+
+      return NULL;
+    }
+
+    /**
+      The value of key to change, which is added with a default value if
+      there is none.  Its leaf is copied if it's shared.
+    */
+    Mapped& modify(const Key& key)
+    {
+      if (!find(key))
+      {
+        insert(key, Mapped());
+      }
+
+      Node* node = own(&mRoot);
+      while (!node->isLeaf)
+      {
+        node = own(&node->children[childOf(*node, key)]);
+      }
+
+      return node->values[lowerBound(*node, key)];
+    }
+
+    /** Add key with value, false if key is there already */
+    bool insert(const Key& key, const Mapped& value)
+    {
+      if (find(key))
+      {
+        return false;
+      }
+
+      if (!mRoot)
+      {
+        mRoot = newNode(true);
+      }
+
+      NodePtrH split = insertInto(&mRoot, key, value);
+      if (split)
+      {
+        NodePtrH root = newNode(false);
+        root->keys.push_back(mRoot->keys.front());
+        root->children.push_back(mRoot);
+        root->keys.push_back(split->keys.front());
+        root->children.push_back(split);
+        mRoot = root;
+      }
+
+      ++mSize;
+      return true;
+    }
+
+    /** False if there is no key */
+    bool erase(const Key& key)
+    {
+      if (!find(key))
+      {
+        return false;
+      }
+
+      eraseFrom(&mRoot, key);
+
+      if (mRoot->keys.empty())
+      {
+        mRoot.reset();
+      }
+      else
+      {
+        while (!mRoot->isLeaf && mRoot->children.size() == 1)
+        {
+          NodePtrH child = mRoot->children.front();
+          mRoot = child;
+        }
+      }
+
+      --mSize;
+      return true;
+    }
+
+    /**
+      Call visit(key, value) for the entries in key order, from the first
+      key not less than *first (from the smallest if first is NULL), for
+      as long as it returns true
+    */
+    template <typename Visit>
+    void visit(const Key* first, Visit visit) const
+    {
+      if (mRoot)
+      {
+        visitNode(*mRoot, first, visit);
+      }
+    }
+
+  private:
+    size_t lowerBound(const Node& node, const Key& key) const
+    {
+      return std::lower_bound(node.keys.cbegin(), node.keys.cend(), key, mLess) -
+        node.keys.cbegin();
+    }
+
+    /** The child of branch node whose keys key falls among */
+    size_t childOf(const Node& node, const Key& key) const
+    {
+      return std::upper_bound(node.keys.cbegin() + 1, node.keys.cend(), key, mLess) -
+        node.keys.cbegin() - 1;
+    }
+
+    NodePtrH newNode(bool isLeaf) const
+    {
+      NodePtrH node(new Node());
+      node->stamp = mStamp;
+      node->isLeaf = isLeaf;
+      return node;
+    }
+
+    /** *node, replaced by a copy first unless this map made it */
+    Node* own(NodePtrH* node) const
+    {
+      if ((*node)->stamp != mStamp)
+      {
+        *node = NodePtrH(new Node(**node));
+        (*node)->stamp = mStamp;
+        Versioned::CountCopiedNode();
+      }
+
+      return node->get();
+    }
+
+    /** Add key under *node, returns the upper half of *node if it split */
+    NodePtrH insertInto(NodePtrH* slot, const Key& key, const Mapped& value)
+    {
+      Node* node = own(slot);
+
+      if (node->isLeaf)
+      {
+        size_t entry = lowerBound(*node, key);
+        node->keys.insert(node->keys.begin() + entry, key);
+        node->values.insert(node->values.begin() + entry, value);
+      }
+      else
+      {
+        size_t child = childOf(*node, key);
+        NodePtrH split = insertInto(&node->children[child], key, value);
+        if (split)
+        {
+          node->keys.insert(node->keys.begin() + child + 1, split->keys.front());
+          node->children.insert(node->children.begin() + child + 1, split);
+        }
+      }
+
+      if (node->keys.size() <= kNodeSize)
+      {
+        return NodePtrH();
+      }
+
+      size_t half = node->keys.size() / 2;
+      NodePtrH upper = newNode(node->isLeaf);
+      upper->keys.assign(node->keys.begin() + half, node->keys.end());
+      node->keys.erase(node->keys.begin() + half, node->keys.end());
+
+      if (node->isLeaf)
+      {
+        upper->values.assign(node->values.begin() + half, node->values.end());
+        node->values.erase(node->values.begin() + half, node->values.end());
+      }
+      else
+      {
+        upper->children.assign(node->children.begin() + half, node->children.end());
+        node->children.erase(node->children.begin() + half, node->children.end());
+      }
+
+      return upper;
+    }
+
+    /** Take key, which is there, from under *node */
+    void eraseFrom(NodePtrH* slot, const Key& key)
+    {
+      Node* node = own(slot);
+
+      if (node->isLeaf)
+      {
+        size_t entry = lowerBound(*node, key);
+        node->keys.erase(node->keys.begin() + entry);
+        node->values.erase(node->values.begin() + entry);
+        return;
+      }
+
+      size_t child = childOf(*node, key);
+      eraseFrom(&node->children[child], key);
+
+      if (node->children[child]->keys.empty())
+      {
+        node->keys.erase(node->keys.begin() + child);
+        node->children.erase(node->children.begin() + child);
+      }
+    }
+
+    /** False once visit returned false */
+    template <typename Visit>
+    bool visitNode(const Node& node, const Key* first, Visit& visit) const
+    {
+      if (node.isLeaf)
+      {
+        for (size_t entry = first ? lowerBound(node, *first) : 0;
+          entry < node.keys.size(); ++entry)
+        {
+          if (!visit(node.keys[entry], node.values[entry]))
+          {
+            return false;
+          }
+        }
+
+        return true;
+      }
+
+      for (size_t child = first ? childOf(node, *first) : 0;
+        child < node.children.size(); ++child)
+      {
+        if (!visitNode(*node.children[child], first, visit))
+        {
+          return false;
+        }
+
+        // Every key of the next children is larger
+        first = NULL;
+      }
+
+      return true;
+    }
+
+    NodePtrH mRoot;
+    size_t mSize;
+    mutable uint64_t mStamp;
+    Less mLess;
+  };
+}
+
+#endif
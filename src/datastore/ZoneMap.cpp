@@ -0,0 +1,126 @@
+
+#include <datastore/ZoneMap.h>
+
+using namespace DataStore;
+
+/////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////
+
+void Zone::update(ValueConstPtrH value)
+{
+  if (!min || *value < *min)
+    min = value;
+  if (!max || *max < *value)
+    max = value;
+}
+
+bool Zone::contains(const Value& value) const
+{
+  return min && !(value < *min) && !(*max < value);
+}
+
+/////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////
+
+ZoneFilter::ZoneFilter(const Predicate& pred)
+{
+  IFieldDescriptorConstList touchedFields;
+  pred.getFieldDescriptors(&touchedFields);
+
+  for (IFieldDescriptorConstList::const_iterator field = touchedFields.cbegin();
+    field != touchedFields.cend(); ++field)
+  {
+    bool seen = false;
+    for (ConstraintList::const_iterator constraint = mConstraints.cbegin();
+      constraint != mConstraints.cend() && !seen; ++constraint)
+    {
+      seen = constraint->first == (*field)->getId();
+    }
+
+    ValueRange range;
+    if (!seen && pred.getRange(**field, &range))
+    {
+      mConstraints.push_back(std::make_pair((*field)->getId(), range));
+    }
+  }
+}
+
+bool ZoneFilter::mayMatch(const ZoneList& zones) const
+{
+  for (ConstraintList::const_iterator constraint = mConstraints.cbegin();
+    constraint != mConstraints.cend(); ++constraint)
+  {
+    const ValueRange& range = constraint->second;
+    if (range.isEmpty())
+      return false;
+
+    if ((size_t)constraint->first >= zones.size())
+      continue;
+
+    // A bounded field must have a value to match, so a block without 
+    // any values for it can't match either.
+    const Zone& zone = zones[constraint->first];
+    if (!zone.min || !range.overlaps(*zone.min, *zone.max))
+      return false;
+  }
+
+  return true;
+}
+
+/////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////
+
+ZoneMap::ZoneMap(size_t fieldCount) :
+  mFieldCount(fieldCount)
+{
+}
+
+void ZoneMap::update(const RowIdentifier& id, const IRow& row,
+  const IFieldDescriptorConstList& fields)
+{
+  size_t block = BlockOf(id);
+  while (block >= mBlocks.size())
+  {
+    mBlocks.push_back(ZoneList(mFieldCount));
+  }
+
+  // Most rows fall within their zones, which are then left shared
+  const ZoneList& current = mBlocks[block];
+  bool widens = false;
+  for (IFieldDescriptorConstList::const_iterator field = fields.cbegin();
+    field != fields.cend() && !widens; ++field)
+  {
+    ValueConstPtrH value = row.getValue(**field);
+    widens = value && (size_t)(*field)->getId() < current.size() &&
+      !current[(*field)->getId()].contains(*value);
+  }
+
+  if (!widens)
+  {
+    return;
+  }
+
+  ZoneList& zones = mBlocks.modify(block);
+
+  for (IFieldDescriptorConstList::const_iterator field = fields.cbegin();
+    field != fields.cend(); ++field)
+  {
+    ValueConstPtrH value = row.getValue(**field);
+    if (value && (size_t)(*field)->getId() < zones.size())
+    {
+      zones[(*field)->getId()].update(value);
+    }
+  }
+}
+
+void ZoneMap::setZones(size_t block, const ZoneList& zones)
+{
+  while (block >= mBlocks.size())
+  {
+    mBlocks.push_back(ZoneList(mFieldCount));
+  }
+
+  ZoneList& blockZones = mBlocks.modify(block);
+  blockZones = zones;
+  blockZones.resize(mFieldCount);
+}
@@ -0,0 +1,93 @@
+
+#ifndef __ZONE_MAP_H__
+#define __ZONE_MAP_H__
+
+#include <datastore/FieldDescriptor.h>
+#include <datastore/RowIdentifier.h>
+#include <datastore/Logic.h>
+#include <datastore/Row.h>
+#include <datastore/PointerType.h>
+#include <datastore/Versioned.h>
+#include <utility>
+#include <vector>
+
+namespace DataStore
+{
+  /**
+    The smallest and largest value of a field within a block of rows.
+    Both are NULL if no row in the block has a value for the field.
+  */
+  struct Zone
+  {
+    ValueConstPtrH min;
+    ValueConstPtrH max;
+
+    /** Widen the zone to include value */
+    void update(ValueConstPtrH value);
+
+    /** True if value is within the zone already */
+    bool contains(const Value& value) const;
+  };
+
+  typedef std::vector<Zone> ZoneList;
+
+  /**
+    The per-field value ranges implied by a predicate, computed once per 
+    query and then tested against the zones of each block.
+  */
+  class ZoneFilter
+  {
+  public:
+    ZoneFilter(const Predicate& pred);
+
+    /** False if no row summarized by zones (one Zone per field) can match */
+    bool mayMatch(const ZoneList& zones) const;
+
+    /** False if the predicate does not bound any field */
+    bool empty() const { return mConstraints.empty(); }
+
+  private:
+    typedef std::vector<std::pair<FieldId, ValueRange> > ConstraintList;
+    ConstraintList mConstraints;
+  };
+
+  /**
+    Min/max summaries of every field, per block of kRowsPerBlock 
+    consecutive rows.  Summaries only ever widen: replacing a row widens
+    its block's zones to cover the new values, but does not narrow them.
+    A copy shares the summaries with the original until either widens
+    them.
+  */
+  class ZoneMap
+  {
+  public:
+    enum { kRowsPerBlock = 64 * 1024 };
+
+    ZoneMap(size_t fieldCount);
+
+    /** Account for row being stored at id */
+    void update(const RowIdentifier& id, const IRow& row,
+      const IFieldDescriptorConstList& fields);
+
+    /** Replace the zones of block, e.g. with zones read from storage */
+    void setZones(size_t block, const ZoneList& zones);
+
+    size_t getBlockCount() const { return mBlocks.size(); }
+
+    /** One Zone per field, indexed by field id */
+    const ZoneList& getZones(size_t block) const { return mBlocks[block]; }
+
+    static size_t BlockOf(const RowIdentifier& id)
+    {
+      return (size_t)id / kRowsPerBlock;
+    }
+
+  private:
+    size_t mFieldCount;
+    VersionedVector<ZoneList, 3> mBlocks;
+  };
+
+  typedef PointerType<ZoneMap>::Shared ZoneMapPtrH;
+}
+
+#endif
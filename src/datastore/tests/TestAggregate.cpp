@@ -0,0 +1,137 @@
+
+#include "CppUnitTest.h"
+#include <datastore/Database.h>
+#include <datastore/JsonStorage.h>
+#include <string>
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+
+namespace Tests
+{
+  /**
+    Rows of STB, TITLE and REV, the revenue summed by TITLE
+  */
+  static const char* kScheme =
+    "[                          "
+    "  {                        "
+    "    \"name\": \"STB\",       "
+    "    \"type\": \"text\",      "
+    "    \"key\": true,         "
+    "    \"description\": \"The key\" "
+    "  },                       "
+    "  {                        "
+    "    \"name\": \"TITLE\",     "
+    "    \"type\": \"text\",      "
+    "    \"description\": \"The group\" "
+    "  },                       "
+    "  {                        "
+    "    \"name\": \"REV\",       "
+    "    \"type\": \"float\",     "
+    "    \"aggregateBy\": [\"TITLE\"], "
+    "    \"description\": \"The sum\" "
+    "  }                        "
+    "]                          ";
+
+	TEST_CLASS(TestAggregate)
+	{
+	public:
+
+    static void insertRow(DataStore::Database& database, const char* stb,
+      const char* title, const char* rev)
+    {
+      DataStore::IFieldDescriptorConstListConstPtrH fields =
+        database.getScheme()->getFieldDescriptors();
+
+      DataStore::IRowPtrH row = database.createRow();
+      row->setValue(*(*fields)[0], (*fields)[0]->fromString(stb));
+      row->setValue(*(*fields)[1], (*fields)[1]->fromString(title));
+      row->setValue(*(*fields)[2], (*fields)[2]->fromString(rev));
+      Assert::IsTrue(database.insert(row));
+    }
+
+    /** The groups, as "TITLE=REV:sum;" */
+    static std::string readGroups(DataStore::IQueryCursor& cursor)
+    {
+      DataStore::IFieldDescriptorConstListConstPtrH fields = cursor.getFieldDescriptors();
+      Assert::AreEqual((size_t)2, fields->size());
+      Assert::AreEqual(std::string("REV:sum"), std::string((*fields)[1]->getName()));
+
+      std::string groups;
+      for (const DataStore::IRow* row = cursor.next(); row != NULL; row = cursor.next())
+      {
+        mStd::mString title;
+        mStd::mString sum;
+        Assert::IsTrue(row->getValue(*(*fields)[0])->getValue().convertTo(&title));
+        Assert::IsTrue(row->getValue(*(*fields)[1])->getValue().convertTo(&sum));
+
+        groups += title.c_str();
+        groups += "=";
+        groups += sum.c_str();
+        groups += ";";
+      }
+
+      return groups;
+    }
+
+    TEST_METHOD(GivenReplacedRowsVerifySumsAreRetracted)
+    {
+      try
+      {
+        DataStore::ISchemeConstPtrH scheme(new DataStore::SchemeJson(kScheme));
+        DataStore::Database database(scheme);
+        DataStore::IFieldDescriptorConstPtrH title = (*scheme->getFieldDescriptors())[1];
+
+        insertRow(database, "stb1", "the matrix", "4.00");
+        insertRow(database, "stb2", "unbreakable", "6.00");
+        insertRow(database, "stb3", "the matrix", "4.50");
+
+        // An open cursor keeps reading the version it was opened on
+        DataStore::IQueryCursorPtrH before = database.openAggregateCursor(title);
+
+        // stb2 moves to another title, which leaves its old one empty, and
+        // stb3 is replaced within its title
+        insertRow(database, "stb2", "the hobbit", "8.00");
+        insertRow(database, "stb3", "the matrix", "1.25");
+
+        DataStore::IQueryCursorPtrH after = database.openAggregateCursor(title);
+        Assert::AreEqual(std::string("the hobbit=8.00;the matrix=5.25;"), readGroups(*after));
+        Assert::AreEqual((size_t)2, after->getStats().rowsMatched);
+
+        Assert::AreEqual(std::string("the matrix=8.50;unbreakable=6.00;"), readGroups(*before));
+      }
+      catch (std::exception& ex)
+      {
+        Logger::WriteMessage(ex.what());
+        Assert::Fail(L"Exception");
+      }
+    }
+
+    TEST_METHOD(GivenUndeclaredAggregateVerifyFailure)
+    {
+      try
+      {
+        DataStore::ISchemeConstPtrH scheme(new DataStore::SchemeJson(kScheme));
+        DataStore::Database database(scheme);
+        DataStore::IFieldDescriptorConstListConstPtrH fields = scheme->getFieldDescriptors();
+
+        insertRow(database, "stb1", "the matrix", "4.00");
+
+        try
+        {
+          database.openAggregateCursor((*fields)[0]);
+          Assert::Fail(L"Exception expected, but missed");
+        }
+        catch (std::runtime_error& ex)
+        {
+          (void)ex;
+          // Nothing is summed by STB
+        }
+      }
+      catch (std::exception& ex)
+      {
+        Logger::WriteMessage(ex.what());
+        Assert::Fail(L"Exception");
+      }
+    }
+	};
+}
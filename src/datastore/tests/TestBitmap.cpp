@@ -0,0 +1,102 @@
+
+#include "CppUnitTest.h"
+#include <datastore/Bitmap.h>
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+
+namespace Tests
+{
+  TEST_CLASS(TestBitmap)
+  {
+  public:
+    TEST_METHOD(GivenSparseValuesVerifyMembership)
+    {
+      DataStore::Bitmap bitmap;
+
+      Assert::IsTrue(bitmap.add(7));
+      Assert::IsTrue(bitmap.add(3));
+      Assert::IsTrue(bitmap.add(70000));
+      Assert::IsFalse(bitmap.add(7));
+      Assert::AreEqual((size_t)3, bitmap.size());
+
+      Assert::IsTrue(bitmap.contains(3));
+      Assert::IsTrue(bitmap.contains(70000));
+      Assert::IsFalse(bitmap.contains(4));
+
+      // Values are visited in ascending order, across chunks
+      DataStore::Bitmap::const_iterator value = bitmap.cbegin();
+      Assert::AreEqual((DataStore::Bitmap::Element)3, *value);
+      Assert::AreEqual((DataStore::Bitmap::Element)7, *(++value));
+      Assert::AreEqual((DataStore::Bitmap::Element)70000, *(++value));
+      Assert::IsTrue(++value == bitmap.cend());
+
+      Assert::IsTrue(bitmap.remove(70000));
+      Assert::IsFalse(bitmap.remove(70000));
+      Assert::AreEqual((size_t)2, bitmap.size());
+    }
+
+    TEST_METHOD(GivenDenseValuesVerifyMembership)
+    {
+      DataStore::Bitmap bitmap;
+
+      // Enough values to switch a chunk over to a bitset
+      for (DataStore::Bitmap::Element v = 0; v < 20000; v += 2)
+      {
+        bitmap.add(v);
+      }
+      Assert::AreEqual((size_t)10000, bitmap.size());
+      Assert::IsTrue(bitmap.contains(19998));
+      Assert::IsFalse(bitmap.contains(19999));
+
+      size_t count = 0;
+      DataStore::Bitmap::Element expected = 0;
+      for (DataStore::Bitmap::const_iterator value = bitmap.cbegin();
+        value != bitmap.cend(); ++value, expected += 2, ++count)
+      {
+        Assert::AreEqual(expected, *value);
+      }
+      Assert::AreEqual((size_t)10000, count);
+
+      // ...and back to an array
+      for (DataStore::Bitmap::Element v = 0; v < 19000; v += 2)
+      {
+        bitmap.remove(v);
+      }
+      Assert::AreEqual((size_t)500, bitmap.size());
+      Assert::IsTrue(bitmap.contains(19000));
+      Assert::AreEqual((DataStore::Bitmap::Element)19000, *bitmap.cbegin());
+    }
+
+    TEST_METHOD(GivenTwoBitmapsVerifyIntersectAndMerge)
+    {
+      DataStore::Bitmap evens;
+      DataStore::Bitmap threes;
+
+      for (DataStore::Bitmap::Element v = 0; v < 200000; ++v)
+      {
+        if (v % 2 == 0)
+          evens.add(v);
+        if (v % 3 == 0)
+          threes.add(v);
+      }
+
+      DataStore::Bitmap both(evens);
+      both.intersect(threes);
+      Assert::AreEqual((size_t)33334, both.size());
+      Assert::IsTrue(both.contains(6));
+      Assert::IsFalse(both.contains(4));
+      Assert::IsFalse(both.contains(9));
+
+      DataStore::Bitmap either(evens);
+      either.merge(threes);
+      Assert::AreEqual((size_t)(100000 + 66667 - 33334), either.size());
+      Assert::IsTrue(either.contains(4));
+      Assert::IsTrue(either.contains(9));
+      Assert::IsFalse(either.contains(7));
+
+      DataStore::Bitmap none;
+      none.intersect(evens);
+      Assert::IsTrue(none.empty());
+    }
+  };
+}
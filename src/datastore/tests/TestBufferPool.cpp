@@ -0,0 +1,186 @@
+
+#include "CppUnitTest.h"
+#include <datastore/BufferPool.h>
+#include <algorithm>
+#include <atomic>
+#include <stdio.h>
+#include <thread>
+#include <vector>
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+
+namespace Tests
+{
+  TEST_CLASS(TestBufferPool)
+  {
+  public:
+    /** Write pageCount pool pages, each filled with its page number */
+    static void WritePages(const char* filename, size_t pageCount)
+    {
+      FILE* file = fopen(filename, "wb");
+      Assert::IsTrue(file != NULL);
+
+      std::vector<char> page(DataStore::BufferPool::kPageSize);
+      for (size_t number = 0; number < pageCount; ++number)
+      {
+        std::fill(page.begin(), page.end(), (char)number);
+        fwrite(&page[0], 1, page.size(), file);
+      }
+
+      fclose(file);
+    }
+
+    /** Read pages of file written by WritePages, counting those that are wrong */
+    static void ReadPages(const DataStore::PagedFile* file, size_t pageCount, size_t thread,
+      size_t readCount, std::atomic<size_t>* outWrongPages, std::atomic<size_t>* outFailures)
+    {
+      try
+      {
+        std::vector<char> page(DataStore::BufferPool::kPageSize);
+        for (size_t read = 0; read < readCount; ++read)
+        {
+          size_t number = (read * 7 + thread * 13) % pageCount;
+          file->read(number * page.size(), &page[0], page.size());
+          if (std::count(page.begin(), page.end(), (char)number) != (ptrdiff_t)page.size())
+          {
+            ++*outWrongPages;
+          }
+        }
+      }
+      catch (std::exception&)
+      {
+        ++*outFailures;
+      }
+    }
+
+    TEST_METHOD(GivenSmallPoolVerifyPagesEvicted)
+    {
+      const char* filename = "TestBufferPool.dat";
+      const size_t pageCount = 40;
+      const size_t pageSize = DataStore::BufferPool::kPageSize;
+
+      try
+      {
+        WritePages(filename, pageCount);
+
+        DataStore::BufferPoolPtrH pool(new DataStore::BufferPool(0));
+        Assert::AreEqual((size_t)DataStore::BufferPool::kMinFrames, pool->getFrameCount());
+
+        DataStore::PagedFile file(filename, pool);
+        Assert::AreEqual((uint64_t)(pageCount * pageSize), file.getSize());
+        Assert::IsTrue(file.getMappedData() == NULL);
+
+        // Page 0 stays pinned while every page is read
+        DataStore::PageHandle pinned;
+        const char* first = file.pin(0, pageSize, &pinned);
+
+        for (size_t page = 0; page < pageCount; ++page)
+        {
+          char value = 0;
+          file.read(page * pageSize + pageSize / 2, &value, sizeof(value));
+          Assert::AreEqual((char)page, value);
+        }
+
+        Assert::AreEqual((char)0, first[pageSize - 1]);
+        Assert::AreEqual(pageCount, pool->getMissCount());
+        Assert::AreEqual((size_t)1, pool->getHitCount());
+        Assert::AreEqual(pageCount - pool->getFrameCount(), pool->getEvictionCount());
+
+        // A read across pages pins them one at a time
+        char straddling[2] = { 0 };
+        file.read(pageSize * 10 - 1, straddling, sizeof(straddling));
+        Assert::AreEqual((char)9, straddling[0]);
+        Assert::AreEqual((char)10, straddling[1]);
+      }
+      catch (std::exception& ex)
+      {
+        Logger::WriteMessage(ex.what());
+        Assert::Fail(L"Exception");
+      }
+
+      remove(filename);
+    }
+
+    TEST_METHOD(GivenAllPagesPinnedVerifyFailure)
+    {
+      const char* filename = "TestBufferPoolPinned.dat";
+      const size_t pageSize = DataStore::BufferPool::kPageSize;
+
+      WritePages(filename, DataStore::BufferPool::kMinFrames + 1);
+
+      {
+        DataStore::BufferPoolPtrH pool(new DataStore::BufferPool(0));
+        DataStore::PagedFile file(filename, pool);
+
+        DataStore::PageHandle handles[DataStore::BufferPool::kMinFrames];
+        for (size_t page = 0; page < DataStore::BufferPool::kMinFrames; ++page)
+        {
+          file.pin(page * pageSize, pageSize, &handles[page]);
+        }
+
+        try
+        {
+          DataStore::PageHandle handle;
+          file.pin(DataStore::BufferPool::kMinFrames * pageSize, pageSize, &handle);
+          Assert::Fail(L"Exception expected, but missed");
+        }
+        catch (std::exception& ex)
+        {
+          (void)ex; // Exception expected
+        }
+
+        // Once a page is unpinned it can be evicted
+        handles[3].release();
+        DataStore::PageHandle handle;
+        const char* last = file.pin(DataStore::BufferPool::kMinFrames * pageSize, pageSize, &handle);
+        Assert::AreEqual((char)DataStore::BufferPool::kMinFrames, last[0]);
+      }
+
+      remove(filename);
+    }
+
+    TEST_METHOD(GivenThreadsMissingPagesVerifyEachReadsItsPage)
+    {
+      const char* filename = "TestBufferPoolThreads.dat";
+      const size_t pageCount = 64;
+      const size_t pageSize = DataStore::BufferPool::kPageSize;
+      const size_t threadCount = 8;
+      const size_t readCount = 2000;
+
+      try
+      {
+        WritePages(filename, pageCount);
+
+        // Far more pages than frames, so threads keep reading pages into
+        // frames while others pin theirs
+        DataStore::BufferPoolPtrH pool(new DataStore::BufferPool(0));
+        DataStore::PagedFile file(filename, pool);
+
+        std::atomic<size_t> wrongPages(0);
+        std::atomic<size_t> failures(0);
+        std::vector<std::thread> threads;
+        for (size_t thread = 0; thread < threadCount; ++thread)
+        {
+          threads.push_back(std::thread(ReadPages, &file, pageCount, thread, readCount,
+            &wrongPages, &failures));
+        }
+
+        for (size_t thread = 0; thread < threadCount; ++thread)
+        {
+          threads[thread].join();
+        }
+
+        Assert::AreEqual((size_t)0, (size_t)failures);
+        Assert::AreEqual((size_t)0, (size_t)wrongPages);
+        Assert::AreEqual(threadCount * readCount, pool->getHitCount() + pool->getMissCount());
+      }
+      catch (std::exception& ex)
+      {
+        Logger::WriteMessage(ex.what());
+        Assert::Fail(L"Exception");
+      }
+
+      remove(filename);
+    }
+  };
+}
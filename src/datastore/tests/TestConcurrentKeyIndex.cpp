@@ -0,0 +1,139 @@
+
+#include "CppUnitTest.h"
+#include <datastore/ConcurrentKeyIndex.h>
+#include <datastore/Database.h>
+#include <datastore/JsonStorage.h>
+#include <stdio.h>
+#include <thread>
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+
+namespace Tests
+{
+  TEST_CLASS(TestConcurrentKeyIndex)
+  {
+  public:
+    static const size_t kKeyCount = 500;
+    static const size_t kRowsPerKey = 40;
+    static const size_t kThreadCount = 8;
+
+    /** Rows whose key repeats every kKeyCount rows */
+    static void CreateRows(DataStore::Database* database, DataStore::IRowConstList* outRows)
+    {
+      DataStore::IFieldDescriptorConstListConstPtrH fields =
+        database->getScheme()->getFieldDescriptors();
+
+      char key[32];
+      for (size_t i = 0; i < kKeyCount * kRowsPerKey; ++i)
+      {
+        sprintf(key, "key%u", (unsigned)(i % kKeyCount));
+
+        DataStore::IRowPtrH row = database->createRow();
+        row->setValue(*(*fields)[0], (*fields)[0]->fromString(key));
+        outRows->push_back(row);
+      }
+    }
+
+    /**
+      Put every kThreadCount-th row, starting at row thread, from the last
+      one back, so later rows of a key are often put before earlier ones
+    */
+    static void PutRows(DataStore::ConcurrentKeyIndex* index,
+      const DataStore::IRowConstList* rows, size_t thread, size_t* outNewKeys)
+    {
+      *outNewKeys = 0;
+
+      size_t i = rows->size() - kThreadCount + thread;
+      for (;;)
+      {
+        const DataStore::IRowConstPtrH& row = (*rows)[i];
+        if (index->put(row, index->hash(*row), i))
+        {
+          ++*outNewKeys;
+        }
+
+        if (i < kThreadCount)
+        {
+          break;
+        }
+        i -= kThreadCount;
+      }
+    }
+
+    static void VerifyConcurrentPuts(size_t stripeCount)
+    {
+      DataStore::Database database(DataStore::ISchemeConstPtrH(
+        new DataStore::SchemeJson(
+          "[{\"name\": \"keyField\", \"type\": \"text\", \"size\": 16, \"key\": true}]")));
+
+      DataStore::IRowConstList rows;
+      CreateRows(&database, &rows);
+
+      DataStore::IFieldDescriptorConstList keyFields(
+        *database.getScheme()->getFieldDescriptors());
+      DataStore::ConcurrentKeyIndex index(keyFields, stripeCount);
+
+      std::vector<size_t> newKeys(kThreadCount);
+      std::vector<std::thread> threads;
+      for (size_t thread = 0; thread < kThreadCount; ++thread)
+      {
+        threads.push_back(std::thread(PutRows, &index, &rows, thread, &newKeys[thread]));
+      }
+      for (size_t thread = 0; thread < kThreadCount; ++thread)
+      {
+        threads[thread].join();
+      }
+
+      size_t newKeyCount = 0;
+      for (size_t thread = 0; thread < kThreadCount; ++thread)
+      {
+        newKeyCount += newKeys[thread];
+      }
+      Assert::AreEqual(kKeyCount, newKeyCount);
+      Assert::AreEqual(kKeyCount, index.size());
+
+      DataStore::ConcurrentKeyIndex::EntryList entries;
+      index.getEntries(&entries);
+      Assert::AreEqual(kKeyCount, entries.size());
+
+      for (size_t key = 0; key < entries.size(); ++key)
+      {
+        const DataStore::ConcurrentKeyIndex::Entry& entry = entries[key];
+        size_t last = key + kKeyCount * (kRowsPerKey - 1);
+
+        Assert::IsTrue(entry.firstSequence == key);
+        Assert::IsTrue(entry.lastSequence == last);
+        Assert::AreEqual(kRowsPerKey, entry.occurrences);
+        Assert::IsTrue(entry.row == rows[last]);
+        Assert::IsTrue(index.find(*rows[key], index.hash(*rows[key])) == rows[last]);
+      }
+    }
+
+    TEST_METHOD(GivenConcurrentPutsVerifyHighestSequenceWins)
+    {
+      try
+      {
+        VerifyConcurrentPuts(DataStore::ConcurrentKeyIndex::kDefaultStripeCount);
+      }
+      catch (std::exception& ex)
+      {
+        Logger::WriteMessage(ex.what());
+        Assert::Fail(L"Exception");
+      }
+    }
+
+    TEST_METHOD(GivenSingleStripeVerifyHighestSequenceWins)
+    {
+      try
+      {
+        // Every put contends for the same lock
+        VerifyConcurrentPuts(1);
+      }
+      catch (std::exception& ex)
+      {
+        Logger::WriteMessage(ex.what());
+        Assert::Fail(L"Exception");
+      }
+    }
+  };
+}
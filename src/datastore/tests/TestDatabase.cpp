@@ -2,6 +2,10 @@
 #include "CppUnitTest.h"
 #include <datastore/Database.h>
 #include <datastore/JsonStorage.h>
+#include <datastore/Versioned.h>
+#include <atomic>
+#include <thread>
+#include <stdio.h>
 
 using namespace Microsoft::VisualStudio::CppUnitTestFramework;
 
@@ -107,5 +111,634 @@ namespace Tests
       }
 		}
 
+    TEST_METHOD(GivenOrderByVerifyCursorOrder)
+    {
+      const char* schemeJson =
+        "[                          "
+        "  {                        "
+        "    \"name\": \"keyField\",  "
+        "    \"type\": \"text\",   "
+        "    \"size\": 32,          "
+        "    \"key\": true,         "
+        "    \"description\": \"This is a key field\" "
+        "  },                       "
+        "  {                        "
+        "    \"name\": \"valueField\",  "
+        "    \"type\": \"float\",   "
+        "    \"size\": 32,          "
+        "    \"key\": false,        "
+        "    \"description\": \"This is a value field\" "
+        "  }                        "
+        "]                          ";
+
+      try
+      {
+        DataStore::ISchemeConstPtrH scheme(new DataStore::SchemeJson(schemeJson));
+        DataStore::Database database(scheme);
+
+        DataStore::IFieldDescriptorConstListConstPtrH fields = scheme->getFieldDescriptors();
+        DataStore::IFieldDescriptorConstPtrH keyField = (*fields)[0];
+        DataStore::IFieldDescriptorConstPtrH valueField = (*fields)[1];
+
+        const char* keys[] = { "a", "b", "c", "d" };
+        const char* values[] = { "3.0", "1.0", "4.0", "2.0" };
+        for (int i = 0; i < 4; ++i)
+        {
+          DataStore::IRowPtrH newRow = database.createRow();
+          newRow->setValue(*keyField, keyField->fromString(keys[i]));
+          newRow->setValue(*valueField, valueField->fromString(values[i]));
+          Assert::IsTrue(database.insert(newRow));
+        }
+
+        // Unordered cursor returns rows in the order they were inserted
+        DataStore::IQueryCursorPtrH cursor = database.openCursor();
+        for (int i = 0; i < 4; ++i)
+        {
+          const DataStore::IRow* row = cursor->next();
+          Assert::IsTrue(row != NULL);
+          Assert::IsTrue(*row->getValue(*keyField) == *keyField->fromString(keys[i]));
+        }
+        Assert::IsTrue(cursor->next() == NULL);
+        Assert::AreEqual((size_t)4, cursor->getStats().rowsMatched);
+
+        // Ordered cursor
+        DataStore::IFieldDescriptorConstListPtrH orderBy(new DataStore::IFieldDescriptorConstList());
+        orderBy->push_back(valueField);
+
+        const char* orderedKeys[] = { "b", "d", "a", "c" };
+        cursor = database.openCursor(NULL, NULL, orderBy);
+        for (int i = 0; i < 4; ++i)
+        {
+          const DataStore::IRow* row = cursor->next();
+          Assert::IsTrue(row != NULL);
+          Assert::IsTrue(*row->getValue(*keyField) == *keyField->fromString(orderedKeys[i]));
+        }
+        Assert::IsTrue(cursor->next() == NULL);
+      }
+      catch (std::exception& ex)
+      {
+        Logger::WriteMessage(ex.what());
+        Assert::Fail(L"Exception");
+      }
+    }
+
+    TEST_METHOD(GivenBatchOfQueriesVerifySameResultsAsAlone)
+    {
+      const char* schemeJson =
+        "[                          "
+        "  {                        "
+        "    \"name\": \"keyField\",  "
+        "    \"type\": \"text\",   "
+        "    \"size\": 32,          "
+        "    \"key\": true,         "
+        "    \"index\": \"hash\",   "
+        "    \"description\": \"This is a key field\" "
+        "  },                       "
+        "  {                        "
+        "    \"name\": \"valueField\",  "
+        "    \"type\": \"float\",   "
+        "    \"size\": 32,          "
+        "    \"key\": false,        "
+        "    \"description\": \"This is a value field\" "
+        "  }                        "
+        "]                          ";
+
+      try
+      {
+        DataStore::ISchemeConstPtrH scheme(new DataStore::SchemeJson(schemeJson));
+        DataStore::Database database(scheme);
+
+        DataStore::IFieldDescriptorConstListConstPtrH fields = scheme->getFieldDescriptors();
+        DataStore::IFieldDescriptorConstPtrH keyField = (*fields)[0];
+        DataStore::IFieldDescriptorConstPtrH valueField = (*fields)[1];
+
+        const char* keys[] = { "a", "b", "c", "d", "e" };
+        const char* values[] = { "3.0", "1.0", "4.0", "2.0", "5.0" };
+        for (int i = 0; i < 5; ++i)
+        {
+          DataStore::IRowPtrH newRow = database.createRow();
+          newRow->setValue(*keyField, keyField->fromString(keys[i]));
+          newRow->setValue(*valueField, valueField->fromString(values[i]));
+          Assert::IsTrue(database.insert(newRow));
+        }
+
+        DataStore::IFieldDescriptorConstListPtrH orderBy(new DataStore::IFieldDescriptorConstList());
+        orderBy->push_back(valueField);
+
+        // Two filters share the scan, the index answers the third
+        DataStore::BatchQueryList batch(4);
+        batch[0].filter = DataStore::Predicate(DataStore::IQualifierPtrH(
+          new DataStore::Logic::Range(valueField, valueField->fromString("2.0"), NULL)));
+        batch[0].orderBy = orderBy;
+        batch[1].filter = DataStore::Predicate(DataStore::IQualifierPtrH(
+          new DataStore::Logic::Range(valueField, NULL, valueField->fromString("3.0"))));
+        batch[2].filter = DataStore::Predicate(DataStore::IQualifierPtrH(
+          new DataStore::Logic::Exact(keyField, keyField->fromString("d"))));
+        batch[3].select = DataStore::IFieldDescriptorConstListPtrH(
+          new DataStore::IFieldDescriptorConstList(1, valueField));
+        batch[3].orderBy = orderBy;
+
+        DataStore::IQueryResultConstList results;
+        DataStore::QueryStatsList stats;
+        database.queryBatch(batch, &results, &stats);
+        Assert::AreEqual((size_t)4, results.size());
+        Assert::AreEqual((size_t)4, stats.size());
+
+        for (size_t query = 0; query < batch.size(); ++query)
+        {
+          DataStore::QueryStats aloneStats;
+          DataStore::IQueryResultConstPtrH alone = database.query(batch[query].select,
+            &batch[query].filter, batch[query].orderBy, &aloneStats);
+
+          Assert::AreEqual(alone->size(), results[query]->size());
+          Assert::AreEqual(alone->getFieldDescriptors()->size(),
+            results[query]->getFieldDescriptors()->size());
+          for (size_t row = 0; row < alone->size(); ++row)
+          {
+            Assert::IsTrue(*(*alone)[row]->getValue(*keyField) ==
+              *(*results[query])[row]->getValue(*keyField));
+          }
+
+          Assert::AreEqual(aloneStats.rowsMatched, stats[query].rowsMatched);
+          Assert::AreEqual(aloneStats.usedIndex, stats[query].usedIndex);
+        }
+
+        Assert::AreEqual((size_t)4, results[0]->size());
+        Assert::AreEqual((size_t)3, results[1]->size());
+        Assert::AreEqual((size_t)1, results[2]->size());
+        Assert::IsTrue(stats[2].usedIndex);
+      }
+      catch (std::exception& ex)
+      {
+        Logger::WriteMessage(ex.what());
+        Assert::Fail(L"Exception");
+      }
+    }
+
+    TEST_METHOD(GivenDuplicateKeysInBatchVerifyLastWins)
+    {
+      const char* schemeJson =
+        "[                          "
+        "  {                        "
+        "    \"name\": \"keyField\",  "
+        "    \"type\": \"text\",   "
+        "    \"size\": 32,          "
+        "    \"key\": true,         "
+        "    \"description\": \"This is a key field\" "
+        "  },                       "
+        "  {                        "
+        "    \"name\": \"valueField\",  "
+        "    \"type\": \"float\",   "
+        "    \"size\": 32,          "
+        "    \"key\": false,        "
+        "    \"description\": \"This is a value field\" "
+        "  }                        "
+        "]                          ";
+
+      try
+      {
+        DataStore::ISchemeConstPtrH scheme(new DataStore::SchemeJson(schemeJson));
+        DataStore::Database database(scheme);
+
+        DataStore::IFieldDescriptorConstListConstPtrH fields = scheme->getFieldDescriptors();
+        DataStore::IFieldDescriptorConstPtrH keyField = (*fields)[0];
+        DataStore::IFieldDescriptorConstPtrH valueField = (*fields)[1];
+
+        // "a" is already stored, "b" appears twice in the batch
+        DataStore::IRowPtrH storedRow = database.createRow();
+        storedRow->setValue(*keyField, keyField->fromString("a"));
+        storedRow->setValue(*valueField, valueField->fromString("1.0"));
+        Assert::IsTrue(database.insert(storedRow));
+
+        const char* keys[] = { "b", "a", "c", "b" };
+        const char* values[] = { "2.0", "3.0", "4.0", "5.0" };
+
+        DataStore::IRowConstList batch;
+        for (int i = 0; i < 4; ++i)
+        {
+          DataStore::IRowPtrH newRow = database.createRow();
+          newRow->setValue(*keyField, keyField->fromString(keys[i]));
+          newRow->setValue(*valueField, valueField->fromString(values[i]));
+          batch.push_back(newRow);
+        }
+
+        size_t inserted = 0;
+        size_t replaced = 0;
+        Assert::IsTrue(database.insertBatch(batch, &inserted, &replaced));
+        Assert::AreEqual((size_t)2, inserted);
+        Assert::AreEqual((size_t)2, replaced);
+
+        // Rows are stored in order of the first appearance of their key
+        const char* expectedKeys[] = { "a", "b", "c" };
+        const char* expectedValues[] = { "3.0", "5.0", "4.0" };
+
+        DataStore::IQueryCursorPtrH cursor = database.openCursor();
+        for (int i = 0; i < 3; ++i)
+        {
+          const DataStore::IRow* row = cursor->next();
+          Assert::IsTrue(row != NULL);
+          Assert::IsTrue(*row->getValue(*keyField) == *keyField->fromString(expectedKeys[i]));
+          Assert::IsTrue(*row->getValue(*valueField) == *valueField->fromString(expectedValues[i]));
+        }
+        Assert::IsTrue(cursor->next() == NULL);
+      }
+      catch (std::exception& ex)
+      {
+        Logger::WriteMessage(ex.what());
+        Assert::Fail(L"Exception");
+      }
+    }
+
+    TEST_METHOD(GivenLoadFieldsVerifyOnlyTheyAreLoaded)
+    {
+      const char* schemeJson =
+        "[                          "
+        "  {                        "
+        "    \"name\": \"keyField\",  "
+        "    \"type\": \"text\",   "
+        "    \"size\": 32,          "
+        "    \"key\": true,         "
+        "    \"description\": \"This is a key field\" "
+        "  },                       "
+        "  {                        "
+        "    \"name\": \"valueField\",  "
+        "    \"type\": \"float\",   "
+        "    \"size\": 32,          "
+        "    \"key\": false,        "
+        "    \"description\": \"This is a value field\" "
+        "  }                        "
+        "]                          ";
+
+      const char* filename = "TestDatabaseLoadFields.json";
+
+      try
+      {
+        DataStore::SchemeJsonConstPtrH scheme(new DataStore::SchemeJson(schemeJson));
+        DataStore::IFieldDescriptorConstListConstPtrH fields = scheme->getFieldDescriptors();
+        DataStore::IFieldDescriptorConstPtrH keyField = (*fields)[0];
+        DataStore::IFieldDescriptorConstPtrH valueField = (*fields)[1];
+
+        {
+          DataStore::DatabasePtrH database = DataStore::DataStorageJson::Create(scheme, filename);
+
+          const char* keys[] = { "a", "b" };
+          const char* values[] = { "1.0", "2.0" };
+          for (int i = 0; i < 2; ++i)
+          {
+            DataStore::IRowPtrH newRow = database->createRow();
+            newRow->setValue(*keyField, keyField->fromString(keys[i]));
+            newRow->setValue(*valueField, valueField->fromString(values[i]));
+            Assert::IsTrue(database->insert(newRow));
+          }
+        }
+
+        // Load the value field only, rows aren't told apart by their keys
+        DataStore::IFieldDescriptorConstListPtrH loadFields(new DataStore::IFieldDescriptorConstList());
+        loadFields->push_back(valueField);
+
+        DataStore::Database database(DataStore::DataStorageJson::Open(filename), loadFields);
+
+        DataStore::IQueryResultConstPtrH result = database.query(loadFields);
+        Assert::AreEqual((size_t)2, result->size());
+        Assert::IsTrue(*(*result)[1]->getValue(*valueField) == *valueField->fromString("2.0"));
+        Assert::IsTrue(!(*result)[1]->getValue(*keyField));
+
+        // Fields that weren't loaded can't be queried, and the database is read-only
+        bool threw = false;
+        try
+        {
+          database.query();
+        }
+        catch (std::exception&)
+        {
+          threw = true;
+        }
+        Assert::IsTrue(threw);
+        Assert::IsFalse(database.insert(database.createRow()));
+      }
+      catch (std::exception& ex)
+      {
+        Logger::WriteMessage(ex.what());
+        Assert::Fail(L"Exception");
+      }
+
+      remove(filename);
+    }
+
+    TEST_METHOD(GivenLoadFilterVerifyOnlyMatchingRowsLoaded)
+    {
+      const char* schemeJson =
+        "[                          "
+        "  {                        "
+        "    \"name\": \"keyField\",  "
+        "    \"type\": \"text\",   "
+        "    \"size\": 32,          "
+        "    \"key\": true,         "
+        "    \"description\": \"This is a key field\" "
+        "  },                       "
+        "  {                        "
+        "    \"name\": \"valueField\",  "
+        "    \"type\": \"float\",   "
+        "    \"size\": 32,          "
+        "    \"key\": false,        "
+        "    \"description\": \"This is a value field\" "
+        "  }                        "
+        "]                          ";
+
+      const char* filename = "TestDatabaseLoadFilter.json";
+
+      try
+      {
+        DataStore::SchemeJsonConstPtrH scheme(new DataStore::SchemeJson(schemeJson));
+        DataStore::IFieldDescriptorConstListConstPtrH fields = scheme->getFieldDescriptors();
+        DataStore::IFieldDescriptorConstPtrH keyField = (*fields)[0];
+        DataStore::IFieldDescriptorConstPtrH valueField = (*fields)[1];
+
+        {
+          DataStore::DatabasePtrH database = DataStore::DataStorageJson::Create(scheme, filename);
+
+          const char* keys[] = { "a", "b", "c" };
+          const char* values[] = { "1.0", "2.0", "3.0" };
+          for (int i = 0; i < 3; ++i)
+          {
+            DataStore::IRowPtrH newRow = database->createRow();
+            newRow->setValue(*keyField, keyField->fromString(keys[i]));
+            newRow->setValue(*valueField, valueField->fromString(values[i]));
+            Assert::IsTrue(database->insert(newRow));
+          }
+        }
+
+        // The stored zones can't rule the block out, but rows are filtered
+        // as they are read
+        DataStore::Predicate filter(DataStore::IQualifierPtrH(new DataStore::Logic::Range(
+          valueField, valueField->fromString("2.0"), NULL)));
+
+        DataStore::Database database(DataStore::DataStorageJson::Open(filename), NULL, &filter);
+
+        DataStore::IQueryResultConstPtrH result = database.query();
+        Assert::AreEqual((size_t)2, result->size());
+        Assert::IsTrue(*(*result)[0]->getValue(*keyField) == *keyField->fromString("b"));
+
+        // No block can match this
+        DataStore::Predicate noMatch(DataStore::IQualifierPtrH(new DataStore::Logic::Range(
+          valueField, valueField->fromString("4.0"), NULL)));
+
+        DataStore::Database empty(DataStore::DataStorageJson::Open(filename), NULL, &noMatch);
+        Assert::AreEqual((size_t)0, empty.query()->size());
+      }
+      catch (std::exception& ex)
+      {
+        Logger::WriteMessage(ex.what());
+        Assert::Fail(L"Exception");
+      }
+
+      remove(filename);
+    }
+
+
+    TEST_METHOD(GivenOpenCursorVerifyItReadsItsVersion)
+    {
+      const char* filename = "TestDatabaseVersions.json";
+      const char* schemeJson =
+        "[                          "
+        "  {                        "
+        "    \"name\": \"keyField\",  "
+        "    \"type\": \"text\",   "
+        "    \"size\": 32,          "
+        "    \"key\": true,         "
+        "    \"description\": \"This is a key field\" "
+        "  },                       "
+        "  {                        "
+        "    \"name\": \"valueField\",  "
+        "    \"type\": \"float\",   "
+        "    \"size\": 32,          "
+        "    \"key\": false,        "
+        "    \"description\": \"This is a value field\" "
+        "  }                        "
+        "]                          ";
+
+      try
+      {
+        remove(filename);
+        DataStore::SchemeJsonConstPtrH scheme(new DataStore::SchemeJson(schemeJson));
+        DataStore::IFieldDescriptorConstListConstPtrH fields = scheme->getFieldDescriptors();
+        DataStore::IFieldDescriptorConstPtrH keyField = (*fields)[0];
+        DataStore::IFieldDescriptorConstPtrH valueField = (*fields)[1];
+
+        DataStore::DatabasePtrH created = DataStore::DataStorageJson::Create(scheme, filename);
+        DataStore::Database& database = *created;
+
+        DataStore::IRowPtrH row = database.createRow();
+        row->setValue(*keyField, keyField->fromString("a"));
+        row->setValue(*valueField, valueField->fromString("1.0"));
+        Assert::IsTrue(database.insert(row));
+        uint64_t inserted = database.getGeneration();
+        database.persist();
+        uint64_t persisted = database.getGeneration();
+        Assert::IsTrue(inserted > 0 && persisted > inserted);
+
+        // The cursor keeps reading the version it was opened on
+        DataStore::IQueryCursorPtrH cursor = database.openCursor();
+        Assert::IsTrue(database.getGeneration() == persisted);
+
+        row = database.createRow();
+        row->setValue(*keyField, keyField->fromString("a"));
+        row->setValue(*valueField, valueField->fromString("2.0"));
+        Assert::IsTrue(database.insert(row));
+
+        row = database.createRow();
+        row->setValue(*keyField, keyField->fromString("b"));
+        row->setValue(*valueField, valueField->fromString("3.0"));
+        Assert::IsTrue(database.insert(row));
+
+        const DataStore::IRow* pinned = cursor->next();
+        Assert::IsTrue(pinned != NULL);
+        Assert::IsTrue(*pinned->getValue(*valueField) == *valueField->fromString("1.0"));
+        Assert::IsTrue(cursor->next() == NULL);
+
+        Assert::AreEqual((size_t)2, database.query()->size());
+        uint64_t modified = database.getGeneration();
+        Assert::IsTrue(modified > persisted);
+
+        // Reloading publishes the stored rows, the pinned result is unchanged
+        DataStore::IQueryResultConstPtrH before = database.query();
+        database.reload(DataStore::DataStorageJson::Open(filename));
+
+        DataStore::IQueryResultConstPtrH after = database.query();
+        Assert::AreEqual((size_t)2, before->size());
+        Assert::AreEqual((size_t)1, after->size());
+        Assert::IsTrue(*(*after)[0]->getValue(*valueField) == *valueField->fromString("1.0"));
+        Assert::IsTrue(database.getGeneration() > modified);
+      }
+      catch (std::exception& ex)
+      {
+        Logger::WriteMessage(ex.what());
+        Assert::Fail(L"Exception");
+      }
+
+      remove(filename);
+    }
+
+    /** Count the rows of database until isWriting is cleared */
+    static void CountRows(DataStore::Database* database, size_t batchSize,
+      std::atomic<bool>* isWriting, std::atomic<size_t>* partialReads,
+      std::atomic<size_t>* reads)
+    {
+      size_t lastCount = 0;
+      do
+      {
+        size_t count = 0;
+        DataStore::IQueryCursorPtrH cursor = database->openCursor();
+        while (cursor->next() != NULL)
+        {
+          ++count;
+        }
+
+        // A version is published once its batch is inserted in full
+        if (count % batchSize != 0 || count < lastCount)
+        {
+          ++*partialReads;
+        }
+        lastCount = count;
+        ++*reads;
+      } while (*isWriting);
+    }
+
+    TEST_METHOD(GivenConcurrentWriterVerifyReadersSeeWholeBatches)
+    {
+      const char* schemeJson =
+        "[                          "
+        "  {                        "
+        "    \"name\": \"keyField\",  "
+        "    \"type\": \"text\",   "
+        "    \"size\": 32,          "
+        "    \"key\": true,         "
+        "    \"description\": \"This is a key field\" "
+        "  }                        "
+        "]                          ";
+
+      const size_t batchCount = 50;
+      const size_t batchSize = 20;
+
+      try
+      {
+        DataStore::ISchemeConstPtrH scheme(new DataStore::SchemeJson(schemeJson));
+        DataStore::IFieldDescriptorConstPtrH keyField = (*scheme->getFieldDescriptors())[0];
+        DataStore::Database database(scheme);
+
+        // Empty until the first batch is published
+        Assert::AreEqual((size_t)0, database.query()->size());
+
+        std::atomic<bool> isWriting(true);
+        std::atomic<size_t> partialReads(0);
+        std::atomic<size_t> reads(0);
+
+        std::vector<std::thread> readers;
+        for (int reader = 0; reader < 4; ++reader)
+        {
+          readers.push_back(std::thread(&TestDatabase::CountRows, &database, 
+            batchSize, &isWriting, &partialReads, &reads));
+        }
+
+        for (size_t batch = 0; batch < batchCount; ++batch)
+        {
+          DataStore::IRowConstList rows;
+          for (size_t i = 0; i < batchSize; ++i)
+          {
+            DataStore::IRowPtrH row = database.createRow();
+            row->setValue(*keyField, keyField->fromString(
+              std::to_string(batch * batchSize + i).c_str()));
+            rows.push_back(row);
+          }
+          Assert::IsTrue(database.insertBatch(rows));
+        }
+
+        isWriting = false;
+        for (size_t reader = 0; reader < readers.size(); ++reader)
+        {
+          readers[reader].join();
+        }
+
+        Assert::AreEqual((size_t)0, (size_t)partialReads);
+        Assert::IsTrue(reads > 0);
+        Assert::AreEqual(batchCount * batchSize, database.query()->size());
+      }
+      catch (std::exception& ex)
+      {
+        Logger::WriteMessage(ex.what());
+        Assert::Fail(L"Exception");
+      }
+    }
+
+
+    TEST_METHOD(GivenQueriedDatabaseVerifyInsertsCopyOnlyWhatTheyWrite)
+    {
+      const char* schemeJson =
+        "[                          "
+        "  {                        "
+        "    \"name\": \"keyField\",  "
+        "    \"type\": \"text\",   "
+        "    \"size\": 32,          "
+        "    \"key\": true,         "
+        "    \"index\": \"hash\",   "
+        "    \"description\": \"This is a key field\" "
+        "  },                       "
+        "  {                        "
+        "    \"name\": \"dateField\", "
+        "    \"type\": \"date\",    "
+        "    \"index\": \"ordered\", "
+        "    \"description\": \"This is an ordered field\" "
+        "  },                       "
+        "  {                        "
+        "    \"name\": \"providerField\", "
+        "    \"type\": \"text\",    "
+        "    \"index\": \"bitmap\", "
+        "    \"description\": \"This is a low-cardinality field\" "
+        "  }                        "
+        "]                          ";
+
+      const size_t rowCount = 20000;
+      const char* dates[] = { "2014-04-01", "2014-04-02", "2014-04-03" };
+      const char* providers[] = { "warner", "hbo", "fox", "sony" };
+
+      try
+      {
+        DataStore::ISchemeConstPtrH scheme(new DataStore::SchemeJson(schemeJson));
+        DataStore::IFieldDescriptorConstListConstPtrH fields = scheme->getFieldDescriptors();
+        DataStore::Database database(scheme);
+
+        // From here on, every insert writes to a new version, which 
+        // shares the previous one's rows and indexes
+        DataStore::IQueryResultConstPtrH queried = database.query();
+        uint64_t copiedBefore = DataStore::Versioned::GetCopiedNodes();
+
+        for (size_t i = 0; i < rowCount; ++i)
+        {
+          DataStore::IRowPtrH row = database.createRow();
+          row->setValue(*(*fields)[0], (*fields)[0]->fromString(std::to_string(i).c_str()));
+          row->setValue(*(*fields)[1], (*fields)[1]->fromString(dates[i % 3]));
+          row->setValue(*(*fields)[2], (*fields)[2]->fromString(providers[i % 4]));
+          Assert::IsTrue(database.insert(row));
+        }
+
+        // Copying the table on each insert would copy every leaf of it,
+        // hundreds of nodes by the last inserts
+        uint64_t copied = DataStore::Versioned::GetCopiedNodes() - copiedBefore;
+        Assert::IsTrue(copied < rowCount * 32);
+
+        Assert::AreEqual((size_t)0, queried->size());
+        Assert::AreEqual(rowCount, database.query()->size());
+
+        DataStore::Predicate hbo(DataStore::IQualifierPtrH(
+          new DataStore::Logic::Exact((*fields)[2], (*fields)[2]->fromString("hbo"))));
+        Assert::AreEqual(rowCount / 4, database.query(NULL, &hbo)->size());
+      }
+      catch (std::exception& ex)
+      {
+        Logger::WriteMessage(ex.what());
+        Assert::Fail(L"Exception");
+      }
+    }
+
 	};
-}
\ No newline at end of file
+}
@@ -0,0 +1,240 @@
+
+#include "CppUnitTest.h"
+#include <datastore/Database.h>
+#include <datastore/JsonStorage.h>
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+
+namespace Tests
+{
+  TEST_CLASS(TestIndex)
+  {
+  public:
+    static DataStore::ISchemeConstPtrH CreateIndexedScheme()
+    {
+      const char* schemeJson =
+        "[                          "
+        "  {                        "
+        "    \"name\": \"keyField\",  "
+        "    \"type\": \"text\",    "
+        "    \"size\": 32,          "
+        "    \"key\": true,         "
+        "    \"index\": \"hash\",   "
+        "    \"description\": \"This is a key field\" "
+        "  },                       "
+        "  {                        "
+        "    \"name\": \"dateField\", "
+        "    \"type\": \"date\",    "
+        "    \"index\": \"ordered\", "
+        "    \"description\": \"This is an ordered field\" "
+        "  }                        "
+        "]                          ";
+
+      return DataStore::ISchemeConstPtrH(new DataStore::SchemeJson(schemeJson));
+    }
+
+    static void InsertRow(DataStore::Database* database, const char* key, const char* date,
+      DataStore::Database::InsertionResult* pResult = NULL)
+    {
+      DataStore::IFieldDescriptorConstListConstPtrH fields =
+        database->getScheme()->getFieldDescriptors();
+
+      DataStore::IRowPtrH newRow = database->createRow();
+      newRow->setValue(*(*fields)[0], (*fields)[0]->fromString(key));
+      newRow->setValue(*(*fields)[1], (*fields)[1]->fromString(date));
+      Assert::IsTrue(database->insert(newRow, pResult));
+    }
+
+    TEST_METHOD(GivenIndexedSchemeVerifyIndexTypes)
+    {
+      try
+      {
+        DataStore::ISchemeConstPtrH scheme = CreateIndexedScheme();
+        DataStore::IFieldDescriptorConstListConstPtrH fields = scheme->getFieldDescriptors();
+
+        Assert::IsTrue(DataStore::eIndexType_Hash == (*fields)[0]->getIndexType());
+        Assert::IsTrue(DataStore::eIndexType_Ordered == (*fields)[1]->getIndexType());
+      }
+      catch (std::exception& ex)
+      {
+        Logger::WriteMessage(ex.what());
+        Assert::Fail(L"Exception");
+      }
+    }
+
+    TEST_METHOD(GivenHashIndexVerifyExactQuery)
+    {
+      try
+      {
+        DataStore::Database database(CreateIndexedScheme());
+        DataStore::IFieldDescriptorConstListConstPtrH fields =
+          database.getScheme()->getFieldDescriptors();
+
+        InsertRow(&database, "a", "2014-04-01");
+        InsertRow(&database, "b", "2014-04-02");
+        InsertRow(&database, "c", "2014-04-03");
+
+        // Replacing a row must move it within the indexes
+        DataStore::Database::InsertionResult insertionResult;
+        InsertRow(&database, "b", "2014-04-05", &insertionResult);
+        Assert::IsTrue(DataStore::Database::eInsertionResult_Replaced == insertionResult);
+
+        DataStore::IQualifierPtrH exactKey(new DataStore::Logic::Exact((*fields)[0],
+          (*fields)[0]->fromString("b")));
+        DataStore::Predicate filter(exactKey);
+
+        DataStore::IQueryResultConstPtrH result = database.query(NULL, &filter);
+        Assert::AreEqual((size_t)1, result->size());
+
+        DataStore::ValueConstPtrH date = (*result)[0]->getValue(*(*fields)[1]);
+        Assert::IsTrue(*date == *(*fields)[1]->fromString("2014-04-05"));
+      }
+      catch (std::exception& ex)
+      {
+        Logger::WriteMessage(ex.what());
+        Assert::Fail(L"Exception");
+      }
+    }
+
+    TEST_METHOD(GivenOrderedIndexVerifyRangeQuery)
+    {
+      try
+      {
+        DataStore::Database database(CreateIndexedScheme());
+        DataStore::IFieldDescriptorConstListConstPtrH fields =
+          database.getScheme()->getFieldDescriptors();
+
+        InsertRow(&database, "a", "2014-04-01");
+        InsertRow(&database, "b", "2014-04-02");
+        InsertRow(&database, "c", "2014-04-03");
+        InsertRow(&database, "d", "2014-04-04");
+
+        DataStore::IQualifierPtrH dateRange(new DataStore::Logic::Range((*fields)[1],
+          (*fields)[1]->fromString("2014-04-02"), (*fields)[1]->fromString("2014-04-03")));
+        DataStore::Predicate filter(dateRange);
+
+        DataStore::IQueryResultConstPtrH result = database.query(NULL, &filter);
+        Assert::AreEqual((size_t)2, result->size());
+
+        // Candidates from an index are returned in row order
+        DataStore::ValueConstPtrH key = (*result)[0]->getValue(*(*fields)[0]);
+        Assert::IsTrue(*key == *(*fields)[0]->fromString("b"));
+        key = (*result)[1]->getValue(*(*fields)[0]);
+        Assert::IsTrue(*key == *(*fields)[0]->fromString("c"));
+      }
+      catch (std::exception& ex)
+      {
+        Logger::WriteMessage(ex.what());
+        Assert::Fail(L"Exception");
+      }
+    }
+
+    TEST_METHOD(GivenBitmapIndexVerifyOrQuery)
+    {
+      const char* schemeJson =
+        "[                          "
+        "  {                        "
+        "    \"name\": \"keyField\",  "
+        "    \"type\": \"text\",    "
+        "    \"key\": true,         "
+        "    \"description\": \"This is a key field\" "
+        "  },                       "
+        "  {                        "
+        "    \"name\": \"providerField\", "
+        "    \"type\": \"text\",    "
+        "    \"index\": \"bitmap\", "
+        "    \"description\": \"This is a low-cardinality field\" "
+        "  }                        "
+        "]                          ";
+
+      try
+      {
+        DataStore::Database database(DataStore::ISchemeConstPtrH(
+          new DataStore::SchemeJson(schemeJson)));
+        DataStore::IFieldDescriptorConstListConstPtrH fields =
+          database.getScheme()->getFieldDescriptors();
+        DataStore::IFieldDescriptorConstPtrH provider = (*fields)[1];
+
+        const char* providers[] = { "warner", "disney", "fox" };
+        for (int i = 0; i < 300; ++i)
+        {
+          char key[16];
+          sprintf(key, "key%d", i);
+
+          DataStore::IRowPtrH newRow = database.createRow();
+          newRow->setValue(*(*fields)[0], (*fields)[0]->fromString(key));
+          newRow->setValue(*provider, provider->fromString(providers[i % 3]));
+          Assert::IsTrue(database.insert(newRow));
+        }
+
+        DataStore::Logic::Or* either = new DataStore::Logic::Or();
+        DataStore::IQualifierPtrH eitherProvider(either);
+        either->with(DataStore::IQualifierPtrH(
+          new DataStore::Logic::Exact(provider, provider->fromString("disney"))));
+        either->with(DataStore::IQualifierPtrH(
+          new DataStore::Logic::Exact(provider, provider->fromString("fox"))));
+        DataStore::Predicate filter(eitherProvider);
+
+        DataStore::IQueryResultConstPtrH result = database.query(NULL, &filter);
+        Assert::AreEqual((size_t)200, result->size());
+
+        for (size_t i = 0; i < result->size(); ++i)
+        {
+          DataStore::ValueConstPtrH value = (*result)[i]->getValue(*provider);
+          Assert::IsFalse(*value == *provider->fromString("warner"));
+        }
+      }
+      catch (std::exception& ex)
+      {
+        Logger::WriteMessage(ex.what());
+        Assert::Fail(L"Exception");
+      }
+    }
+
+    TEST_METHOD(GivenReorderedTermsVerifySameDescription)
+    {
+      try
+      {
+        DataStore::ISchemeConstPtrH scheme = CreateIndexedScheme();
+        DataStore::IFieldDescriptorConstListConstPtrH fields = scheme->getFieldDescriptors();
+        DataStore::IFieldDescriptorConstPtrH key = (*fields)[0];
+        DataStore::IFieldDescriptorConstPtrH date = (*fields)[1];
+
+        DataStore::IQualifierPtrH keyTerm(
+          new DataStore::Logic::Exact(key, key->fromString("abc")));
+        DataStore::IQualifierPtrH dateTerm(
+          new DataStore::Logic::Range(date, date->fromString("2014-04-01"), NULL));
+
+        DataStore::Logic::And* keyFirst = new DataStore::Logic::And();
+        DataStore::IQualifierPtrH keyFirstRoot(keyFirst);
+        keyFirst->with(keyTerm);
+        keyFirst->with(dateTerm);
+
+        DataStore::Logic::And* dateFirst = new DataStore::Logic::And();
+        DataStore::IQualifierPtrH dateFirstRoot(dateFirst);
+        dateFirst->with(dateTerm);
+        dateFirst->with(keyTerm);
+
+        std::string keyFirstText;
+        DataStore::Predicate(keyFirstRoot).describe(&keyFirstText);
+        std::string dateFirstText;
+        DataStore::Predicate(dateFirstRoot).describe(&dateFirstText);
+        Assert::IsTrue(keyFirstText == dateFirstText);
+
+        // Another value reads differently, and matching all reads empty
+        std::string otherText;
+        DataStore::Predicate(DataStore::IQualifierPtrH(
+          new DataStore::Logic::Exact(key, key->fromString("abd")))).describe(&otherText);
+        Assert::IsTrue(otherText != keyFirstText);
+        std::string allText;
+        DataStore::Predicate::AlwaysTrue().describe(&allText);
+        Assert::IsTrue(allText.empty());
+      }
+      catch (std::exception& ex)
+      {
+        Logger::WriteMessage(ex.what());
+        Assert::Fail(L"Exception");
+      }
+    }
+  };
+}
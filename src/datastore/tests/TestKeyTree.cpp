@@ -0,0 +1,109 @@
+
+#include "CppUnitTest.h"
+#include <datastore/KeyTree.h>
+#include <datastore/JsonStorage.h>
+#include <stdio.h>
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+
+namespace Tests
+{
+  TEST_CLASS(TestKeyTree)
+  {
+  public:
+    static DataStore::ISchemeConstPtrH CreateScheme()
+    {
+      const char* schemeJson =
+        "[                          "
+        "  {                        "
+        "    \"name\": \"textField\", "
+        "    \"type\": \"text\",    "
+        "    \"key\": true,         "
+        "    \"description\": \"This is a key field\" "
+        "  },                       "
+        "  {                        "
+        "    \"name\": \"floatField\", "
+        "    \"type\": \"float\",   "
+        "    \"key\": true,         "
+        "    \"description\": \"This is a key field\" "
+        "  }                        "
+        "]                          ";
+
+      return DataStore::ISchemeConstPtrH(new DataStore::SchemeJson(schemeJson));
+    }
+
+    /** The key of a row with text, and number unless it's 0 */
+    static std::string Key(const DataStore::ISchemeConstPtrH& scheme, const char* text, int number)
+    {
+      DataStore::IFieldDescriptorConstListConstPtrH fields = scheme->getFieldDescriptors();
+      DataStore::Row row(*fields);
+      row.setValue(*(*fields)[0], (*fields)[0]->fromString(text));
+      if (number != 0)
+      {
+        char value[32];
+        sprintf(value, "%d.5", number);
+        row.setValue(*(*fields)[1], (*fields)[1]->fromString(value));
+      }
+
+      return DataStore::KeyTree::EncodeKey(*scheme->getKeyFieldDescriptors(), row);
+    }
+
+    TEST_METHOD(GivenManyKeysVerifyEachFound)
+    {
+      try
+      {
+        DataStore::ISchemeConstPtrH scheme = CreateScheme();
+
+        // Enough keys for a few levels of pages, with negative, missing
+        // and positive floats
+        DataStore::KeyTree::EntryList entries;
+        for (int i = 0; i < 20000; ++i)
+        {
+          char text[32];
+          sprintf(text, "stb%d", i % 1000);
+          entries.push_back(DataStore::KeyTree::Entry(Key(scheme, text, i / 1000 - 10), i));
+        }
+
+        std::vector<char> pages;
+        Assert::IsTrue(DataStore::KeyTree::Build(&entries, &pages));
+        Assert::IsTrue(pages.size() > 100 * DataStore::KeyTree::kPageSize);
+
+        DataStore::KeyTree tree(&pages[0], pages.size());
+        for (int i = 0; i < 20000; ++i)
+        {
+          char text[32];
+          sprintf(text, "stb%d", i % 1000);
+
+          uint64_t position = 0;
+          Assert::IsTrue(tree.find(Key(scheme, text, i / 1000 - 10), &position));
+          Assert::AreEqual((uint64_t)i, position);
+        }
+
+        uint64_t position = 0;
+        Assert::IsFalse(tree.find(Key(scheme, "stb1000", 1), &position));
+        Assert::IsFalse(tree.find(Key(scheme, "stb1", 11), &position));
+        Assert::IsFalse(tree.find(Key(scheme, "", 0), &position));
+        Assert::IsFalse(tree.find(Key(scheme, "zzz", 0), &position));
+      }
+      catch (std::exception& ex)
+      {
+        Logger::WriteMessage(ex.what());
+        Assert::Fail(L"Exception");
+      }
+    }
+
+    TEST_METHOD(GivenOversizedKeyVerifyNoTree)
+    {
+      DataStore::ISchemeConstPtrH scheme = CreateScheme();
+
+      DataStore::KeyTree::EntryList entries;
+      entries.push_back(DataStore::KeyTree::Entry(Key(scheme, "a", 1), 0));
+      entries.push_back(DataStore::KeyTree::Entry(
+        std::string(DataStore::KeyTree::kMaxKeySize + 1, 'b'), 1));
+
+      std::vector<char> pages;
+      Assert::IsFalse(DataStore::KeyTree::Build(&entries, &pages));
+      Assert::IsTrue(pages.empty());
+    }
+  };
+}
@@ -0,0 +1,160 @@
+
+#include "CppUnitTest.h"
+#include <datastore/Database.h>
+#include <datastore/JsonStorage.h>
+#include <datastore/LsmStorage.h>
+#include <datastore/FileSystem.h>
+#include <stdio.h>
+
+#ifdef _WIN32
+#include <direct.h>
+#define rmdir _rmdir
+#else
+#include <unistd.h>
+#endif
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+
+namespace Tests
+{
+  TEST_CLASS(TestLsm)
+  {
+  public:
+    static DataStore::ISchemeConstPtrH CreateScheme()
+    {
+      const char* schemeJson =
+        "[                          "
+        "  {                        "
+        "    \"name\": \"keyField\",  "
+        "    \"type\": \"text\",    "
+        "    \"key\": true,         "
+        "    \"description\": \"This is a key field\" "
+        "  },                       "
+        "  {                        "
+        "    \"name\": \"floatField\", "
+        "    \"type\": \"float\",   "
+        "    \"description\": \"This is a float field\" "
+        "  }                        "
+        "]                          ";
+
+      return DataStore::ISchemeConstPtrH(new DataStore::SchemeJson(schemeJson));
+    }
+
+    /** True if the key was put before */
+    static bool Put(DataStore::DataStorageLsm* lsm, const char* key, const char* value)
+    {
+      DataStore::IFieldDescriptorConstListConstPtrH fields =
+        lsm->getScheme()->getFieldDescriptors();
+
+      DataStore::IRowPtrH row(new DataStore::Row(*fields));
+      row->setValue(*(*fields)[0], (*fields)[0]->fromString(key));
+      row->setValue(*(*fields)[1], (*fields)[1]->fromString(value));
+      return lsm->put(row);
+    }
+
+    static void RemoveDatabase(const char* directory)
+    {
+      std::vector<std::string> names;
+      DataStore::FileSystem::ListFiles(directory, &names);
+      for (size_t i = 0; i < names.size(); ++i)
+      {
+        remove((std::string(directory) + "/" + names[i]).c_str());
+      }
+      rmdir(directory);
+    }
+
+    TEST_METHOD(GivenOverwritingRunsVerifyNewestRowWins)
+    {
+      const char* directory = "TestLsm";
+
+      try
+      {
+        {
+          DataStore::DataStorageLsmPtrH lsm =
+            DataStore::DataStorageLsm::Create(CreateScheme(), directory);
+          Assert::IsFalse(Put(lsm.get(), "a", "1.0"));
+          Assert::IsFalse(Put(lsm.get(), "b", "1.0"));
+          Assert::IsFalse(Put(lsm.get(), "c", "1.0"));
+          lsm->flush();
+
+          // b is replaced twice, first in the run and then within the memtable
+          Assert::IsFalse(Put(lsm.get(), "d", "2.0"));
+          Assert::IsTrue(Put(lsm.get(), "b", "2.0"));
+          Assert::IsTrue(Put(lsm.get(), "b", "3.0"));
+          lsm->flush();
+          lsm->waitForCompaction();
+        }
+
+        Assert::IsTrue(DataStore::DataStorageLsm::IsLsm(directory));
+
+        for (int compacted = 0; compacted < 2; ++compacted)
+        {
+          {
+            DataStore::DatabasePtrH database = DataStore::DataStorageLsm::Load(directory);
+            DataStore::IFieldDescriptorConstListConstPtrH fields =
+              database->getScheme()->getFieldDescriptors();
+
+            DataStore::IFieldDescriptorConstListPtrH orderBy(new DataStore::IFieldDescriptorConstList());
+            orderBy->push_back((*fields)[0]);
+
+            DataStore::IQueryResultConstPtrH result = database->query(NULL, NULL, orderBy);
+            Assert::AreEqual((size_t)4, result->size());
+            Assert::IsTrue(*(*result)[1]->getValue(*(*fields)[0]) == *(*fields)[0]->fromString("b"));
+            Assert::IsTrue(*(*result)[1]->getValue(*(*fields)[1]) == *(*fields)[1]->fromString("3.0"));
+            Assert::IsTrue(*(*result)[2]->getValue(*(*fields)[1]) == *(*fields)[1]->fromString("1.0"));
+
+            // The newest run's row of b is found by key, not the one it hides
+            DataStore::Predicate key(DataStore::IQualifierPtrH(new DataStore::Logic::Exact(
+              (*fields)[0], (*fields)[0]->fromString("b"))));
+            result = database->query(NULL, &key);
+            Assert::AreEqual((size_t)1, result->size());
+            Assert::IsTrue(*(*result)[0]->getValue(*(*fields)[1]) == *(*fields)[1]->fromString("3.0"));
+          }
+
+          DataStore::DataStorageLsm::Open(directory)->compact();
+          Assert::AreEqual((size_t)1, DataStore::DataStorageLsm::Open(directory)->getRunCount());
+        }
+      }
+      catch (std::exception& ex)
+      {
+        Logger::WriteMessage(ex.what());
+        Assert::Fail(L"Exception");
+      }
+
+      RemoveDatabase(directory);
+    }
+
+    TEST_METHOD(GivenManyFlushesVerifyRunsCompacted)
+    {
+      const char* directory = "TestLsmCompacted";
+
+      try
+      {
+        DataStore::DataStorageLsmPtrH lsm =
+          DataStore::DataStorageLsm::Create(CreateScheme(), directory);
+        lsm->setMemtableLimit(1);
+
+        const char* keys[] = { "a", "b", "c", "d", "e", "f", "g", "h" };
+        for (int i = 0; i < 8; ++i)
+        {
+          Put(lsm.get(), keys[i], "1.0");
+        }
+        lsm->waitForCompaction();
+
+        // Each row was flushed as a run of its own, and merged since
+        Assert::IsTrue(lsm->getRunCount() < 8);
+        Assert::IsTrue(lsm->getCompactionCount() > 0);
+
+        DataStore::DatabasePtrH database = DataStore::DataStorageLsm::Load(directory);
+        Assert::AreEqual((size_t)8, database->query()->size());
+      }
+      catch (std::exception& ex)
+      {
+        Logger::WriteMessage(ex.what());
+        Assert::Fail(L"Exception");
+      }
+
+      RemoveDatabase(directory);
+    }
+  };
+}
@@ -0,0 +1,261 @@
+
+#include "CppUnitTest.h"
+#include <datastore/Database.h>
+#include <datastore/JsonStorage.h>
+#include <datastore/PartitionedStorage.h>
+#include <stdio.h>
+
+#ifdef _WIN32
+#include <direct.h>
+#define rmdir _rmdir
+#else
+#include <unistd.h>
+#endif
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+
+namespace Tests
+{
+  TEST_CLASS(TestPartitioned)
+  {
+  public:
+    /** Keyed by keyField, or by keyField and dateField */
+    static DataStore::ISchemeConstPtrH CreateScheme(bool isDateKey = false)
+    {
+      const char* schemeJson = isDateKey ?
+        "[                          "
+        "  {                        "
+        "    \"name\": \"keyField\",  "
+        "    \"type\": \"text\",    "
+        "    \"key\": true,         "
+        "    \"description\": \"This is a key field\" "
+        "  },                       "
+        "  {                        "
+        "    \"name\": \"dateField\", "
+        "    \"type\": \"date\",    "
+        "    \"key\": true,         "
+        "    \"partition\": \"month\", "
+        "    \"description\": \"This is a partitioned date key field\" "
+        "  }                        "
+        "]                          " :
+        "[                          "
+        "  {                        "
+        "    \"name\": \"keyField\",  "
+        "    \"type\": \"text\",    "
+        "    \"key\": true,         "
+        "    \"description\": \"This is a key field\" "
+        "  },                       "
+        "  {                        "
+        "    \"name\": \"dateField\", "
+        "    \"type\": \"date\",    "
+        "    \"partition\": \"month\", "
+        "    \"description\": \"This is a partitioned date field\" "
+        "  }                        "
+        "]                          ";
+
+      return DataStore::ISchemeConstPtrH(new DataStore::SchemeJson(schemeJson));
+    }
+
+    /** Rows a to e, across the partitions 2014-03, 2014-04 and 2014-05 */
+    static void WriteDatabase(const char* directory, bool isDateKey = false)
+    {
+      DataStore::DatabasePtrH database =
+        DataStore::DataStoragePartitioned::Create(CreateScheme(isDateKey), directory);
+      DataStore::IFieldDescriptorConstListConstPtrH fields =
+        database->getScheme()->getFieldDescriptors();
+
+      const char* values[][2] = {
+        { "a", "2014-03-31" },
+        { "b", "2014-04-01" },
+        { "c", "2014-04-30" },
+        { "d", "2014-05-01" },
+        { "e", "2014-05-15" }
+      };
+
+      for (int i = 0; i < 5; ++i)
+      {
+        DataStore::IRowPtrH row = database->createRow();
+        for (size_t field = 0; field < fields->size(); ++field)
+        {
+          row->setValue(*(*fields)[field], (*fields)[field]->fromString(values[i][field]));
+        }
+        Assert::IsTrue(database->insert(row));
+      }
+    }
+
+    static DataStore::IRowPtrH CreateRow(DataStore::DataStoragePartitioned& storage,
+      const char* key, const char* date)
+    {
+      DataStore::IFieldDescriptorConstListConstPtrH fields =
+        storage.getScheme()->getFieldDescriptors();
+
+      DataStore::IRowPtrH row(new DataStore::Row(*fields));
+      row->setValue(*(*fields)[0], (*fields)[0]->fromString(key));
+      row->setValue(*(*fields)[1], (*fields)[1]->fromString(date));
+      return row;
+    }
+
+    static long GetFileSize(const std::string& filename)
+    {
+      FILE* file = fopen(filename.c_str(), "rb");
+      Assert::IsTrue(file != NULL);
+      fseek(file, 0, SEEK_END);
+      long size = ftell(file);
+      fclose(file);
+      return size;
+    }
+
+    static void RemoveDatabase(const char* directory)
+    {
+      const char* files[] = { "scheme.json", "2014-03.snap", "2014-04.snap", "2014-05.snap",
+        "2014-06.snap" };
+      for (int i = 0; i < 5; ++i)
+      {
+        remove((std::string(directory) + "/" + files[i]).c_str());
+      }
+      rmdir(directory);
+    }
+
+    TEST_METHOD(GivenDateFilterVerifyPartitionsPruned)
+    {
+      const char* directory = "TestPartitioned";
+
+      try
+      {
+        WriteDatabase(directory);
+        Assert::IsTrue(DataStore::DataStoragePartitioned::IsPartitioned(directory));
+
+        DataStore::DataStoragePartitionedPtrH storage =
+          DataStore::DataStoragePartitioned::Open(directory);
+        Assert::AreEqual((size_t)3, storage->getPartitionCount());
+
+        DataStore::IFieldDescriptorConstPtrH dateField = (*storage->getScheme()->getFieldDescriptors())[1];
+
+        // Only April is loaded
+        DataStore::Predicate april(DataStore::IQualifierPtrH(new DataStore::Logic::Range(
+          dateField, dateField->fromString("2014-04-10"), dateField->fromString("2014-04-30"))));
+        DataStore::Database database(storage, NULL, &april);
+
+        DataStore::QueryStats stats;
+        DataStore::IQueryResultConstPtrH result = database.query(NULL, &april, NULL, &stats);
+        Assert::AreEqual((size_t)1, result->size());
+        Assert::AreEqual((size_t)2, stats.rowsScanned);
+
+        // All rows are loaded without a filter
+        DataStore::DatabasePtrH all = DataStore::DataStoragePartitioned::Load(directory);
+        Assert::AreEqual((size_t)5, all->query()->size());
+      }
+      catch (std::exception& ex)
+      {
+        Logger::WriteMessage(ex.what());
+        Assert::Fail(L"Exception");
+      }
+
+      RemoveDatabase(directory);
+    }
+
+    TEST_METHOD(GivenExpiredPartitionsVerifyDropped)
+    {
+      const char* directory = "TestPartitionedDropped";
+
+      try
+      {
+        WriteDatabase(directory);
+
+        DataStore::DataStoragePartitionedPtrH storage =
+          DataStore::DataStoragePartitioned::Open(directory);
+
+        // April isn't over on the 30th
+        DataStore::Date date;
+        date.fromString("2014-04-30");
+        Assert::AreEqual((size_t)1, storage->dropBefore(date));
+        Assert::AreEqual((size_t)2, storage->getPartitionCount());
+
+        DataStore::DatabasePtrH database = DataStore::DataStoragePartitioned::Load(directory);
+        Assert::AreEqual((size_t)4, database->query()->size());
+      }
+      catch (std::exception& ex)
+      {
+        Logger::WriteMessage(ex.what());
+        Assert::Fail(L"Exception");
+      }
+
+      RemoveDatabase(directory);
+    }
+
+    TEST_METHOD(GivenPutRowsVerifyOtherPartitionsLeftInPlace)
+    {
+      const char* directory = "TestPartitionedPut";
+
+      try
+      {
+        WriteDatabase(directory, true);
+
+        // A byte past the end of March, which a rewrite would drop
+        std::string march = std::string(directory) + "/2014-03.snap";
+        FILE* file = fopen(march.c_str(), "ab");
+        Assert::IsTrue(file != NULL);
+        fputc(0, file);
+        fclose(file);
+        long marchSize = GetFileSize(march);
+
+        DataStore::DataStoragePartitionedPtrH storage =
+          DataStore::DataStoragePartitioned::Open(directory);
+        storage->put(CreateRow(*storage, "b", "2014-04-01"));
+        storage->put(CreateRow(*storage, "f", "2014-06-02"));
+        storage->put(CreateRow(*storage, "f", "2014-06-02"));
+
+        size_t inserted = 0;
+        size_t replaced = 0;
+        storage->flush(&inserted, &replaced);
+        Assert::AreEqual((size_t)1, inserted);
+        Assert::AreEqual((size_t)2, replaced);
+        Assert::AreEqual((size_t)4, storage->getPartitionCount());
+
+        Assert::AreEqual(marchSize, GetFileSize(march));
+
+        DataStore::DatabasePtrH database = DataStore::DataStoragePartitioned::Load(directory);
+        Assert::AreEqual((size_t)6, database->query()->size());
+      }
+      catch (std::exception& ex)
+      {
+        Logger::WriteMessage(ex.what());
+        Assert::Fail(L"Exception");
+      }
+
+      RemoveDatabase(directory);
+    }
+
+    TEST_METHOD(GivenPutRowWithNewDateVerifyMovedPartition)
+    {
+      const char* directory = "TestPartitionedMoved";
+
+      try
+      {
+        WriteDatabase(directory);
+
+        // The date isn't part of the key, so a moves from March to May
+        DataStore::DataStoragePartitionedPtrH storage =
+          DataStore::DataStoragePartitioned::Open(directory);
+        storage->put(CreateRow(*storage, "a", "2014-05-20"));
+
+        size_t inserted = 0;
+        size_t replaced = 0;
+        storage->flush(&inserted, &replaced);
+        Assert::AreEqual((size_t)0, inserted);
+        Assert::AreEqual((size_t)1, replaced);
+        Assert::AreEqual((size_t)2, storage->getPartitionCount());
+
+        DataStore::DatabasePtrH database = DataStore::DataStoragePartitioned::Load(directory);
+        Assert::AreEqual((size_t)5, database->query()->size());
+      }
+      catch (std::exception& ex)
+      {
+        Logger::WriteMessage(ex.what());
+        Assert::Fail(L"Exception");
+      }
+
+      RemoveDatabase(directory);
+    }
+  };
+}
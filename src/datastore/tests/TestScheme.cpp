@@ -133,5 +133,60 @@ namespace Tests
         // Exception expected
       }
     }
+
+    TEST_METHOD(GivenPartitionedTextFieldVerifyFailure)
+    {
+      const char* schemeJson =
+        "[                          "
+        "  {                        "
+        "    \"name\": \"field1\",  "
+        "    \"type\": \"text\",    "
+        "    \"key\": true,         "
+        "    \"partition\": \"month\", "
+        "    \"description\": \"Only dates can be partitioned\" "
+        "  }                        "
+        "]                          ";
+
+      try
+      {
+        DataStore::SchemeJson scheme(schemeJson);
+        Assert::Fail(L"Exception expected, but missed");
+      }
+      catch (std::exception& ex)
+      {
+        (void)ex;
+        // Exception expected
+      }
+    }
+
+    TEST_METHOD(GivenAggregatedTextFieldVerifyFailure)
+    {
+      const char* schemeJson =
+        "[                          "
+        "  {                        "
+        "    \"name\": \"field1\",  "
+        "    \"type\": \"text\",    "
+        "    \"key\": true,         "
+        "    \"description\": \"The group\" "
+        "  },                       "
+        "  {                        "
+        "    \"name\": \"field2\",  "
+        "    \"type\": \"text\",    "
+        "    \"aggregateBy\": [\"field1\"], "
+        "    \"description\": \"Only floats can be summed\" "
+        "  }                        "
+        "]                          ";
+
+      try
+      {
+        DataStore::SchemeJson scheme(schemeJson);
+        Assert::Fail(L"Exception expected, but missed");
+      }
+      catch (std::exception& ex)
+      {
+        (void)ex;
+        // Exception expected
+      }
+    }
 	};
 }
\ No newline at end of file
@@ -0,0 +1,334 @@
+
+#include "CppUnitTest.h"
+#include <datastore/Database.h>
+#include <datastore/JsonStorage.h>
+#include <datastore/SnapshotStorage.h>
+#include <stdio.h>
+#include <string>
+#include <vector>
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+
+namespace Tests
+{
+  TEST_CLASS(TestSnapshot)
+  {
+  public:
+    static DataStore::ISchemeConstPtrH CreateScheme()
+    {
+      const char* schemeJson =
+        "[                          "
+        "  {                        "
+        "    \"name\": \"keyField\",  "
+        "    \"type\": \"text\",    "
+        "    \"key\": true,         "
+        "    \"description\": \"This is a key field\" "
+        "  },                       "
+        "  {                        "
+        "    \"name\": \"dateField\", "
+        "    \"type\": \"date\",    "
+        "    \"description\": \"This is a date field\" "
+        "  },                       "
+        "  {                        "
+        "    \"name\": \"timeField\", "
+        "    \"type\": \"time\",    "
+        "    \"description\": \"This is a time field\" "
+        "  },                       "
+        "  {                        "
+        "    \"name\": \"floatField\", "
+        "    \"type\": \"float\",   "
+        "    \"description\": \"This is a float field\" "
+        "  }                        "
+        "]                          ";
+
+      return DataStore::ISchemeConstPtrH(new DataStore::SchemeJson(schemeJson));
+    }
+
+    /** Write rows keyed a, b and c to a snapshot.  Row b has no float value. */
+    static void WriteSnapshot(const char* filename)
+    {
+      DataStore::ISchemeConstPtrH scheme = CreateScheme();
+      DataStore::Database database(scheme);
+      DataStore::IFieldDescriptorConstListConstPtrH fields = scheme->getFieldDescriptors();
+
+      const char* values[][4] = {
+        { "a", "2014-04-01", "01:0030", "4.5" },
+        { "b", "2014-04-02", "02:0045", NULL },
+        { "c", "2014-04-03", "00:0100", "8.0" }
+      };
+
+      for (int i = 0; i < 3; ++i)
+      {
+        DataStore::IRowPtrH row = database.createRow();
+        for (size_t field = 0; field < fields->size(); ++field)
+        {
+          if (values[i][field] != NULL)
+          {
+            row->setValue(*(*fields)[field], (*fields)[field]->fromString(values[i][field]));
+          }
+        }
+        Assert::IsTrue(database.insert(row));
+      }
+
+      DataStore::DataStorageSnapshotPtrH snapshot =
+        DataStore::DataStorageSnapshot::Create(scheme, filename);
+
+      snapshot->beginPersist();
+      DataStore::IQueryCursorPtrH cursor = database.openCursor();
+      for (const DataStore::IRow* row = cursor->next(); row != NULL; row = cursor->next())
+      {
+        snapshot->persistRow(row);
+      }
+      snapshot->endPersist();
+    }
+
+    TEST_METHOD(GivenPersistedRowsVerifySnapshotValues)
+    {
+      const char* filename = "TestSnapshot.snap";
+
+      try
+      {
+        WriteSnapshot(filename);
+        Assert::IsTrue(DataStore::DataStorageSnapshot::IsSnapshot(filename));
+
+        DataStore::DatabasePtrH database = DataStore::DataStorageSnapshot::Load(filename);
+        DataStore::IFieldDescriptorConstListConstPtrH fields =
+          database->getScheme()->getFieldDescriptors();
+        Assert::AreEqual((size_t)4, fields->size());
+
+        DataStore::IFieldDescriptorConstPtrH keyField = (*fields)[0];
+        DataStore::IFieldDescriptorConstPtrH dateField = (*fields)[1];
+        DataStore::IFieldDescriptorConstPtrH timeField = (*fields)[2];
+        DataStore::IFieldDescriptorConstPtrH floatField = (*fields)[3];
+
+        DataStore::IQueryResultConstPtrH result = database->query();
+        Assert::AreEqual((size_t)3, result->size());
+
+        DataStore::IRowConstPtrH row = (*result)[1];
+        Assert::IsTrue(*row->getValue(*keyField) == *keyField->fromString("b"));
+        Assert::IsTrue(*row->getValue(*dateField) == *dateField->fromString("2014-04-02"));
+        Assert::IsTrue(*row->getValue(*timeField) == *timeField->fromString("02:0045"));
+        Assert::IsTrue(!row->getValue(*floatField));
+
+        row = (*result)[2];
+        Assert::IsTrue(*row->getValue(*floatField) == *floatField->fromString("8.0"));
+
+        // Stored zones rule out the only block
+        DataStore::Predicate later(DataStore::IQualifierPtrH(new DataStore::Logic::Range(
+          dateField, dateField->fromString("2014-05-01"), NULL)));
+        DataStore::QueryStats stats;
+        result = database->query(NULL, &later, NULL, &stats);
+        Assert::AreEqual((size_t)0, result->size());
+        Assert::AreEqual((size_t)1, stats.blocksSkipped);
+
+        // The key tree finds the only row that can match
+        DataStore::Predicate key(DataStore::IQualifierPtrH(new DataStore::Logic::Exact(
+          keyField, keyField->fromString("b"))));
+        DataStore::QueryStats keyStats;
+        result = database->query(NULL, &key, NULL, &keyStats);
+        Assert::AreEqual((size_t)1, result->size());
+        Assert::IsTrue(keyStats.usedIndex);
+        Assert::AreEqual((size_t)1, keyStats.rowsScanned);
+
+        DataStore::Predicate missing(DataStore::IQualifierPtrH(new DataStore::Logic::Exact(
+          keyField, keyField->fromString("bb"))));
+        result = database->query(NULL, &missing);
+        Assert::AreEqual((size_t)0, result->size());
+      }
+      catch (std::exception& ex)
+      {
+        Logger::WriteMessage(ex.what());
+        Assert::Fail(L"Exception");
+      }
+
+      remove(filename);
+    }
+
+    TEST_METHOD(GivenShortBlockCountVerifyFailure)
+    {
+      const char* filename = "TestSnapshotBlocks.snap";
+
+      try
+      {
+        WriteSnapshot(filename);
+
+        // The block count follows the magic, version, field count, row
+        // count and rows per block
+        FILE* file = fopen(filename, "r+b");
+        Assert::IsTrue(file != NULL);
+        uint64_t blockCount = 0;
+        fseek(file, 32, SEEK_SET);
+        fwrite(&blockCount, sizeof(blockCount), 1, file);
+        fclose(file);
+
+        try
+        {
+          DataStore::DataStorageSnapshot::Load(filename);
+          Assert::Fail(L"Exception expected, but missed");
+        }
+        catch (std::runtime_error& ex)
+        {
+          (void)ex;
+          // Its rows would never be scanned
+        }
+      }
+      catch (std::exception& ex)
+      {
+        Logger::WriteMessage(ex.what());
+        Assert::Fail(L"Exception");
+      }
+
+      remove(filename);
+    }
+
+    TEST_METHOD(GivenBufferPoolVerifySnapshotValues)
+    {
+      const char* filename = "TestSnapshotPool.snap";
+
+      try
+      {
+        WriteSnapshot(filename);
+
+        DataStore::BufferPoolPtrH pool(new DataStore::BufferPool(0));
+        DataStore::DatabasePtrH database = DataStore::DataStorageSnapshot::Load(filename, pool);
+        DataStore::IFieldDescriptorConstListConstPtrH fields =
+          database->getScheme()->getFieldDescriptors();
+
+        DataStore::IQueryResultConstPtrH result = database->query();
+        Assert::AreEqual((size_t)3, result->size());
+        Assert::IsTrue(*(*result)[2]->getValue(*(*fields)[0]) == *(*fields)[0]->fromString("c"));
+        Assert::IsTrue(*(*result)[2]->getValue(*(*fields)[1]) == *(*fields)[1]->fromString("2014-04-03"));
+        Assert::IsTrue(!(*result)[1]->getValue(*(*fields)[3]));
+
+        // The key tree is read through the pool too
+        DataStore::Predicate key(DataStore::IQualifierPtrH(new DataStore::Logic::Exact(
+          (*fields)[0], (*fields)[0]->fromString("a"))));
+        result = database->query(NULL, &key);
+        Assert::AreEqual((size_t)1, result->size());
+
+        Assert::IsTrue(pool->getMissCount() > 0);
+        Assert::IsTrue(pool->getHitCount() > 0);
+      }
+      catch (std::exception& ex)
+      {
+        Logger::WriteMessage(ex.what());
+        Assert::Fail(L"Exception");
+      }
+
+      remove(filename);
+    }
+
+    TEST_METHOD(GivenSmallPoolVerifyTextSurvivesEviction)
+    {
+      const char* filename = "TestSnapshotEviction.snap";
+      const size_t rowCount = 2000;
+
+      try
+      {
+        // Keys of about 100 bytes, so their heap spans many more pages than
+        // the pool holds
+        std::vector<std::string> keys;
+        {
+          DataStore::ISchemeConstPtrH scheme = CreateScheme();
+          DataStore::IFieldDescriptorConstPtrH keyField = (*scheme->getFieldDescriptors())[0];
+
+          DataStore::DataStorageSnapshotPtrH snapshot =
+            DataStore::DataStorageSnapshot::Create(scheme, filename);
+          snapshot->beginPersist();
+          for (size_t i = 0; i < rowCount; ++i)
+          {
+            char key[128];
+            sprintf(key, "%05u %s", (unsigned)i,
+              "a key long enough that the text heap is many pages larger than the pool");
+            keys.push_back(key);
+
+            DataStore::Row row(*scheme->getFieldDescriptors());
+            row.setValue(*keyField, keyField->fromString(keys.back().c_str()));
+            snapshot->persistRow(&row);
+          }
+          snapshot->endPersist();
+        }
+
+        DataStore::BufferPoolPtrH pool(new DataStore::BufferPool(0));
+        DataStore::DatabasePtrH database = DataStore::DataStorageSnapshot::Load(filename, pool);
+        DataStore::IFieldDescriptorConstPtrH keyField =
+          (*database->getScheme()->getFieldDescriptors())[0];
+
+        // Every value is read before any is checked, so the pages they were
+        // read from have long been evicted
+        DataStore::IQueryResultConstPtrH result = database->query();
+        Assert::AreEqual(rowCount, result->size());
+
+        std::vector<DataStore::ValueConstPtrH> values;
+        for (size_t i = 0; i < rowCount; ++i)
+        {
+          values.push_back((*result)[i]->getValue(*keyField));
+        }
+        Assert::IsTrue(pool->getEvictionCount() > 0);
+
+        for (size_t i = 0; i < rowCount; ++i)
+        {
+          mStd::mString key;
+          Assert::IsTrue(values[i]->getValue().convertTo(&key));
+          Assert::AreEqual(keys[i], std::string(key.c_str()));
+        }
+      }
+      catch (std::exception& ex)
+      {
+        Logger::WriteMessage(ex.what());
+        Assert::Fail(L"Exception");
+      }
+
+      remove(filename);
+    }
+
+    TEST_METHOD(GivenModifiedSnapshotVerifyRowsPersisted)
+    {
+      const char* filename = "TestSnapshotModified.snap";
+
+      try
+      {
+        WriteSnapshot(filename);
+
+        {
+          DataStore::DatabasePtrH database = DataStore::DataStorageSnapshot::Load(filename);
+          DataStore::IFieldDescriptorConstListConstPtrH fields =
+            database->getScheme()->getFieldDescriptors();
+
+          // Replace row a, and add row d
+          const char* keys[] = { "a", "d" };
+          for (int i = 0; i < 2; ++i)
+          {
+            DataStore::IRowPtrH row = database->createRow();
+            row->setValue(*(*fields)[0], (*fields)[0]->fromString(keys[i]));
+            row->setValue(*(*fields)[3], (*fields)[3]->fromString("16.0"));
+
+            DataStore::Database::InsertionResult insertionResult;
+            Assert::IsTrue(database->insert(row, &insertionResult));
+            Assert::IsTrue((i == 0 ? DataStore::Database::eInsertionResult_Replaced :
+              DataStore::Database::eInsertionResult_Inserted) == insertionResult);
+          }
+        }
+
+        DataStore::DatabasePtrH database = DataStore::DataStorageSnapshot::Load(filename);
+        DataStore::IFieldDescriptorConstListConstPtrH fields =
+          database->getScheme()->getFieldDescriptors();
+
+        DataStore::IQueryResultConstPtrH result = database->query();
+        Assert::AreEqual((size_t)4, result->size());
+
+        DataStore::IRowConstPtrH row = (*result)[0];
+        Assert::IsTrue(*row->getValue(*(*fields)[0]) == *(*fields)[0]->fromString("a"));
+        Assert::IsTrue(*row->getValue(*(*fields)[3]) == *(*fields)[3]->fromString("16.0"));
+        Assert::IsTrue(!row->getValue(*(*fields)[1]));
+      }
+      catch (std::exception& ex)
+      {
+        Logger::WriteMessage(ex.what());
+        Assert::Fail(L"Exception");
+      }
+
+      remove(filename);
+    }
+  };
+}
@@ -0,0 +1,117 @@
+
+#include "CppUnitTest.h"
+#include <datastore/Database.h>
+#include <datastore/JsonStorage.h>
+#include <datastore/ZoneMap.h>
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+
+namespace Tests
+{
+  TEST_CLASS(TestZoneMap)
+  {
+  public:
+    static DataStore::ISchemeConstPtrH CreateScheme()
+    {
+      const char* schemeJson =
+        "[                          "
+        "  {                        "
+        "    \"name\": \"keyField\",  "
+        "    \"type\": \"text\",    "
+        "    \"key\": true,         "
+        "    \"index\": \"hash\",   "
+        "    \"description\": \"This is a key field\" "
+        "  },                       "
+        "  {                        "
+        "    \"name\": \"dateField\", "
+        "    \"type\": \"date\",    "
+        "    \"description\": \"This is an unindexed field\" "
+        "  }                        "
+        "]                          ";
+
+      return DataStore::ISchemeConstPtrH(new DataStore::SchemeJson(schemeJson));
+    }
+
+    TEST_METHOD(GivenZonesVerifyRangeOverlap)
+    {
+      try
+      {
+        DataStore::Database database(CreateScheme());
+        DataStore::IFieldDescriptorConstListConstPtrH fields =
+          database.getScheme()->getFieldDescriptors();
+        DataStore::IFieldDescriptorConstPtrH dateField = (*fields)[1];
+
+        DataStore::ZoneMap zoneMap(fields->size());
+
+        DataStore::IRowPtrH row = database.createRow();
+        row->setValue(*dateField, dateField->fromString("2014-04-01"));
+        zoneMap.update(0, *row, *fields);
+        row = database.createRow();
+        row->setValue(*dateField, dateField->fromString("2014-04-10"));
+        zoneMap.update(1, *row, *fields);
+        Assert::AreEqual((size_t)1, zoneMap.getBlockCount());
+
+        DataStore::Predicate inside(DataStore::IQualifierPtrH(new DataStore::Logic::Exact(
+          dateField, dateField->fromString("2014-04-05"))));
+        Assert::IsTrue(DataStore::ZoneFilter(inside).mayMatch(zoneMap.getZones(0)));
+
+        DataStore::Predicate after(DataStore::IQualifierPtrH(new DataStore::Logic::Range(
+          dateField, dateField->fromString("2014-04-11"), NULL)));
+        Assert::IsFalse(DataStore::ZoneFilter(after).mayMatch(zoneMap.getZones(0)));
+
+        // keyField has no values in the block, nothing can match it
+        DataStore::Predicate key(DataStore::IQualifierPtrH(new DataStore::Logic::Exact(
+          (*fields)[0], (*fields)[0]->fromString("a"))));
+        Assert::IsFalse(DataStore::ZoneFilter(key).mayMatch(zoneMap.getZones(0)));
+      }
+      catch (std::exception& ex)
+      {
+        Logger::WriteMessage(ex.what());
+        Assert::Fail(L"Exception");
+      }
+    }
+
+    TEST_METHOD(GivenDateOrderedRowsVerifyBlocksSkipped)
+    {
+      try
+      {
+        DataStore::Database database(CreateScheme());
+        DataStore::IFieldDescriptorConstListConstPtrH fields =
+          database.getScheme()->getFieldDescriptors();
+        DataStore::IFieldDescriptorConstPtrH dateField = (*fields)[1];
+
+        DataStore::ValuePtrH january = dateField->fromString("2014-01-01");
+        DataStore::ValuePtrH february = dateField->fromString("2014-02-01");
+
+        // First block all January, the rest February
+        const size_t rowCount = DataStore::ZoneMap::kRowsPerBlock + 100;
+        for (size_t i = 0; i < rowCount; ++i)
+        {
+          char key[16];
+          sprintf(key, "%u", (unsigned)i);
+
+          DataStore::IRowPtrH newRow = database.createRow();
+          newRow->setValue(*(*fields)[0], (*fields)[0]->fromString(key));
+          newRow->setValue(*dateField, 
+            i < DataStore::ZoneMap::kRowsPerBlock ? january : february);
+          Assert::IsTrue(database.insert(newRow));
+        }
+
+        DataStore::Predicate filter(DataStore::IQualifierPtrH(
+          new DataStore::Logic::Exact(dateField, february)));
+
+        DataStore::QueryStats stats;
+        DataStore::IQueryResultConstPtrH result = database.query(NULL, &filter, NULL, &stats);
+        Assert::AreEqual((size_t)100, result->size());
+        Assert::AreEqual((size_t)1, stats.blocksSkipped);
+        Assert::AreEqual((size_t)1, stats.blocksScanned);
+        Assert::AreEqual((size_t)100, stats.rowsScanned);
+      }
+      catch (std::exception& ex)
+      {
+        Logger::WriteMessage(ex.what());
+        Assert::Fail(L"Exception");
+      }
+    }
+  };
+}
@@ -0,0 +1,77 @@
+
+#ifndef __BOUNDED_QUEUE_H__
+#define __BOUNDED_QUEUE_H__
+
+#include <atomic>
+#include <vector>
+#include <stddef.h>
+
+/**
+  Fixed capacity, lock-free queue for exactly one producer thread and one
+  consumer thread.  The producer only writes the tail and the consumer 
+  only writes the head, so neither ever waits on a lock; a full or empty
+  queue is reported back to the caller instead.
+*/
+template <typename T>
+class BoundedQueue
+{
+public:
+  /** Capacity is rounded up to a power of two */
+  BoundedQueue(size_t capacity) :
+    mHead(0),
+    mTail(0)
+  {
+    size_t size = 2;
+    while (size < capacity)
+    {
+      size *= 2;
+    }
+
+    mItems.resize(size);
+    mMask = size - 1;
+  }
+
+  /** Producer only.  Returns false if the queue is full */
+  bool tryPush(const T& item)
+  {
+    size_t tail = mTail.load(std::memory_order_relaxed);
+    if (tail - mHead.load(std::memory_order_acquire) == mItems.size())
+    {
+      return false;
+    }
+
+    mItems[tail & mMask] = item;
+    mTail.store(tail + 1, std::memory_order_release);
+    return true;
+  }
+
+  /** Consumer only.  Returns false if the queue is empty */
+  bool tryPop(T* outItem)
+  {
+    size_t head = mHead.load(std::memory_order_relaxed);
+    if (head == mTail.load(std::memory_order_acquire))
+    {
+      return false;
+    }
+
+    *outItem = mItems[head & mMask];
+    mHead.store(head + 1, std::memory_order_release);
+    return true;
+  }
+
+private:
+  BoundedQueue(const BoundedQueue&);
+  BoundedQueue& operator=(const BoundedQueue&);
+
+  std::vector<T> mItems;
+  size_t mMask;
+
+  // Kept on separate cache lines, each is written by one side only
+  char mPadding0[64];
+  std::atomic<size_t> mHead;
+  char mPadding1[64];
+  std::atomic<size_t> mTail;
+  char mPadding2[64];
+};
+
+#endif
@@ -0,0 +1,145 @@
+
+#include "CharScan.h"
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define CHAR_SCAN_X86
+#include <emmintrin.h>
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#endif
+
+#if defined(__GNUC__)
+#define CHAR_SCAN_TARGET(name) __attribute__((target(name)))
+#else
+#define CHAR_SCAN_TARGET(name)
+#endif
+
+typedef const char* (*FindFirstOfFunction)(const char*, const char*, char, char);
+
+const char* FindFirstOfScalar(const char* begin, const char* end, char a, char b)
+{
+  for (; begin != end; ++begin)
+  {
+    if (*begin == a || *begin == b)
+    {
+      break;
+    }
+  }
+
+  return begin;
+}
+
+#ifdef CHAR_SCAN_X86
+
+static inline unsigned int LowestSetBit(unsigned int mask)
+{
+#ifdef _MSC_VER
+  unsigned long index;
+  _BitScanForward(&index, mask);
+  return index;
+#else
+  return __builtin_ctz(mask);
+#endif
+}
+
+static const char* FindFirstOfSse2(const char* begin, const char* end, char a, char b)
+{
+  const __m128i va = _mm_set1_epi8(a);
+  const __m128i vb = _mm_set1_epi8(b);
+
+  for (; end - begin >= 16; begin += 16)
+  {
+    __m128i chunk = _mm_loadu_si128((const __m128i*)begin);
+    __m128i found = _mm_or_si128(_mm_cmpeq_epi8(chunk, va), _mm_cmpeq_epi8(chunk, vb));
+
+    unsigned int mask = (unsigned int)_mm_movemask_epi8(found);
+    if (mask != 0)
+    {
+      return begin + LowestSetBit(mask);
+    }
+  }
+
+  return FindFirstOfScalar(begin, end, a, b);
+}
+
+CHAR_SCAN_TARGET("avx2")
+static const char* FindFirstOfAvx2(const char* begin, const char* end, char a, char b)
+{
+  const __m256i va = _mm256_set1_epi8(a);
+  const __m256i vb = _mm256_set1_epi8(b);
+
+  for (; end - begin >= 32; begin += 32)
+  {
+    __m256i chunk = _mm256_loadu_si256((const __m256i*)begin);
+    __m256i found = _mm256_or_si256(_mm256_cmpeq_epi8(chunk, va), _mm256_cmpeq_epi8(chunk, vb));
+
+    unsigned int mask = (unsigned int)_mm256_movemask_epi8(found);
+    if (mask != 0)
+    {
+      return begin + LowestSetBit(mask);
+    }
+  }
+
+  return FindFirstOfSse2(begin, end, a, b);
+}
+
+static bool CpuSupportsAvx2()
+{
+#ifdef _MSC_VER
+  int info[4];
+  __cpuid(info, 0);
+  if (info[0] < 7)
+  {
+    return false;
+  }
+
+  // The OS must also save the AVX registers (OSXSAVE, and XCR0 bits 1-2)
+  __cpuid(info, 1);
+  bool osSavesAvx = (info[2] & (1 << 27)) != 0 && (info[2] & (1 << 28)) != 0 &&
+    (_xgetbv(0) & 0x6) == 0x6;
+
+  __cpuidex(info, 7, 0);
+  return osSavesAvx && (info[1] & (1 << 5)) != 0;
+#else
+  __builtin_cpu_init();
+  return __builtin_cpu_supports("avx2") != 0;
+#endif
+}
+
+static FindFirstOfFunction SelectFindFirstOf(const char** method)
+{
+  if (CpuSupportsAvx2())
+  {
+    *method = "avx2";
+    return FindFirstOfAvx2;
+  }
+
+  // SSE2 is part of every x64 CPU
+  *method = "sse2";
+  return FindFirstOfSse2;
+}
+
+#else
+
+static FindFirstOfFunction SelectFindFirstOf(const char** method)
+{
+  *method = "scalar";
+  return FindFirstOfScalar;
+}
+
+#endif
+
+static const char* sMethod = "scalar";
+static const FindFirstOfFunction sFindFirstOf = SelectFindFirstOf(&sMethod);
+
+const char* FindFirstOf(const char* begin, const char* end, char a, char b)
+{
+  return sFindFirstOf(begin, end, a, b);
+}
+
+const char* GetCharScanMethod()
+{
+  return sMethod;
+}
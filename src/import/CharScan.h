@@ -0,0 +1,20 @@
+
+#ifndef __CHAR_SCAN_H__
+#define __CHAR_SCAN_H__
+
+#include <stddef.h>
+
+/**
+  Returns the first occurrence of a or b in [begin, end), or end if there
+  is none.  Scans 32 or 16 bytes at a time with AVX2 or SSE2 when the CPU
+  supports them, picked once at start-up, and byte by byte otherwise.
+*/
+const char* FindFirstOf(const char* begin, const char* end, char a, char b);
+
+/** The implementation FindFirstOf uses: "avx2", "sse2" or "scalar" */
+const char* GetCharScanMethod();
+
+/** Byte at a time implementation, always available */
+const char* FindFirstOfScalar(const char* begin, const char* end, char a, char b);
+
+#endif
@@ -0,0 +1,332 @@
+
+#include "ExternalSort.h"
+#include "Tokenizer.h"
+#include <datastore/Index.h>
+#include <algorithm>
+#include <chrono>
+#include <memory>
+#include <sstream>
+#include <stdexcept>
+#include <stdio.h>
+
+// Spill files are bar delimited, like the import input, with a leading
+// flag telling existing rows from added ones
+static const char kSpillDelimiter = '|';
+static const char kExistingFlag = 'E';
+static const char kAddedFlag = 'A';
+
+// Each run being merged reads its spill file this much at a time
+static const size_t kSpillReadSize = 256 * 1024;
+
+struct EntryKeyLess
+{
+  EntryKeyLess(const DataStore::IFieldDescriptorConstList& keyFields) :
+    mKeyFields(keyFields)
+  {
+  }
+
+  bool operator()(const ExternalSorter::Entry& left, const ExternalSorter::Entry& right) const
+  {
+    return DataStore::KeyIndex::Compare(mKeyFields, *left.row, *right.row) < 0;
+  }
+
+private:
+  const DataStore::IFieldDescriptorConstList& mKeyFields;
+};
+
+///////////////////////////////////////////////////////////////////////////////
+// RunReader
+
+/**
+  Reads the entries of one sorted run back, either from its spill file or 
+  from memory
+*/
+class ExternalSorter::RunReader
+{
+public:
+  RunReader(const std::string& path, DataStore::IFieldDescriptorConstListConstPtrH fields) :
+    mEntries(NULL),
+    mPosition(0),
+    mFields(fields),
+    mFile(fopen(path.c_str(), "r")),
+    mTokenizer(kSpillDelimiter)
+  {
+    if (mFile == NULL)
+    {
+      throw std::runtime_error("Unable to open sort run \"" + path + "\"");
+    }
+
+    mReader.reset(new BlockReader(mFile, kSpillReadSize));
+  }
+
+  RunReader(const EntryList& entries) :
+    mEntries(&entries),
+    mPosition(0),
+    mFile(NULL),
+    mTokenizer(kSpillDelimiter)
+  {
+  }
+
+  ~RunReader()
+  {
+    if (mFile != NULL)
+    {
+      fclose(mFile);
+    }
+  }
+
+  bool next(Entry* outEntry)
+  {
+    if (mEntries != NULL)
+    {
+      if (mPosition == mEntries->size())
+      {
+        return false;
+      }
+
+      *outEntry = (*mEntries)[mPosition++];
+      return true;
+    }
+
+    while (!mTokenizer.nextLine(&mValues))
+    {
+      if (!mReader->read(&mBlock))
+      {
+        return false;
+      }
+
+      mTokenizer.reset(&mBlock[0], &mBlock[0] + mBlock.size());
+    }
+
+    if (mValues.size() != mFields->size() + 1)
+    {
+      throw std::runtime_error("Corrupt sort run");
+    }
+
+    DataStore::IRowPtrH row(new DataStore::Row(*mFields));
+
+    FieldList::const_iterator value = mValues.cbegin() + 1;
+    for (DataStore::IFieldDescriptorConstList::const_iterator field = mFields->cbegin();
+      field != mFields->cend(); ++field, ++value)
+    {
+      row->setValue(**field, (*field)->fromString(*value));
+    }
+
+    outEntry->row = row;
+    outEntry->existing = mValues[0][0] == kExistingFlag;
+    return true;
+  }
+
+private:
+  RunReader(const RunReader&);
+  RunReader& operator=(const RunReader&);
+
+  const EntryList* mEntries;
+  size_t mPosition;
+
+  DataStore::IFieldDescriptorConstListConstPtrH mFields;
+  FILE* mFile;
+  std::unique_ptr<BlockReader> mReader;
+  Tokenizer mTokenizer;
+  std::vector<char> mBlock;
+  FieldList mValues;
+};
+
+///////////////////////////////////////////////////////////////////////////////
+// ExternalSorter
+
+ExternalSorter::ExternalSorter(DataStore::IFieldDescriptorConstListConstPtrH fields,
+  DataStore::IFieldDescriptorConstListConstPtrH keyFields,
+  const std::string& tempDirectory, size_t rowsPerRun) :
+  mFields(fields),
+  mKeyFields(keyFields),
+  mTempDirectory(tempDirectory),
+  mRowsPerRun(rowsPerRun > 0 ? rowsPerRun : 1),
+  mInsertedCount(0),
+  mReplacedCount(0)
+{
+}
+
+ExternalSorter::~ExternalSorter()
+{
+  for (std::vector<std::string>::const_iterator path = mSpillFiles.cbegin();
+    path != mSpillFiles.cend(); ++path)
+  {
+    remove(path->c_str());
+  }
+}
+
+void ExternalSorter::add(DataStore::IRowConstPtrH row, bool existing)
+{
+  Entry entry = { row, existing };
+  mRun.push_back(entry);
+
+  if (mRun.size() >= mRowsPerRun)
+  {
+    spill();
+  }
+}
+
+void ExternalSorter::sortRun()
+{
+  // Stable, so that among equal keys the row added last stays last
+  std::stable_sort(mRun.begin(), mRun.end(), EntryKeyLess(*mKeyFields));
+}
+
+void ExternalSorter::spill()
+{
+  sortRun();
+
+  std::stringstream path;
+  path << mTempDirectory << "/import-sort-"
+    << std::chrono::steady_clock::now().time_since_epoch().count()
+    << "-" << mSpillFiles.size() << ".tmp";
+
+  FILE* file = fopen(path.str().c_str(), "w");
+  if (file == NULL)
+  {
+    throw std::runtime_error("Unable to create sort run \"" + path.str() + "\"");
+  }
+
+  mSpillFiles.push_back(path.str());
+
+  mStd::mString strValue;
+  for (EntryList::const_iterator entry = mRun.cbegin(); entry != mRun.cend(); ++entry)
+  {
+    fputc(entry->existing ? kExistingFlag : kAddedFlag, file);
+
+    for (DataStore::IFieldDescriptorConstList::const_iterator field = mFields->cbegin();
+      field != mFields->cend(); ++field)
+    {
+      fputc(kSpillDelimiter, file);
+
+      DataStore::ValueConstPtrH value = entry->row->getValue(**field);
+      if (value && value->getValue().convertTo(&strValue))
+      {
+        fputs(strValue.c_str(), file);
+      }
+    }
+
+    fputc('\n', file);
+  }
+
+  bool failed = ferror(file) != 0;
+  if (fclose(file) != 0 || failed)
+  {
+    throw std::runtime_error("Unable to write sort run \"" + path.str() + "\"");
+  }
+
+  mRun.clear();
+}
+
+void ExternalSorter::merge(DataStore::IRowSink* sink)
+{
+  sortRun();
+
+  // Runs in the order they were added, the one still in memory last
+  std::vector<std::unique_ptr<RunReader> > runs;
+  for (std::vector<std::string>::const_iterator path = mSpillFiles.cbegin();
+    path != mSpillFiles.cend(); ++path)
+  {
+    runs.push_back(std::unique_ptr<RunReader>(new RunReader(*path, mFields)));
+  }
+  runs.push_back(std::unique_ptr<RunReader>(new RunReader(mRun)));
+
+  //
+  // Heap of the first entry of each run.  The smallest key is on top, and
+  // among equal keys the earliest run, so the entries of a key come off 
+  // the heap in the order they were added.
+  //
+
+  struct Head
+  {
+    Entry entry;
+    size_t run;
+  };
+
+  struct HeadGreater
+  {
+    HeadGreater(const DataStore::IFieldDescriptorConstList& keyFields) :
+      mKeyFields(keyFields)
+    {
+    }
+
+    bool operator()(const Head& left, const Head& right) const
+    {
+      int order = DataStore::KeyIndex::Compare(mKeyFields, *left.entry.row, *right.entry.row);
+      return order > 0 || (order == 0 && left.run > right.run);
+    }
+
+    const DataStore::IFieldDescriptorConstList& mKeyFields;
+  };
+
+  HeadGreater greater(*mKeyFields);
+  std::vector<Head> heap;
+
+  for (size_t run = 0; run < runs.size(); ++run)
+  {
+    Head head;
+    head.run = run;
+    if (runs[run]->next(&head.entry))
+    {
+      heap.push_back(head);
+    }
+  }
+  std::make_heap(heap.begin(), heap.end(), greater);
+
+  // The last entry of the current key, and what the key's entries were
+  Entry current;
+  bool haveCurrent = false;
+  bool currentExisted = false;
+  size_t currentAdded = 0;
+
+  while (!heap.empty())
+  {
+    std::pop_heap(heap.begin(), heap.end(), greater);
+    Head head = heap.back();
+    heap.pop_back();
+
+    Head following;
+    following.run = head.run;
+    if (runs[head.run]->next(&following.entry))
+    {
+      heap.push_back(following);
+      std::push_heap(heap.begin(), heap.end(), greater);
+    }
+
+    if (!haveCurrent || DataStore::KeyIndex::Compare(*mKeyFields, *current.row, *head.entry.row) != 0)
+    {
+      if (haveCurrent)
+      {
+        sink->addRow(current.row);
+      }
+
+      haveCurrent = true;
+      currentExisted = false;
+      currentAdded = 0;
+    }
+
+    current = head.entry;
+    if (current.existing)
+    {
+      currentExisted = true;
+    }
+    else if (currentExisted || currentAdded > 0)
+    {
+      ++currentAdded;
+      ++mReplacedCount;
+    }
+    else
+    {
+      ++currentAdded;
+      ++mInsertedCount;
+    }
+  }
+
+  if (haveCurrent)
+  {
+    sink->addRow(current.row);
+  }
+
+  mRun.clear();
+}
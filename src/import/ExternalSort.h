@@ -0,0 +1,70 @@
+
+#ifndef __EXTERNAL_SORT_H__
+#define __EXTERNAL_SORT_H__
+
+#include <datastore/Row.h>
+#include <datastore/DataStorage.h>
+#include <string>
+#include <vector>
+
+/**
+  Sorts rows by their key fields with an external merge sort.  Rows are 
+  collected into runs of a fixed size, each run is sorted and spilled to a
+  file in a temporary directory, and the runs are merged at the end.  Rows
+  sharing a key are collapsed during the merge, the row added last wins.
+
+  Rows added as existing (already stored) count neither as inserted nor 
+  replaced, but make an added row with the same key a replacement.
+*/
+class ExternalSorter
+{
+public:
+  ExternalSorter(DataStore::IFieldDescriptorConstListConstPtrH fields,
+    DataStore::IFieldDescriptorConstListConstPtrH keyFields,
+    const std::string& tempDirectory, size_t rowsPerRun);
+
+  /** Removes the spill files */
+  ~ExternalSorter();
+
+  void add(DataStore::IRowConstPtrH row, bool existing = false);
+
+  /** Pass the surviving row of each key to sink, in key order */
+  void merge(DataStore::IRowSink* sink);
+
+  size_t getInsertedCount() const { return mInsertedCount; }
+  size_t getReplacedCount() const { return mReplacedCount; }
+
+  /** Number of runs spilled to disk */
+  size_t getSpilledRunCount() const { return mSpillFiles.size(); }
+
+  /** Rows are ordered by key, then by the order they were added */
+  struct Entry
+  {
+    DataStore::IRowConstPtrH row;
+    bool existing;
+  };
+
+  typedef std::vector<Entry> EntryList;
+
+  class RunReader;
+
+private:
+  ExternalSorter(const ExternalSorter&);
+  ExternalSorter& operator=(const ExternalSorter&);
+
+  void sortRun();
+  void spill();
+
+  DataStore::IFieldDescriptorConstListConstPtrH mFields;
+  DataStore::IFieldDescriptorConstListConstPtrH mKeyFields;
+  std::string mTempDirectory;
+  size_t mRowsPerRun;
+
+  EntryList mRun;
+  std::vector<std::string> mSpillFiles;
+
+  size_t mInsertedCount;
+  size_t mReplacedCount;
+};
+
+#endif
@@ -0,0 +1,387 @@
+
+#include "ImportPipeline.h"
+#include <sstream>
+#include <stdexcept>
+
+// Batches in flight per parser, beyond the one each stage works on
+static const size_t kBatchesPerParser = 2;
+
+/** Spin briefly, then back off to sleeping, while waiting on a queue */
+static void Backoff(size_t spins)
+{
+  if (spins < 64)
+  {
+    std::this_thread::yield();
+  }
+  else
+  {
+    std::this_thread::sleep_for(std::chrono::microseconds(50));
+  }
+}
+
+ImportPipeline::ImportPipeline(FILE* input, char delimiter,
+  DataStore::IFieldDescriptorConstListConstPtrH fields, size_t parserCount) :
+  mReader(input),
+  mDelimiter(delimiter),
+  mParser(fields),
+  mBatches((parserCount > 0 ? parserCount : 1) * kBatchesPerParser + 3),
+  mFree(mBatches.size()),
+  mRead(mBatches.size()),
+  mNextParser(0),
+  mReturned(NULL),
+  mLineBase(0),
+  mStopping(false),
+  mReaderStats("reader"),
+  mTokenizerStats("tokenizer"),
+  mInserterStats("inserter")
+{
+  if (parserCount == 0)
+  {
+    parserCount = 1;
+  }
+
+  for (size_t i = 0; i < parserCount; ++i)
+  {
+    mTokenized.push_back(BatchQueuePtr(new BatchQueue(kBatchesPerParser)));
+    mParsed.push_back(BatchQueuePtr(new BatchQueue(kBatchesPerParser)));
+
+    std::stringstream name;
+    name << "parser " << (i + 1);
+    mParserStats.push_back(StageStats(name.str()));
+  }
+}
+
+ImportPipeline::~ImportPipeline()
+{
+  mStopping.store(true, std::memory_order_release);
+  join();
+}
+
+std::vector<std::string> ImportPipeline::readHeader()
+{
+  std::vector<std::string> header;
+
+  RowBatch* batch = &mBatches[0];
+  Tokenizer tokenizer(mDelimiter);
+  FieldList fields;
+
+  Clock::time_point start = Clock::now();
+
+  while (header.empty() && mReader.read(&batch->block))
+  {
+    char* begin = &batch->block[0];
+    tokenizer.reset(begin, begin + batch->block.size());
+
+    while (tokenizer.nextLine(&fields))
+    {
+      ++mLineBase;
+
+      if (!fields.empty())
+      {
+        header.assign(fields.cbegin(), fields.cend());
+        break;
+      }
+    }
+
+    batch->offset = tokenizer.getPosition() - begin;
+    mReaderStats.bytes += batch->block.size();
+  }
+
+  mReaderStats.busySeconds += SecondsSince(start);
+
+  // The rest of the header's block holds the first rows
+  if (header.empty())
+  {
+    mFree.tryPush(batch);
+  }
+  else
+  {
+    ++mReaderStats.batches;
+    mRead.tryPush(batch);
+  }
+
+  for (size_t i = 1; i < mBatches.size(); ++i)
+  {
+    mFree.tryPush(&mBatches[i]);
+  }
+
+  mThreads.push_back(std::thread(&ImportPipeline::read, this));
+  mThreads.push_back(std::thread(&ImportPipeline::tokenize, this));
+  for (size_t i = 0; i < mParsed.size(); ++i)
+  {
+    mThreads.push_back(std::thread(&ImportPipeline::parse, this, i));
+  }
+
+  return header;
+}
+
+const RowBatch* ImportPipeline::next()
+{
+  if (mReturned != NULL)
+  {
+    mInserterStats.busySeconds += SecondsSince(mReturnedAt);
+
+    // The free queue holds every batch, so there is always room
+    mFree.tryPush(mReturned);
+    mReturned = NULL;
+  }
+
+  RowBatch* batch = NULL;
+  if (!pop(mParsed[mNextParser].get(), &batch, &mInserterStats))
+  {
+    return NULL;
+  }
+
+  if (batch == NULL)
+  {
+    // End of input, every stage is finishing
+    join();
+    return NULL;
+  }
+
+  mNextParser = (mNextParser + 1) % mParsed.size();
+
+  // Line numbers were counted from the start of the block
+  for (std::vector<size_t>::iterator line = batch->lines.begin();
+    line != batch->lines.end(); ++line)
+  {
+    *line += mLineBase;
+  }
+
+  batch->errorLine += mLineBase;
+  mLineBase += batch->lineCount;
+
+  ++mInserterStats.batches;
+  mInserterStats.bytes += batch->block.size() - batch->offset;
+
+  mReturned = batch;
+  mReturnedAt = Clock::now();
+  return batch;
+}
+
+ImportPipeline::StageStatsList ImportPipeline::getStageStats() const
+{
+  StageStatsList stats;
+  stats.push_back(mReaderStats);
+  stats.push_back(mTokenizerStats);
+  stats.insert(stats.end(), mParserStats.begin(), mParserStats.end());
+  stats.push_back(mInserterStats);
+  return stats;
+}
+
+void ImportPipeline::read()
+{
+  for (;;)
+  {
+    RowBatch* batch = NULL;
+    if (!pop(&mFree, &batch, &mReaderStats))
+    {
+      return;
+    }
+
+    Clock::time_point start = Clock::now();
+
+    batch->offset = 0;
+    bool haveInput = mReader.read(&batch->block);
+
+    mReaderStats.busySeconds += SecondsSince(start);
+
+    if (!haveInput)
+    {
+      // End of input
+      push(&mRead, NULL, &mReaderStats);
+      return;
+    }
+
+    ++mReaderStats.batches;
+    mReaderStats.bytes += batch->block.size();
+
+    if (!push(&mRead, batch, &mReaderStats))
+    {
+      return;
+    }
+  }
+}
+
+void ImportPipeline::tokenize()
+{
+  Tokenizer tokenizer(mDelimiter);
+  FieldList fields;
+  size_t nextParser = 0;
+
+  for (;;)
+  {
+    RowBatch* batch = NULL;
+    if (!pop(&mRead, &batch, &mTokenizerStats))
+    {
+      return;
+    }
+
+    if (batch == NULL)
+    {
+      // End of input, pass it on to every parser
+      for (size_t i = 0; i < mTokenized.size(); ++i)
+      {
+        push(mTokenized[(nextParser + i) % mTokenized.size()].get(), NULL, &mTokenizerStats);
+      }
+      return;
+    }
+
+    Clock::time_point start = Clock::now();
+
+    batch->fields.clear();
+    batch->lineFields.clear();
+    batch->lines.clear();
+
+    size_t line = 0;
+
+    if (batch->offset < batch->block.size())
+    {
+      char* begin = &batch->block[0];
+      tokenizer.reset(begin + batch->offset, begin + batch->block.size());
+
+      while (tokenizer.nextLine(&fields))
+      {
+        ++line;
+
+        if (!fields.empty())
+        {
+          batch->lineFields.push_back(batch->fields.size());
+          batch->fields.insert(batch->fields.end(), fields.begin(), fields.end());
+          batch->lines.push_back(line);
+        }
+      }
+    }
+
+    batch->lineCount = line;
+
+    ++mTokenizerStats.batches;
+    mTokenizerStats.bytes += batch->block.size() - batch->offset;
+    mTokenizerStats.busySeconds += SecondsSince(start);
+
+    if (!push(mTokenized[nextParser].get(), batch, &mTokenizerStats))
+    {
+      return;
+    }
+
+    nextParser = (nextParser + 1) % mTokenized.size();
+  }
+}
+
+void ImportPipeline::parse(size_t parser)
+{
+  StageStats& stats = mParserStats[parser];
+
+  for (;;)
+  {
+    RowBatch* batch = NULL;
+    if (!pop(mTokenized[parser].get(), &batch, &stats))
+    {
+      return;
+    }
+
+    if (batch == NULL)
+    {
+      push(mParsed[parser].get(), NULL, &stats);
+      return;
+    }
+
+    Clock::time_point start = Clock::now();
+
+    batch->rows.clear();
+    batch->error.clear();
+    batch->errorLine = 0;
+
+    for (size_t i = 0; i < batch->lineFields.size(); ++i)
+    {
+      FieldList::const_iterator first = batch->fields.begin() + batch->lineFields[i];
+      FieldList::const_iterator last = i + 1 < batch->lineFields.size() ?
+        batch->fields.begin() + batch->lineFields[i + 1] : batch->fields.end();
+
+      try
+      {
+        batch->rows.push_back(mParser.parse(first, last));
+      }
+      catch (std::exception& ex)
+      {
+        batch->error = ex.what();
+        batch->errorLine = batch->lines[i];
+        break;
+      }
+    }
+
+    ++stats.batches;
+    stats.bytes += batch->block.size() - batch->offset;
+    stats.busySeconds += SecondsSince(start);
+
+    if (!push(mParsed[parser].get(), batch, &stats))
+    {
+      return;
+    }
+  }
+}
+
+bool ImportPipeline::pop(BatchQueue* queue, RowBatch** outBatch, StageStats* stats)
+{
+  if (queue->tryPop(outBatch))
+  {
+    return true;
+  }
+
+  ++stats->inputStalls;
+  Clock::time_point start = Clock::now();
+
+  for (size_t spins = 0; !queue->tryPop(outBatch); ++spins)
+  {
+    if (mStopping.load(std::memory_order_acquire))
+    {
+      return false;
+    }
+
+    Backoff(spins);
+  }
+
+  stats->stalledSeconds += SecondsSince(start);
+  return true;
+}
+
+bool ImportPipeline::push(BatchQueue* queue, RowBatch* batch, StageStats* stats)
+{
+  if (queue->tryPush(batch))
+  {
+    return true;
+  }
+
+  ++stats->outputStalls;
+  Clock::time_point start = Clock::now();
+
+  for (size_t spins = 0; !queue->tryPush(batch); ++spins)
+  {
+    if (mStopping.load(std::memory_order_acquire))
+    {
+      return false;
+    }
+
+    Backoff(spins);
+  }
+
+  stats->stalledSeconds += SecondsSince(start);
+  return true;
+}
+
+void ImportPipeline::join()
+{
+  for (std::vector<std::thread>::iterator thread = mThreads.begin();
+    thread != mThreads.end(); ++thread)
+  {
+    thread->join();
+  }
+
+  mThreads.clear();
+}
+
+double ImportPipeline::SecondsSince(const Clock::time_point& start)
+{
+  std::chrono::duration<double> elapsed = Clock::now() - start;
+  return elapsed.count();
+}
@@ -0,0 +1,131 @@
+
+#ifndef __IMPORT_PIPELINE_H__
+#define __IMPORT_PIPELINE_H__
+
+#include "BoundedQueue.h"
+#include "RowParser.h"
+#include "Tokenizer.h"
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+/**
+  Runs the import as a pipeline of stages, each on its own thread:
+
+    reader -> tokenizer -> parsers -> inserter
+
+  The reader fills blocks of input, the tokenizer splits them into the 
+  fields of each line, and a number of parsers turn the fields into rows.
+  The inserter is the caller of next().  Stages hand batches to each other
+  through bounded lock-free queues, and a fixed pool of batches bounds the
+  memory in flight: the reader waits for the inserter to give one back.
+
+  Batches are dealt to the parsers round robin, and collected from them in
+  the same order, so the inserter sees them in input order and a later 
+  line still replaces an earlier one.
+*/
+class ImportPipeline
+{
+public:
+  /** Counters of one stage, for tuning */
+  struct StageStats
+  {
+    StageStats(const std::string& stageName) :
+      name(stageName),
+      batches(0),
+      bytes(0),
+      busySeconds(0.0),
+      inputStalls(0),
+      outputStalls(0),
+      stalledSeconds(0.0)
+    {
+    }
+
+    std::string name;
+    size_t batches;
+    unsigned long long bytes;
+    /** Time spent working on batches */
+    double busySeconds;
+    /** Times the stage waited for a batch to work on */
+    size_t inputStalls;
+    /** Times the stage waited for room in the next stage's queue */
+    size_t outputStalls;
+    /** Time spent waiting, for either */
+    double stalledSeconds;
+  };
+
+  typedef std::vector<StageStats> StageStatsList;
+
+  ImportPipeline(FILE* input, char delimiter,
+    DataStore::IFieldDescriptorConstListConstPtrH fields, size_t parserCount);
+  ~ImportPipeline();
+
+  /** 
+    Read the header, which is the first non-empty line, and start the 
+    stages.  Must be called before next().  Returns no names if the input
+    is empty.
+  */
+  std::vector<std::string> readHeader();
+
+  /**
+    The next batch of rows, with line numbers counted from the start of 
+    input.  The batch stays valid until the following call.  If the batch
+    has an error, its rows are the ones before the malformed line, and no
+    further batches should be read.  Returns NULL at the end of input.
+  */
+  const RowBatch* next();
+
+  /** Total number of bytes read, once next() has returned NULL */
+  unsigned long long getBytesRead() const { return mReader.getBytesRead(); }
+
+  /** Counters of each stage, once next() has returned NULL */
+  StageStatsList getStageStats() const;
+
+private:
+  ImportPipeline(const ImportPipeline&);
+  ImportPipeline& operator=(const ImportPipeline&);
+
+  typedef BoundedQueue<RowBatch*> BatchQueue;
+  typedef std::unique_ptr<BatchQueue> BatchQueuePtr;
+  typedef std::chrono::steady_clock Clock;
+
+  void read();
+  void tokenize();
+  void parse(size_t parser);
+  void join();
+
+  /** Wait for a batch, returns false if the pipeline is stopping */
+  bool pop(BatchQueue* queue, RowBatch** outBatch, StageStats* stats);
+  /** Wait for room for a batch, returns false if the pipeline is stopping */
+  bool push(BatchQueue* queue, RowBatch* batch, StageStats* stats);
+
+  static double SecondsSince(const Clock::time_point& start);
+
+  BlockReader mReader;
+  char mDelimiter;
+  RowParser mParser;
+
+  std::vector<RowBatch> mBatches;
+  BatchQueue mFree;
+  BatchQueue mRead;
+  std::vector<BatchQueuePtr> mTokenized;
+  std::vector<BatchQueuePtr> mParsed;
+
+  size_t mNextParser;
+  RowBatch* mReturned;
+  Clock::time_point mReturnedAt;
+  size_t mLineBase;
+
+  std::vector<std::thread> mThreads;
+  std::atomic<bool> mStopping;
+
+  StageStats mReaderStats;
+  StageStats mTokenizerStats;
+  StageStatsList mParserStats;
+  StageStats mInserterStats;
+};
+
+#endif
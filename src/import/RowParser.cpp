@@ -0,0 +1,53 @@
+
+#include "RowParser.h"
+#include <sstream>
+#include <stdexcept>
+
+RowParser::RowParser(DataStore::IFieldDescriptorConstListConstPtrH fields) :
+  mFields(fields)
+{
+}
+
+DataStore::IRowPtrH RowParser::parse(FieldList::const_iterator begin,
+  FieldList::const_iterator end) const
+{
+  // Make sure that the row has the right number of fields
+  if ((size_t)(end - begin) != mFields->size())
+  {
+    throw std::runtime_error("Row is missing a field");
+  }
+
+  // Parse each value in row.
+
+  DataStore::IRowPtrH row(new DataStore::Row(*mFields));
+
+  DataStore::IFieldDescriptorConstList::const_iterator fieldDescriptor =
+    mFields->cbegin();
+  FieldList::const_iterator stringValue = begin;
+
+  while (stringValue != end && fieldDescriptor != mFields->cend())
+  {
+    DataStore::ValuePtrH value = (*fieldDescriptor)->fromString(*stringValue);
+
+    if (!value)
+    {
+      std::stringstream ex;
+      ex << "Malformed value in field \"" << (*fieldDescriptor)->getName()
+        << "\" : \"" << *stringValue << "\"";
+      throw std::runtime_error(ex.str());
+    }
+
+    if (!row->setValue(*(fieldDescriptor->get()), value))
+    {
+      std::stringstream ex;
+      ex << "Unable to add value to row at field \"" << (*fieldDescriptor)->getName()
+        << "\" with value \"" << *stringValue << "\"";
+      throw std::runtime_error(ex.str());
+    }
+
+    ++stringValue;
+    ++fieldDescriptor;
+  }
+
+  return row;
+}
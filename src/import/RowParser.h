@@ -0,0 +1,66 @@
+
+#ifndef __ROW_PARSER_H__
+#define __ROW_PARSER_H__
+
+#include <datastore/Row.h>
+#include "Tokenizer.h"
+#include <string>
+#include <vector>
+
+/**
+  Turns the fields of one input line into a row, using the scheme's field
+  descriptors to parse each value.  Throws on a malformed line; the message
+  doesn't include the line number, which the caller knows.
+*/
+class RowParser
+{
+public:
+  RowParser(DataStore::IFieldDescriptorConstListConstPtrH fields);
+
+  /** Parse the fields in [begin, end) */
+  DataStore::IRowPtrH parse(FieldList::const_iterator begin,
+    FieldList::const_iterator end) const;
+
+private:
+  DataStore::IFieldDescriptorConstListConstPtrH mFields;
+};
+
+/**
+  One block of input as it moves through the import: read, split into the
+  fields of each line, then parsed into rows.
+*/
+struct RowBatch
+{
+  RowBatch() :
+    offset(0),
+    lineCount(0),
+    errorLine(0)
+  {
+  }
+
+  /** Input text, and where the lines start within it */
+  std::vector<char> block;
+  size_t offset;
+
+  /** 
+    Fields of every non-empty line, pointing into block.  The fields of 
+    line i start at fields[lineFields[i]].
+  */
+  FieldList fields;
+  std::vector<size_t> lineFields;
+
+  /** Input line number of each non-empty line, and so of each row */
+  std::vector<size_t> lines;
+
+  /** Number of input lines in the block */
+  size_t lineCount;
+
+  /** Parsed rows */
+  DataStore::IRowConstList rows;
+
+  /** Set if parsing stopped on a malformed line */
+  std::string error;
+  size_t errorLine;
+};
+
+#endif
@@ -0,0 +1,131 @@
+
+#include "Tokenizer.h"
+#include "CharScan.h"
+#include <stdexcept>
+
+///////////////////////////////////////////////////////////////////////////////
+// BlockReader
+
+BlockReader::BlockReader(FILE* input, size_t blockSize) :
+  mInput(input),
+  mBlockSize(blockSize > 0 ? blockSize : (size_t)kDefaultBlockSize),
+  mBytesRead(0),
+  mEndOfInput(false)
+{
+}
+
+bool BlockReader::read(std::vector<char>* block)
+{
+  block->swap(mCarry);
+  mCarry.clear();
+
+  // Keep reading until the block holds at least one line end, so that a 
+  // line longer than the block size is still delivered whole.
+  size_t searchFrom = 0;
+
+  while (!mEndOfInput)
+  {
+    size_t used = block->size();
+    block->resize(used + mBlockSize);
+
+    size_t count = fread(&(*block)[used], 1, mBlockSize, mInput);
+    block->resize(used + count);
+    mBytesRead += count;
+
+    if (count < mBlockSize)
+    {
+      if (ferror(mInput))
+      {
+        throw std::runtime_error("Unable to read input");
+      }
+
+      mEndOfInput = true;
+    }
+
+    // Find the last line end of the data just read
+    const char* data = block->empty() ? NULL : &(*block)[0];
+    size_t lineEnd = block->size();
+    while (lineEnd > searchFrom && data[lineEnd - 1] != '\n')
+    {
+      --lineEnd;
+    }
+
+    if (lineEnd > searchFrom)
+    {
+      mCarry.assign(block->begin() + lineEnd, block->end());
+      block->resize(lineEnd);
+      break;
+    }
+
+    searchFrom = block->size();
+  }
+
+  // The last line of input may not have a line end, give it one so that
+  // every line of a block can be terminated in place.
+  if (mEndOfInput && !mCarry.empty())
+  {
+    block->insert(block->end(), mCarry.begin(), mCarry.end());
+    mCarry.clear();
+  }
+
+  if (!block->empty() && block->back() != '\n')
+  {
+    block->push_back('\n');
+  }
+
+  return !block->empty();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Tokenizer
+
+Tokenizer::Tokenizer(char delimiter) :
+  mDelimiter(delimiter),
+  mPosition(NULL),
+  mEnd(NULL)
+{
+}
+
+void Tokenizer::reset(char* begin, char* end)
+{
+  mPosition = begin;
+  mEnd = end;
+}
+
+bool Tokenizer::nextLine(FieldList* fields)
+{
+  fields->clear();
+
+  if (mPosition == NULL || mPosition >= mEnd)
+  {
+    return false;
+  }
+
+  // Find delimiters and the line end in a single pass
+  char* field = mPosition;
+  for (;;)
+  {
+    char* found = (char*)FindFirstOf(field, mEnd, mDelimiter, '\n');
+    if (found == mEnd)
+    {
+      throw std::runtime_error("Input block does not end on a line boundary");
+    }
+
+    if (*found == '\n')
+    {
+      // An empty line has no fields
+      if (found != mPosition)
+      {
+        fields->push_back(field);
+      }
+
+      *found = '\0';
+      mPosition = found + 1;
+      return true;
+    }
+
+    fields->push_back(field);
+    *found = '\0';
+    field = found + 1;
+  }
+}
@@ -0,0 +1,74 @@
+
+#ifndef __TOKENIZER_H__
+#define __TOKENIZER_H__
+
+#include <stdio.h>
+#include <vector>
+
+/**
+  Fields of one input line.  Each points into the block the line was read
+  from, and is terminated in place, so it stays valid until the block is 
+  reused.
+*/
+typedef std::vector<const char*> FieldList;
+
+/**
+  Reads input in large blocks which always end with a line end.  The 
+  partial line at the end of a read is carried over into the next block.
+*/
+class BlockReader
+{
+public:
+  enum { kDefaultBlockSize = 4 * 1024 * 1024 };
+
+  BlockReader(FILE* input, size_t blockSize = kDefaultBlockSize);
+
+  /** 
+    Fill block with the next run of whole lines.  The block's storage is
+    reused from call to call.  Returns false once the input is exhausted.
+  */
+  bool read(std::vector<char>* block);
+
+  /** Total number of bytes read from input */
+  unsigned long long getBytesRead() const { return mBytesRead; }
+
+private:
+  BlockReader(const BlockReader&);
+  BlockReader& operator=(const BlockReader&);
+
+  FILE* mInput;
+  size_t mBlockSize;
+  std::vector<char> mCarry;
+  unsigned long long mBytesRead;
+  bool mEndOfInput;
+};
+
+/**
+  Walks the lines of a block, splitting each into fields without copying.
+  Delimiters and line ends are overwritten with terminators, so the block 
+  must end with a line end (as blocks from BlockReader do).
+*/
+class Tokenizer
+{
+public:
+  Tokenizer(char delimiter);
+
+  /** Start walking a new block */
+  void reset(char* begin, char* end);
+
+  /** 
+    Split the next line into fields.  Empty lines are returned with no 
+    fields.  Returns false at the end of the block.
+  */
+  bool nextLine(FieldList* fields);
+
+  /** Start of the line that nextLine() returns next */
+  char* getPosition() const { return mPosition; }
+
+private:
+  char mDelimiter;
+  char* mPosition;
+  char* mEnd;
+};
+
+#endif
@@ -4,27 +4,121 @@
 #include <iostream>
 #include <string>
 #include <sstream>
-#include <fstream>
 #include <exception>
+#include <memory>
+#include <chrono>
+#include <stdio.h>
+#include <stdlib.h>
 #include <tclap/CmdLine.h>
 #include <datastore/Database.h>
 #include <datastore/JsonStorage.h>
+#include <datastore/SnapshotStorage.h>
+#include <datastore/PartitionedStorage.h>
+#include <datastore/LsmStorage.h>
+#include "ExternalSort.h"
+#include "ImportPipeline.h"
 
 static const char kFieldDelimiter = '|';
 
-bool getStringValues(const std::string& row, std::vector<std::string>* outFields)
+/**
+  Import counters go to stderr, so they don't mix with the regular output
+*/
+void printStats(unsigned long long bytesRead, double seconds,
+  const ImportPipeline::StageStatsList& stages)
 {
-  outFields->clear();
+  double megabytes = bytesRead / (1024.0 * 1024.0);
 
-  std::istringstream tokenStream(row);
-  for (std::string field; std::getline(tokenStream, field, kFieldDelimiter);)
+  std::cerr << "Bytes read: " << bytesRead << std::endl;
+  std::cerr << "Import time: " << seconds << " s" << std::endl;
+  if (seconds > 0.0)
   {
-    outFields->push_back(field);
+    std::cerr << "Throughput: " << (megabytes / seconds) << " MB/s" << std::endl;
+  }
+
+  for (ImportPipeline::StageStatsList::const_iterator stage = stages.cbegin();
+    stage != stages.cend(); ++stage)
+  {
+    std::cerr << "Stage " << stage->name << ": " << stage->batches << " batches, "
+      << stage->busySeconds << " s busy";
+    if (stage->busySeconds > 0.0)
+    {
+      std::cerr << " (" << (stage->bytes / (1024.0 * 1024.0) / stage->busySeconds) << " MB/s)";
+    }
+    std::cerr << ", stalled " << stage->inputStalls << " times on input and "
+      << stage->outputStalls << " times on output for " << stage->stalledSeconds 
+      << " s" << std::endl;
   }
+}
 
-  return true;
+/**
+  Buffer pool counters, to stderr as well
+*/
+void printPoolStats(const DataStore::BufferPool& pool)
+{
+  std::cerr << "Pool pages: " << pool.getFrameCount() << std::endl;
+  std::cerr << "Pool hits: " << pool.getHitCount() << std::endl;
+  std::cerr << "Pool misses: " << pool.getMissCount() << std::endl;
+  std::cerr << "Pool evictions: " << pool.getEvictionCount() << std::endl;
 }
 
+/**
+  Where sort runs are spilled, unless --temp-dir says otherwise
+*/
+std::string defaultTempDirectory()
+{
+  const char* variables[] = { "TMPDIR", "TEMP", "TMP" };
+  for (size_t i = 0; i < sizeof(variables) / sizeof(variables[0]); ++i)
+  {
+    const char* directory = getenv(variables[i]);
+    if (directory != NULL && *directory != '\0')
+    {
+      return directory;
+    }
+  }
+
+  return ".";
+}
+
+/**
+  Feeds the rows already in storage to the sorter, ahead of the input
+*/
+class ExistingRowSorter : public DataStore::IRowSink
+{
+public:
+  ExistingRowSorter(ExternalSorter* sorter) :
+    mSorter(sorter)
+  {
+  }
+
+  void addRow(DataStore::IRowConstPtrH row)
+  {
+    mSorter->add(row, true);
+  }
+
+private:
+  ExternalSorter* mSorter;
+};
+
+/**
+  Writes rows to a storage, as they arrive
+*/
+class StorageRowWriter : public DataStore::IRowSink
+{
+public:
+  StorageRowWriter(DataStore::IDataStorage* storage) :
+    mStorage(storage)
+  {
+  }
+
+  void addRow(DataStore::IRowConstPtrH row)
+  {
+    mStorage->persistRow(row.get());
+  }
+
+private:
+  DataStore::IDataStorage* mStorage;
+};
+
 int main(int argc, char** argv)
 {
   try
@@ -32,10 +126,30 @@ int main(int argc, char** argv)
     TCLAP::CmdLine cmd("Datastore Importer. Reads bar-delimited input and appends records to datastore.\nCreate a new database:\n>  Import.exe -c Scheme.json -d mydb.json\nImport data into your database:\n>  cat Example1.txt | Import.exe -d mydb.json\n(or)\n>  Import.exe -d mydb.json -i Example1.txt", ' ');
     TCLAP::ValueArg<std::string> createUsingSchemeArg("c", "create", "Create a new data store using a JSON scheme file, and exit", false, "Scheme.json", "JSON scheme file");
     TCLAP::ValueArg<std::string> importFileArg("i", "import", "Bar-delimited input file name.  If none specified, reads from STDIN", false, "", "Bar delmited input file");
-    TCLAP::ValueArg<std::string> datastoreFileArg("d", "db", "JSON database file name to load or create", true, "db.json", "Database file");
+    TCLAP::ValueArg<std::string> datastoreFileArg("d", "db", "JSON database file name to load or create.  A scheme with a partitioned field creates a partitioned database directory instead", true, "db.json", "Database file");
+    TCLAP::ValueArg<unsigned int> threadsArg("t", "threads", "Number of parser threads in the import pipeline.  Rows are still inserted in input order", false, 1, "Thread count");
+    TCLAP::SwitchArg statsArg("", "stats", "Print import throughput, and the counters of each pipeline stage, to stderr", false);
+    TCLAP::SwitchArg bulkArg("b", "bulk", "Sort the existing and imported rows by key with an external merge sort, and rewrite the database in key order without loading it into memory.  Nothing is written if the input has an error", false);
+    TCLAP::ValueArg<std::string> tempDirArg("", "temp-dir", "Directory for the sort runs of a bulk import.  Defaults to TMPDIR, TEMP or TMP", false, "", "Directory");
+    TCLAP::ValueArg<std::string> snapshotArg("", "snapshot", "Write a memory-mapped snapshot of the database, which query loads without parsing, and exit", false, "", "Snapshot file");
+    TCLAP::ValueArg<std::string> dropBeforeArg("", "drop-before", "Drop the partitions of a partitioned database that only hold dates before this one, and exit", false, "", "YYYY-MM-DD");
+    TCLAP::SwitchArg lsmArg("", "lsm", "With -c, create a log-structured database directory instead, to which each import only writes the rows it imports", false);
+    TCLAP::SwitchArg compactArg("", "compact", "Merge the runs of a log-structured database into one, and exit", false);
+    TCLAP::ValueArg<unsigned int> runRowsArg("", "run-rows", "Rows sorted in memory before a bulk import spills them to disk, or a log-structured database writes them as a run", false, 1000000, "Row count");
+    TCLAP::ValueArg<unsigned int> memoryLimitArg("", "memory-limit", "Megabytes of the stored pages of a partitioned or log-structured database to keep in memory.  Pages are read through a buffer pool of this size rather than mapped", false, 0, "Megabytes");
     cmd.add(createUsingSchemeArg);
     cmd.add(importFileArg);
     cmd.add(datastoreFileArg);
+    cmd.add(threadsArg);
+    cmd.add(statsArg);
+    cmd.add(bulkArg);
+    cmd.add(tempDirArg);
+    cmd.add(runRowsArg);
+    cmd.add(snapshotArg);
+    cmd.add(dropBeforeArg);
+    cmd.add(lsmArg);
+    cmd.add(compactArg);
+    cmd.add(memoryLimitArg);
     cmd.parse(argc, argv);
 
     //
@@ -43,14 +157,55 @@ int main(int argc, char** argv)
     //
 
     bool isInCreateMode = createUsingSchemeArg.isSet();
+    bool isPartitioned = DataStore::DataStoragePartitioned::IsPartitioned(
+      datastoreFileArg.getValue().c_str());
+    bool isLsm = DataStore::DataStorageLsm::IsLsm(datastoreFileArg.getValue().c_str());
+
+    // JSON databases are parsed into memory, there are no pages to bound
+    DataStore::BufferPoolPtrH pool;
+    if (memoryLimitArg.isSet() && !isInCreateMode)
+    {
+      if (!isPartitioned && !isLsm)
+      {
+        throw std::runtime_error("A memory limit needs a partitioned or log-structured database");
+      }
+
+      pool = DataStore::BufferPoolPtrH(new DataStore::BufferPool(
+        (size_t)memoryLimitArg.getValue() * 1024 * 1024));
+    }
 
     DataStore::DatabasePtrH database;
+    DataStore::DataStorageJsonPtrH storage;
+    DataStore::DataStorageLsmPtrH lsm;
+    DataStore::DataStoragePartitionedPtrH partitioned;
+    std::unique_ptr<ExternalSorter> sorter;
+    DataStore::ISchemeConstPtrH scheme;
+
     if (isInCreateMode)
     {
       // Create a new db
-      database = DataStore::DataStorageJson::Create(
-        createUsingSchemeArg.getValue().c_str(),
-        datastoreFileArg.getValue().c_str());
+      DataStore::SchemeJsonPtrH newScheme = DataStore::SchemeJson::Load(
+        createUsingSchemeArg.getValue().c_str());
+
+      if (lsmArg.isSet())
+      {
+        if (DataStore::DataStoragePartitioned::IsPartitioned(*newScheme))
+        {
+          throw std::runtime_error("A partitioned scheme can't be used for a log-structured database");
+        }
+
+        DataStore::DataStorageLsm::Create(newScheme, datastoreFileArg.getValue().c_str());
+      }
+      else if (DataStore::DataStoragePartitioned::IsPartitioned(*newScheme))
+      {
+        database = DataStore::DataStoragePartitioned::Create(newScheme,
+          datastoreFileArg.getValue().c_str());
+      }
+      else
+      {
+        database = DataStore::DataStorageJson::Create(newScheme,
+          datastoreFileArg.getValue().c_str());
+      }
 
       std::cout << "Database \"" << datastoreFileArg.getValue()
         << "\" created" << std::endl;
@@ -58,126 +213,259 @@ int main(int argc, char** argv)
       // and exit
       return 0;
     }
+    else if (dropBeforeArg.isSet())
+    {
+      if (!isPartitioned)
+      {
+        throw std::runtime_error("Only partitioned databases can drop partitions");
+      }
+
+      DataStore::Date date;
+      if (!date.fromString(dropBeforeArg.getValue().c_str()))
+      {
+        std::string ex = "Invalid date \"" + dropBeforeArg.getValue() + "\"";
+        throw std::runtime_error(ex);
+      }
+
+      partitioned = DataStore::DataStoragePartitioned::Open(datastoreFileArg.getValue().c_str());
+      size_t dropped = partitioned->dropBefore(date);
+
+      std::cout << dropped << " partitions dropped from \"" 
+        << datastoreFileArg.getValue() << "\"" << std::endl;
+
+      // and exit
+      return 0;
+    }
+    else if (compactArg.isSet())
+    {
+      if (!isLsm)
+      {
+        throw std::runtime_error("Only log-structured databases can be compacted");
+      }
+
+      lsm = DataStore::DataStorageLsm::Open(datastoreFileArg.getValue().c_str(), pool);
+      lsm->compact();
+
+      std::cout << "Database \"" << datastoreFileArg.getValue()
+        << "\" compacted" << std::endl;
+
+      // and exit
+      return 0;
+    }
+    else if ((isPartitioned || isLsm) && (snapshotArg.isSet() || bulkArg.isSet()))
+    {
+      throw std::runtime_error("Snapshots and bulk imports are only supported for JSON databases");
+    }
+    else if (snapshotArg.isSet())
+    {
+      // Copy the stored rows straight into the snapshot
+      storage = DataStore::DataStorageJson::Open(datastoreFileArg.getValue().c_str());
+
+      DataStore::DataStorageSnapshotPtrH snapshot = DataStore::DataStorageSnapshot::Create(
+        storage->getScheme(), snapshotArg.getValue().c_str());
+
+      StorageRowWriter writer(snapshot.get());
+      snapshot->beginPersist();
+      storage->scanRows(&writer);
+      snapshot->endPersist();
+
+      std::cout << "Snapshot \"" << snapshotArg.getValue()
+        << "\" written" << std::endl;
+
+      // and exit
+      return 0;
+    }
+    else if (bulkArg.isSet())
+    {
+      // Bulk import, the existing rows go through the sort and never into
+      // a database
+      storage = DataStore::DataStorageJson::Open(datastoreFileArg.getValue().c_str());
+      scheme = storage->getScheme();
+
+      std::string tempDirectory = tempDirArg.isSet() ? 
+        tempDirArg.getValue() : defaultTempDirectory();
+
+      sorter.reset(new ExternalSorter(scheme->getFieldDescriptors(),
+        scheme->getKeyFieldDescriptors(), tempDirectory, runRowsArg.getValue()));
+
+      ExistingRowSorter existingRows(sorter.get());
+      storage->scanRows(&existingRows);
+    }
+    else if (isLsm)
+    {
+      // Imported rows are only added to the memtable, the stored runs are
+      // neither loaded nor rewritten
+      lsm = DataStore::DataStorageLsm::Open(datastoreFileArg.getValue().c_str(), pool);
+      lsm->setMemtableLimit(runRowsArg.getValue());
+      scheme = lsm->getScheme();
+    }
+    else if (isPartitioned)
+    {
+      // Imported rows are queued, and only the partitions they fall in are
+      // loaded and rewritten
+      partitioned = DataStore::DataStoragePartitioned::Open(datastoreFileArg.getValue().c_str(), pool);
+      scheme = partitioned->getScheme();
+    }
     else
     {
       database = DataStore::DataStorageJson::Load(datastoreFileArg.getValue().c_str());
+      scheme = database->getScheme();
     }
 
     // Read from stdin by default, unless '-i' arg is specified
-    std::ifstream inputFile;
-    std::istream* input = &std::cin;
+    std::unique_ptr<FILE, int(*)(FILE*)> inputFile(NULL, fclose);
+    FILE* input = stdin;
 
     if (importFileArg.isSet())
     {
-      inputFile.open(importFileArg.getValue().c_str(), std::fstream::in);
-      if (!inputFile.is_open())
+      inputFile.reset(fopen(importFileArg.getValue().c_str(), "r"));
+      if (!inputFile)
       {
         std::string ex = "Unable to open input file \"" +
           importFileArg.getValue() + "\"";
         throw std::runtime_error(ex);
       }
-      input = &inputFile;
+      input = inputFile.get();
     }
 
     //
-    // Use the FieldDescriptors to decide how to parse the input rows.
+    // Read records from input, parse, and validate that they match scheme.
+    // Input is read a block at a time, and passes through a pipeline of
+    // reader, tokenizer and parser threads before it is inserted here.
     //
 
-    DataStore::ISchemeConstPtrH scheme(database->getScheme());
-    DataStore::IFieldDescriptorConstListConstPtrH fieldDescriptors = 
-      scheme->getFieldDescriptors();
+    std::chrono::steady_clock::time_point startTime = std::chrono::steady_clock::now();
 
-    //
-    // Read records from input, parse, and validate that they match scheme
-    //
-
-    size_t line = 1;
+    ImportPipeline reader(input, kFieldDelimiter, 
+      scheme->getFieldDescriptors(), threadsArg.getValue());
 
-    std::string header;
-    *input >> header;
-    line++;
-
-    std::vector<std::string> headerFieldNames;
-    getStringValues(header, &headerFieldNames);
+    std::vector<std::string> headerFieldNames = reader.readHeader();
     if (!scheme->allFieldsPresent(headerFieldNames))
     {
       throw std::runtime_error("Header does not match scheme");
     }
 
-    int replacedCount = 0;
-    int insertedCount = 0;
+    size_t replacedCount = 0;
+    size_t insertedCount = 0;
 
-    for (std::string row; std::getline(*input, row);)
+    try
     {
-      if (row.size() > 0)
+      for (const RowBatch* batch = reader.next(); batch != NULL; batch = reader.next())
       {
-        std::vector<std::string> stringValues;
-        getStringValues(row, &stringValues);
-
-        // Make sure that the row has the right number of fields
-        if (stringValues.size() != fieldDescriptors->size())
+        if (lsm)
         {
-          std::stringstream ex;
-          ex << "Row is missing a field, at line: " << line;
-          std::string str = ex.str();
-          throw std::runtime_error(str);
+          for (DataStore::IRowConstList::const_iterator row = batch->rows.cbegin();
+            row != batch->rows.cend(); ++row)
+          {
+            // The memtable and the runs' key trees tell whether the key is new
+            if (lsm->put(*row))
+              ++replacedCount;
+            else
+              ++insertedCount;
+          }
         }
-
-        // Parse each value in row.
-
-        DataStore::IRowPtrH row = database->createRow();
-
-        DataStore::IFieldDescriptorConstList::const_iterator fieldDescriptor =
-          fieldDescriptors->cbegin();
-        std::vector<std::string>::const_iterator stringValue = stringValues.cbegin();
-
-        while (stringValue != stringValues.cend() && fieldDescriptor != fieldDescriptors->cend())
+        else if (partitioned)
         {
-          DataStore::ValuePtrH value =
-            (*fieldDescriptor)->fromString(stringValue->c_str());
-
-          if (!value)
+          for (DataStore::IRowConstList::const_iterator row = batch->rows.cbegin();
+            row != batch->rows.cend(); ++row)
           {
-            std::stringstream ex;
-            ex << "Malformed value in field \"" << (*fieldDescriptor)->getName()
-              << "\" : \"" << *stringValue << "\", at line " << line;
-            std::string str = ex.str();
-            throw std::runtime_error(str);
+            partitioned->put(*row);
           }
-
-          if (!row->setValue(*(fieldDescriptor->get()), value))
+        }
+        else if (sorter)
+        {
+          for (DataStore::IRowConstList::const_iterator row = batch->rows.cbegin();
+            row != batch->rows.cend(); ++row)
+          {
+            sorter->add(*row);
+          }
+        }
+        else
+        {
+          size_t inserted = 0;
+          size_t replaced = 0;
+          if (!database->insertBatch(batch->rows, &inserted, &replaced))
           {
             std::stringstream ex;
-            ex << "Unable to add value to row at field \"" << (*fieldDescriptor)->getName()
-              << "\" with value \"" << *stringValue << "\", at line" << line;
+            ex << "Error inserting rows at lines " << batch->lines.front() 
+              << " to " << batch->lines.back();
             std::string str = ex.str();
             throw std::runtime_error(str);
           }
 
-          ++stringValue;
-          ++fieldDescriptor;
+          insertedCount += inserted;
+          replacedCount += replaced;
         }
 
-        DataStore::Database::InsertionResult insertionResult;
-        if (!database->insert(row, &insertionResult))
+        if (!batch->error.empty())
         {
           std::stringstream ex;
-          ex << "Error inserting row at line " << line;
+          ex << batch->error << ", at line " << batch->errorLine;
           std::string str = ex.str();
           throw std::runtime_error(str);
         }
+      }
+    }
+    catch (std::exception&)
+    {
+      // Keep the rows before the bad line, as a JSON database does when it
+      // is released, whether or not the memtable filled up before it
+      if (partitioned)
+      {
+        partitioned->flush();
+      }
+      if (lsm)
+      {
+        lsm->flush();
+      }
+      throw;
+    }
 
-        if (insertionResult == DataStore::Database::eInsertionResult_Inserted)
-          ++insertedCount;
-        else if (insertionResult == DataStore::Database::eInsertionResult_Replaced)
-          ++replacedCount;
+    if (sorter)
+    {
+      // Merge the sort runs straight into storage, in key order
+      StorageRowWriter writer(storage.get());
+      storage->beginPersist();
+      sorter->merge(&writer);
+      storage->endPersist();
+
+      insertedCount = sorter->getInsertedCount();
+      replacedCount = sorter->getReplacedCount();
+    }
 
-        ++line;
-      }
+    if (partitioned)
+    {
+      partitioned->flush(&insertedCount, &replacedCount);
+    }
+
+    if (lsm)
+    {
+      lsm->flush();
+      lsm->waitForCompaction();
     }
 
     std::cout << "Inserted " << insertedCount << " new rows" << std::endl;
     std::cout << "Replaced " << replacedCount << " existing rows" << std::endl;
+
+    if (statsArg.isSet())
+    {
+      std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - startTime;
+      printStats(reader.getBytesRead(), elapsed.count(), reader.getStageStats());
+
+      if (sorter)
+      {
+        std::cerr << "Sort runs spilled: " << sorter->getSpilledRunCount() << std::endl;
+      }
+      if (lsm)
+      {
+        std::cerr << "Runs: " << lsm->getRunCount() << std::endl;
+        std::cerr << "Compactions: " << lsm->getCompactionCount() << std::endl;
+      }
+      if (pool)
+      {
+        printPoolStats(*pool);
+      }
+    }
   }
   catch (TCLAP::ArgException &e)
   {
@@ -0,0 +1,73 @@
+
+#include "CppUnitTest.h"
+#include <import/CharScan.h>
+#include <vector>
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+
+namespace Tests
+{
+  TEST_CLASS(TestCharScan)
+  {
+  public:
+    /** 
+      Fill text with bytes that are neither delimiter, including ones with 
+      the high bit set, which compare as negative chars.
+    */
+    static void Fill(std::vector<char>* text)
+    {
+      for (size_t i = 0; i < text->size(); ++i)
+      {
+        char c = (char)(i * 37 + 0x80);
+        (*text)[i] = (c == '|' || c == '\n') ? 'x' : c;
+      }
+    }
+
+    static void AssertSameAsScalar(const std::vector<char>& text, size_t offset, size_t length)
+    {
+      const char* begin = &text[0] + offset;
+      const char* end = begin + length;
+
+      Assert::IsTrue(FindFirstOfScalar(begin, end, '|', '\n') == 
+        FindFirstOf(begin, end, '|', '\n'));
+    }
+
+    TEST_METHOD(GivenEveryLengthAndMatchVerifySameAsScalar)
+    {
+      Logger::WriteMessage(GetCharScanMethod());
+
+      const size_t maxLength = 70;
+      const size_t maxOffset = 31;
+      std::vector<char> text(maxOffset + maxLength + 1);
+
+      // Misaligned starts move the 16 and 32 byte chunks over the text
+      for (size_t offset = 0; offset <= maxOffset; ++offset)
+      {
+        for (size_t length = 0; length <= maxLength; ++length)
+        {
+          Fill(&text);
+          AssertSameAsScalar(text, offset, length);
+
+          for (size_t match = 0; match < length; ++match)
+          {
+            Fill(&text);
+            text[offset + match] = (match % 2 == 0) ? '|' : '\n';
+            AssertSameAsScalar(text, offset, length);
+
+            // A later match of the other delimiter doesn't hide the first
+            if (match + 1 < length)
+            {
+              text[offset + length - 1] = (match % 2 == 0) ? '\n' : '|';
+              AssertSameAsScalar(text, offset, length);
+            }
+          }
+
+          // A match just past the end isn't found
+          Fill(&text);
+          text[offset + length] = '|';
+          AssertSameAsScalar(text, offset, length);
+        }
+      }
+    }
+  };
+}
@@ -0,0 +1,112 @@
+
+#include "CppUnitTest.h"
+#include <datastore/JsonStorage.h>
+#include <datastore/Row.h>
+#include <import/ExternalSort.h>
+#include <string>
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+
+namespace Tests
+{
+  TEST_CLASS(TestExternalSort)
+  {
+  public:
+    static DataStore::ISchemeConstPtrH CreateScheme()
+    {
+      const char* schemeJson =
+        "[                          "
+        "  {                        "
+        "    \"name\": \"keyField\",  "
+        "    \"type\": \"text\",    "
+        "    \"key\": true,         "
+        "    \"description\": \"This is a key field\" "
+        "  },                       "
+        "  {                        "
+        "    \"name\": \"valueField\", "
+        "    \"type\": \"text\",    "
+        "    \"description\": \"This is a value field\" "
+        "  }                        "
+        "]                          ";
+
+      return DataStore::ISchemeConstPtrH(new DataStore::SchemeJson(schemeJson));
+    }
+
+    /** Collects the merged rows as "key=value;" */
+    struct RowText : public DataStore::IRowSink
+    {
+      RowText(DataStore::IFieldDescriptorConstListConstPtrH fields) :
+        mFields(fields)
+      {
+      }
+
+      virtual void addRow(DataStore::IRowConstPtrH row)
+      {
+        mStd::mString key;
+        mStd::mString value;
+        Assert::IsTrue(row->getValue(*(*mFields)[0])->getValue().convertTo(&key));
+        Assert::IsTrue(row->getValue(*(*mFields)[1])->getValue().convertTo(&value));
+
+        text += key.c_str();
+        text += "=";
+        text += value.c_str();
+        text += ";";
+      }
+
+      DataStore::IFieldDescriptorConstListConstPtrH mFields;
+      std::string text;
+    };
+
+    static DataStore::IRowConstPtrH CreateRow(DataStore::IFieldDescriptorConstListConstPtrH fields,
+      const char* key, const char* value)
+    {
+      DataStore::IRowPtrH row(new DataStore::Row(*fields));
+      row->setValue(*(*fields)[0], (*fields)[0]->fromString(key));
+      row->setValue(*(*fields)[1], (*fields)[1]->fromString(value));
+      return row;
+    }
+
+    TEST_METHOD(GivenDuplicateKeysAcrossRunsVerifyCounts)
+    {
+      try
+      {
+        DataStore::ISchemeConstPtrH scheme = CreateScheme();
+        DataStore::IFieldDescriptorConstListConstPtrH fields = scheme->getFieldDescriptors();
+        DataStore::IFieldDescriptorConstListConstPtrH keyFields = scheme->getKeyFieldDescriptors();
+
+        RowText merged(fields);
+
+        {
+          // Every row is spilled to a run of its own
+          ExternalSorter sorter(fields, keyFields, ".", 1);
+
+          sorter.add(CreateRow(fields, "a", "stored"), true);
+          sorter.add(CreateRow(fields, "b", "stored"), true);
+
+          sorter.add(CreateRow(fields, "c", "1"));
+          sorter.add(CreateRow(fields, "a", "2"));
+          sorter.add(CreateRow(fields, "c", "3"));
+          sorter.add(CreateRow(fields, "d", "4"));
+          sorter.add(CreateRow(fields, "c", "5"));
+          sorter.add(CreateRow(fields, "d", "6"));
+
+          Assert::AreEqual((size_t)8, sorter.getSpilledRunCount());
+
+          sorter.merge(&merged);
+
+          // c and d are new, a replaces a stored row, c twice and d once
+          // replace an added one
+          Assert::AreEqual((size_t)2, sorter.getInsertedCount());
+          Assert::AreEqual((size_t)4, sorter.getReplacedCount());
+        }
+
+        Assert::AreEqual(std::string("a=2;b=stored;c=5;d=6;"), merged.text);
+      }
+      catch (std::exception& ex)
+      {
+        Logger::WriteMessage(ex.what());
+        Assert::Fail(L"Exception");
+      }
+    }
+  };
+}
@@ -0,0 +1,168 @@
+
+#include "FilterParser.h"
+#include <stdexcept>
+#include <vector>
+
+/**
+  The field of fields named name, NULL if there isn't one
+*/
+static DataStore::IFieldDescriptorConstPtrH findField(const std::string& name,
+  const DataStore::IFieldDescriptorConstList& fields)
+{
+  for (DataStore::IFieldDescriptorConstList::const_iterator field = fields.cbegin();
+    field != fields.cend(); ++field)
+  {
+    if (name == (*field)->getName())
+    {
+      return *field;
+    }
+  }
+
+  return DataStore::IFieldDescriptorConstPtrH();
+}
+
+/**
+  Parse a single FIELD=value, FIELD>=value or FIELD<=value term.  
+  Double quotes around the value are optional.
+*/
+static DataStore::IQualifierPtrH parseFilterTerm(const std::string& term,
+  const DataStore::IFieldDescriptorConstList& fields)
+{
+  size_t opPos = term.find_first_of("<>=");
+  if (opPos == std::string::npos || opPos == 0)
+  {
+    throw std::runtime_error("Syntax error in filter expression");
+  }
+
+  std::string fieldName = term.substr(0, opPos);
+  std::string op;
+  std::string expectedValue;
+
+  if (term.compare(opPos, 2, ">=") == 0 || term.compare(opPos, 2, "<=") == 0)
+  {
+    op = term.substr(opPos, 2);
+    expectedValue = term.substr(opPos + 2);
+  }
+  else if (term[opPos] == '=')
+  {
+    op = "=";
+    expectedValue = term.substr(opPos + 1);
+  }
+  else
+  {
+    throw std::runtime_error("Syntax error in filter expression, expected =, >= or <=");
+  }
+
+  if (expectedValue.size() >= 2 && expectedValue[0] == '"' &&
+    expectedValue[expectedValue.size() - 1] == '"')
+  {
+    expectedValue = expectedValue.substr(1, expectedValue.size() - 2);
+  }
+
+  DataStore::IFieldDescriptorConstPtrH field = findField(fieldName, fields);
+  if (!field)
+  {
+    std::string ex = "Unrecognized field \"";
+    ex += fieldName;
+    ex += "\" specified in filter expression";
+    throw std::runtime_error(ex);
+  }
+
+  DataStore::ValuePtrH desiredValue = field->fromString(expectedValue.c_str());
+  if (!desiredValue)
+  {
+    std::string ex = "Syntax error in filter expression, value format is incorrect";
+    throw std::runtime_error(ex);
+  }
+
+  if (op == ">=")
+  {
+    return DataStore::IQualifierPtrH(new DataStore::Logic::Range(field, desiredValue, NULL));
+  }
+  else if (op == "<=")
+  {
+    return DataStore::IQualifierPtrH(new DataStore::Logic::Range(field, NULL, desiredValue));
+  }
+  else
+  {
+    return DataStore::IQualifierPtrH(new DataStore::Logic::Exact(field, desiredValue));
+  }
+}
+
+/**
+  Split expression on each occurrence of separator that isn't within
+  double quotes, so a quoted value may contain AND or OR
+*/
+static std::vector<std::string> splitExpression(const std::string& expression,
+  const std::string& separator)
+{
+  std::vector<std::string> parts;
+
+  size_t start = 0;
+  bool isQuoted = false;
+  for (size_t position = 0; position < expression.size(); ++position)
+  {
+    if (expression[position] == '"')
+    {
+      isQuoted = !isQuoted;
+    }
+    else if (!isQuoted && expression.compare(position, separator.size(), separator) == 0)
+    {
+      parts.push_back(expression.substr(start, position - start));
+      start = position + separator.size();
+      position = start - 1;
+    }
+  }
+  parts.push_back(expression.substr(start));
+
+  return parts;
+}
+
+/**
+  Parse terms joined by AND, e.g. DATE>=2014-04-01 AND DATE<=2014-04-02
+*/
+static DataStore::IQualifierPtrH parseAndExpression(const std::string& expression, 
+  const DataStore::IFieldDescriptorConstList& fields)
+{
+  std::vector<std::string> terms = splitExpression(expression, " AND ");
+  if (terms.size() == 1)
+  {
+    return parseFilterTerm(terms[0], fields);
+  }
+
+  DataStore::Logic::And* andTogether = new DataStore::Logic::And();
+  DataStore::IQualifierPtrH allTerms(andTogether);
+
+  for (std::vector<std::string>::const_iterator term = terms.cbegin();
+    term != terms.cend(); ++term)
+  {
+    andTogether->with(parseFilterTerm(*term, fields));
+  }
+
+  return allTerms;
+}
+
+/**
+  Parse AND expressions joined by OR.  AND has higher precedence than OR, 
+  parentheses are not supported.
+*/
+DataStore::IQualifierPtrH parseFilterExpression(const std::string& expression, 
+  const DataStore::IFieldDescriptorConstList& fields)
+{
+  std::vector<std::string> alternatives = splitExpression(expression, " OR ");
+  if (alternatives.size() == 1)
+  {
+    return parseAndExpression(alternatives[0], fields);
+  }
+
+  DataStore::Logic::Or* orTogether = new DataStore::Logic::Or();
+  DataStore::IQualifierPtrH anyAlternative(orTogether);
+
+  for (std::vector<std::string>::const_iterator alternative = alternatives.cbegin();
+    alternative != alternatives.cend(); ++alternative)
+  {
+    orTogether->with(parseAndExpression(*alternative, fields));
+  }
+
+  return anyAlternative;
+}
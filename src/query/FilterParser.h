@@ -0,0 +1,19 @@
+
+#ifndef __FILTER_PARSER_H__
+#define __FILTER_PARSER_H__
+
+#include <datastore/FieldDescriptor.h>
+#include <datastore/Logic.h>
+#include <string>
+
+/**
+  Parse a filter expression, as given to -f, into a logical expression of
+  fields:  FIELD=value, FIELD>=value or FIELD<=value terms, joined by AND
+  and OR.  AND has higher precedence than OR, parentheses are not
+  supported.  A value in double quotes may contain spaces, AND and OR.
+  Throws on a syntax error, or a field that isn't in fields.
+*/
+DataStore::IQualifierPtrH parseFilterExpression(const std::string& expression,
+  const DataStore::IFieldDescriptorConstList& fields);
+
+#endif
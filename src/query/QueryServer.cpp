@@ -0,0 +1,594 @@
+
+#include "QueryServer.h"
+#include "ResultWriter.h"
+#include <algorithm>
+#include <chrono>
+#include <stdexcept>
+#include <stdlib.h>
+#include <string.h>
+
+#ifndef _WIN32
+#include <errno.h>
+#include <signal.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include <thread>
+#include <vector>
+#endif
+
+// Results are mostly small, so connections get a smaller buffer than stdout
+static const size_t kConnectionBufferSize = 64 * 1024;
+
+// A request is a few options, each on a line of its own
+static const size_t kDefaultRequestTimeout = 2 * 1000;
+static const size_t kMaxRequestLines = 16;
+static const size_t kMaxRequestLineSize = 64 * 1024;
+
+#ifdef _WIN32
+
+/////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////
+
+static void ThrowUnsupported()
+{
+  throw std::runtime_error("A query server needs Unix domain sockets, which this platform doesn't support");
+}
+
+QueryServer::QueryServer(const std::string& socketPath, Handler handler,
+  CacheKey cacheKey, ResultCachePtrH cache, size_t threadCount) :
+  mSocketPath(socketPath),
+  mHandler(handler),
+  mCacheKey(cacheKey),
+  mCache(cache),
+  mThreadCount(threadCount),
+  mRequestTimeout(kDefaultRequestTimeout),
+  mSocket(-1),
+  mIsStopping(false),
+  mHasFailed(false)
+{
+  ThrowUnsupported();
+}
+
+QueryServer::~QueryServer()
+{
+}
+
+void QueryServer::serve()
+{
+  ThrowUnsupported();
+}
+
+void QueryServer::stop()
+{
+}
+
+void QueryServer::setRequestTimeout(size_t milliseconds)
+{
+  mRequestTimeout = std::max<size_t>(milliseconds, 1);
+}
+
+void QueryServer::Send(const std::string& socketPath, const QueryRequest& request,
+  FILE* output)
+{
+  ThrowUnsupported();
+}
+
+void QueryServer::acceptConnections()
+{
+  ThrowUnsupported();
+}
+
+void QueryServer::answer(int connection)
+{
+  ThrowUnsupported();
+}
+
+void QueryServer::readRequest(FILE* input, QueryRequest* outRequest, bool* outIsComplete)
+{
+  ThrowUnsupported();
+}
+
+void QueryServer::answerQuery(const QueryRequest& request, FILE* output)
+{
+  ThrowUnsupported();
+}
+
+#else
+
+/////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////
+
+/** The address of socketPath, throws if it's too long */
+static sockaddr_un AddressOf(const std::string& socketPath)
+{
+  sockaddr_un address;
+  memset(&address, 0, sizeof(address));
+  address.sun_family = AF_UNIX;
+
+  if (socketPath.empty() || socketPath.size() >= sizeof(address.sun_path))
+  {
+    std::string ex = "Invalid socket path \"" + socketPath + "\"";
+    throw std::runtime_error(ex);
+  }
+  memcpy(address.sun_path, socketPath.c_str(), socketPath.size());
+
+  return address;
+}
+
+/** Read a line without its newline, false at the end of the stream */
+static bool ReadLine(FILE* input, std::string* outLine)
+{
+  outLine->clear();
+
+  for (int c = fgetc(input); c != EOF; c = fgetc(input))
+  {
+    if (c == '\n')
+    {
+      return true;
+    }
+    outLine->push_back((char)c);
+  }
+
+  return !outLine->empty();
+}
+
+/** Write an option of a request, whose value has to fit on its line */
+static void WriteOption(FILE* output, char name, const std::string& value)
+{
+  if (value.empty())
+  {
+    return;
+  }
+
+  if (value.find('\n') != std::string::npos)
+  {
+    throw std::runtime_error("Query options can't contain newlines");
+  }
+
+  fprintf(output, "%c=%s\n", name, value.c_str());
+}
+
+/** Write size bytes of data as a chunk of a result */
+static void WriteChunk(FILE* output, const char* data, size_t size)
+{
+  if (size > 0)
+  {
+    fprintf(output, "%llu\n", (unsigned long long)size);
+    fwrite(data, 1, size, output);
+  }
+}
+
+/////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////
+
+QueryServer::QueryServer(const std::string& socketPath, Handler handler,
+  CacheKey cacheKey, ResultCachePtrH cache, size_t threadCount) :
+  mSocketPath(socketPath),
+  mHandler(handler),
+  mCacheKey(cacheKey),
+  mCache(cache),
+  mThreadCount(threadCount > 0 ? threadCount :
+    2 * std::max<size_t>(std::thread::hardware_concurrency(), 1)),
+  mRequestTimeout(kDefaultRequestTimeout),
+  mSocket(-1),
+  mIsStopping(false),
+  mHasFailed(false)
+{
+  sockaddr_un address = AddressOf(socketPath);
+
+  // A socket left by a server that was stopped, but not any other file
+  struct stat status;
+  if (lstat(socketPath.c_str(), &status) == 0 && S_ISSOCK(status.st_mode))
+  {
+    unlink(socketPath.c_str());
+  }
+
+  mSocket = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (mSocket < 0)
+  {
+    throw std::runtime_error("Unable to create socket");
+  }
+
+  if (bind(mSocket, (const sockaddr*)&address, sizeof(address)) != 0 ||
+    listen(mSocket, SOMAXCONN) != 0)
+  {
+    close(mSocket);
+    std::string ex = "Unable to listen on socket \"" + socketPath + "\"";
+    throw std::runtime_error(ex);
+  }
+}
+
+QueryServer::~QueryServer()
+{
+  close(mSocket);
+  unlink(mSocketPath.c_str());
+}
+
+void QueryServer::serve()
+{
+  // A client that goes away mid-result fails the write, rather than
+  // stopping the server
+  signal(SIGPIPE, SIG_IGN);
+
+  std::vector<std::thread> threads;
+  for (size_t thread = 0; thread < mThreadCount; ++thread)
+  {
+    threads.push_back(std::thread(&QueryServer::acceptConnections, this));
+  }
+
+  for (std::vector<std::thread>::iterator thread = threads.begin();
+    thread != threads.end(); ++thread)
+  {
+    thread->join();
+  }
+
+  if (mHasFailed)
+  {
+    throw std::runtime_error("Unable to accept connection");
+  }
+}
+
+void QueryServer::stop()
+{
+  // Wakes the threads waiting in accept()
+  mIsStopping = true;
+  shutdown(mSocket, SHUT_RDWR);
+}
+
+void QueryServer::setRequestTimeout(size_t milliseconds)
+{
+  mRequestTimeout = std::max<size_t>(milliseconds, 1);
+}
+
+void QueryServer::acceptConnections()
+{
+  while (!mIsStopping)
+  {
+    int connection = accept(mSocket, NULL, NULL);
+    if (connection < 0)
+    {
+      if (mIsStopping)
+      {
+        break;
+      }
+      if (errno == EINTR || errno == ECONNABORTED)
+      {
+        continue;
+      }
+
+      // serve() throws once the other threads have stopped too
+      mHasFailed = true;
+      stop();
+      break;
+    }
+
+    answer(connection);
+  }
+}
+
+void QueryServer::answer(int connection)
+{
+  FILE* input = fdopen(connection, "r");
+  int outputConnection = dup(connection);
+  FILE* output = outputConnection < 0 ? NULL : fdopen(outputConnection, "w");
+  if (input == NULL || output == NULL)
+  {
+    if (input != NULL)
+    {
+      fclose(input);
+    }
+    else
+    {
+      close(connection);
+    }
+    if (outputConnection >= 0)
+    {
+      close(outputConnection);
+    }
+    return;
+  }
+
+  try
+  {
+    QueryRequest request;
+    bool isComplete = false;
+    readRequest(input, &request, &isComplete);
+
+    // Otherwise the client went away before finishing its request
+    if (isComplete)
+    {
+      answerQuery(request, output);
+    }
+  }
+  catch (std::exception& ex)
+  {
+    // In place of the next chunk, if the result has started
+    fprintf(output, "error: %s\n", ex.what());
+  }
+
+  fclose(output);
+  fclose(input);
+}
+
+void QueryServer::readRequest(FILE* input, QueryRequest* outRequest, bool* outIsComplete)
+{
+  // A read waits for the timeout at most, and a client that trickles its
+  // request in passes the deadline
+  timeval timeout;
+  timeout.tv_sec = (time_t)(mRequestTimeout / 1000);
+  timeout.tv_usec = (suseconds_t)(mRequestTimeout % 1000 * 1000);
+  setsockopt(fileno(input), SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+
+  typedef std::chrono::steady_clock Clock;
+  Clock::time_point deadline = Clock::now() + std::chrono::milliseconds(mRequestTimeout);
+
+  *outIsComplete = false;
+  std::string line;
+  for (size_t lineCount = 0;; ++lineCount)
+  {
+    if (lineCount == kMaxRequestLines)
+    {
+      throw std::runtime_error("Request has too many lines");
+    }
+
+    line.clear();
+    for (;;)
+    {
+      int c = fgetc(input);
+      if (c == EOF)
+      {
+        if (ferror(input) && (errno == EAGAIN || errno == EWOULDBLOCK))
+        {
+          throw std::runtime_error("Request timed out");
+        }
+        if (ferror(input) && errno == EINTR)
+        {
+          clearerr(input);
+          continue;
+        }
+
+        // The client went away before finishing its request
+        return;
+      }
+      if (Clock::now() > deadline)
+      {
+        throw std::runtime_error("Request timed out");
+      }
+      if (c == '\n')
+      {
+        break;
+      }
+      if (line.size() == kMaxRequestLineSize)
+      {
+        throw std::runtime_error("Request line is too long");
+      }
+      line.push_back((char)c);
+    }
+
+    if (line.empty())
+    {
+      *outIsComplete = true;
+      return;
+    }
+
+    if (line == "reload")
+    {
+      outRequest->reload = true;
+      continue;
+    }
+
+    if (line == "stats")
+    {
+      outRequest->stats = true;
+      continue;
+    }
+
+    if (line.size() < 2 || line[1] != '=')
+    {
+      throw std::runtime_error("Invalid request");
+    }
+
+    switch (line[0])
+    {
+    case 's': outRequest->select = line.substr(2); break;
+    case 'f': outRequest->filter = line.substr(2); break;
+    case 'o': outRequest->order = line.substr(2); break;
+    case 'g': outRequest->group = line.substr(2); break;
+    default: throw std::runtime_error("Invalid request");
+    }
+  }
+}
+
+void QueryServer::answerQuery(const QueryRequest& request, FILE* output)
+{
+  if (request.stats)
+  {
+    ResultCache::Stats stats = {};
+    if (mCache)
+    {
+      stats = mCache->getStats();
+    }
+
+    char counters[256];
+    int length = snprintf(counters, sizeof(counters),
+      "Cache hits: %llu\nCache misses: %llu\nCache evictions: %llu\n"
+      "Cache entries: %llu\nCache bytes: %llu\n",
+      (unsigned long long)stats.hits, (unsigned long long)stats.misses,
+      (unsigned long long)stats.evictions, (unsigned long long)stats.entries,
+      (unsigned long long)stats.bytes);
+
+    fputs("ok\n", output);
+    WriteChunk(output, counters, length > 0 ? (size_t)length : 0);
+    fputs("0\n", output);
+    return;
+  }
+
+  std::string key;
+  if (mCache && mCacheKey)
+  {
+    key = mCacheKey(request);
+  }
+
+  ResultCache::ResultConstPtrH cached;
+  if (!key.empty())
+  {
+    cached = mCache->find(key);
+  }
+
+  if (cached)
+  {
+    fputs("ok\n", output);
+    WriteChunk(output, cached->data(), cached->size());
+    fputs("0\n", output);
+    return;
+  }
+
+  DataStore::IQueryCursorPtrH cursor = mHandler(request);
+
+  fputs("ok\n", output);
+
+  if (cursor)
+  {
+    DataStore::IFieldDescriptorConstListConstPtrH fields = cursor->getFieldDescriptors();
+
+    // A result that is too large to cache stops being copied
+    DataStore::PointerType<std::string>::Shared result(new std::string());
+    ResultWriter writer(output, kConnectionBufferSize);
+    writer.setChunked(true);
+    if (!key.empty())
+    {
+      writer.copyTo(result.get(), mCache->getCapacity());
+    }
+
+    for (const DataStore::IRow* row = cursor->next(); row != NULL; row = cursor->next())
+    {
+      writer.writeRow(*row, *fields);
+    }
+    writer.flush();
+
+    // Unless writing failed, the copy holds the whole result
+    if (!key.empty() && writer.isCopying())
+    {
+      mCache->insert(key, result);
+    }
+  }
+
+  fputs("0\n", output);
+}
+
+void QueryServer::Send(const std::string& socketPath, const QueryRequest& request,
+  FILE* output)
+{
+  sockaddr_un address = AddressOf(socketPath);
+
+  int connection = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (connection < 0)
+  {
+    throw std::runtime_error("Unable to create socket");
+  }
+
+  if (connect(connection, (const sockaddr*)&address, sizeof(address)) != 0)
+  {
+    close(connection);
+    std::string ex = "Unable to connect to query server at \"" + socketPath + "\"";
+    throw std::runtime_error(ex);
+  }
+
+  FILE* stream = fdopen(connection, "r+");
+  if (stream == NULL)
+  {
+    close(connection);
+    throw std::runtime_error("Unable to connect to query server");
+  }
+
+  try
+  {
+    WriteOption(stream, 's', request.select);
+    WriteOption(stream, 'f', request.filter);
+    WriteOption(stream, 'o', request.order);
+    WriteOption(stream, 'g', request.group);
+    if (request.reload)
+    {
+      fputs("reload\n", stream);
+    }
+    if (request.stats)
+    {
+      fputs("stats\n", stream);
+    }
+    fputs("\n", stream);
+    if (fflush(stream) != 0)
+    {
+      throw std::runtime_error("Unable to send query");
+    }
+
+    std::string status;
+    if (!ReadLine(stream, &status))
+    {
+      throw std::runtime_error("The query server closed the connection");
+    }
+
+    const std::string errorPrefix = "error: ";
+    if (status.compare(0, errorPrefix.size(), errorPrefix) == 0)
+    {
+      throw std::runtime_error(status.substr(errorPrefix.size()));
+    }
+    if (status != "ok")
+    {
+      throw std::runtime_error("Invalid response from the query server");
+    }
+
+    // Chunks until the empty one, or an error that cut the result short
+    char buffer[kConnectionBufferSize];
+    for (;;)
+    {
+      std::string header;
+      if (!ReadLine(stream, &header))
+      {
+        throw std::runtime_error("The query server closed the connection before the end of the result");
+      }
+      if (header.compare(0, errorPrefix.size(), errorPrefix) == 0)
+      {
+        fflush(output);
+        throw std::runtime_error(header.substr(errorPrefix.size()));
+      }
+
+      char* end = NULL;
+      unsigned long long size = strtoull(header.c_str(), &end, 10);
+      if (header.empty() || *end != '\0')
+      {
+        throw std::runtime_error("Invalid response from the query server");
+      }
+      if (size == 0)
+      {
+        break;
+      }
+
+      while (size > 0)
+      {
+        size_t count = fread(buffer, 1, (size_t)std::min<unsigned long long>(size, sizeof(buffer)), stream);
+        if (count == 0)
+        {
+          throw std::runtime_error("The query server closed the connection before the end of the result");
+        }
+        if (fwrite(buffer, 1, count, output) != count)
+        {
+          throw std::runtime_error("Unable to write result");
+        }
+        size -= count;
+      }
+    }
+    fflush(output);
+  }
+  catch (std::exception&)
+  {
+    fclose(stream);
+    throw;
+  }
+
+  fclose(stream);
+}
+
+#endif
@@ -0,0 +1,135 @@
+
+#ifndef __QUERY_SERVER_H__
+#define __QUERY_SERVER_H__
+
+#include <datastore/Database.h>
+#include "ResultCache.h"
+#include <atomic>
+#include <functional>
+#include <string>
+#include <stdio.h>
+
+/**
+  The options of one query, as given to -s, -f, -o and -g.  An empty option
+  was not given.  Or, a request to reload the database, or for the 
+  counters of the result cache.
+*/
+struct QueryRequest
+{
+  QueryRequest() :
+    reload(false),
+    stats(false)
+  {
+  }
+
+  std::string select;
+  std::string filter;
+  std::string order;
+  std::string group;
+  bool reload;
+  bool stats;
+};
+
+/**
+  Answers queries sent over a Unix domain socket, so a database that is
+  slow to load is loaded once for any number of queries.  A fixed number
+  of threads accept connections and answer them, further connections wait
+  in the socket's backlog.  Each connection carries a single query:
+
+  @verbatim
+  request:   s=<select>, f=<filter>, o=<order> and g=<group> lines,
+             those given, or a "reload" or "stats" line, followed by an
+             empty line
+  response:  "error: <message>", or "ok" followed by the result as
+             chunks: a line with the size of the chunk in bytes, then
+             its bytes.  A chunk of size 0 ends the result, and an
+             "error: <message>" line in place of a chunk cuts it short.
+             Then the server closes the connection.
+  @endverbatim
+
+  A client has to send its whole request within the request timeout, in
+  a few short lines, or it is answered with an error.  So connections that
+  are left idle don't hold the threads from other queries.
+
+  With a cache, the result of a query is written down as it is sent, and
+  sent from the cache for the next request that has the same key.
+*/
+class QueryServer
+{
+public:
+  /**
+    Opens a cursor over the result of request, the server streams its rows
+    to the client.  Returns NULL for a reload, which has no rows.  Throws
+    if the request is invalid.  Called from several threads at once.
+  */
+  typedef std::function<DataStore::IQueryCursorPtrH(const QueryRequest&)> Handler;
+
+  /**
+    The key the result of request is cached under, empty if it mustn't be
+    cached.  Taken before the handler opens its cursor, so a result is 
+    never older than its key.  Throws if the request is invalid.
+  */
+  typedef std::function<std::string(const QueryRequest&)> CacheKey;
+
+  /** 
+    Serve on socketPath, replacing a socket left there, with threadCount
+    threads (0 for twice the hardware threads).  Results are cached if
+    there is a cache.
+  */
+  QueryServer(const std::string& socketPath, Handler handler,
+    CacheKey cacheKey = CacheKey(), ResultCachePtrH cache = ResultCachePtrH(),
+    size_t threadCount = 0);
+  ~QueryServer();
+
+  /**
+    Accept connections until stop() is called, then wait for the queries
+    being answered.  Throws if connections can't be accepted.
+  */
+  void serve();
+
+  /**
+    Stop accepting connections, serve() returns once the queries being
+    answered are.  Safe to call from a signal handler.
+  */
+  void stop();
+
+  /** Milliseconds a client has to send its request, 2 seconds by default */
+  void setRequestTimeout(size_t milliseconds);
+
+  /**
+    Send request to the server at socketPath, and copy the result rows 
+    (or cache counters) to output.  Throws with the server's message if 
+    the query failed, even after part of the result was copied, and if
+    the connection closed before the end of the result.
+  */
+  static void Send(const std::string& socketPath, const QueryRequest& request,
+    FILE* output);
+
+private:
+  QueryServer(const QueryServer&);
+  QueryServer& operator=(const QueryServer&);
+
+  /** Run by each thread of serve(), until the server is stopped */
+  void acceptConnections();
+
+  /** Answer the query on connection, and close it */
+  void answer(int connection);
+
+  /** Read the request on input, throws if it is too slow or too long */
+  void readRequest(FILE* input, QueryRequest* outRequest, bool* outIsComplete);
+
+  /** Send the rows of the query, or its cached result */
+  void answerQuery(const QueryRequest& request, FILE* output);
+
+  std::string mSocketPath;
+  Handler mHandler;
+  CacheKey mCacheKey;
+  ResultCachePtrH mCache;
+  size_t mThreadCount;
+  size_t mRequestTimeout;
+  int mSocket;
+  std::atomic<bool> mIsStopping;
+  std::atomic<bool> mHasFailed;
+};
+
+#endif
@@ -0,0 +1,91 @@
+
+#include "ResultCache.h"
+
+// Bookkeeping of an entry besides its key and result: the list node, the
+// hash table node and the shared result's control block
+static const size_t kEntryOverhead = 128;
+
+ResultCache::ResultCache(size_t capacity) :
+  mCapacity(capacity),
+  mBytes(0),
+  mHits(0),
+  mMisses(0),
+  mEvictions(0)
+{
+}
+
+size_t ResultCache::SizeOf(const Entry& entry)
+{
+  // The key is held by the list and the hash table both
+  return 2 * entry.key.size() + entry.result->size() + kEntryOverhead;
+}
+
+ResultCache::ResultConstPtrH ResultCache::find(const std::string& key)
+{
+  std::lock_guard<std::mutex> lock(mMutex);
+
+  std::unordered_map<std::string, EntryList::iterator>::const_iterator found =
+    mEntriesByKey.find(key);
+  if (found == mEntriesByKey.cend())
+  {
+    ++mMisses;
+    return ResultConstPtrH();
+  }
+
+  ++mHits;
+  mEntries.splice(mEntries.begin(), mEntries, found->second);
+  return found->second->result;
+}
+
+void ResultCache::insert(const std::string& key, ResultConstPtrH result)
+{
+  Entry entry;
+  entry.key = key;
+  entry.result = result;
+
+  size_t size = SizeOf(entry);
+  if (size > mCapacity)
+  {
+    return;
+  }
+
+  std::lock_guard<std::mutex> lock(mMutex);
+
+  // Another thread may have run the same query meanwhile
+  if (mEntriesByKey.find(key) != mEntriesByKey.cend())
+  {
+    return;
+  }
+
+  while (mBytes + size > mCapacity)
+  {
+    const Entry& leastRecent = mEntries.back();
+    mBytes -= SizeOf(leastRecent);
+    mEntriesByKey.erase(leastRecent.key);
+    mEntries.pop_back();
+    ++mEvictions;
+  }
+
+  mEntries.push_front(entry);
+  mEntriesByKey[key] = mEntries.begin();
+  mBytes += size;
+}
+
+size_t ResultCache::getCapacity() const
+{
+  return mCapacity;
+}
+
+ResultCache::Stats ResultCache::getStats() const
+{
+  std::lock_guard<std::mutex> lock(mMutex);
+
+  Stats stats;
+  stats.hits = mHits;
+  stats.misses = mMisses;
+  stats.evictions = mEvictions;
+  stats.entries = mEntries.size();
+  stats.bytes = mBytes;
+
+  return stats;
+}
@@ -0,0 +1,76 @@
+
+#ifndef __RESULT_CACHE_H__
+#define __RESULT_CACHE_H__
+
+#include <datastore/PointerType.h>
+#include <list>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <stdint.h>
+
+/**
+  Keeps the written results of recent queries, so a query that is asked
+  again is answered without running it.  The key has to tell apart every
+  query, and every version of the database, that can give another result.
+  Results are evicted least recently used first once their total size is
+  over the capacity.  Safe to use from several threads.
+*/
+class ResultCache
+{
+public:
+  typedef DataStore::PointerType<std::string>::SharedConst ResultConstPtrH;
+
+  /** Counters so far */
+  struct Stats
+  {
+    uint64_t hits;
+    uint64_t misses;
+    uint64_t evictions;
+    size_t entries;
+    size_t bytes;
+  };
+
+  /** Keep up to capacity bytes of results and their keys */
+  explicit ResultCache(size_t capacity);
+
+  /** The result cached for key, NULL (and a miss) if there is none */
+  ResultConstPtrH find(const std::string& key);
+
+  /** Cache result for key, unless it alone is over the capacity */
+  void insert(const std::string& key, ResultConstPtrH result);
+
+  /** Results larger than this are not worth writing down */
+  size_t getCapacity() const;
+
+  Stats getStats() const;
+
+private:
+  ResultCache(const ResultCache&);
+  ResultCache& operator=(const ResultCache&);
+
+  struct Entry
+  {
+    std::string key;
+    ResultConstPtrH result;
+  };
+
+  /** Most recently used first */
+  typedef std::list<Entry> EntryList;
+
+  static size_t SizeOf(const Entry& entry);
+
+  size_t mCapacity;
+
+  mutable std::mutex mMutex;
+  EntryList mEntries;
+  std::unordered_map<std::string, EntryList::iterator> mEntriesByKey;
+  size_t mBytes;
+  uint64_t mHits;
+  uint64_t mMisses;
+  uint64_t mEvictions;
+};
+
+typedef DataStore::PointerType<ResultCache>::Shared ResultCachePtrH;
+
+#endif
@@ -0,0 +1,210 @@
+
+#include "ResultWriter.h"
+#include <string.h>
+#include <stdexcept>
+
+// Largest formatted non-text value (float, date or time)
+static const size_t kMaxFormattedSize = 64;
+
+ResultWriter::ResultWriter(FILE* output, size_t bufferSize) :
+  mOutput(output),
+  mBuffer(bufferSize < kMaxFormattedSize ? kMaxFormattedSize : bufferSize),
+  mUsed(0),
+  mCopy(NULL),
+  mMaxCopySize(0),
+  mIsChunked(false)
+{
+}
+
+ResultWriter::~ResultWriter()
+{
+  try
+  {
+    flush();
+  }
+  catch (std::exception&)
+  {
+    // Nowhere to report to
+  }
+}
+
+void ResultWriter::flush()
+{
+  if (mUsed > 0)
+  {
+    size_t used = mUsed;
+    mUsed = 0;
+
+    if (mCopy != NULL)
+    {
+      if (mCopy->size() + used <= mMaxCopySize)
+      {
+        mCopy->append(&mBuffer[0], used);
+      }
+      else
+      {
+        mCopy->clear();
+        mCopy = NULL;
+      }
+    }
+
+    if ((mIsChunked && fprintf(mOutput, "%llu\n", (unsigned long long)used) < 0) ||
+      fwrite(&mBuffer[0], 1, used, mOutput) != used)
+    {
+      throw std::runtime_error("Unable to write result");
+    }
+  }
+
+  fflush(mOutput);
+}
+
+void ResultWriter::copyTo(std::string* outCopy, size_t maxSize)
+{
+  mCopy = outCopy;
+  mMaxCopySize = maxSize;
+}
+
+bool ResultWriter::isCopying() const
+{
+  return mCopy != NULL;
+}
+
+void ResultWriter::setChunked(bool isChunked)
+{
+  mIsChunked = isChunked;
+}
+
+char* ResultWriter::reserve(size_t size)
+{
+  if (mBuffer.size() - mUsed < size)
+  {
+    flush();
+  }
+
+  return &mBuffer[mUsed];
+}
+
+void ResultWriter::write(const char* text, size_t length)
+{
+  while (length > 0)
+  {
+    if (mUsed == mBuffer.size())
+    {
+      flush();
+    }
+
+    size_t chunk = mBuffer.size() - mUsed;
+    if (chunk > length)
+    {
+      chunk = length;
+    }
+
+    memcpy(&mBuffer[mUsed], text, chunk);
+    mUsed += chunk;
+    text += chunk;
+    length -= chunk;
+  }
+}
+
+void ResultWriter::write(char c)
+{
+  if (mUsed == mBuffer.size())
+  {
+    flush();
+  }
+
+  mBuffer[mUsed++] = c;
+}
+
+void ResultWriter::writeRow(const DataStore::IRow& row,
+  const DataStore::IFieldDescriptorConstList& fields)
+{
+  if (fields.empty())
+  {
+    return;
+  }
+
+  for (DataStore::IFieldDescriptorConstList::const_iterator field = fields.cbegin();
+    field != fields.cend(); ++field)
+  {
+    if (field != fields.cbegin())
+    {
+      write(',');
+    }
+
+    DataStore::ValueConstPtrH value = row.getValue(**field);
+    if (value)
+    {
+      writeValue(*value, (*field)->getType());
+    }
+  }
+
+  write('\n');
+}
+
+void ResultWriter::writeValue(const DataStore::Value& value, 
+  const DataStore::TypeInfo& type)
+{
+  const mStd::Variant& v = value.getValue();
+
+  if (type == DataStore::TypeInfo_Date)
+  {
+    DataStore::Date date;
+    if (v.convertTo(&date))
+    {
+      writeDate(date);
+      return;
+    }
+  }
+  else if (type == DataStore::TypeInfo_Time)
+  {
+    DataStore::Time time;
+    if (v.convertTo(&time))
+    {
+      mUsed += time.format(reserve(kMaxFormattedSize), kMaxFormattedSize);
+      return;
+    }
+  }
+  else if (type == DataStore::TypeInfo_Float)
+  {
+    // Two decimals, like the sums of an aggregate
+    float f = 0.0f;
+    if (v.convertTo(&f))
+    {
+      int written = 
+#ifdef _MSC_VER
+      sprintf_s(
+#else
+      snprintf(
+#endif
+        reserve(kMaxFormattedSize), kMaxFormattedSize, "%.2f", f);
+
+      if (written > 0)
+      {
+        mUsed += (size_t)written;
+      }
+      return;
+    }
+  }
+
+  // Text, or anything else.  The scratch string is reused from cell to cell.
+  if (v.convertTo(&mScratch))
+  {
+    const char* text = mScratch.c_str();
+    write(text, strlen(text));
+  }
+}
+
+void ResultWriter::writeDate(const DataStore::Date& date)
+{
+  CachedDate& cached = mDateCache[date.hash() % kDateCacheSize];
+
+  if (!cached.valid || cached.date != date)
+  {
+    cached.date = date;
+    cached.length = date.format(cached.text, sizeof(cached.text));
+    cached.valid = true;
+  }
+
+  write(cached.text, cached.length);
+}
@@ -0,0 +1,91 @@
+
+#ifndef __RESULT_WRITER_H__
+#define __RESULT_WRITER_H__
+
+#include <datastore/FieldDescriptor.h>
+#include <datastore/FieldType.h>
+#include <datastore/Row.h>
+#include <stdio.h>
+#include <string>
+#include <vector>
+
+/**
+  Writes rows as comma separated text into a large buffer, and hands the
+  buffer to the output stream only once it fills (or on flush).  Each 
+  field type has its own formatter that writes straight into the buffer,
+  avoiding the per-cell string conversion and per-line flush of iostreams.
+*/
+class ResultWriter
+{
+public:
+  enum { kDefaultBufferSize = 1024 * 1024 };
+
+  ResultWriter(FILE* output, size_t bufferSize = kDefaultBufferSize);
+  ~ResultWriter();
+
+  /** Write the selected fields of row, followed by a newline */
+  void writeRow(const DataStore::IRow& row,
+    const DataStore::IFieldDescriptorConstList& fields);
+
+  /** Write buffered output to the stream */
+  void flush();
+
+  /**
+    Also append what is written to outCopy, until it would grow past 
+    maxSize.  Then outCopy is cleared, and copying stops.
+  */
+  void copyTo(std::string* outCopy, size_t maxSize);
+
+  /** True if outCopy of copyTo() holds everything written so far */
+  bool isCopying() const;
+
+  /**
+    Precede each buffer handed to the stream by its size in bytes, on a
+    line of its own, so a reader can tell a whole result from a cut one
+    (see QueryServer).  Copies are not affected.
+  */
+  void setChunked(bool isChunked);
+
+private:
+  ResultWriter(const ResultWriter&);
+  ResultWriter& operator=(const ResultWriter&);
+
+  /** Make sure at least size bytes are free in the buffer */
+  char* reserve(size_t size);
+
+  void write(const char* text, size_t length);
+  void write(char c);
+
+  void writeValue(const DataStore::Value& value, const DataStore::TypeInfo& type);
+  void writeDate(const DataStore::Date& date);
+
+  /** 
+    Dates in a result tend to repeat, remember how recently seen dates 
+    are formatted to avoid the time zone conversion.
+  */
+  struct CachedDate
+  {
+    CachedDate() : valid(false), length(0) {}
+
+    bool valid;
+    DataStore::Date date;
+    char text[16];
+    size_t length;
+  };
+
+  enum { kDateCacheSize = 256 };
+
+  FILE* mOutput;
+  std::vector<char> mBuffer;
+  size_t mUsed;
+
+  std::string* mCopy;
+  size_t mMaxCopySize;
+
+  bool mIsChunked;
+
+  mStd::mString mScratch;
+  CachedDate mDateCache[kDateCacheSize];
+};
+
+#endif
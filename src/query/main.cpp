@@ -7,9 +7,16 @@
 #include <fstream>
 #include <exception>
 #include <algorithm>
+#include <signal.h>
 #include <tclap/CmdLine.h>
 #include <datastore/Database.h>
 #include <datastore/JsonStorage.h>
+#include <datastore/SnapshotStorage.h>
+#include <datastore/PartitionedStorage.h>
+#include <datastore/LsmStorage.h>
+#include "FilterParser.h"
+#include "QueryServer.h"
+#include "ResultWriter.h"
 
 /**
 */
@@ -95,45 +102,19 @@ DataStore::IFieldDescriptorConstListPtrH parseFieldNameList(const std::string& e
 }
 
 /**
+  Append the fields that aren't in outFields already
 */
-DataStore::IQualifierPtrH parseFilterExpression(const std::string& expression, 
-  const DataStore::IFieldDescriptorConstList& fields)
+void addFields(const DataStore::IFieldDescriptorConstList& fields,
+  DataStore::IFieldDescriptorConstList* outFields)
 {
-  //
-  // For now, only support FIELD="value"
-  //
-
-  // Hack some reasonably large values and use sscanf as a quick & dirty parser
-  char fieldName[64];
-  char expectedValue[1024];
-
-  // Doesn't really work for all types of data, but should work for example
-  // data sets.
-  int parsedItems = sscanf(expression.c_str(), "%64[^=]=%1024[^\n]", fieldName, 
-    expectedValue);
-  if (parsedItems != 2)
-  {
-    throw std::runtime_error("Syntax error in filter expression");
-  }
-
-  DataStore::IFieldDescriptorConstPtrH field = findFieldByName(fieldName, fields);
-  if (!field)
-  {
-    std::string ex = "Unrecognized field \"";
-    ex += fieldName;
-    ex += "\" specified in filter expression";
-    throw std::runtime_error(ex);
-  }
-
-  DataStore::ValuePtrH desiredValue = field->fromString(expectedValue);
-  if (!desiredValue)
+  for (DataStore::IFieldDescriptorConstList::const_iterator field = fields.cbegin();
+    field != fields.cend(); ++field)
   {
-    std::string ex = "Syntax error in filter expression, value format is incorrect";
-    throw std::runtime_error(ex);
+    if (!findFieldByName((*field)->getName(), *outFields))
+    {
+      outFields->push_back(*field);
+    }
   }
-
-  DataStore::IQualifierPtrH exactMatch(new DataStore::Logic::Exact(field, desiredValue));
-  return exactMatch;
 }
 
 /**
@@ -160,40 +141,577 @@ void printFields(const DataStore::IFieldDescriptorConstList& fields)
 }
 
 /**
+  A query, its options parsed against the fields of the database
+*/
+struct ParsedQuery
+{
+  ParsedQuery() :
+    filter(DataStore::Predicate::AlwaysTrue())
+  {
+  }
+
+  DataStore::IFieldDescriptorConstListPtrH selectedFields;
+  DataStore::Predicate filter;
+  DataStore::IFieldDescriptorConstListPtrH orderByFields;
+  DataStore::IFieldDescriptorConstPtrH groupField;
+};
+
+/**
+  Parse the selection of a grouped query, e.g. TITLE,REV:sum.  The group
+  field selects its value, FIELD:sum the sum of FIELD in each group.
 */
-void printResult(const DataStore::IQueryResult& result)
+DataStore::IFieldDescriptorConstListPtrH parseGroupSelection(const std::string& expression,
+  const DataStore::IFieldDescriptorConstList& fields,
+  DataStore::IFieldDescriptorConstPtrH groupField)
+{
+  static const std::string kSum = ":sum";
+
+  std::vector<std::string> selected;
+  getStringValuesSeparatedBy(',', expression, &selected);
+
+  DataStore::IFieldDescriptorConstListPtrH selectedFields
+    (new DataStore::IFieldDescriptorConstList());
+
+  for (std::vector<std::string>::const_iterator item = selected.cbegin();
+    item != selected.cend(); ++item)
+  {
+    if (*item == groupField->getName())
+    {
+      selectedFields->push_back(groupField);
+      continue;
+    }
+
+    if (item->size() <= kSum.size() ||
+      item->compare(item->size() - kSum.size(), kSum.size(), kSum) != 0)
+    {
+      std::string ex = "\"" + *item + "\" is neither the group field nor a FIELD:sum";
+      throw std::runtime_error(ex);
+    }
+
+    std::string fieldName = item->substr(0, item->size() - kSum.size());
+    DataStore::IFieldDescriptorConstPtrH field = findFieldByName(fieldName.c_str(), fields);
+    if (!field)
+    {
+      std::string ex = "Unrecognized field \"" + fieldName + "\" specified in list";
+      throw std::runtime_error(ex);
+    }
+
+    selectedFields->push_back(field);
+  }
+
+  return selectedFields;
+}
+
+/**
+  The fields of the scheme that declare a sum by groupField
+*/
+DataStore::IFieldDescriptorConstList summedFields(const DataStore::IFieldDescriptorConstList& fields,
+  const DataStore::IFieldDescriptor& groupField)
+{
+  DataStore::IFieldDescriptorConstList summed;
+
+  for (DataStore::IFieldDescriptorConstList::const_iterator field = fields.cbegin();
+    field != fields.cend(); ++field)
+  {
+    const std::vector<std::string>& aggregateBy = (*field)->getAggregateBy();
+    if (std::find(aggregateBy.cbegin(), aggregateBy.cend(), groupField.getName()) != 
+      aggregateBy.cend())
+    {
+      summed.push_back(*field);
+    }
+  }
+
+  return summed;
+}
+
+/**
+  Parse the selection (-s) and order (-o) into lists of field descriptors,
+  and the filter (-f) into a logical expression AST.  Order is always 
+  ascending.  A grouped query (-g) reads the aggregates the scheme 
+  declares, its selection is the group field and sums, e.g. REV:sum.
+*/
+void parseQuery(const QueryRequest& request,
+  const DataStore::IFieldDescriptorConstList& fields, ParsedQuery* outQuery)
+{
+  if (!request.group.empty())
+  {
+    if (!request.filter.empty() || !request.order.empty())
+    {
+      throw std::runtime_error("-g reads the aggregates kept over all rows, it doesn't take -f or -o");
+    }
+
+    outQuery->groupField = findFieldByName(request.group.c_str(), fields);
+    if (!outQuery->groupField)
+    {
+      std::string ex = "Unrecognized field \"" + request.group + "\" specified to group by";
+      throw std::runtime_error(ex);
+    }
+
+    if (!request.select.empty())
+    {
+      outQuery->selectedFields = parseGroupSelection(request.select, fields,
+        outQuery->groupField);
+    }
+
+    return;
+  }
+
+  if (!request.select.empty())
+  {
+    outQuery->selectedFields = parseFieldNameList(request.select, fields);
+  }
+
+  if (!request.filter.empty())
+  {
+    outQuery->filter = DataStore::Predicate(
+      parseFilterExpression(request.filter, fields));
+  }
+
+  if (!request.order.empty())
+  {
+    outQuery->orderByFields = parseFieldNameList(request.order, fields);
+  }
+}
+
+/**
+  Open the storage of a database.  Snapshots, partitions and runs are 
+  mapped (or read through the pool) rather than parsed.
+*/
+DataStore::IDataStoragePtrH openStorage(const char* datastoreFilename,
+  DataStore::BufferPoolPtrH pool)
+{
+  if (DataStore::DataStorageSnapshot::IsSnapshot(datastoreFilename))
+  {
+    return DataStore::DataStorageSnapshot::Open(datastoreFilename, pool);
+  }
+  else if (DataStore::DataStoragePartitioned::IsPartitioned(datastoreFilename))
+  {
+    return DataStore::DataStoragePartitioned::Open(datastoreFilename, pool);
+  }
+  else if (DataStore::DataStorageLsm::IsLsm(datastoreFilename))
+  {
+    return DataStore::DataStorageLsm::Open(datastoreFilename, pool);
+  }
+  else if (pool)
+  {
+    throw std::runtime_error("A memory limit needs a snapshot, partitioned or log-structured database");
+  }
+  else
+  {
+    return DataStore::DataStorageJson::Open(datastoreFilename);
+  }
+}
+
+/**
+  Open a cursor over the result of query, or over its groups
+*/
+DataStore::IQueryCursorPtrH openQueryCursor(DataStore::Database& database,
+  const ParsedQuery& query)
+{
+  if (query.groupField)
+  {
+    return database.openAggregateCursor(query.groupField, query.selectedFields);
+  }
+
+  return database.openCursor(query.selectedFields, &query.filter, query.orderByFields);
+}
+
+/**
+  Answers the queries sent to a server, from the database it loaded.  A
+  reload opens the storage again, to pick up what was imported since.
+*/
+struct serverQueryHandler
+{
+  serverQueryHandler(DataStore::DatabasePtrH database,
+    const std::string& datastoreFilename, DataStore::BufferPoolPtrH pool) :
+    mDatabase(database),
+    mDatastoreFilename(datastoreFilename),
+    mPool(pool)
+  {
+  }
+
+  DataStore::IQueryCursorPtrH operator() (const QueryRequest& request)
+  {
+    if (request.reload)
+    {
+      mDatabase->reload(openStorage(mDatastoreFilename.c_str(), mPool));
+      return DataStore::IQueryCursorPtrH();
+    }
+
+    ParsedQuery query;
+    parseQuery(request, *mDatabase->getScheme()->getFieldDescriptors(), &query);
+
+    return openQueryCursor(*mDatabase, query);
+  }
+
+  DataStore::DatabasePtrH mDatabase;
+  std::string mDatastoreFilename;
+  DataStore::BufferPoolPtrH mPool;
+};
+
+/**
+  Append the names of fields, separated by commas
+*/
+void describeFields(const DataStore::IFieldDescriptorConstList& fields, std::string* outText)
+{
+  for (DataStore::IFieldDescriptorConstList::const_iterator field = fields.cbegin();
+    field != fields.cend(); ++field)
+  {
+    if (field != fields.cbegin())
+    {
+      *outText += ",";
+    }
+    *outText += (*field)->getName();
+  }
+}
+
+/**
+  The key a server caches the result of a query under: the generation of
+  the database, the selected fields, the filter in its canonical form and
+  the order, or the group.  So the same query spelled another way (e.g. the terms of 
+  an AND swapped) shares the result, until the database changes.
+*/
+struct serverCacheKey
+{
+  explicit serverCacheKey(DataStore::DatabasePtrH database) :
+    mDatabase(database)
+  {
+  }
+
+  std::string operator() (const QueryRequest& request)
+  {
+    if (request.reload)
+    {
+      return std::string();
+    }
+
+    std::ostringstream generation;
+    generation << mDatabase->getGeneration();
+
+    ParsedQuery query;
+    parseQuery(request, *mDatabase->getScheme()->getFieldDescriptors(), &query);
+
+    std::string key = generation.str();
+    key += "\ns=";
+    if (query.selectedFields)
+    {
+      describeFields(*query.selectedFields, &key);
+    }
+    else
+    {
+      key += "*";
+    }
+    key += "\nf=";
+    query.filter.describe(&key);
+    key += "\no=";
+    if (query.orderByFields)
+    {
+      describeFields(*query.orderByFields, &key);
+    }
+    key += "\ng=";
+    if (query.groupField)
+    {
+      key += query.groupField->getName();
+    }
+
+    return key;
+  }
+
+  DataStore::DatabasePtrH mDatabase;
+};
+
+/**
+  Print rows as they are produced by the cursor
+*/
+void printResult(DataStore::IQueryCursor* cursor, FILE* output = stdout)
+{
+  DataStore::IFieldDescriptorConstListConstPtrH fields = cursor->getFieldDescriptors();
+
+  ResultWriter writer(output);
+
+  for (const DataStore::IRow* row = cursor->next(); row != NULL; row = cursor->next())
+  {
+    writer.writeRow(*row, *fields);
+  }
+
+  writer.flush();
+}
+
+/**
+  Print the rows of a result
+*/
+void printResult(const DataStore::IQueryResult& result, FILE* output)
 {
   DataStore::IFieldDescriptorConstListConstPtrH fields = result.getFieldDescriptors();
 
-  for (DataStore::IQueryResult::const_iterator row = result.cbegin();
-    row != result.cend(); ++row)
+  ResultWriter writer(output);
+
+  for (size_t row = 0; row < result.size(); ++row)
   {
-    DataStore::IFieldDescriptorConstList::const_iterator field = fields->cbegin();
+    writer.writeRow(*result[row], *fields);
+  }
+
+  writer.flush();
+}
 
-    if (!fields->empty())
+/**
+  Execution counters go to stderr, so they don't mix with the result
+*/
+void printStats(const DataStore::QueryStats& stats)
+{
+  std::cerr << "Rows scanned: " << stats.rowsScanned << std::endl;
+  std::cerr << "Rows matched: " << stats.rowsMatched << std::endl;
+  std::cerr << "Index used: " << (stats.usedIndex ? "yes" : "no") << std::endl;
+  std::cerr << "Blocks scanned: " << stats.blocksScanned << std::endl;
+  std::cerr << "Blocks skipped: " << stats.blocksSkipped << std::endl;
+}
+
+/**
+  Buffer pool counters, to stderr as well
+*/
+void printPoolStats(const DataStore::BufferPool& pool)
+{
+  std::cerr << "Pool pages: " << pool.getFrameCount() << std::endl;
+  std::cerr << "Pool hits: " << pool.getHitCount() << std::endl;
+  std::cerr << "Pool misses: " << pool.getMissCount() << std::endl;
+  std::cerr << "Pool evictions: " << pool.getEvictionCount() << std::endl;
+}
+
+/**
+  A query of a batch file, and the file its result is written to
+*/
+struct BatchEntry
+{
+  std::string outputFilename;
+  QueryRequest request;
+  ParsedQuery query;
+};
+
+/**
+  Read the queries of a batch file.  Queries are separated by empty lines.
+  Each has an out=<file> line, and s=<select>, f=<filter>, o=<order> and
+  g=<group> lines for the options it is given, as they are sent to a 
+  server.  Lines starting with # are comments.
+*/
+void readBatch(const std::string& batchFilename, std::vector<BatchEntry>* outEntries)
+{
+  std::ifstream batch(batchFilename.c_str());
+  if (!batch)
+  {
+    std::string ex = "Unable to open batch file \"" + batchFilename + "\"";
+    throw std::runtime_error(ex);
+  }
+
+  bool isInQuery = false;
+  size_t lineNumber = 0;
+  for (std::string line; std::getline(batch, line);)
+  {
+    ++lineNumber;
+
+    if (!line.empty() && line[line.size() - 1] == '\r')
     {
-      while (field != fields->cend())
-      {
-        DataStore::ValueConstPtrH v = (*row)->getValue(*(field->get()));
+      line.erase(line.size() - 1);
+    }
+
+    if (line.empty())
+    {
+      isInQuery = false;
+      continue;
+    }
+    if (line[0] == '#')
+    {
+      continue;
+    }
+
+    if (!isInQuery)
+    {
+      outEntries->push_back(BatchEntry());
+      isInQuery = true;
+    }
+    BatchEntry& entry = outEntries->back();
+
+    std::ostringstream ex;
+    ex << "Invalid line " << lineNumber << " of batch file \"" << batchFilename << "\"";
+
+    if (line.compare(0, 4, "out=") == 0)
+    {
+      entry.outputFilename = line.substr(4);
+      continue;
+    }
+    if (line.size() < 2 || line[1] != '=')
+    {
+      throw std::runtime_error(ex.str());
+    }
+
+    switch (line[0])
+    {
+    case 's': entry.request.select = line.substr(2); break;
+    case 'f': entry.request.filter = line.substr(2); break;
+    case 'o': entry.request.order = line.substr(2); break;
+    case 'g': entry.request.group = line.substr(2); break;
+    default: throw std::runtime_error(ex.str());
+    }
+  }
+
+  for (std::vector<BatchEntry>::const_iterator entry = outEntries->cbegin();
+    entry != outEntries->cend(); ++entry)
+  {
+    if (entry->outputFilename.empty())
+    {
+      std::string ex = "A query of batch file \"" + batchFilename + "\" has no out= line";
+      throw std::runtime_error(ex);
+    }
+  }
+}
+
+/**
+  Write each query's result to its own file
+*/
+FILE* openOutput(const std::string& outputFilename)
+{
+  FILE* output = fopen(outputFilename.c_str(), "w");
+  if (output == NULL)
+  {
+    std::string ex = "Unable to write \"" + outputFilename + "\"";
+    throw std::runtime_error(ex);
+  }
+
+  return output;
+}
+
+/**
+  Run the queries of a batch file, loading the database once.  Loads the
+  fields that any query uses, every row, and runs the row queries in a 
+  single pass over them.  Grouped queries read the kept aggregates.
+*/
+void runBatch(DataStore::IDataStoragePtrH storage, const std::string& batchFilename,
+  bool printsStats)
+{
+  DataStore::IFieldDescriptorConstListConstPtrH allFields =
+    storage->getScheme()->getFieldDescriptors();
+
+  std::vector<BatchEntry> entries;
+  readBatch(batchFilename, &entries);
+
+  DataStore::IFieldDescriptorConstListPtrH usedFields(
+    new DataStore::IFieldDescriptorConstList());
+  bool usesAllFields = false;
+
+  for (std::vector<BatchEntry>::iterator entry = entries.begin();
+    entry != entries.end(); ++entry)
+  {
+    try
+    {
+      parseQuery(entry->request, *allFields, &entry->query);
+    }
+    catch (std::exception& ex)
+    {
+      std::string what = "In the query for \"" + entry->outputFilename + "\": " + ex.what();
+      throw std::runtime_error(what);
+    }
+
+    const ParsedQuery& query = entry->query;
+    if (query.groupField)
+    {
+      addFields(DataStore::IFieldDescriptorConstList(1, query.groupField), usedFields.get());
+      addFields(summedFields(*allFields, *query.groupField), usedFields.get());
+    }
+    else if (!query.selectedFields)
+    {
+      usesAllFields = true;
+    }
+
+    DataStore::IFieldDescriptorConstList filterFields;
+    query.filter.getFieldDescriptors(&filterFields);
+
+    if (query.selectedFields)
+    {
+      addFields(*query.selectedFields, usedFields.get());
+    }
+    addFields(filterFields, usedFields.get());
+    if (query.orderByFields)
+    {
+      addFields(*query.orderByFields, usedFields.get());
+    }
+  }
+
+  DataStore::Database database(storage, usesAllFields ?
+    DataStore::IFieldDescriptorConstListPtrH() : usedFields);
+
+  //
+  // The row queries share a pass, then each result goes to its file
+  //
 
-        mStd::mString strValue("");
-        if (v)
-          v->getValue().convertTo(&strValue);
+  DataStore::BatchQueryList batch;
+  for (std::vector<BatchEntry>::const_iterator entry = entries.cbegin();
+    entry != entries.cend(); ++entry)
+  {
+    if (!entry->query.groupField)
+    {
+      DataStore::BatchQuery query;
+      query.select = entry->query.selectedFields;
+      query.filter = entry->query.filter;
+      query.orderBy = entry->query.orderByFields;
+      batch.push_back(query);
+    }
+  }
 
-        std::cout << strValue.c_str();
+  DataStore::IQueryResultConstList results;
+  DataStore::QueryStatsList stats;
+  database.queryBatch(batch, &results, &stats);
 
-        ++field;
-        if (field != fields->cend())
-        {
-          std::cout << ",";
-        }
+  size_t nextResult = 0;
+  for (std::vector<BatchEntry>::const_iterator entry = entries.cbegin();
+    entry != entries.cend(); ++entry)
+  {
+    FILE* output = openOutput(entry->outputFilename);
+    DataStore::QueryStats queryStats;
+
+    try
+    {
+      if (entry->query.groupField)
+      {
+        DataStore::IQueryCursorPtrH cursor = openQueryCursor(database, entry->query);
+        printResult(cursor.get(), output);
+        queryStats = cursor->getStats();
+      }
+      else
+      {
+        printResult(*results[nextResult], output);
+        queryStats = stats[nextResult++];
       }
+    }
+    catch (...)
+    {
+      fclose(output);
+      throw;
+    }
 
-      std::cout << std::endl;
+    if (fclose(output) != 0)
+    {
+      std::string ex = "Unable to write \"" + entry->outputFilename + "\"";
+      throw std::runtime_error(ex);
+    }
+
+    if (printsStats)
+    {
+      std::cerr << entry->outputFilename << ":" << std::endl;
+      printStats(queryStats);
     }
   }
 }
 
+/** The server that SIGINT and SIGTERM stop */
+QueryServer* gServer = NULL;
+
+void stopServer(int)
+{
+  if (gServer != NULL)
+  {
+    gServer->stop();
+  }
+}
+
 /**
 */
 int main(int argc, char** argv)
@@ -202,22 +720,94 @@ int main(int argc, char** argv)
   {
     TCLAP::CmdLine cmd("Query tool", ' ');
     TCLAP::SwitchArg showArg("", "show", "Show fields and exit", false);
+    TCLAP::SwitchArg statsArg("", "stats", "Print query execution statistics to stderr", false);
     TCLAP::ValueArg<std::string> selectArg("s", "select", "Comma separated list of field names to select, if omitted, all fields are selected", false, "", "Field selection");
-    TCLAP::ValueArg<std::string> filterArg("f", "filter", "Filter expression in the form FIELDNAME=\"value\", filters selction", false, "", "Filter expression");
+    TCLAP::ValueArg<std::string> filterArg("f", "filter", "Filter expression in the form FIELDNAME=\"value\", filters selction.  >= and <= are also supported, and terms may be joined with AND and OR (AND takes precedence)", false, "", "Filter expression");
     TCLAP::ValueArg<std::string> orderArg("o", "order", "Comma separated list of field names with which to order a selection", false, "", "Order by");
-    TCLAP::ValueArg<std::string> datastoreFileArg("d", "db", "JSON database file name to load or create", false, "db.json", "Database file");
+    TCLAP::ValueArg<std::string> groupArg("g", "group", "Field name to group by.  The sums that the scheme declares by it (\"aggregateBy\") are kept as rows are imported into a loaded database, so a server (--serve) answers from them without reading the rows.  Run here, the rows are read to sum them.  The selection is the field and FIELD:sum names, if omitted, every sum by the field is selected", false, "", "Group by");
+    TCLAP::ValueArg<std::string> datastoreFileArg("d", "db", "JSON database file name to load or create, a snapshot written by import --snapshot, or a partitioned or log-structured database directory", false, "db.json", "Database file");
+    TCLAP::ValueArg<std::string> serveArg("", "serve", "Load the database once, and answer the queries sent to this Unix domain socket with --connect until stopped", false, "", "Socket path");
+    TCLAP::SwitchArg reloadArg("", "reload", "With --connect, have the server load its database again, to answer from what was imported since.  Queries are answered from the previous rows meanwhile", false);
+    TCLAP::ValueArg<std::string> connectArg("", "connect", "Send the query to the server listening on this Unix domain socket, rather than loading the database", false, "", "Socket path");
+    TCLAP::ValueArg<unsigned int> memoryLimitArg("", "memory-limit", "Megabytes of the stored pages of a snapshot, partitioned or log-structured database to keep in memory.  Pages are read through a buffer pool of this size rather than mapped", false, 0, "Megabytes");
+    TCLAP::ValueArg<std::string> batchArg("", "batch", "Run the queries of this file, loading the database once and sharing a single pass over its rows.  Queries are separated by empty lines, each has an out=<file> line for its result, and s=, f=, o= and g= lines for the options it is given", false, "", "Batch file");
+    TCLAP::ValueArg<unsigned int> serverThreadsArg("", "server-threads", "With --serve, the number of queries answered at once, further connections wait.  0 for twice the hardware threads", false, 0, "Threads");
+    TCLAP::ValueArg<unsigned int> cacheLimitArg("", "cache-limit", "With --serve, megabytes of recent query results to keep, so a query that is asked again is answered without running it.  0 turns the cache off", false, 64, "Megabytes");
     cmd.add(showArg);
+    cmd.add(statsArg);
     cmd.add(selectArg);
     cmd.add(filterArg);
     cmd.add(orderArg);
+    cmd.add(groupArg);
     cmd.add(datastoreFileArg);
+    cmd.add(serveArg);
+    cmd.add(connectArg);
+    cmd.add(reloadArg);
+    cmd.add(memoryLimitArg);
+    cmd.add(cacheLimitArg);
+    cmd.add(serverThreadsArg);
+    cmd.add(batchArg);
     cmd.parse(argc, argv);
 
-    DataStore::DatabasePtrH database =
-      DataStore::DataStorageJson::Load(datastoreFileArg.getValue().c_str());
+    QueryRequest request;
+    request.select = selectArg.getValue();
+    request.filter = filterArg.getValue();
+    request.order = orderArg.getValue();
+    request.group = groupArg.getValue();
+    request.reload = reloadArg.getValue();
+    request.stats = statsArg.getValue();
+
+    //
+    // As a client, the server parses and runs the query
+    //
+    if (connectArg.isSet())
+    {
+      if (serveArg.isSet() || showArg.isSet() || memoryLimitArg.isSet() || 
+        cacheLimitArg.isSet() || serverThreadsArg.isSet() || datastoreFileArg.isSet() ||
+        batchArg.isSet())
+      {
+        throw std::runtime_error("--connect only takes the query, the server has the database");
+      }
+      if (request.reload && (selectArg.isSet() || filterArg.isSet() || orderArg.isSet() ||
+        groupArg.isSet()))
+      {
+        throw std::runtime_error("--reload doesn't take a query");
+      }
+      if (request.stats && (selectArg.isSet() || filterArg.isSet() || orderArg.isSet() ||
+        groupArg.isSet() || request.reload))
+      {
+        throw std::runtime_error("--stats with --connect prints the counters of the server's result cache, it doesn't take a query");
+      }
+
+      // Counters go to stderr, as they do for a query run here
+      QueryServer::Send(connectArg.getValue(), request, request.stats ? stderr : stdout);
+      return 0;
+    }
+    else if (reloadArg.isSet())
+    {
+      throw std::runtime_error("--reload is sent to a server with --connect");
+    }
+    else if (cacheLimitArg.isSet() && !serveArg.isSet())
+    {
+      throw std::runtime_error("--cache-limit is for a server, with --serve");
+    }
+    else if (serverThreadsArg.isSet() && !serveArg.isSet())
+    {
+      throw std::runtime_error("--server-threads is for a server, with --serve");
+    }
+
+    DataStore::BufferPoolPtrH pool;
+    if (memoryLimitArg.isSet())
+    {
+      pool = DataStore::BufferPoolPtrH(new DataStore::BufferPool(
+        (size_t)memoryLimitArg.getValue() * 1024 * 1024));
+    }
+
+    DataStore::IDataStoragePtrH storage = 
+      openStorage(datastoreFileArg.getValue().c_str(), pool);
 
     DataStore::IFieldDescriptorConstListConstPtrH allFields =
-      database->getScheme()->getFieldDescriptors();
+      storage->getScheme()->getFieldDescriptors();
 
     //
     // Show fields and exit?
@@ -229,47 +819,121 @@ int main(int argc, char** argv)
     }
 
     //
-    // Parse selection (-s) into a list of field descriptors
+    // Run a batch of queries, each to its own file
     //
-
-    DataStore::IFieldDescriptorConstListPtrH selectedFields;
-    if (selectArg.isSet())
+    if (batchArg.isSet())
     {
-      selectedFields = parseFieldNameList(selectArg.getValue(),
-        *(allFields.get()));
+      if (selectArg.isSet() || filterArg.isSet() || orderArg.isSet() || groupArg.isSet() ||
+        serveArg.isSet())
+      {
+        throw std::runtime_error("--batch runs the queries of its file, rather than its own");
+      }
+
+      runBatch(storage, batchArg.getValue(), statsArg.getValue());
+      if (statsArg.isSet() && pool)
+      {
+        printPoolStats(*pool);
+      }
+      return 0;
     }
 
     //
-    // Parse filter (-f) expression into a logical expression AST
+    // As a server, load all of the database and answer queries from it
     //
-
-    DataStore::Predicate filter = DataStore::Predicate::AlwaysTrue();
-    if (filterArg.isSet())
+    if (serveArg.isSet())
     {
-      DataStore::IQualifierPtrH filterAst =
-        parseFilterExpression(filterArg.getValue(), *(allFields.get()));
-      filter = DataStore::Predicate(filterAst);
+      if (selectArg.isSet() || filterArg.isSet() || orderArg.isSet() || groupArg.isSet() ||
+        statsArg.isSet())
+      {
+        throw std::runtime_error("--serve answers the queries of --connect, rather than its own");
+      }
+
+      ResultCachePtrH cache;
+      if (cacheLimitArg.getValue() > 0)
+      {
+        cache = ResultCachePtrH(new ResultCache(
+          (size_t)cacheLimitArg.getValue() * 1024 * 1024));
+      }
+
+      DataStore::DatabasePtrH database(new DataStore::Database(storage));
+      QueryServer server(serveArg.getValue(), 
+        serverQueryHandler(database, datastoreFileArg.getValue(), pool),
+        serverCacheKey(database), cache, serverThreadsArg.getValue());
+
+      // Stop on SIGINT or SIGTERM, so the socket is removed
+      gServer = &server;
+      signal(SIGINT, stopServer);
+      signal(SIGTERM, stopServer);
+
+      std::cerr << "Serving \"" << serveArg.getValue() << "\"" << std::endl;
+      server.serve();
+      gServer = NULL;
+      return 0;
     }
 
     //
-    // Parse order (-o) in to list of field descriptors, order is
-    // always ascending.
+    // Parse selection (-s), filter (-f), order (-o) and group (-g)
+    //
+
+    ParsedQuery query;
+    parseQuery(request, *allFields, &query);
+
+    DataStore::IFieldDescriptorConstListPtrH selectedFields = query.selectedFields;
+    const DataStore::Predicate& filter = query.filter;
+    DataStore::IFieldDescriptorConstListPtrH orderByFields = query.orderByFields;
+
+    //
+    // Load only the fields the query uses, unless all of them are selected,
+    // and let the storage skip the rows that don't match the filter.  A 
+    // grouped query uses the group field and the fields summed by it.
     //
 
-    DataStore::IFieldDescriptorConstListPtrH orderByFields;
-    if (orderArg.isSet())
+    DataStore::IFieldDescriptorConstListPtrH usedFields;
+    if (query.groupField)
     {
-      orderByFields = parseFieldNameList(orderArg.getValue(),
-        *(allFields.get()));
+      usedFields = DataStore::IFieldDescriptorConstListPtrH(
+        new DataStore::IFieldDescriptorConstList(1, query.groupField));
+
+      if (selectedFields)
+      {
+        addFields(*selectedFields, usedFields.get());
+      }
+      addFields(summedFields(*allFields, *query.groupField), usedFields.get());
     }
+    else if (selectedFields)
+    {
+      usedFields = DataStore::IFieldDescriptorConstListPtrH(
+        new DataStore::IFieldDescriptorConstList());
+
+      DataStore::IFieldDescriptorConstList filterFields;
+      filter.getFieldDescriptors(&filterFields);
+
+      addFields(*selectedFields, usedFields.get());
+      addFields(filterFields, usedFields.get());
+      if (orderByFields)
+      {
+        addFields(*orderByFields, usedFields.get());
+      }
+    }
+
+    DataStore::DatabasePtrH database(new DataStore::Database(storage, usedFields,
+      request.filter.empty() ? NULL : &filter));
 
     //
     // Perform query, and print result
     //
 
-    DataStore::IQueryResultConstPtrH result =
-      database->query(selectedFields, &filter, orderByFields);
-    printResult(*(result.get()));
+    DataStore::IQueryCursorPtrH cursor = openQueryCursor(*database, query);
+    printResult(cursor.get());
+
+    if (statsArg.isSet())
+    {
+      printStats(cursor->getStats());
+      if (pool)
+      {
+        printPoolStats(*pool);
+      }
+    }
   }
   catch (TCLAP::ArgException &e)
   {
@@ -0,0 +1,102 @@
+
+#include "CppUnitTest.h"
+#include <datastore/Database.h>
+#include <datastore/JsonStorage.h>
+#include <query/FilterParser.h>
+#include <string>
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+
+namespace Tests
+{
+  TEST_CLASS(TestFilterParser)
+  {
+  public:
+    static DataStore::ISchemeConstPtrH CreateScheme()
+    {
+      const char* schemeJson =
+        "[                          "
+        "  {                        "
+        "    \"name\": \"TITLE\",     "
+        "    \"type\": \"text\",    "
+        "    \"key\": true,         "
+        "    \"description\": \"A text field\" "
+        "  },                       "
+        "  {                        "
+        "    \"name\": \"REV\",       "
+        "    \"type\": \"float\",   "
+        "    \"description\": \"A float field\" "
+        "  }                        "
+        "]                          ";
+
+      return DataStore::ISchemeConstPtrH(new DataStore::SchemeJson(schemeJson));
+    }
+
+    /** Rows of database, in key order, that filter matches, joined by ';' */
+    static std::string Matching(DataStore::Database& database, const std::string& filter)
+    {
+      DataStore::Predicate predicate(parseFilterExpression(filter,
+        *database.getScheme()->getFieldDescriptors()));
+
+      DataStore::IFieldDescriptorConstListPtrH title(new DataStore::IFieldDescriptorConstList());
+      title->push_back(database.getScheme()->getFieldDescriptors()->front());
+      DataStore::IQueryResultConstPtrH result = database.query(title, &predicate, title);
+
+      std::string titles;
+      for (size_t row = 0; row < result->size(); ++row)
+      {
+        mStd::mString value;
+        (*result)[row]->getValue(*title->front())->getValue().convertTo(&value);
+        titles += value.c_str();
+        titles += ";";
+      }
+
+      return titles;
+    }
+
+    TEST_METHOD(GivenQuotedValueWithKeywordsVerifyNotSplit)
+    {
+      try
+      {
+        DataStore::ISchemeConstPtrH scheme = CreateScheme();
+        DataStore::Database database(scheme);
+        DataStore::IFieldDescriptorConstListConstPtrH fields = scheme->getFieldDescriptors();
+
+        const char* values[][2] = {
+          { "war AND peace", "4" },
+          { "war", "6" },
+          { "peace", "8" },
+          { "this OR that", "2" }
+        };
+
+        for (int i = 0; i < 4; ++i)
+        {
+          DataStore::IRowPtrH row = database.createRow();
+          for (int field = 0; field < 2; ++field)
+          {
+            row->setValue(*(*fields)[field], (*fields)[field]->fromString(values[i][field]));
+          }
+          Assert::IsTrue(database.insert(row));
+        }
+
+        Assert::AreEqual(std::string("war AND peace;"),
+          Matching(database, "TITLE=\"war AND peace\""));
+        Assert::AreEqual(std::string("this OR that;"),
+          Matching(database, "TITLE=\"this OR that\""));
+        Assert::AreEqual(std::string("this OR that;war AND peace;"),
+          Matching(database, "TITLE=\"war AND peace\" OR TITLE=\"this OR that\""));
+        Assert::AreEqual(std::string("war AND peace;"),
+          Matching(database, "TITLE=\"war AND peace\" AND REV<=5"));
+
+        // Unquoted, the keyword still joins terms
+        Assert::AreEqual(std::string("peace;war;"),
+          Matching(database, "TITLE=war OR TITLE=peace"));
+      }
+      catch (std::exception& ex)
+      {
+        Logger::WriteMessage(ex.what());
+        Assert::Fail(L"Exception");
+      }
+    }
+  };
+}
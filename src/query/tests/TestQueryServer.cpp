@@ -0,0 +1,152 @@
+
+#include "CppUnitTest.h"
+#include <query/QueryServer.h>
+#include <chrono>
+#include <stdio.h>
+#include <string>
+#include <thread>
+
+// The server needs Unix domain sockets
+#ifndef _WIN32
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#include <string.h>
+#include <unistd.h>
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+
+namespace Tests
+{
+  TEST_CLASS(TestQueryServer)
+  {
+  public:
+    static std::string SocketPath()
+    {
+      char path[64];
+      sprintf(path, "/tmp/TestQueryServer.%d.sock", (int)getpid());
+      return path;
+    }
+
+    /** Answers every query with no rows */
+    static DataStore::IQueryCursorPtrH NoRows(const QueryRequest&)
+    {
+      return DataStore::IQueryCursorPtrH();
+    }
+
+    /** Connect to socketPath, send request as is, and leave it open */
+    static int SendPartial(const std::string& socketPath, const std::string& request)
+    {
+      sockaddr_un address;
+      memset(&address, 0, sizeof(address));
+      address.sun_family = AF_UNIX;
+      strncpy(address.sun_path, socketPath.c_str(), sizeof(address.sun_path) - 1);
+
+      int connection = socket(AF_UNIX, SOCK_STREAM, 0);
+      Assert::IsTrue(connection >= 0);
+      Assert::IsTrue(connect(connection, (const sockaddr*)&address, sizeof(address)) == 0);
+
+      for (size_t sent = 0; sent < request.size();)
+      {
+        ssize_t count = send(connection, request.data() + sent, request.size() - sent, 0);
+        Assert::IsTrue(count > 0);
+        sent += (size_t)count;
+      }
+
+      return connection;
+    }
+
+    /** What the server answered on connection, until it closed it */
+    static std::string Receive(int connection)
+    {
+      timeval timeout;
+      timeout.tv_sec = 5;
+      timeout.tv_usec = 0;
+      setsockopt(connection, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+
+      std::string response;
+      char buffer[256];
+      for (ssize_t count = recv(connection, buffer, sizeof(buffer), 0); count > 0;
+        count = recv(connection, buffer, sizeof(buffer), 0))
+      {
+        response.append(buffer, (size_t)count);
+      }
+      close(connection);
+
+      return response;
+    }
+
+    TEST_METHOD(GivenIdleConnectionVerifyNextQueryAnswered)
+    {
+      try
+      {
+        // A single thread, which the idle connection would hold
+        std::string socketPath = SocketPath();
+        QueryServer server(socketPath, NoRows, QueryServer::CacheKey(),
+          ResultCachePtrH(), 1);
+        server.setRequestTimeout(200);
+        std::thread serving(&QueryServer::serve, &server);
+
+        int idle = SendPartial(socketPath, "s=TITLE\n");
+
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        QueryRequest request;
+        request.select = "TITLE";
+        FILE* output = tmpfile();
+        QueryServer::Send(socketPath, request, output);
+        fclose(output);
+        Assert::IsTrue(std::chrono::steady_clock::now() - start < std::chrono::seconds(5));
+
+        Assert::AreEqual(std::string("error: Request timed out\n"), Receive(idle));
+
+        server.stop();
+        serving.join();
+      }
+      catch (std::exception& ex)
+      {
+        Logger::WriteMessage(ex.what());
+        Assert::Fail(L"Exception");
+      }
+    }
+
+    TEST_METHOD(GivenOversizedRequestVerifyFailure)
+    {
+      try
+      {
+        std::string socketPath = SocketPath();
+        QueryServer server(socketPath, NoRows, QueryServer::CacheKey(),
+          ResultCachePtrH(), 1);
+        std::thread serving(&QueryServer::serve, &server);
+
+        std::string longLine = "f=" + std::string(100 * 1024, 'x') + "\n\n";
+        Assert::AreEqual(std::string("error: Request line is too long\n"),
+          Receive(SendPartial(socketPath, longLine)));
+
+        std::string manyLines;
+        for (int line = 0; line < 100; ++line)
+        {
+          manyLines += "s=TITLE\n";
+        }
+        manyLines += "\n";
+        Assert::AreEqual(std::string("error: Request has too many lines\n"),
+          Receive(SendPartial(socketPath, manyLines)));
+
+        // Still answering
+        QueryRequest request;
+        FILE* output = tmpfile();
+        QueryServer::Send(socketPath, request, output);
+        fclose(output);
+
+        server.stop();
+        serving.join();
+      }
+      catch (std::exception& ex)
+      {
+        Logger::WriteMessage(ex.what());
+        Assert::Fail(L"Exception");
+      }
+    }
+  };
+}
+
+#endif
@@ -0,0 +1,109 @@
+
+#include "CppUnitTest.h"
+#include <datastore/Database.h>
+#include <datastore/JsonStorage.h>
+#include <query/ResultWriter.h>
+#include <stdio.h>
+#include <string>
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+
+namespace Tests
+{
+  TEST_CLASS(TestResultWriter)
+  {
+  public:
+    static DataStore::ISchemeConstPtrH CreateScheme()
+    {
+      const char* schemeJson =
+        "[                          "
+        "  {                        "
+        "    \"name\": \"TITLE\",     "
+        "    \"type\": \"text\",    "
+        "    \"key\": true,         "
+        "    \"description\": \"A text field\" "
+        "  },                       "
+        "  {                        "
+        "    \"name\": \"DATE\",      "
+        "    \"type\": \"date\",    "
+        "    \"description\": \"A date field\" "
+        "  },                       "
+        "  {                        "
+        "    \"name\": \"REV\",       "
+        "    \"type\": \"float\",   "
+        "    \"description\": \"A float field\" "
+        "  }                        "
+        "]                          ";
+
+      return DataStore::ISchemeConstPtrH(new DataStore::SchemeJson(schemeJson));
+    }
+
+    /** Write every row of database, in order, and return the text */
+    static std::string WriteRows(DataStore::Database& database)
+    {
+      FILE* output = tmpfile();
+      Assert::IsTrue(output != NULL);
+
+      DataStore::IFieldDescriptorConstListConstPtrH fields =
+        database.getScheme()->getFieldDescriptors();
+      DataStore::IQueryResultConstPtrH result = database.query(fields, NULL, fields);
+
+      {
+        ResultWriter writer(output);
+        for (size_t row = 0; row < result->size(); ++row)
+        {
+          writer.writeRow(*(*result)[row], *fields);
+        }
+      }
+
+      std::string text;
+      rewind(output);
+      for (int c = fgetc(output); c != EOF; c = fgetc(output))
+      {
+        text += (char)c;
+      }
+      fclose(output);
+
+      return text;
+    }
+
+    TEST_METHOD(GivenFloatsVerifyTwoDecimals)
+    {
+      try
+      {
+        DataStore::ISchemeConstPtrH scheme = CreateScheme();
+        DataStore::Database database(scheme);
+        DataStore::IFieldDescriptorConstListConstPtrH fields = scheme->getFieldDescriptors();
+
+        const char* values[][3] = {
+          { "a", "2014-04-01", "4" },
+          { "b", "2014-04-02", "12345.67" },
+          { "c", "2014-04-03", "1234567" },
+          { "d", "2014-04-04", "0.5" }
+        };
+
+        for (int i = 0; i < 4; ++i)
+        {
+          DataStore::IRowPtrH row = database.createRow();
+          for (int field = 0; field < 3; ++field)
+          {
+            row->setValue(*(*fields)[field], (*fields)[field]->fromString(values[i][field]));
+          }
+          Assert::IsTrue(database.insert(row));
+        }
+
+        // The same text as the baseline conversion and the sums of -g
+        Assert::AreEqual(std::string(
+          "a,2014-04-01,4.00\n"
+          "b,2014-04-02,12345.67\n"
+          "c,2014-04-03,1234567.00\n"
+          "d,2014-04-04,0.50\n"), WriteRows(database));
+      }
+      catch (std::exception& ex)
+      {
+        Logger::WriteMessage(ex.what());
+        Assert::Fail(L"Exception");
+      }
+    }
+  };
+}